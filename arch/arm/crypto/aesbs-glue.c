@@ -0,0 +1,654 @@
+/*
+ * linux/arch/arm/crypto/aesbs-glue.c - glue code for NEON bit sliced AES
+ *
+ * The bit sliced code in aesbs-core.S works on eight blocks at a time,
+ * so it is only offered for the modes that can be parallelized: CBC
+ * decryption, CTR and XTS.  CBC encryption uses the generic cipher.
+ *
+ * The NEON unit is only available to the kernel in process context, so
+ * the algorithms exported to users are asynchronous wrappers which run
+ * the synchronous "__driver-*" implementations directly when possible
+ * and defer to cryptd when called from interrupt context.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <asm/neon.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/cryptd.h>
+#include <crypto/xts.h>
+#include <linux/hardirq.h>
+#include <linux/module.h>
+
+#define AESBS_BLOCKS		8
+#define AESBS_BATCH		(AESBS_BLOCKS * AES_BLOCK_SIZE)
+
+/* one bit sliced round key per round plus one, 128 bytes each */
+#define AESBS_KEY_SIZE		(AES_MAX_KEYLENGTH_U32 / 4 * AESBS_BATCH)
+
+asmlinkage void aesbs_encrypt8(u8 out[], u8 const in[], u8 const bskey[],
+			       int rounds);
+asmlinkage void aesbs_decrypt8(u8 out[], u8 const in[], u8 const bskey[],
+			       int rounds);
+
+typedef void (*aesbs_fn_t)(u8 out[], u8 const in[], u8 const bskey[],
+			   int rounds);
+
+struct aesbs_ctx {
+	int rounds;
+	u8 bskey[AESBS_KEY_SIZE];
+};
+
+struct aesbs_cbc_ctx {
+	struct aesbs_ctx dec;
+	struct crypto_cipher *enc;
+};
+
+struct aesbs_xts_ctx {
+	struct aesbs_ctx crypt;
+	struct crypto_cipher *tweak;
+};
+
+struct async_aesbs_ctx {
+	struct cryptd_ablkcipher *cryptd_tfm;
+};
+
+/*
+ * Convert an expanded key into the bit sliced layout of aesbs-core.S:
+ * byte j of slice i of a round key is 0xff if bit 7 - i of round key byte
+ * m0[j] is set, m0 being the column to row major permutation.  The 0x63
+ * added by the S-box is folded into all round keys but the first.
+ */
+static void aesbs_convert_key(u8 *bskey, const u32 *rk, int rounds)
+{
+	static const u8 m0[AES_BLOCK_SIZE] = {
+		0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15
+	};
+	int r, i, j;
+
+	for (r = 0; r <= rounds; r++, rk += 4) {
+		for (i = 0; i < 8; i++) {
+			u8 inv = (r && (0x63 & (0x80 >> i))) ? 0xff : 0;
+
+			for (j = 0; j < AES_BLOCK_SIZE; j++) {
+				u8 b = rk[m0[j] / 4] >> (8 * (m0[j] % 4));
+
+				*bskey++ = (((b << i) & 0x80) ? 0xff : 0) ^ inv;
+			}
+		}
+	}
+}
+
+static int aesbs_set_key(struct aesbs_ctx *ctx, const u8 *in_key,
+			 unsigned int key_len, u32 *flags)
+{
+	struct crypto_aes_ctx rk;
+	int err;
+
+	err = crypto_aes_expand_key(&rk, in_key, key_len);
+	if (err) {
+		*flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return err;
+	}
+
+	ctx->rounds = 6 + key_len / 4;
+	aesbs_convert_key(ctx->bskey, rk.key_enc, ctx->rounds);
+	memset(&rk, 0, sizeof(rk));
+
+	return 0;
+}
+
+/* Process up to AESBS_BLOCKS blocks in place. */
+static void aesbs_crypt(aesbs_fn_t fn, struct aesbs_ctx *ctx, u8 *blks,
+			unsigned int nbytes)
+{
+	u8 buf[AESBS_BATCH];
+
+	if (nbytes == AESBS_BATCH) {
+		fn(blks, blks, ctx->bskey, ctx->rounds);
+		return;
+	}
+
+	memcpy(buf, blks, nbytes);
+	fn(buf, buf, ctx->bskey, ctx->rounds);
+	memcpy(blks, buf, nbytes);
+}
+
+static int aesbs_cbc_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	err = aesbs_set_key(&ctx->dec, in_key, key_len, &tfm->crt_flags);
+	if (err)
+		return err;
+
+	return crypto_cipher_setkey(ctx->enc, in_key, key_len);
+}
+
+static int aesbs_cbc_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst,
+			     struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+		u8 *iv = walk.iv;
+
+		do {
+			if (d != s)
+				memcpy(d, s, AES_BLOCK_SIZE);
+			crypto_xor(d, iv, AES_BLOCK_SIZE);
+			crypto_cipher_encrypt_one(ctx->enc, d, d);
+			iv = d;
+
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+			nbytes -= AES_BLOCK_SIZE;
+		} while (nbytes >= AES_BLOCK_SIZE);
+
+		memcpy(walk.iv, iv, AES_BLOCK_SIZE);
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+/*
+ * Decrypt up to AESBS_BLOCKS blocks.  All of src is read before dst is
+ * written, so the two may be the same.
+ */
+static void aesbs_cbc_decrypt_blocks(struct aesbs_ctx *ctx, u8 *dst,
+				     const u8 *src, unsigned int nbytes,
+				     u8 *iv)
+{
+	u8 buf[AESBS_BATCH];
+	unsigned int i;
+
+	if (nbytes == AESBS_BATCH) {
+		aesbs_decrypt8(buf, src, ctx->bskey, ctx->rounds);
+	} else {
+		memcpy(buf, src, nbytes);
+		aesbs_decrypt8(buf, buf, ctx->bskey, ctx->rounds);
+	}
+
+	crypto_xor(buf, iv, AES_BLOCK_SIZE);
+	for (i = AES_BLOCK_SIZE; i < nbytes; i += AES_BLOCK_SIZE)
+		crypto_xor(buf + i, src + i - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+
+	memcpy(iv, src + nbytes - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+	memcpy(dst, buf, nbytes);
+}
+
+static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst,
+			     struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	kernel_neon_begin();
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		while (nbytes >= AES_BLOCK_SIZE) {
+			unsigned int n = min_t(unsigned int, AESBS_BATCH,
+					round_down(nbytes, AES_BLOCK_SIZE));
+
+			aesbs_cbc_decrypt_blocks(&ctx->dec, d, s, n, walk.iv);
+			s += n;
+			d += n;
+			nbytes -= n;
+		}
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	kernel_neon_end();
+
+	return err;
+}
+
+static int aesbs_ctr_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	return aesbs_set_key(ctx, in_key, key_len, &tfm->crt_flags);
+}
+
+/*
+ * XOR up to AESBS_BLOCKS blocks of keystream into dst; the last block
+ * may be partial.
+ */
+static void aesbs_ctr_blocks(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			     unsigned int nbytes, u8 *ctr)
+{
+	u8 ks[AESBS_BATCH];
+	unsigned int i;
+
+	for (i = 0; i < nbytes; i += AES_BLOCK_SIZE) {
+		memcpy(ks + i, ctr, AES_BLOCK_SIZE);
+		crypto_inc(ctr, AES_BLOCK_SIZE);
+	}
+	aesbs_encrypt8(ks, ks, ctx->bskey, ctx->rounds);
+
+	if (dst != src)
+		memcpy(dst, src, nbytes);
+	crypto_xor(dst, ks, nbytes);
+}
+
+static int aesbs_ctr_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst,
+			   struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AES_BLOCK_SIZE);
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	kernel_neon_begin();
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		while (nbytes >= AES_BLOCK_SIZE) {
+			unsigned int n = min_t(unsigned int, AESBS_BATCH,
+					round_down(nbytes, AES_BLOCK_SIZE));
+
+			aesbs_ctr_blocks(ctx, d, s, n, walk.iv);
+			s += n;
+			d += n;
+			nbytes -= n;
+		}
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	if (walk.nbytes) {
+		aesbs_ctr_blocks(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+				 walk.nbytes, walk.iv);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+	kernel_neon_end();
+
+	return err;
+}
+
+static int aesbs_xts_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+	u32 *flags = &tfm->crt_flags;
+	int err;
+
+	/* key consists of keys of equal size concatenated, therefore
+	 * the length must be even
+	 */
+	if (key_len % 2) {
+		*flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	/* first half of xts-key is for crypt */
+	err = aesbs_set_key(&ctx->crypt, in_key, key_len / 2, flags);
+	if (err)
+		return err;
+
+	/* second half of xts-key is for tweak */
+	return crypto_cipher_setkey(ctx->tweak, in_key + key_len / 2,
+				    key_len / 2);
+}
+
+static void aesbs_xts_tweak(void *tfm, u8 *dst, const u8 *src)
+{
+	crypto_cipher_encrypt_one(tfm, dst, src);
+}
+
+static void aesbs_xts_encrypt_fn(void *ctx, u8 *blks, unsigned int nbytes)
+{
+	aesbs_crypt(aesbs_encrypt8, ctx, blks, nbytes);
+}
+
+static void aesbs_xts_decrypt_fn(void *ctx, u8 *blks, unsigned int nbytes)
+{
+	aesbs_crypt(aesbs_decrypt8, ctx, blks, nbytes);
+}
+
+static int aesbs_xts_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes,
+			   void (*fn)(void *, u8 *, unsigned int))
+{
+	struct aesbs_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	be128 buf[AESBS_BLOCKS];
+	struct xts_crypt_req req = {
+		.tbuf = buf,
+		.tbuflen = sizeof(buf),
+
+		.tweak_ctx = ctx->tweak,
+		.tweak_fn = aesbs_xts_tweak,
+		.crypt_ctx = &ctx->crypt,
+		.crypt_fn = fn,
+	};
+	int ret;
+
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+	kernel_neon_begin();
+	ret = xts_crypt(desc, dst, src, nbytes, &req);
+	kernel_neon_end();
+
+	return ret;
+}
+
+static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst,
+			     struct scatterlist *src, unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, aesbs_xts_encrypt_fn);
+}
+
+static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst,
+			     struct scatterlist *src, unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, aesbs_xts_decrypt_fn);
+}
+
+static int aesbs_cbc_init_tfm(struct crypto_tfm *tfm)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->enc = crypto_alloc_cipher("aes", 0, 0);
+	return PTR_RET(ctx->enc);
+}
+
+static void aesbs_cbc_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_cipher(ctx->enc);
+}
+
+static int aesbs_xts_init_tfm(struct crypto_tfm *tfm)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->tweak = crypto_alloc_cipher("aes", 0, 0);
+	return PTR_RET(ctx->tweak);
+}
+
+static void aesbs_xts_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_cipher(ctx->tweak);
+}
+
+static int ablk_set_key(struct crypto_ablkcipher *tfm, const u8 *key,
+			unsigned int key_len)
+{
+	struct async_aesbs_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	struct crypto_ablkcipher *child = &ctx->cryptd_tfm->base;
+	int err;
+
+	crypto_ablkcipher_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_ablkcipher_set_flags(child, crypto_ablkcipher_get_flags(tfm)
+				    & CRYPTO_TFM_REQ_MASK);
+	err = crypto_ablkcipher_setkey(child, key, key_len);
+	crypto_ablkcipher_set_flags(tfm, crypto_ablkcipher_get_flags(child)
+				    & CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static int __ablk_encrypt(struct ablkcipher_request *req)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct async_aesbs_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	struct blkcipher_desc desc;
+
+	desc.tfm = cryptd_ablkcipher_child(ctx->cryptd_tfm);
+	desc.info = req->info;
+	desc.flags = 0;
+
+	return crypto_blkcipher_crt(desc.tfm)->encrypt(
+		&desc, req->dst, req->src, req->nbytes);
+}
+
+static int ablk_encrypt(struct ablkcipher_request *req)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct async_aesbs_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+
+	if (in_interrupt()) {
+		struct ablkcipher_request *cryptd_req =
+			ablkcipher_request_ctx(req);
+
+		memcpy(cryptd_req, req, sizeof(*req));
+		ablkcipher_request_set_tfm(cryptd_req, &ctx->cryptd_tfm->base);
+
+		return crypto_ablkcipher_encrypt(cryptd_req);
+	} else {
+		return __ablk_encrypt(req);
+	}
+}
+
+static int ablk_decrypt(struct ablkcipher_request *req)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct async_aesbs_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+
+	if (in_interrupt()) {
+		struct ablkcipher_request *cryptd_req =
+			ablkcipher_request_ctx(req);
+
+		memcpy(cryptd_req, req, sizeof(*req));
+		ablkcipher_request_set_tfm(cryptd_req, &ctx->cryptd_tfm->base);
+
+		return crypto_ablkcipher_decrypt(cryptd_req);
+	} else {
+		struct blkcipher_desc desc;
+
+		desc.tfm = cryptd_ablkcipher_child(ctx->cryptd_tfm);
+		desc.info = req->info;
+		desc.flags = 0;
+
+		return crypto_blkcipher_crt(desc.tfm)->decrypt(
+			&desc, req->dst, req->src, req->nbytes);
+	}
+}
+
+static void ablk_exit(struct crypto_tfm *tfm)
+{
+	struct async_aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	cryptd_free_ablkcipher(ctx->cryptd_tfm);
+}
+
+static int ablk_init(struct crypto_tfm *tfm)
+{
+	struct async_aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct cryptd_ablkcipher *cryptd_tfm;
+	char drv_name[CRYPTO_MAX_ALG_NAME];
+
+	snprintf(drv_name, sizeof(drv_name), "__driver-%s",
+					crypto_tfm_alg_driver_name(tfm));
+
+	cryptd_tfm = cryptd_alloc_ablkcipher(drv_name, 0, 0);
+	if (IS_ERR(cryptd_tfm))
+		return PTR_ERR(cryptd_tfm);
+
+	ctx->cryptd_tfm = cryptd_tfm;
+	tfm->crt_ablkcipher.reqsize = sizeof(struct ablkcipher_request) +
+		crypto_ablkcipher_reqsize(&cryptd_tfm->base);
+
+	return 0;
+}
+
+static struct crypto_alg aesbs_algs[] = { {
+	.cra_name		= "__cbc-aes-neonbs",
+	.cra_driver_name	= "__driver-cbc-aes-neonbs",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_cbc_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= aesbs_cbc_init_tfm,
+	.cra_exit		= aesbs_cbc_exit_tfm,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_cbc_set_key,
+			.encrypt	= aesbs_cbc_encrypt,
+			.decrypt	= aesbs_cbc_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "__ctr-aes-neonbs",
+	.cra_driver_name	= "__driver-ctr-aes-neonbs",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_ctr_set_key,
+			.encrypt	= aesbs_ctr_crypt,
+			.decrypt	= aesbs_ctr_crypt,
+		},
+	},
+}, {
+	.cra_name		= "__xts-aes-neonbs",
+	.cra_driver_name	= "__driver-xts-aes-neonbs",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_xts_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= aesbs_xts_init_tfm,
+	.cra_exit		= aesbs_xts_exit_tfm,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+			.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_xts_set_key,
+			.encrypt	= aesbs_xts_encrypt,
+			.decrypt	= aesbs_xts_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct async_aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= ablk_init,
+	.cra_exit		= ablk_exit,
+	.cra_u = {
+		.ablkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= ablk_set_key,
+			.encrypt	= __ablk_encrypt,
+			.decrypt	= ablk_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct async_aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= ablk_init,
+	.cra_exit		= ablk_exit,
+	.cra_u = {
+		.ablkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= ablk_set_key,
+			.encrypt	= ablk_encrypt,
+			.decrypt	= ablk_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct async_aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= ablk_init,
+	.cra_exit		= ablk_exit,
+	.cra_u = {
+		.ablkcipher = {
+			.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+			.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= ablk_set_key,
+			.encrypt	= ablk_encrypt,
+			.decrypt	= ablk_decrypt,
+		},
+	},
+} };
+
+static int __init aesbs_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	return crypto_register_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
+}
+
+static void __exit aesbs_mod_exit(void)
+{
+	crypto_unregister_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
+}
+
+module_init(aesbs_mod_init);
+module_exit(aesbs_mod_exit);
+
+MODULE_DESCRIPTION("Bit sliced AES in CBC/CTR/XTS modes using NEON");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,29 @@
+/*
+ * linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * Kernel mode NEON: any NEON code must be bracketed by a
+ * kernel_neon_begin()/kernel_neon_end() pair, must not sleep, and must
+ * not be used from interrupt context.  Keep the NEON code itself in a
+ * separate assembler file (or a C file built with -mfpu=neon) so the
+ * compiler cannot move NEON instructions outside of the pair.
+ *
+ * HWCAP_NEON is set by vfp_init() at core_initcall time, so users must
+ * not check cpu_has_neon() from pure or early initcalls.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif /* __ASM_ARM_NEON_H */
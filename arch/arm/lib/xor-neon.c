@@ -0,0 +1,171 @@
+/*
+ * linux/arch/arm/lib/xor-neon.c
+ *
+ * NEON inner loops for the xor_blocks() templates in <asm/xor.h>.
+ *
+ * This file is built with -mfpu=neon, so GCC may emit NEON instructions
+ * anywhere in it; the functions must only be called between
+ * kernel_neon_begin() and kernel_neon_end().  It deliberately includes
+ * no kernel headers other than <linux/export.h>, as GCC's <arm_neon.h>
+ * does not mix well with the kernel's own type definitions.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/export.h>
+#include <arm_neon.h>
+
+/*
+ * Each iteration handles 64 bytes (four quadword registers) per source,
+ * so 'bytes' must be a multiple of 64.
+ */
+
+void xor_neon_inner_2(unsigned long bytes, unsigned long *p1,
+		      unsigned long *p2)
+{
+	uint64_t *dp = (uint64_t *)p1;
+	uint64_t *s1 = (uint64_t *)p2;
+	unsigned long lines = bytes / (sizeof(uint64x2_t) * 4);
+
+	do {
+		uint64x2_t v0, v1, v2, v3;
+
+		v0 = veorq_u64(vld1q_u64(dp + 0), vld1q_u64(s1 + 0));
+		v1 = veorq_u64(vld1q_u64(dp + 2), vld1q_u64(s1 + 2));
+		v2 = veorq_u64(vld1q_u64(dp + 4), vld1q_u64(s1 + 4));
+		v3 = veorq_u64(vld1q_u64(dp + 6), vld1q_u64(s1 + 6));
+
+		vst1q_u64(dp + 0, v0);
+		vst1q_u64(dp + 2, v1);
+		vst1q_u64(dp + 4, v2);
+		vst1q_u64(dp + 6, v3);
+
+		dp += 8;
+		s1 += 8;
+	} while (--lines > 0);
+}
+EXPORT_SYMBOL(xor_neon_inner_2);
+
+void xor_neon_inner_3(unsigned long bytes, unsigned long *p1,
+		      unsigned long *p2, unsigned long *p3)
+{
+	uint64_t *dp = (uint64_t *)p1;
+	uint64_t *s1 = (uint64_t *)p2;
+	uint64_t *s2 = (uint64_t *)p3;
+	unsigned long lines = bytes / (sizeof(uint64x2_t) * 4);
+
+	do {
+		uint64x2_t v0, v1, v2, v3;
+
+		v0 = veorq_u64(vld1q_u64(dp + 0), vld1q_u64(s1 + 0));
+		v1 = veorq_u64(vld1q_u64(dp + 2), vld1q_u64(s1 + 2));
+		v2 = veorq_u64(vld1q_u64(dp + 4), vld1q_u64(s1 + 4));
+		v3 = veorq_u64(vld1q_u64(dp + 6), vld1q_u64(s1 + 6));
+
+		v0 = veorq_u64(v0, vld1q_u64(s2 + 0));
+		v1 = veorq_u64(v1, vld1q_u64(s2 + 2));
+		v2 = veorq_u64(v2, vld1q_u64(s2 + 4));
+		v3 = veorq_u64(v3, vld1q_u64(s2 + 6));
+
+		vst1q_u64(dp + 0, v0);
+		vst1q_u64(dp + 2, v1);
+		vst1q_u64(dp + 4, v2);
+		vst1q_u64(dp + 6, v3);
+
+		dp += 8;
+		s1 += 8;
+		s2 += 8;
+	} while (--lines > 0);
+}
+EXPORT_SYMBOL(xor_neon_inner_3);
+
+void xor_neon_inner_4(unsigned long bytes, unsigned long *p1,
+		      unsigned long *p2, unsigned long *p3,
+		      unsigned long *p4)
+{
+	uint64_t *dp = (uint64_t *)p1;
+	uint64_t *s1 = (uint64_t *)p2;
+	uint64_t *s2 = (uint64_t *)p3;
+	uint64_t *s3 = (uint64_t *)p4;
+	unsigned long lines = bytes / (sizeof(uint64x2_t) * 4);
+
+	do {
+		uint64x2_t v0, v1, v2, v3;
+
+		v0 = veorq_u64(vld1q_u64(dp + 0), vld1q_u64(s1 + 0));
+		v1 = veorq_u64(vld1q_u64(dp + 2), vld1q_u64(s1 + 2));
+		v2 = veorq_u64(vld1q_u64(dp + 4), vld1q_u64(s1 + 4));
+		v3 = veorq_u64(vld1q_u64(dp + 6), vld1q_u64(s1 + 6));
+
+		v0 = veorq_u64(v0, vld1q_u64(s2 + 0));
+		v1 = veorq_u64(v1, vld1q_u64(s2 + 2));
+		v2 = veorq_u64(v2, vld1q_u64(s2 + 4));
+		v3 = veorq_u64(v3, vld1q_u64(s2 + 6));
+
+		v0 = veorq_u64(v0, vld1q_u64(s3 + 0));
+		v1 = veorq_u64(v1, vld1q_u64(s3 + 2));
+		v2 = veorq_u64(v2, vld1q_u64(s3 + 4));
+		v3 = veorq_u64(v3, vld1q_u64(s3 + 6));
+
+		vst1q_u64(dp + 0, v0);
+		vst1q_u64(dp + 2, v1);
+		vst1q_u64(dp + 4, v2);
+		vst1q_u64(dp + 6, v3);
+
+		dp += 8;
+		s1 += 8;
+		s2 += 8;
+		s3 += 8;
+	} while (--lines > 0);
+}
+EXPORT_SYMBOL(xor_neon_inner_4);
+
+void xor_neon_inner_5(unsigned long bytes, unsigned long *p1,
+		      unsigned long *p2, unsigned long *p3,
+		      unsigned long *p4, unsigned long *p5)
+{
+	uint64_t *dp = (uint64_t *)p1;
+	uint64_t *s1 = (uint64_t *)p2;
+	uint64_t *s2 = (uint64_t *)p3;
+	uint64_t *s3 = (uint64_t *)p4;
+	uint64_t *s4 = (uint64_t *)p5;
+	unsigned long lines = bytes / (sizeof(uint64x2_t) * 4);
+
+	do {
+		uint64x2_t v0, v1, v2, v3;
+
+		v0 = veorq_u64(vld1q_u64(dp + 0), vld1q_u64(s1 + 0));
+		v1 = veorq_u64(vld1q_u64(dp + 2), vld1q_u64(s1 + 2));
+		v2 = veorq_u64(vld1q_u64(dp + 4), vld1q_u64(s1 + 4));
+		v3 = veorq_u64(vld1q_u64(dp + 6), vld1q_u64(s1 + 6));
+
+		v0 = veorq_u64(v0, vld1q_u64(s2 + 0));
+		v1 = veorq_u64(v1, vld1q_u64(s2 + 2));
+		v2 = veorq_u64(v2, vld1q_u64(s2 + 4));
+		v3 = veorq_u64(v3, vld1q_u64(s2 + 6));
+
+		v0 = veorq_u64(v0, vld1q_u64(s3 + 0));
+		v1 = veorq_u64(v1, vld1q_u64(s3 + 2));
+		v2 = veorq_u64(v2, vld1q_u64(s3 + 4));
+		v3 = veorq_u64(v3, vld1q_u64(s3 + 6));
+
+		v0 = veorq_u64(v0, vld1q_u64(s4 + 0));
+		v1 = veorq_u64(v1, vld1q_u64(s4 + 2));
+		v2 = veorq_u64(v2, vld1q_u64(s4 + 4));
+		v3 = veorq_u64(v3, vld1q_u64(s4 + 6));
+
+		vst1q_u64(dp + 0, v0);
+		vst1q_u64(dp + 2, v1);
+		vst1q_u64(dp + 4, v2);
+		vst1q_u64(dp + 6, v3);
+
+		dp += 8;
+		s1 += 8;
+		s2 += 8;
+		s3 += 8;
+		s4 += 8;
+	} while (--lines > 0);
+}
+EXPORT_SYMBOL(xor_neon_inner_5);
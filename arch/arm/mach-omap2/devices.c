@@ -721,7 +721,27 @@ static struct platform_device sham_device = {
 	.id		= -1,
 };
 
-static void omap_init_sham(void)
+#ifdef CONFIG_ARCH_OMAP4
+static void __init omap4_init_sham(void)
+{
+	struct omap_hwmod *oh;
+	struct platform_device *pdev;
+
+	oh = omap_hwmod_lookup("sham");
+	if (!oh) {
+		pr_err("%s: unable to find hwmod\n", __func__);
+		return;
+	}
+
+	pdev = omap_device_build("omap4-sham", -1, oh, NULL, 0, NULL, 0, 0);
+	WARN(IS_ERR(pdev), "%s: could not build device, err %ld\n",
+						__func__, PTR_ERR(pdev));
+}
+#else
+static inline void omap4_init_sham(void) { }
+#endif
+
+static void __init omap_init_sham(void)
 {
 	if (cpu_is_omap24xx()) {
 		sham_device.resource = omap2_sham_resources;
@@ -729,6 +749,9 @@ static void omap_init_sham(void)
 	} else if (cpu_is_omap34xx()) {
 		sham_device.resource = omap3_sham_resources;
 		sham_device.num_resources = omap3_sham_resources_sz;
+	} else if (cpu_is_omap44xx()) {
+		omap4_init_sham();
+		return;
 	} else {
 		pr_err("%s: platform not supported\n", __func__);
 		return;
@@ -790,7 +813,34 @@ static struct platform_device aes_device = {
 	.id		= -1,
 };
 
-static void omap_init_aes(void)
+#ifdef CONFIG_ARCH_OMAP4
+/* both public AES engines, the driver spreads transforms over them */
+static void __init omap4_init_aes(void)
+{
+	static const char *oh_names[] = { "aes1", "aes2" };
+	struct omap_hwmod *oh;
+	struct platform_device *pdev;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(oh_names); i++) {
+		oh = omap_hwmod_lookup(oh_names[i]);
+		if (!oh) {
+			pr_err("%s: unable to find hwmod %s\n", __func__,
+								oh_names[i]);
+			continue;
+		}
+
+		pdev = omap_device_build("omap4-aes", i, oh, NULL, 0,
+								NULL, 0, 0);
+		WARN(IS_ERR(pdev), "%s: could not build device, err %ld\n",
+						__func__, PTR_ERR(pdev));
+	}
+}
+#else
+static inline void omap4_init_aes(void) { }
+#endif
+
+static void __init omap_init_aes(void)
 {
 	if (cpu_is_omap24xx()) {
 		aes_device.resource = omap2_aes_resources;
@@ -798,6 +848,9 @@ static void omap_init_aes(void)
 	} else if (cpu_is_omap34xx()) {
 		aes_device.resource = omap3_aes_resources;
 		aes_device.num_resources = omap3_aes_resources_sz;
+	} else if (cpu_is_omap44xx()) {
+		omap4_init_aes();
+		return;
 	} else {
 		pr_err("%s: platform not supported\n", __func__);
 		return;
@@ -962,6 +962,131 @@ static struct omap_hwmod omap44xx_smartreflex_mpu_hwmod = {
 	.dev_attr       = &smartreflex_mpu_dev_attr,
 };
 
+/*
+ * 'aes' class
+ * advanced encryption standard accelerator (public instances)
+ */
+
+static struct omap_hwmod_class_sysconfig omap44xx_aes_sysc = {
+	.rev_offs	= 0x0080,
+	.sysc_offs	= 0x0084,
+	.syss_offs	= 0x0088,
+	.sysc_flags	= SYSS_HAS_RESET_STATUS,
+};
+
+static struct omap_hwmod_class omap44xx_aes_hwmod_class = {
+	.name	= "aes",
+	.sysc	= &omap44xx_aes_sysc,
+};
+
+/* aes1 */
+static struct omap_hwmod omap44xx_aes1_hwmod;
+static struct omap_hwmod_irq_info omap44xx_aes1_irqs[] = {
+	{ .irq = 85 + OMAP44XX_IRQ_GIC_START },
+	{ .irq = -1 }
+};
+
+static struct omap_hwmod_dma_info omap44xx_aes1_sdma_reqs[] = {
+	{ .name = "tx", .dma_req = 110 + OMAP44XX_DMA_REQ_START },
+	{ .name = "rx", .dma_req = 109 + OMAP44XX_DMA_REQ_START },
+	{ .dma_req = -1 }
+};
+
+static struct omap_hwmod_addr_space omap44xx_aes1_addrs[] = {
+	{
+		.pa_start	= 0x4b501000,
+		.pa_end		= 0x4b50109f,
+		.flags		= ADDR_TYPE_RT
+	},
+	{ }
+};
+
+/* l4_per -> aes1 */
+static struct omap_hwmod_ocp_if omap44xx_l4_per__aes1 = {
+	.master		= &omap44xx_l4_per_hwmod,
+	.slave		= &omap44xx_aes1_hwmod,
+	.clk		= "l4_div_ck",
+	.addr		= omap44xx_aes1_addrs,
+	.user		= OCP_USER_MPU | OCP_USER_SDMA,
+};
+
+/* aes1 slave ports */
+static struct omap_hwmod_ocp_if *omap44xx_aes1_slaves[] = {
+	&omap44xx_l4_per__aes1,
+};
+
+static struct omap_hwmod omap44xx_aes1_hwmod = {
+	.name		= "aes1",
+	.class		= &omap44xx_aes_hwmod_class,
+	.clkdm_name	= "l4_secure_clkdm",
+	.mpu_irqs	= omap44xx_aes1_irqs,
+	.sdma_reqs	= omap44xx_aes1_sdma_reqs,
+	.main_clk	= "aes1_fck",
+	.prcm = {
+		.omap4 = {
+			.clkctrl_offs = OMAP4_CM_L4SEC_AES1_CLKCTRL_OFFSET,
+			.context_offs = OMAP4_RM_L4SEC_AES1_CONTEXT_OFFSET,
+			.modulemode   = MODULEMODE_SWCTRL,
+		},
+	},
+	.slaves		= omap44xx_aes1_slaves,
+	.slaves_cnt	= ARRAY_SIZE(omap44xx_aes1_slaves),
+};
+
+/* aes2 */
+static struct omap_hwmod omap44xx_aes2_hwmod;
+static struct omap_hwmod_irq_info omap44xx_aes2_irqs[] = {
+	{ .irq = 64 + OMAP44XX_IRQ_GIC_START },
+	{ .irq = -1 }
+};
+
+static struct omap_hwmod_dma_info omap44xx_aes2_sdma_reqs[] = {
+	{ .name = "tx", .dma_req = 113 + OMAP44XX_DMA_REQ_START },
+	{ .name = "rx", .dma_req = 112 + OMAP44XX_DMA_REQ_START },
+	{ .dma_req = -1 }
+};
+
+static struct omap_hwmod_addr_space omap44xx_aes2_addrs[] = {
+	{
+		.pa_start	= 0x4b701000,
+		.pa_end		= 0x4b70109f,
+		.flags		= ADDR_TYPE_RT
+	},
+	{ }
+};
+
+/* l4_per -> aes2 */
+static struct omap_hwmod_ocp_if omap44xx_l4_per__aes2 = {
+	.master		= &omap44xx_l4_per_hwmod,
+	.slave		= &omap44xx_aes2_hwmod,
+	.clk		= "l4_div_ck",
+	.addr		= omap44xx_aes2_addrs,
+	.user		= OCP_USER_MPU | OCP_USER_SDMA,
+};
+
+/* aes2 slave ports */
+static struct omap_hwmod_ocp_if *omap44xx_aes2_slaves[] = {
+	&omap44xx_l4_per__aes2,
+};
+
+static struct omap_hwmod omap44xx_aes2_hwmod = {
+	.name		= "aes2",
+	.class		= &omap44xx_aes_hwmod_class,
+	.clkdm_name	= "l4_secure_clkdm",
+	.mpu_irqs	= omap44xx_aes2_irqs,
+	.sdma_reqs	= omap44xx_aes2_sdma_reqs,
+	.main_clk	= "aes2_fck",
+	.prcm = {
+		.omap4 = {
+			.clkctrl_offs = OMAP4_CM_L4SEC_AES2_CLKCTRL_OFFSET,
+			.context_offs = OMAP4_RM_L4SEC_AES2_CONTEXT_OFFSET,
+			.modulemode   = MODULEMODE_SWCTRL,
+		},
+	},
+	.slaves		= omap44xx_aes2_slaves,
+	.slaves_cnt	= ARRAY_SIZE(omap44xx_aes2_slaves),
+};
+
 /*
  * 'aess' class
  * audio engine sub system
@@ -4564,6 +4689,79 @@ static struct omap_hwmod omap44xx_mmc5_hwmod = {
 	.slaves_cnt	= ARRAY_SIZE(omap44xx_mmc5_slaves),
 };
 
+/*
+ * 'sham' class
+ * sha1/sha2/md5 hash accelerator (public instance)
+ */
+
+static struct omap_hwmod_class_sysconfig omap44xx_sham_sysc = {
+	.rev_offs	= 0x0100,
+	.sysc_offs	= 0x0110,
+	.syss_offs	= 0x0114,
+	.sysc_flags	= (SYSC_HAS_AUTOIDLE | SYSC_HAS_SIDLEMODE |
+			   SYSC_HAS_SOFTRESET | SYSS_HAS_RESET_STATUS),
+	.idlemodes	= (SIDLE_FORCE | SIDLE_NO | SIDLE_SMART),
+	.sysc_fields	= &omap_hwmod_sysc_type1,
+};
+
+static struct omap_hwmod_class omap44xx_sham_hwmod_class = {
+	.name	= "sham",
+	.sysc	= &omap44xx_sham_sysc,
+};
+
+/* sham */
+static struct omap_hwmod omap44xx_sham_hwmod;
+static struct omap_hwmod_irq_info omap44xx_sham_irqs[] = {
+	{ .irq = 51 + OMAP44XX_IRQ_GIC_START },
+	{ .irq = -1 }
+};
+
+static struct omap_hwmod_dma_info omap44xx_sham_sdma_reqs[] = {
+	{ .name = "rx", .dma_req = 118 + OMAP44XX_DMA_REQ_START },
+	{ .dma_req = -1 }
+};
+
+static struct omap_hwmod_addr_space omap44xx_sham_addrs[] = {
+	{
+		.pa_start	= 0x4b100000,
+		.pa_end		= 0x4b1002ff,
+		.flags		= ADDR_TYPE_RT
+	},
+	{ }
+};
+
+/* l4_per -> sham */
+static struct omap_hwmod_ocp_if omap44xx_l4_per__sham = {
+	.master		= &omap44xx_l4_per_hwmod,
+	.slave		= &omap44xx_sham_hwmod,
+	.clk		= "l4_div_ck",
+	.addr		= omap44xx_sham_addrs,
+	.user		= OCP_USER_MPU | OCP_USER_SDMA,
+};
+
+/* sham slave ports */
+static struct omap_hwmod_ocp_if *omap44xx_sham_slaves[] = {
+	&omap44xx_l4_per__sham,
+};
+
+static struct omap_hwmod omap44xx_sham_hwmod = {
+	.name		= "sham",
+	.class		= &omap44xx_sham_hwmod_class,
+	.clkdm_name	= "l4_secure_clkdm",
+	.mpu_irqs	= omap44xx_sham_irqs,
+	.sdma_reqs	= omap44xx_sham_sdma_reqs,
+	.main_clk	= "sha2md5_fck",
+	.prcm = {
+		.omap4 = {
+			.clkctrl_offs = OMAP4_CM_L4SEC_SHA2MD51_CLKCTRL_OFFSET,
+			.context_offs = OMAP4_RM_L4SEC_SHA2MD51_CONTEXT_OFFSET,
+			.modulemode   = MODULEMODE_SWCTRL,
+		},
+	},
+	.slaves		= omap44xx_sham_slaves,
+	.slaves_cnt	= ARRAY_SIZE(omap44xx_sham_slaves),
+};
+
 /*
  * 'spinlock' class
  * spinlock provides hardware assistance for synchronizing the processes
@@ -6067,6 +6265,10 @@ static __initdata struct omap_hwmod *omap44xx_hwmods[] = {
 	/* mpu_bus class */
 	&omap44xx_mpu_private_hwmod,
 
+	/* aes class */
+	&omap44xx_aes1_hwmod,
+	&omap44xx_aes2_hwmod,
+
 	/* aess class */
 	&omap44xx_aess_hwmod,
 
@@ -6174,6 +6376,9 @@ static __initdata struct omap_hwmod *omap44xx_hwmods[] = {
 	&omap44xx_smartreflex_iva_hwmod,
 	&omap44xx_smartreflex_mpu_hwmod,
 
+	/* sham class */
+	&omap44xx_sham_hwmod,
+
 	/* spinlock class */
 	&omap44xx_spinlock_hwmod,
 
@@ -26,8 +26,12 @@
 #include <linux/io.h>
 #include <linux/crypto.h>
 #include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/pm_runtime.h>
+#include <linux/mutex.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/aes.h>
+#include <crypto/algapi.h>
 
 #include <plat/cpu.h>
 #include <plat/dma.h>
@@ -37,11 +41,18 @@
 #define FLD_MASK(start, end)	(((1 << ((start) - (end) + 1)) - 1) << (end))
 #define FLD_VAL(val, start, end) (((val) << (end)) & FLD_MASK(start, end))
 
-#define AES_REG_KEY(x)			(0x1C - ((x ^ 0x01) * 0x04))
-#define AES_REG_IV(x)			(0x20 + ((x) * 0x04))
-
-#define AES_REG_CTRL			0x30
-#define AES_REG_CTRL_CTR_WIDTH		(1 << 7)
+/*
+ * The register map moved around between the OMAP2/3 and the OMAP4 IP, the
+ * offsets that differ come from the platform data of the instance.
+ */
+#define AES_REG_KEY(dd, x)		((dd)->pdata->key_ofs - \
+						((x ^ 0x01) * 0x04))
+#define AES_REG_IV(dd, x)		((dd)->pdata->iv_ofs + ((x) * 0x04))
+
+#define AES_REG_CTRL(dd)		((dd)->pdata->ctrl_ofs)
+#define AES_REG_CTRL_GCM		(3 << 16)
+#define AES_REG_CTRL_CTR_WIDTH_MASK	(3 << 7)
+#define AES_REG_CTRL_CTR_WIDTH_128	(3 << 7)
 #define AES_REG_CTRL_CTR		(1 << 6)
 #define AES_REG_CTRL_CBC		(1 << 5)
 #define AES_REG_CTRL_KEY_SIZE		(3 << 3)
@@ -49,14 +60,11 @@
 #define AES_REG_CTRL_INPUT_READY	(1 << 1)
 #define AES_REG_CTRL_OUTPUT_READY	(1 << 0)
 
-#define AES_REG_DATA			0x34
-#define AES_REG_DATA_N(x)		(0x34 + ((x) * 0x04))
+#define AES_REG_DATA_N(dd, x)		((dd)->pdata->data_ofs + ((x) * 0x04))
 
-#define AES_REG_REV			0x44
-#define AES_REG_REV_MAJOR		0xF0
-#define AES_REG_REV_MINOR		0x0F
+#define AES_REG_REV(dd)			((dd)->pdata->rev_ofs)
 
-#define AES_REG_MASK			0x48
+#define AES_REG_MASK(dd)		((dd)->pdata->mask_ofs)
 #define AES_REG_MASK_SIDLE		(1 << 6)
 #define AES_REG_MASK_START		(1 << 5)
 #define AES_REG_MASK_DMA_OUT_EN		(1 << 3)
@@ -64,19 +72,29 @@
 #define AES_REG_MASK_SOFTRESET		(1 << 1)
 #define AES_REG_AUTOIDLE		(1 << 0)
 
-#define AES_REG_SYSSTATUS		0x4C
+#define AES_REG_SYSSTATUS(dd)		((dd)->pdata->sysstatus_ofs)
 #define AES_REG_SYSSTATUS_RESETDONE	(1 << 0)
 
+/* OMAP4 only */
+#define AES_REG_LENGTH_N(x)		(0x54 + ((x) * 0x04))
+#define AES_REG_A_LEN			0x5C
+#define AES_REG_TAG_N(x)		(0x70 + ((x) * 0x04))
+
+#define AES_REG_MASK_OMAP4_DMA_IN_EN	(1 << 5)
+#define AES_REG_MASK_OMAP4_DMA_OUT_EN	(1 << 6)
+
 #define DEFAULT_TIMEOUT		(5*HZ)
 
-#define FLAGS_MODE_MASK		0x000f
+#define FLAGS_MODE_MASK		0x00ff
 #define FLAGS_ENCRYPT		BIT(0)
 #define FLAGS_CBC		BIT(1)
 #define FLAGS_GIV		BIT(2)
+#define FLAGS_CTR		BIT(3)
+#define FLAGS_GCM		BIT(4)
 
-#define FLAGS_INIT		BIT(4)
-#define FLAGS_FAST		BIT(5)
-#define FLAGS_BUSY		BIT(6)
+#define FLAGS_INIT		BIT(8)
+#define FLAGS_FAST		BIT(9)
+#define FLAGS_BUSY		BIT(10)
 
 struct omap_aes_ctx {
 	struct omap_aes_dev *dd;
@@ -84,13 +102,78 @@ struct omap_aes_ctx {
 	int		keylen;
 	u32		key[AES_KEYSIZE_256 / sizeof(u32)];
 	unsigned long	flags;
+
+	/* software fallback for requests the engine is not worth waking for */
+	union {
+		struct crypto_blkcipher	*blk;
+		struct crypto_aead	*aead;
+	} fallback;
+	/* GCM: E(K, J0) which the engine leaves out of the tag */
+	struct crypto_cipher	*cipher;
 };
 
 struct omap_aes_reqctx {
-	unsigned long mode;
+	unsigned long	mode;
+	ktime_t		start;
+
+	/* GCM: J0 and the tag mask derived from it */
+	u8		iv[AES_BLOCK_SIZE];
+	u32		auth_tag[AES_BLOCK_SIZE / sizeof(u32)];
+
+	/* keep last, the fallback's request context follows it */
+	struct aead_request	fallback_req;
+};
+
+struct omap_aes_dev;
+
+struct omap_aes_algs_info {
+	struct crypto_alg	*algs_list;
+	unsigned int		size;
 };
 
-#define OMAP_AES_QUEUE_LENGTH	1
+struct omap_aes_pdata {
+	struct omap_aes_algs_info	*algs_info;
+	unsigned int	algs_info_size;
+
+	void		(*trigger)(struct omap_aes_dev *dd, int length);
+
+	/* OMAP4 instances are omap_devices, clocked through runtime PM */
+	bool		pm_runtime;
+
+	u32		key_ofs;
+	u32		iv_ofs;
+	u32		ctrl_ofs;
+	u32		data_ofs;
+	u32		rev_ofs;
+	u32		mask_ofs;
+	u32		sysstatus_ofs;
+
+	u32		dma_enable_in;
+	u32		dma_enable_out;
+	u32		dma_start;
+
+	u32		major_mask;
+	u32		major_shift;
+	u32		minor_mask;
+	u32		minor_shift;
+};
+
+struct omap_aes_stats {
+	unsigned long	hw_requests;
+	u64		hw_bytes;
+	u64		hw_ns;		/* enqueue to completion */
+	u64		hw_max_ns;
+	unsigned long	sw_requests;
+	u64		sw_bytes;
+};
+
+/*
+ * Up to this many bytes a request is cheaper on the CPU than the DMA setup,
+ * tasklet and completion round trip through the engine.
+ */
+#define OMAP_AES_FALLBACK_SIZE	256
+
+#define OMAP_AES_QUEUE_LENGTH	32
 #define OMAP_AES_CACHE_SIZE	0
 
 struct omap_aes_dev {
@@ -103,13 +186,20 @@ struct omap_aes_dev {
 	unsigned long		flags;
 	int			err;
 
+	const struct omap_aes_pdata	*pdata;
+
 	spinlock_t		lock;
 	struct crypto_queue	queue;
 
 	struct tasklet_struct	done_task;
 	struct tasklet_struct	queue_task;
 
+	struct crypto_async_request	*areq;
 	struct ablkcipher_request	*req;
+	struct aead_request		*aead_req;
+	size_t				nbytes;
+	size_t				assoc_len;
+	size_t				text_len;
 	size_t				total;
 	struct scatterlist		*in_sg;
 	size_t				in_offset;
@@ -126,12 +216,19 @@ struct omap_aes_dev {
 	int			dma_out;
 	int			dma_lch_out;
 	dma_addr_t		dma_addr_out;
+
+	unsigned int		fallback_sz;
+	struct omap_aes_stats	stats;
 };
 
 /* keep registered devices data here */
 static LIST_HEAD(dev_list);
 static DEFINE_SPINLOCK(list_lock);
 
+/* algorithms are shared by all engines, registered with the first one */
+static DEFINE_MUTEX(algs_lock);
+static unsigned int algs_users;
+
 static inline u32 omap_aes_read(struct omap_aes_dev *dd, u32 offset)
 {
 	return __raw_readl(dd->io_base + offset);
@@ -174,6 +271,22 @@ static int omap_aes_wait(struct omap_aes_dev *dd, u32 offset, u32 bit)
 	return 0;
 }
 
+static void omap_aes_hw_get(struct omap_aes_dev *dd)
+{
+	if (dd->iclk)
+		clk_enable(dd->iclk);
+	else
+		pm_runtime_get_sync(dd->dev);
+}
+
+static void omap_aes_hw_put(struct omap_aes_dev *dd)
+{
+	if (dd->iclk)
+		clk_disable(dd->iclk);
+	else
+		pm_runtime_put(dd->dev);
+}
+
 static int omap_aes_hw_init(struct omap_aes_dev *dd)
 {
 	/*
@@ -181,12 +294,13 @@ static int omap_aes_hw_init(struct omap_aes_dev *dd)
 	 * It may be long delays between requests.
 	 * Device might go to off mode to save power.
 	 */
-	clk_enable(dd->iclk);
+	omap_aes_hw_get(dd);
 
 	if (!(dd->flags & FLAGS_INIT)) {
 		/* is it necessary to reset before every operation? */
-		omap_aes_write_mask(dd, AES_REG_MASK, AES_REG_MASK_SOFTRESET,
-					AES_REG_MASK_SOFTRESET);
+		omap_aes_write_mask(dd, AES_REG_MASK(dd),
+				    AES_REG_MASK_SOFTRESET,
+				    AES_REG_MASK_SOFTRESET);
 		/*
 		 * prevent OCP bus error (SRESP) in case an access to the module
 		 * is performed while the module is coming out of soft reset
@@ -194,7 +308,7 @@ static int omap_aes_hw_init(struct omap_aes_dev *dd)
 		__asm__ __volatile__("nop");
 		__asm__ __volatile__("nop");
 
-		if (omap_aes_wait(dd, AES_REG_SYSSTATUS,
+		if (omap_aes_wait(dd, AES_REG_SYSSTATUS(dd),
 				AES_REG_SYSSTATUS_RESETDONE))
 			return -ETIMEDOUT;
 
@@ -205,6 +319,35 @@ static int omap_aes_hw_init(struct omap_aes_dev *dd)
 	return 0;
 }
 
+static void omap_aes_dma_trigger_omap2(struct omap_aes_dev *dd, int length)
+{
+	u32 mask, val;
+
+	val = dd->pdata->dma_start;
+
+	if (dd->dma_lch_out >= 0)
+		val |= dd->pdata->dma_enable_out;
+	if (dd->dma_lch_in >= 0)
+		val |= dd->pdata->dma_enable_in;
+
+	mask = dd->pdata->dma_enable_out | dd->pdata->dma_enable_in |
+	       dd->pdata->dma_start;
+
+	/* start DMA or disable idle mode */
+	omap_aes_write_mask(dd, AES_REG_MASK(dd), val, mask);
+}
+
+static void omap_aes_dma_trigger_omap4(struct omap_aes_dev *dd, int length)
+{
+	/* the OMAP4 engine starts a new context once the length is set */
+	omap_aes_write(dd, AES_REG_LENGTH_N(0), length);
+	omap_aes_write(dd, AES_REG_LENGTH_N(1), 0);
+	if (dd->flags & FLAGS_GCM)
+		omap_aes_write(dd, AES_REG_A_LEN, dd->assoc_len);
+
+	omap_aes_dma_trigger_omap2(dd, length);
+}
+
 static int omap_aes_write_ctrl(struct omap_aes_dev *dd)
 {
 	unsigned int key32;
@@ -215,48 +358,49 @@ static int omap_aes_write_ctrl(struct omap_aes_dev *dd)
 	if (err)
 		return err;
 
-	val = 0;
-	if (dd->dma_lch_out >= 0)
-		val |= AES_REG_MASK_DMA_OUT_EN;
-	if (dd->dma_lch_in >= 0)
-		val |= AES_REG_MASK_DMA_IN_EN;
-
-	mask = AES_REG_MASK_DMA_IN_EN | AES_REG_MASK_DMA_OUT_EN;
-
-	omap_aes_write_mask(dd, AES_REG_MASK, val, mask);
-
 	key32 = dd->ctx->keylen / sizeof(u32);
 
 	/* it seems a key should always be set even if it has not changed */
 	for (i = 0; i < key32; i++) {
-		omap_aes_write(dd, AES_REG_KEY(i),
+		omap_aes_write(dd, AES_REG_KEY(dd, i),
 			__le32_to_cpu(dd->ctx->key[i]));
 	}
 
-	if ((dd->flags & FLAGS_CBC) && dd->req->info)
-		omap_aes_write_n(dd, AES_REG_IV(0), dd->req->info, 4);
+	if ((dd->flags & (FLAGS_CBC | FLAGS_CTR)) && dd->req->info)
+		omap_aes_write_n(dd, AES_REG_IV(dd, 0), dd->req->info, 4);
+
+	if (dd->flags & FLAGS_GCM) {
+		struct omap_aes_reqctx *rctx = aead_request_ctx(dd->aead_req);
+
+		omap_aes_write_n(dd, AES_REG_IV(dd, 0), (u32 *)rctx->iv, 4);
+	}
 
 	val = FLD_VAL(((dd->ctx->keylen >> 3) - 1), 4, 3);
 	if (dd->flags & FLAGS_CBC)
 		val |= AES_REG_CTRL_CBC;
+	if (dd->flags & (FLAGS_CTR | FLAGS_GCM))
+		val |= AES_REG_CTRL_CTR | AES_REG_CTRL_CTR_WIDTH_128;
+	if (dd->flags & FLAGS_GCM)
+		val |= AES_REG_CTRL_GCM;
 	if (dd->flags & FLAGS_ENCRYPT)
 		val |= AES_REG_CTRL_DIRECTION;
 
-	mask = AES_REG_CTRL_CBC | AES_REG_CTRL_DIRECTION |
-			AES_REG_CTRL_KEY_SIZE;
+	mask = AES_REG_CTRL_CBC | AES_REG_CTRL_CTR |
+			AES_REG_CTRL_CTR_WIDTH_MASK | AES_REG_CTRL_GCM |
+			AES_REG_CTRL_DIRECTION | AES_REG_CTRL_KEY_SIZE;
 
-	omap_aes_write_mask(dd, AES_REG_CTRL, val, mask);
+	omap_aes_write_mask(dd, AES_REG_CTRL(dd), val, mask);
 
 	/* IN */
 	omap_set_dma_dest_params(dd->dma_lch_in, 0, OMAP_DMA_AMODE_CONSTANT,
-				 dd->phys_base + AES_REG_DATA, 0, 4);
+				 dd->phys_base + AES_REG_DATA_N(dd, 0), 0, 4);
 
 	omap_set_dma_dest_burst_mode(dd->dma_lch_in, OMAP_DMA_DATA_BURST_4);
 	omap_set_dma_src_burst_mode(dd->dma_lch_in, OMAP_DMA_DATA_BURST_4);
 
 	/* OUT */
 	omap_set_dma_src_params(dd->dma_lch_out, 0, OMAP_DMA_AMODE_CONSTANT,
-				dd->phys_base + AES_REG_DATA, 0, 4);
+				dd->phys_base + AES_REG_DATA_N(dd, 0), 0, 4);
 
 	omap_set_dma_src_burst_mode(dd->dma_lch_out, OMAP_DMA_DATA_BURST_4);
 	omap_set_dma_dest_burst_mode(dd->dma_lch_out, OMAP_DMA_DATA_BURST_4);
@@ -271,10 +415,12 @@ static struct omap_aes_dev *omap_aes_find_dev(struct omap_aes_ctx *ctx)
 	spin_lock_bh(&list_lock);
 	if (!ctx->dd) {
 		list_for_each_entry(tmp, &dev_list, list) {
-			/* FIXME: take fist available aes core */
 			dd = tmp;
 			break;
 		}
+		/* spread transforms over the engines round robin */
+		if (dd)
+			list_move_tail(&dd->list, &dev_list);
 		ctx->dd = dd;
 	} else {
 		/* already found before */
@@ -427,24 +573,25 @@ static int sg_copy(struct scatterlist **sg, size_t *offset, void *buf,
 	return off;
 }
 
-static int omap_aes_crypt_dma(struct crypto_tfm *tfm, dma_addr_t dma_addr_in,
+static int omap_aes_crypt_dma(struct omap_aes_dev *dd, dma_addr_t dma_addr_in,
 			       dma_addr_t dma_addr_out, int length)
 {
-	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
-	struct omap_aes_dev *dd = ctx->dd;
-	int len32;
+	int in_len = length, len32;
 
 	pr_debug("len: %d\n", length);
 
 	dd->dma_size = length;
 
+	/* GCM feeds the padded AAD in front of the text, with no output */
+	if (dd->flags & FLAGS_GCM)
+		in_len += ALIGN(dd->assoc_len, AES_BLOCK_SIZE);
+
 	if (!(dd->flags & FLAGS_FAST))
-		dma_sync_single_for_device(dd->dev, dma_addr_in, length,
+		dma_sync_single_for_device(dd->dev, dma_addr_in, in_len,
 					   DMA_TO_DEVICE);
 
-	len32 = DIV_ROUND_UP(length, sizeof(u32));
-
 	/* IN */
+	len32 = DIV_ROUND_UP(in_len, sizeof(u32));
 	omap_set_dma_transfer_params(dd->dma_lch_in, OMAP_DMA_DATA_TYPE_S32,
 				     len32, 1, OMAP_DMA_SYNC_PACKET, dd->dma_in,
 					OMAP_DMA_DST_SYNC);
@@ -453,6 +600,7 @@ static int omap_aes_crypt_dma(struct crypto_tfm *tfm, dma_addr_t dma_addr_in,
 				dma_addr_in, 0, 0);
 
 	/* OUT */
+	len32 = DIV_ROUND_UP(length, sizeof(u32));
 	omap_set_dma_transfer_params(dd->dma_lch_out, OMAP_DMA_DATA_TYPE_S32,
 				     len32, 1, OMAP_DMA_SYNC_PACKET,
 					dd->dma_out, OMAP_DMA_SRC_SYNC);
@@ -463,23 +611,41 @@ static int omap_aes_crypt_dma(struct crypto_tfm *tfm, dma_addr_t dma_addr_in,
 	omap_start_dma(dd->dma_lch_in);
 	omap_start_dma(dd->dma_lch_out);
 
-	/* start DMA or disable idle mode */
-	omap_aes_write_mask(dd, AES_REG_MASK, AES_REG_MASK_START,
-			    AES_REG_MASK_START);
+	dd->pdata->trigger(dd, (dd->flags & FLAGS_GCM) ? dd->text_len : length);
 
 	return 0;
 }
 
+static int omap_aes_gcm_dma_start(struct omap_aes_dev *dd)
+{
+	struct aead_request *req = dd->aead_req;
+	size_t alen = ALIGN(dd->assoc_len, AES_BLOCK_SIZE);
+	size_t clen = ALIGN(dd->text_len, AES_BLOCK_SIZE);
+	u8 *buf = dd->buf_in;
+
+	/* AAD and text each zero padded to the block size, in one go */
+	scatterwalk_map_and_copy(buf, req->assoc, 0, dd->assoc_len, 0);
+	memset(buf + dd->assoc_len, 0, alen - dd->assoc_len);
+	scatterwalk_map_and_copy(buf + alen, req->src, 0, dd->text_len, 0);
+	memset(buf + alen + dd->text_len, 0, clen - dd->text_len);
+
+	dd->total = 0;
+	dd->flags &= ~FLAGS_FAST;
+
+	return omap_aes_crypt_dma(dd, dd->dma_addr_in, dd->dma_addr_out, clen);
+}
+
 static int omap_aes_crypt_dma_start(struct omap_aes_dev *dd)
 {
-	struct crypto_tfm *tfm = crypto_ablkcipher_tfm(
-					crypto_ablkcipher_reqtfm(dd->req));
 	int err, fast = 0, in, out;
 	size_t count;
 	dma_addr_t addr_in, addr_out;
 
 	pr_debug("total: %d\n", dd->total);
 
+	if (dd->flags & FLAGS_GCM)
+		return omap_aes_gcm_dma_start(dd);
+
 	if (sg_is_last(dd->in_sg) && sg_is_last(dd->out_sg)) {
 		/* check for alignment */
 		in = IS_ALIGNED((u32)dd->in_sg->offset, sizeof(u32));
@@ -531,7 +697,7 @@ static int omap_aes_crypt_dma_start(struct omap_aes_dev *dd)
 
 	dd->total -= count;
 
-	err = omap_aes_crypt_dma(tfm, addr_in, addr_out, count);
+	err = omap_aes_crypt_dma(dd, addr_in, addr_out, count);
 	if (err) {
 		dma_unmap_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
 		dma_unmap_sg(dd->dev, dd->out_sg, 1, DMA_TO_DEVICE);
@@ -540,16 +706,103 @@ static int omap_aes_crypt_dma_start(struct omap_aes_dev *dd)
 	return err;
 }
 
-static void omap_aes_finish_req(struct omap_aes_dev *dd, int err)
+static inline bool omap_aes_is_aead(struct crypto_async_request *areq)
+{
+	return crypto_tfm_alg_type(areq->tfm) == CRYPTO_ALG_TYPE_AEAD;
+}
+
+static struct omap_aes_reqctx *
+omap_aes_areq_ctx(struct crypto_async_request *areq)
+{
+	if (omap_aes_is_aead(areq))
+		return aead_request_ctx(container_of(areq, struct aead_request,
+						     base));
+
+	return ablkcipher_request_ctx(ablkcipher_request_cast(areq));
+}
+
+static void omap_aes_copy_ivout(struct omap_aes_dev *dd, u32 *ivbuf)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		ivbuf[i] = omap_aes_read(dd, AES_REG_IV(dd, i));
+}
+
+/*
+ * Compares two tags in time that does not depend on their contents, so a
+ * forger cannot learn how many leading bytes of a guess were right.
+ */
+static int omap_aes_tag_neq(const u8 *a, const u8 *b, unsigned int len)
+{
+	u8 neq = 0;
+
+	while (len--)
+		neq |= *a++ ^ *b++;
+
+	return neq;
+}
+
+static int omap_aes_gcm_tag(struct omap_aes_dev *dd)
+{
+	struct aead_request *req = dd->aead_req;
+	struct omap_aes_reqctx *rctx = aead_request_ctx(req);
+	unsigned int authsize = crypto_aead_authsize(crypto_aead_reqtfm(req));
+	u32 *tag = rctx->auth_tag;
+	u8 itag[AES_BLOCK_SIZE];
+	int i;
+
+	/* the tag registers hold GHASH, the tag is that XOR E(K, J0) */
+	for (i = 0; i < AES_BLOCK_SIZE / sizeof(u32); i++)
+		tag[i] ^= omap_aes_read(dd, AES_REG_TAG_N(i));
+
+	if (dd->flags & FLAGS_ENCRYPT) {
+		scatterwalk_map_and_copy(tag, req->dst, dd->text_len,
+					 authsize, 1);
+		return 0;
+	}
+
+	scatterwalk_map_and_copy(itag, req->src, dd->text_len, authsize, 0);
+
+	return omap_aes_tag_neq(itag, (u8 *)tag, authsize) ? -EBADMSG : 0;
+}
+
+/* Collects the results of the current request and frees the engine. */
+static int omap_aes_finish_req(struct omap_aes_dev *dd, int err)
 {
-	struct ablkcipher_request *req = dd->req;
+	struct omap_aes_reqctx *rctx = omap_aes_areq_ctx(dd->areq);
+	unsigned long flags;
+	u64 ns;
 
 	pr_debug("err: %d\n", err);
 
-	clk_disable(dd->iclk);
+	if (!err) {
+		if (dd->flags & FLAGS_GCM)
+			err = omap_aes_gcm_tag(dd);
+		else if ((dd->flags & (FLAGS_CBC | FLAGS_CTR)) && dd->req->info)
+			omap_aes_copy_ivout(dd, dd->req->info);
+	}
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), rctx->start));
+
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->stats.hw_requests++;
+	dd->stats.hw_bytes += dd->nbytes;
+	dd->stats.hw_ns += ns;
+	if (ns > dd->stats.hw_max_ns)
+		dd->stats.hw_max_ns = ns;
 	dd->flags &= ~FLAGS_BUSY;
+	spin_unlock_irqrestore(&dd->lock, flags);
+
+	return err;
+}
+
+static void omap_aes_complete(struct omap_aes_dev *dd,
+			      struct crypto_async_request *areq, int err)
+{
+	omap_aes_hw_put(dd);
 
-	req->base.complete(&req->base, err);
+	areq->complete(areq, err);
 }
 
 static int omap_aes_crypt_dma_stop(struct omap_aes_dev *dd)
@@ -559,7 +812,9 @@ static int omap_aes_crypt_dma_stop(struct omap_aes_dev *dd)
 
 	pr_debug("total: %d\n", dd->total);
 
-	omap_aes_write_mask(dd, AES_REG_MASK, 0, AES_REG_MASK_START);
+	omap_aes_write_mask(dd, AES_REG_MASK(dd), 0,
+			    dd->pdata->dma_enable_out |
+			    dd->pdata->dma_enable_in | dd->pdata->dma_start);
 
 	omap_stop_dma(dd->dma_lch_in);
 	omap_stop_dma(dd->dma_lch_out);
@@ -567,6 +822,12 @@ static int omap_aes_crypt_dma_stop(struct omap_aes_dev *dd)
 	if (dd->flags & FLAGS_FAST) {
 		dma_unmap_sg(dd->dev, dd->out_sg, 1, DMA_FROM_DEVICE);
 		dma_unmap_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
+	} else if (dd->flags & FLAGS_GCM) {
+		dma_sync_single_for_device(dd->dev, dd->dma_addr_out,
+					   dd->dma_size, DMA_FROM_DEVICE);
+
+		scatterwalk_map_and_copy(dd->buf_out, dd->aead_req->dst, 0,
+					 dd->text_len, 1);
 	} else {
 		dma_sync_single_for_device(dd->dev, dd->dma_addr_out,
 					   dd->dma_size, DMA_FROM_DEVICE);
@@ -583,18 +844,55 @@ static int omap_aes_crypt_dma_stop(struct omap_aes_dev *dd)
 	return err;
 }
 
+static void omap_aes_prepare_req(struct omap_aes_dev *dd,
+				 struct ablkcipher_request *req)
+{
+	struct omap_aes_ctx *ctx;
+
+	dd->req = req;
+	dd->aead_req = NULL;
+	dd->nbytes = req->nbytes;
+	dd->total = req->nbytes;
+	dd->in_offset = 0;
+	dd->in_sg = req->src;
+	dd->out_offset = 0;
+	dd->out_sg = req->dst;
+
+	ctx = crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	dd->ctx = ctx;
+	ctx->dd = dd;
+}
+
+static void omap_aes_gcm_prepare_req(struct omap_aes_dev *dd,
+				     struct aead_request *req)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct omap_aes_ctx *ctx = crypto_aead_ctx(tfm);
+
+	dd->req = NULL;
+	dd->aead_req = req;
+	dd->assoc_len = req->assoclen;
+	dd->text_len = req->cryptlen;
+	if (!(dd->flags & FLAGS_ENCRYPT))
+		dd->text_len -= crypto_aead_authsize(tfm);
+	dd->nbytes = dd->assoc_len + dd->text_len;
+	dd->total = dd->text_len;
+
+	dd->ctx = ctx;
+	ctx->dd = dd;
+}
+
 static int omap_aes_handle_queue(struct omap_aes_dev *dd,
-			       struct ablkcipher_request *req)
+			       struct crypto_async_request *req)
 {
 	struct crypto_async_request *async_req, *backlog;
-	struct omap_aes_ctx *ctx;
 	struct omap_aes_reqctx *rctx;
 	unsigned long flags;
 	int err, ret = 0;
 
 	spin_lock_irqsave(&dd->lock, flags);
 	if (req)
-		ret = ablkcipher_enqueue_request(&dd->queue, req);
+		ret = crypto_enqueue_request(&dd->queue, req);
 	if (dd->flags & FLAGS_BUSY) {
 		spin_unlock_irqrestore(&dd->lock, flags);
 		return ret;
@@ -611,30 +909,26 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 	if (backlog)
 		backlog->complete(backlog, -EINPROGRESS);
 
-	req = ablkcipher_request_cast(async_req);
-
 	/* assign new request to device */
-	dd->req = req;
-	dd->total = req->nbytes;
-	dd->in_offset = 0;
-	dd->in_sg = req->src;
-	dd->out_offset = 0;
-	dd->out_sg = req->dst;
-
-	rctx = ablkcipher_request_ctx(req);
-	ctx = crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	dd->areq = async_req;
+	rctx = omap_aes_areq_ctx(async_req);
 	rctx->mode &= FLAGS_MODE_MASK;
 	dd->flags = (dd->flags & ~FLAGS_MODE_MASK) | rctx->mode;
 
-	dd->ctx = ctx;
-	ctx->dd = dd;
+	if (dd->flags & FLAGS_GCM)
+		omap_aes_gcm_prepare_req(dd, container_of(async_req,
+						struct aead_request, base));
+	else
+		omap_aes_prepare_req(dd, ablkcipher_request_cast(async_req));
 
+	dd->err = 0;
 	err = omap_aes_write_ctrl(dd);
 	if (!err)
 		err = omap_aes_crypt_dma_start(dd);
 	if (err) {
 		/* aes_task will not finish it, so do it here */
-		omap_aes_finish_req(dd, err);
+		err = omap_aes_finish_req(dd, err);
+		omap_aes_complete(dd, async_req, err);
 		tasklet_schedule(&dd->queue_task);
 	}
 
@@ -644,6 +938,7 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 static void omap_aes_done_task(unsigned long data)
 {
 	struct omap_aes_dev *dd = (struct omap_aes_dev *)data;
+	struct crypto_async_request *areq;
 	int err;
 
 	pr_debug("enter\n");
@@ -658,8 +953,17 @@ static void omap_aes_done_task(unsigned long data)
 			return; /* DMA started. Not fininishing. */
 	}
 
-	omap_aes_finish_req(dd, err);
+	areq = dd->areq;
+	err = omap_aes_finish_req(dd, err);
+
+	/*
+	 * Start the next queued request before completing this one: the
+	 * engine keeps running while the completion callback does its work,
+	 * and the clock reference taken for the next request keeps the
+	 * module from idling in between.
+	 */
 	omap_aes_handle_queue(dd, NULL);
+	omap_aes_complete(dd, areq, err);
 
 	pr_debug("exit\n");
 }
@@ -671,6 +975,38 @@ static void omap_aes_queue_task(unsigned long data)
 	omap_aes_handle_queue(dd, NULL);
 }
 
+static void omap_aes_stats_sw(struct omap_aes_dev *dd, size_t nbytes)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->stats.sw_requests++;
+	dd->stats.sw_bytes += nbytes;
+	spin_unlock_irqrestore(&dd->lock, flags);
+}
+
+static int omap_aes_crypt_fallback(struct omap_aes_dev *dd,
+				   struct ablkcipher_request *req,
+				   unsigned long mode)
+{
+	struct omap_aes_ctx *ctx = crypto_ablkcipher_ctx(
+			crypto_ablkcipher_reqtfm(req));
+	struct blkcipher_desc desc = {
+		.tfm	= ctx->fallback.blk,
+		.info	= req->info,
+		.flags	= req->base.flags,
+	};
+
+	omap_aes_stats_sw(dd, req->nbytes);
+
+	if (mode & FLAGS_ENCRYPT)
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						   req->nbytes);
+
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+					   req->nbytes);
+}
+
 static int omap_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 {
 	struct omap_aes_ctx *ctx = crypto_ablkcipher_ctx(
@@ -678,11 +1014,12 @@ static int omap_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 	struct omap_aes_reqctx *rctx = ablkcipher_request_ctx(req);
 	struct omap_aes_dev *dd;
 
-	pr_debug("nbytes: %d, enc: %d, cbc: %d\n", req->nbytes,
+	pr_debug("nbytes: %d, enc: %d, cbc: %d, ctr: %d\n", req->nbytes,
 		  !!(mode & FLAGS_ENCRYPT),
-		  !!(mode & FLAGS_CBC));
+		  !!(mode & FLAGS_CBC),
+		  !!(mode & FLAGS_CTR));
 
-	if (!IS_ALIGNED(req->nbytes, AES_BLOCK_SIZE)) {
+	if (!(mode & FLAGS_CTR) && !IS_ALIGNED(req->nbytes, AES_BLOCK_SIZE)) {
 		pr_err("request size is not exact amount of AES blocks\n");
 		return -EINVAL;
 	}
@@ -691,9 +1028,77 @@ static int omap_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 	if (!dd)
 		return -ENODEV;
 
+	/* short requests and CTR tails the engine would pad use the CPU */
+	if (req->nbytes < dd->fallback_sz ||
+	    !IS_ALIGNED(req->nbytes, AES_BLOCK_SIZE))
+		return omap_aes_crypt_fallback(dd, req, mode);
+
 	rctx->mode = mode;
+	rctx->start = ktime_get();
+
+	return omap_aes_handle_queue(dd, &req->base);
+}
+
+static int omap_aes_gcm_fallback(struct omap_aes_dev *dd,
+				 struct aead_request *req, unsigned long mode)
+{
+	struct omap_aes_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct omap_aes_reqctx *rctx = aead_request_ctx(req);
+	struct aead_request *subreq = &rctx->fallback_req;
+
+	omap_aes_stats_sw(dd, req->assoclen + req->cryptlen);
+
+	aead_request_set_tfm(subreq, ctx->fallback.aead);
+	aead_request_set_callback(subreq, req->base.flags,
+				  req->base.complete, req->base.data);
+	aead_request_set_crypt(subreq, req->src, req->dst, req->cryptlen,
+			       req->iv);
+	aead_request_set_assoc(subreq, req->assoc, req->assoclen);
+
+	if (mode & FLAGS_ENCRYPT)
+		return crypto_aead_encrypt(subreq);
+
+	return crypto_aead_decrypt(subreq);
+}
+
+static int omap_aes_gcm_crypt(struct aead_request *req, unsigned long mode)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct omap_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	struct omap_aes_reqctx *rctx = aead_request_ctx(req);
+	unsigned int authsize = crypto_aead_authsize(tfm);
+	__be32 counter = cpu_to_be32(1);
+	struct omap_aes_dev *dd;
+	size_t textlen = req->cryptlen;
+
+	if (!(mode & FLAGS_ENCRYPT)) {
+		if (textlen < authsize)
+			return -EINVAL;
+		textlen -= authsize;
+	}
+
+	dd = omap_aes_find_dev(ctx);
+	if (!dd)
+		return -ENODEV;
 
-	return omap_aes_handle_queue(dd, req);
+	/*
+	 * The engine is only handed requests that carry text and fit the
+	 * bounce buffer in one go, GMAC and jumbo requests use the fallback.
+	 */
+	if (!textlen || textlen < dd->fallback_sz ||
+	    ALIGN(req->assoclen, AES_BLOCK_SIZE) +
+	    ALIGN(textlen, AES_BLOCK_SIZE) > dd->buflen)
+		return omap_aes_gcm_fallback(dd, req, mode);
+
+	/* J0 = IV || 1, the engine counts the text from inc32(J0) */
+	memcpy(rctx->iv, req->iv, 12);
+	memcpy(rctx->iv + 12, &counter, 4);
+	crypto_cipher_encrypt_one(ctx->cipher, (u8 *)rctx->auth_tag, rctx->iv);
+
+	rctx->mode = mode | FLAGS_GCM;
+	rctx->start = ktime_get();
+
+	return omap_aes_handle_queue(dd, &req->base);
 }
 
 /* ********************** ALG API ************************************ */
@@ -712,7 +1117,7 @@ static int omap_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 	memcpy(ctx->key, key, keylen);
 	ctx->keylen = keylen;
 
-	return 0;
+	return crypto_blkcipher_setkey(ctx->fallback.blk, key, keylen);
 }
 
 static int omap_aes_ecb_encrypt(struct ablkcipher_request *req)
@@ -735,10 +1140,77 @@ static int omap_aes_cbc_decrypt(struct ablkcipher_request *req)
 	return omap_aes_crypt(req, FLAGS_CBC);
 }
 
+static int omap_aes_ctr_encrypt(struct ablkcipher_request *req)
+{
+	return omap_aes_crypt(req, FLAGS_ENCRYPT | FLAGS_CTR);
+}
+
+static int omap_aes_ctr_decrypt(struct ablkcipher_request *req)
+{
+	return omap_aes_crypt(req, FLAGS_CTR);
+}
+
+static int omap_aes_gcm_setkey(struct crypto_aead *tfm, const u8 *key,
+			       unsigned int keylen)
+{
+	struct omap_aes_ctx *ctx = crypto_aead_ctx(tfm);
+
+	if (keylen != AES_KEYSIZE_128 && keylen != AES_KEYSIZE_192 &&
+		   keylen != AES_KEYSIZE_256)
+		return -EINVAL;
+
+	memcpy(ctx->key, key, keylen);
+	ctx->keylen = keylen;
+
+	return crypto_cipher_setkey(ctx->cipher, key, keylen) ?:
+	       crypto_aead_setkey(ctx->fallback.aead, key, keylen);
+}
+
+static int omap_aes_gcm_setauthsize(struct crypto_aead *tfm,
+				    unsigned int authsize)
+{
+	struct omap_aes_ctx *ctx = crypto_aead_ctx(tfm);
+
+	switch (authsize) {
+	case 4:
+	case 8:
+	case 12:
+	case 13:
+	case 14:
+	case 15:
+	case 16:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return crypto_aead_setauthsize(ctx->fallback.aead, authsize);
+}
+
+static int omap_aes_gcm_encrypt(struct aead_request *req)
+{
+	return omap_aes_gcm_crypt(req, FLAGS_ENCRYPT);
+}
+
+static int omap_aes_gcm_decrypt(struct aead_request *req)
+{
+	return omap_aes_gcm_crypt(req, 0);
+}
+
 static int omap_aes_cra_init(struct crypto_tfm *tfm)
 {
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(tfm);
+
 	pr_debug("enter\n");
 
+	ctx->fallback.blk = crypto_alloc_blkcipher(name, 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback.blk)) {
+		pr_err("fallback driver '%s' could not be loaded.\n", name);
+		return PTR_ERR(ctx->fallback.blk);
+	}
+
 	tfm->crt_ablkcipher.reqsize = sizeof(struct omap_aes_reqctx);
 
 	return 0;
@@ -746,19 +1218,57 @@ static int omap_aes_cra_init(struct crypto_tfm *tfm)
 
 static void omap_aes_cra_exit(struct crypto_tfm *tfm)
 {
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
 	pr_debug("enter\n");
+
+	crypto_free_blkcipher(ctx->fallback.blk);
+	ctx->fallback.blk = NULL;
+}
+
+static int omap_aes_gcm_cra_init(struct crypto_tfm *tfm)
+{
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(tfm);
+
+	ctx->fallback.aead = crypto_alloc_aead(name, 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback.aead)) {
+		pr_err("fallback driver '%s' could not be loaded.\n", name);
+		return PTR_ERR(ctx->fallback.aead);
+	}
+
+	ctx->cipher = crypto_alloc_cipher("aes", 0, CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->cipher)) {
+		crypto_free_aead(ctx->fallback.aead);
+		return PTR_ERR(ctx->cipher);
+	}
+
+	tfm->crt_aead.reqsize = sizeof(struct omap_aes_reqctx) +
+				crypto_aead_reqsize(ctx->fallback.aead);
+
+	return 0;
+}
+
+static void omap_aes_gcm_cra_exit(struct crypto_tfm *tfm)
+{
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_cipher(ctx->cipher);
+	crypto_free_aead(ctx->fallback.aead);
 }
 
 /* ********************** ALGS ************************************ */
 
-static struct crypto_alg algs[] = {
+static struct crypto_alg algs_ecb_cbc[] = {
 {
 	.cra_name		= "ecb(aes)",
 	.cra_driver_name	= "ecb-aes-omap",
 	.cra_priority		= 100,
 	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
 				  CRYPTO_ALG_KERN_DRIVER_ONLY |
-				  CRYPTO_ALG_ASYNC,
+				  CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
 	.cra_blocksize		= AES_BLOCK_SIZE,
 	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
 	.cra_alignmask		= 0,
@@ -780,7 +1290,8 @@ static struct crypto_alg algs[] = {
 	.cra_priority		= 100,
 	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
 				  CRYPTO_ALG_KERN_DRIVER_ONLY |
-				  CRYPTO_ALG_ASYNC,
+				  CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
 	.cra_blocksize		= AES_BLOCK_SIZE,
 	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
 	.cra_alignmask		= 0,
@@ -799,12 +1310,246 @@ static struct crypto_alg algs[] = {
 }
 };
 
+static struct crypto_alg algs_ctr[] = {
+{
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-omap",
+	.cra_priority		= 100,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
+				  CRYPTO_ALG_KERN_DRIVER_ONLY |
+				  CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= omap_aes_cra_init,
+	.cra_exit		= omap_aes_cra_exit,
+	.cra_u.ablkcipher = {
+		.min_keysize	= AES_MIN_KEY_SIZE,
+		.max_keysize	= AES_MAX_KEY_SIZE,
+		.ivsize		= AES_BLOCK_SIZE,
+		.setkey		= omap_aes_setkey,
+		.encrypt	= omap_aes_ctr_encrypt,
+		.decrypt	= omap_aes_ctr_decrypt,
+	}
+}
+};
+
+static struct crypto_alg algs_gcm[] = {
+{
+	.cra_name		= "gcm(aes)",
+	.cra_driver_name	= "gcm-aes-omap",
+	.cra_priority		= 100,
+	.cra_flags		= CRYPTO_ALG_TYPE_AEAD |
+				  CRYPTO_ALG_KERN_DRIVER_ONLY |
+				  CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_aead_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= omap_aes_gcm_cra_init,
+	.cra_exit		= omap_aes_gcm_cra_exit,
+	.cra_u.aead = {
+		/* like the gcm template: 12 byte nonce, room for the counter */
+		.ivsize		= AES_BLOCK_SIZE,
+		.maxauthsize	= AES_BLOCK_SIZE,
+		.setkey		= omap_aes_gcm_setkey,
+		.setauthsize	= omap_aes_gcm_setauthsize,
+		.encrypt	= omap_aes_gcm_encrypt,
+		.decrypt	= omap_aes_gcm_decrypt,
+	}
+}
+};
+
+static struct omap_aes_algs_info omap_aes_algs_info_ecb_cbc[] = {
+	{
+		.algs_list	= algs_ecb_cbc,
+		.size		= ARRAY_SIZE(algs_ecb_cbc),
+	},
+};
+
+static const struct omap_aes_pdata omap_aes_pdata_omap2 = {
+	.algs_info	= omap_aes_algs_info_ecb_cbc,
+	.algs_info_size	= ARRAY_SIZE(omap_aes_algs_info_ecb_cbc),
+	.trigger	= omap_aes_dma_trigger_omap2,
+	.key_ofs	= 0x1c,
+	.iv_ofs		= 0x20,
+	.ctrl_ofs	= 0x30,
+	.data_ofs	= 0x34,
+	.rev_ofs	= 0x44,
+	.mask_ofs	= 0x48,
+	.sysstatus_ofs	= 0x4c,
+	.dma_enable_in	= AES_REG_MASK_DMA_IN_EN,
+	.dma_enable_out	= AES_REG_MASK_DMA_OUT_EN,
+	.dma_start	= AES_REG_MASK_START,
+	.major_mask	= 0xf0,
+	.major_shift	= 4,
+	.minor_mask	= 0x0f,
+	.minor_shift	= 0,
+};
+
+static struct omap_aes_algs_info omap_aes_algs_info_omap4[] = {
+	{
+		.algs_list	= algs_ecb_cbc,
+		.size		= ARRAY_SIZE(algs_ecb_cbc),
+	},
+	{
+		.algs_list	= algs_ctr,
+		.size		= ARRAY_SIZE(algs_ctr),
+	},
+	{
+		.algs_list	= algs_gcm,
+		.size		= ARRAY_SIZE(algs_gcm),
+	},
+};
+
+static const struct omap_aes_pdata omap_aes_pdata_omap4 = {
+	.algs_info	= omap_aes_algs_info_omap4,
+	.algs_info_size	= ARRAY_SIZE(omap_aes_algs_info_omap4),
+	.trigger	= omap_aes_dma_trigger_omap4,
+	.pm_runtime	= true,
+	.key_ofs	= 0x3c,
+	.iv_ofs		= 0x40,
+	.ctrl_ofs	= 0x50,
+	.data_ofs	= 0x60,
+	.rev_ofs	= 0x80,
+	.mask_ofs	= 0x84,
+	.sysstatus_ofs	= 0x88,
+	.dma_enable_in	= AES_REG_MASK_OMAP4_DMA_IN_EN,
+	.dma_enable_out	= AES_REG_MASK_OMAP4_DMA_OUT_EN,
+	.major_mask	= 0x0700,
+	.major_shift	= 8,
+	.minor_mask	= 0x003f,
+	.minor_shift	= 0,
+};
+
+static const struct platform_device_id omap_aes_id_table[] = {
+	{ "omap-aes",	(kernel_ulong_t)&omap_aes_pdata_omap2 },
+	{ "omap4-aes",	(kernel_ulong_t)&omap_aes_pdata_omap4 },
+	{ }
+};
+MODULE_DEVICE_TABLE(platform, omap_aes_id_table);
+
+static int omap_aes_register_algs(const struct omap_aes_pdata *pdata)
+{
+	struct crypto_alg *algs;
+	int err, i, j;
+
+	for (i = 0; i < pdata->algs_info_size; i++) {
+		algs = pdata->algs_info[i].algs_list;
+		for (j = 0; j < pdata->algs_info[i].size; j++) {
+			INIT_LIST_HEAD(&algs[j].cra_list);
+			err = crypto_register_alg(&algs[j]);
+			if (err)
+				goto err_algs;
+		}
+	}
+
+	return 0;
+
+err_algs:
+	for (; i >= 0; i--) {
+		algs = pdata->algs_info[i].algs_list;
+		while (j--)
+			crypto_unregister_alg(&algs[j]);
+		if (i > 0)
+			j = pdata->algs_info[i - 1].size;
+	}
+
+	return err;
+}
+
+static void omap_aes_unregister_algs(const struct omap_aes_pdata *pdata)
+{
+	struct crypto_alg *algs;
+	int i, j;
+
+	for (i = 0; i < pdata->algs_info_size; i++) {
+		algs = pdata->algs_info[i].algs_list;
+		for (j = 0; j < pdata->algs_info[i].size; j++)
+			crypto_unregister_alg(&algs[j]);
+	}
+}
+
+static ssize_t omap_aes_stats_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct omap_aes_dev *dd = dev_get_drvdata(dev);
+	struct omap_aes_stats stats;
+	unsigned long flags;
+	u64 avg_ns;
+
+	spin_lock_irqsave(&dd->lock, flags);
+	stats = dd->stats;
+	spin_unlock_irqrestore(&dd->lock, flags);
+
+	avg_ns = stats.hw_requests ?
+		div64_u64(stats.hw_ns, stats.hw_requests) : 0;
+
+	return sprintf(buf, "hw_requests: %lu\n"
+			    "hw_bytes: %llu\n"
+			    "hw_latency_avg_us: %llu\n"
+			    "hw_latency_max_us: %llu\n"
+			    "sw_requests: %lu\n"
+			    "sw_bytes: %llu\n",
+		       stats.hw_requests,
+		       (unsigned long long)stats.hw_bytes,
+		       (unsigned long long)div_u64(avg_ns, NSEC_PER_USEC),
+		       (unsigned long long)div_u64(stats.hw_max_ns,
+						   NSEC_PER_USEC),
+		       stats.sw_requests,
+		       (unsigned long long)stats.sw_bytes);
+}
+
+static ssize_t omap_aes_fallback_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	struct omap_aes_dev *dd = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", dd->fallback_sz);
+}
+
+static ssize_t omap_aes_fallback_store(struct device *dev,
+				       struct device_attribute *attr,
+				       const char *buf, size_t size)
+{
+	struct omap_aes_dev *dd = dev_get_drvdata(dev);
+	unsigned int val;
+	int err;
+
+	err = kstrtouint(buf, 0, &val);
+	if (err)
+		return err;
+
+	dd->fallback_sz = val;
+
+	return size;
+}
+
+static DEVICE_ATTR(stats, S_IRUGO, omap_aes_stats_show, NULL);
+static DEVICE_ATTR(fallback_threshold, S_IRUGO | S_IWUSR,
+		   omap_aes_fallback_show, omap_aes_fallback_store);
+
+static struct attribute *omap_aes_attrs[] = {
+	&dev_attr_stats.attr,
+	&dev_attr_fallback_threshold.attr,
+	NULL
+};
+
+static const struct attribute_group omap_aes_attr_group = {
+	.attrs = omap_aes_attrs,
+};
+
 static int omap_aes_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
 	struct omap_aes_dev *dd;
 	struct resource *res;
-	int err = -ENOMEM, i, j;
+	int err = -ENOMEM;
 	u32 reg;
 
 	dd = kzalloc(sizeof(struct omap_aes_dev), GFP_KERNEL);
@@ -813,6 +1558,9 @@ static int omap_aes_probe(struct platform_device *pdev)
 		goto err_data;
 	}
 	dd->dev = dev;
+	dd->pdata = (const struct omap_aes_pdata *)
+			platform_get_device_id(pdev)->driver_data;
+	dd->fallback_sz = OMAP_AES_FALLBACK_SIZE;
 	platform_set_drvdata(pdev, dd);
 
 	spin_lock_init(&dd->lock);
@@ -842,11 +1590,16 @@ static int omap_aes_probe(struct platform_device *pdev)
 		dd->dma_in = res->start;
 
 	/* Initializing the clock */
-	dd->iclk = clk_get(dev, "ick");
-	if (IS_ERR(dd->iclk)) {
-		dev_err(dev, "clock intialization failed.\n");
-		err = PTR_ERR(dd->iclk);
-		goto err_res;
+	if (dd->pdata->pm_runtime) {
+		pm_runtime_irq_safe(dev);
+		pm_runtime_enable(dev);
+	} else {
+		dd->iclk = clk_get(dev, "ick");
+		if (IS_ERR(dd->iclk)) {
+			dev_err(dev, "clock intialization failed.\n");
+			err = PTR_ERR(dd->iclk);
+			goto err_res;
+		}
 	}
 
 	dd->io_base = ioremap(dd->phys_base, SZ_4K);
@@ -856,11 +1609,12 @@ static int omap_aes_probe(struct platform_device *pdev)
 		goto err_io;
 	}
 
-	clk_enable(dd->iclk);
-	reg = omap_aes_read(dd, AES_REG_REV);
+	omap_aes_hw_get(dd);
+	reg = omap_aes_read(dd, AES_REG_REV(dd));
 	dev_info(dev, "OMAP AES hw accel rev: %u.%u\n",
-		 (reg & AES_REG_REV_MAJOR) >> 4, reg & AES_REG_REV_MINOR);
-	clk_disable(dd->iclk);
+		 (reg & dd->pdata->major_mask) >> dd->pdata->major_shift,
+		 (reg & dd->pdata->minor_mask) >> dd->pdata->minor_shift);
+	omap_aes_hw_put(dd);
 
 	tasklet_init(&dd->done_task, omap_aes_done_task, (unsigned long)dd);
 	tasklet_init(&dd->queue_task, omap_aes_queue_task, (unsigned long)dd);
@@ -874,27 +1628,36 @@ static int omap_aes_probe(struct platform_device *pdev)
 	list_add_tail(&dd->list, &dev_list);
 	spin_unlock(&list_lock);
 
-	for (i = 0; i < ARRAY_SIZE(algs); i++) {
-		pr_debug("i: %d\n", i);
-		INIT_LIST_HEAD(&algs[i].cra_list);
-		err = crypto_register_alg(&algs[i]);
-		if (err)
-			goto err_algs;
-	}
+	mutex_lock(&algs_lock);
+	if (!algs_users)
+		err = omap_aes_register_algs(dd->pdata);
+	if (!err)
+		algs_users++;
+	mutex_unlock(&algs_lock);
+	if (err)
+		goto err_algs;
+
+	err = sysfs_create_group(&dev->kobj, &omap_aes_attr_group);
+	if (err)
+		dev_warn(dev, "unable to create sysfs attributes\n");
 
 	pr_info("probe() done\n");
 
 	return 0;
 err_algs:
-	for (j = 0; j < i; j++)
-		crypto_unregister_alg(&algs[j]);
+	spin_lock(&list_lock);
+	list_del(&dd->list);
+	spin_unlock(&list_lock);
 	omap_aes_dma_cleanup(dd);
 err_dma:
 	tasklet_kill(&dd->done_task);
 	tasklet_kill(&dd->queue_task);
 	iounmap(dd->io_base);
 err_io:
-	clk_put(dd->iclk);
+	if (dd->iclk)
+		clk_put(dd->iclk);
+	else
+		pm_runtime_disable(dev);
 err_res:
 	kfree(dd);
 	dd = NULL;
@@ -906,23 +1669,29 @@ err_data:
 static int omap_aes_remove(struct platform_device *pdev)
 {
 	struct omap_aes_dev *dd = platform_get_drvdata(pdev);
-	int i;
 
 	if (!dd)
 		return -ENODEV;
 
+	sysfs_remove_group(&pdev->dev.kobj, &omap_aes_attr_group);
+
 	spin_lock(&list_lock);
 	list_del(&dd->list);
 	spin_unlock(&list_lock);
 
-	for (i = 0; i < ARRAY_SIZE(algs); i++)
-		crypto_unregister_alg(&algs[i]);
+	mutex_lock(&algs_lock);
+	if (!--algs_users)
+		omap_aes_unregister_algs(dd->pdata);
+	mutex_unlock(&algs_lock);
 
 	tasklet_kill(&dd->done_task);
 	tasklet_kill(&dd->queue_task);
 	omap_aes_dma_cleanup(dd);
 	iounmap(dd->io_base);
-	clk_put(dd->iclk);
+	if (dd->iclk)
+		clk_put(dd->iclk);
+	else
+		pm_runtime_disable(&pdev->dev);
 	kfree(dd);
 	dd = NULL;
 
@@ -932,6 +1701,7 @@ static int omap_aes_remove(struct platform_device *pdev)
 static struct platform_driver omap_aes_driver = {
 	.probe	= omap_aes_probe,
 	.remove	= omap_aes_remove,
+	.id_table = omap_aes_id_table,
 	.driver	= {
 		.name	= "omap-aes",
 		.owner	= THIS_MODULE,
@@ -942,7 +1712,9 @@ static int __init omap_aes_mod_init(void)
 {
 	pr_info("loading %s driver\n", "omap-aes");
 
-	if (!cpu_class_is_omap2() || omap_type() != OMAP2_DEVICE_TYPE_SEC) {
+	/* the OMAP4 public engines are usable on GP devices too */
+	if (!cpu_class_is_omap2() ||
+	    (omap_type() != OMAP2_DEVICE_TYPE_SEC && !cpu_is_omap44xx())) {
 		pr_err("Unsupported cpu\n");
 		return -ENODEV;
 	}
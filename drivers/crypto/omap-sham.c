@@ -29,6 +29,9 @@
 #include <linux/scatterlist.h>
 #include <linux/dma-mapping.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/pm_runtime.h>
 #include <linux/crypto.h>
 #include <linux/cryptohash.h>
 #include <crypto/scatterwalk.h>
@@ -41,14 +44,18 @@
 #include <plat/dma.h>
 #include <mach/irqs.h>
 
-#define SHA_REG_DIGEST(x)		(0x00 + ((x) * 0x04))
-#define SHA_REG_DIN(x)			(0x1C + ((x) * 0x04))
+/*
+ * The OMAP4 SHA2MD5 module moved most registers, the offsets that differ
+ * come from the platform data of the instance.
+ */
+#define SHA_REG_IDIGEST(dd, x)		((dd)->pdata->idigest_ofs + ((x)*0x04))
+#define SHA_REG_DIN(dd, x)		((dd)->pdata->din_ofs + ((x) * 0x04))
+#define SHA_REG_DIGCNT(dd)		((dd)->pdata->digcnt_ofs)
 
+/* SHA224 and SHA256 use the same block size as SHA1 and MD5 */
 #define SHA1_MD5_BLOCK_SIZE		SHA1_BLOCK_SIZE
 #define MD5_DIGEST_SIZE			16
 
-#define SHA_REG_DIGCNT			0x14
-
 #define SHA_REG_CTRL			0x18
 #define SHA_REG_CTRL_LENGTH		(0xFFFFFFFF << 5)
 #define SHA_REG_CTRL_CLOSE_HASH		(1 << 4)
@@ -57,19 +64,36 @@
 #define SHA_REG_CTRL_INPUT_READY	(1 << 1)
 #define SHA_REG_CTRL_OUTPUT_READY	(1 << 0)
 
-#define SHA_REG_REV			0x5C
-#define SHA_REG_REV_MAJOR		0xF0
-#define SHA_REG_REV_MINOR		0x0F
+#define SHA_REG_REV(dd)			((dd)->pdata->rev_ofs)
 
-#define SHA_REG_MASK			0x60
+#define SHA_REG_MASK(dd)		((dd)->pdata->mask_ofs)
 #define SHA_REG_MASK_DMA_EN		(1 << 3)
 #define SHA_REG_MASK_IT_EN		(1 << 2)
 #define SHA_REG_MASK_SOFTRESET		(1 << 1)
 #define SHA_REG_AUTOIDLE		(1 << 0)
 
-#define SHA_REG_SYSSTATUS		0x64
+#define SHA_REG_SYSSTATUS(dd)		((dd)->pdata->sysstatus_ofs)
 #define SHA_REG_SYSSTATUS_RESETDONE	(1 << 0)
 
+/* OMAP4 only */
+#define SHA_REG_MODE			0x44
+#define SHA_REG_MODE_CLOSE_HASH		(1 << 4)
+#define SHA_REG_MODE_ALGO_CONSTANT	(1 << 3)
+#define SHA_REG_MODE_ALGO_MASK		(3 << 1)
+#define		SHA_REG_MODE_ALGO_MD5_128	(0 << 1)
+#define		SHA_REG_MODE_ALGO_SHA1_160	(1 << 1)
+#define		SHA_REG_MODE_ALGO_SHA2_224	(2 << 1)
+#define		SHA_REG_MODE_ALGO_SHA2_256	(3 << 1)
+
+#define SHA_REG_LENGTH			0x48
+
+#define SHA_REG_IRQSTATUS		0x118
+#define SHA_REG_IRQSTATUS_INPUT_RDY	(1 << 1)
+#define SHA_REG_IRQSTATUS_OUTPUT_RDY	(1 << 0)
+
+#define SHA_REG_IRQENA			0x11C
+#define SHA_REG_IRQENA_OUTPUT_RDY	(1 << 0)
+
 #define DEFAULT_TIMEOUT_INTERVAL	HZ
 
 /* mostly device flags */
@@ -83,9 +107,20 @@
 /* context flags */
 #define FLAGS_FINUP		16
 #define FLAGS_SG		17
-#define FLAGS_SHA1		18
-#define FLAGS_HMAC		19
-#define FLAGS_ERROR		20
+#define FLAGS_HMAC		18
+#define FLAGS_ERROR		19
+/* algorithm, bits 20 and 21, encoded like the OMAP4 MODE register */
+#define FLAGS_MODE_SHIFT	20
+#define FLAGS_MODE_MASK		(SHA_REG_MODE_ALGO_MASK << \
+					(FLAGS_MODE_SHIFT - 1))
+#define FLAGS_MODE_MD5		(SHA_REG_MODE_ALGO_MD5_128 << \
+					(FLAGS_MODE_SHIFT - 1))
+#define FLAGS_MODE_SHA1		(SHA_REG_MODE_ALGO_SHA1_160 << \
+					(FLAGS_MODE_SHIFT - 1))
+#define FLAGS_MODE_SHA224	(SHA_REG_MODE_ALGO_SHA2_224 << \
+					(FLAGS_MODE_SHIFT - 1))
+#define FLAGS_MODE_SHA256	(SHA_REG_MODE_ALGO_SHA2_256 << \
+					(FLAGS_MODE_SHIFT - 1))
 
 #define OP_UPDATE	1
 #define OP_FINAL	2
@@ -102,7 +137,7 @@ struct omap_sham_reqctx {
 	unsigned long		flags;
 	unsigned long		op;
 
-	u8			digest[SHA1_DIGEST_SIZE] OMAP_ALIGNED;
+	u8			digest[SHA256_DIGEST_SIZE] OMAP_ALIGNED;
 	size_t			digcnt;
 	size_t			bufcnt;
 	size_t			buflen;
@@ -113,6 +148,8 @@ struct omap_sham_reqctx {
 	unsigned int		offset;	/* offset in current sg */
 	unsigned int		total;	/* total request */
 
+	ktime_t			start;	/* queued at */
+
 	u8			buffer[0] OMAP_ALIGNED;
 };
 
@@ -133,7 +170,53 @@ struct omap_sham_ctx {
 	struct omap_sham_hmac_ctx base[0];
 };
 
-#define OMAP_SHAM_QUEUE_LENGTH	1
+struct omap_sham_algs_info {
+	struct ahash_alg	*algs_list;
+	unsigned int		size;
+};
+
+struct omap_sham_pdata {
+	struct omap_sham_algs_info	*algs_info;
+	unsigned int	algs_info_size;
+
+	void		(*write_ctrl)(struct omap_sham_dev *dd, size_t length,
+				      int final, int dma);
+	void		(*trigger)(struct omap_sham_dev *dd, size_t length);
+	int		(*poll_irq)(struct omap_sham_dev *dd);
+	irqreturn_t	(*intr_hdlr)(int irq, void *dev_id);
+
+	/* OMAP4 instances are omap_devices, clocked through runtime PM */
+	bool		pm_runtime;
+
+	u32		idigest_ofs;
+	u32		din_ofs;
+	u32		digcnt_ofs;
+	u32		rev_ofs;
+	u32		mask_ofs;
+	u32		sysstatus_ofs;
+
+	u32		major_mask;
+	u32		major_shift;
+	u32		minor_mask;
+	u32		minor_shift;
+};
+
+struct omap_sham_stats {
+	unsigned long	hw_requests;
+	u64		hw_bytes;
+	u64		hw_ns;		/* enqueue to completion */
+	u64		hw_max_ns;
+	unsigned long	sw_requests;
+	u64		sw_bytes;
+};
+
+/*
+ * Digests of messages up to this many bytes are cheaper on the CPU than the
+ * DMA setup and the interrupt round trip through the engine.
+ */
+#define OMAP_SHAM_FALLBACK_SIZE	256
+
+#define OMAP_SHAM_QUEUE_LENGTH	32
 
 struct omap_sham_dev {
 	struct list_head	list;
@@ -151,6 +234,11 @@ struct omap_sham_dev {
 	unsigned long		flags;
 	struct crypto_queue	queue;
 	struct ahash_request	*req;
+
+	const struct omap_sham_pdata	*pdata;
+
+	unsigned int		fallback_sz;
+	struct omap_sham_stats	stats;
 };
 
 struct omap_sham_drv {
@@ -164,6 +252,10 @@ static struct omap_sham_drv sham = {
 	.lock = __SPIN_LOCK_UNLOCKED(sham.lock),
 };
 
+/* algorithms are shared by all engines, registered with the first one */
+static DEFINE_MUTEX(algs_lock);
+static unsigned int algs_users;
+
 static inline u32 omap_sham_read(struct omap_sham_dev *dd, u32 offset)
 {
 	return __raw_readl(dd->io_base + offset);
@@ -198,20 +290,37 @@ static inline int omap_sham_wait(struct omap_sham_dev *dd, u32 offset, u32 bit)
 	return 0;
 }
 
+static int omap_sham_digest_size(struct omap_sham_reqctx *ctx)
+{
+	switch (ctx->flags & FLAGS_MODE_MASK) {
+	case FLAGS_MODE_MD5:
+		return MD5_DIGEST_SIZE;
+	case FLAGS_MODE_SHA1:
+		return SHA1_DIGEST_SIZE;
+	case FLAGS_MODE_SHA224:
+		return SHA224_DIGEST_SIZE;
+	default:
+		return SHA256_DIGEST_SIZE;
+	}
+}
+
 static void omap_sham_copy_hash(struct ahash_request *req, int out)
 {
 	struct omap_sham_reqctx *ctx = ahash_request_ctx(req);
+	struct omap_sham_dev *dd = ctx->dd;
 	u32 *hash = (u32 *)ctx->digest;
-	int i;
+	int i, size = SHA1_DIGEST_SIZE;
 
 	/* MD5 is almost unused. So copy sha1 size to reduce code */
-	for (i = 0; i < SHA1_DIGEST_SIZE / sizeof(u32); i++) {
+	if (omap_sham_digest_size(ctx) > SHA1_DIGEST_SIZE)
+		/* the SHA224 state is a full SHA256 one */
+		size = SHA256_DIGEST_SIZE;
+
+	for (i = 0; i < size / sizeof(u32); i++) {
 		if (out)
-			hash[i] = omap_sham_read(ctx->dd,
-						SHA_REG_DIGEST(i));
+			hash[i] = omap_sham_read(dd, SHA_REG_IDIGEST(dd, i));
 		else
-			omap_sham_write(ctx->dd,
-					SHA_REG_DIGEST(i), hash[i]);
+			omap_sham_write(dd, SHA_REG_IDIGEST(dd, i), hash[i]);
 	}
 }
 
@@ -220,31 +329,47 @@ static void omap_sham_copy_ready_hash(struct ahash_request *req)
 	struct omap_sham_reqctx *ctx = ahash_request_ctx(req);
 	u32 *in = (u32 *)ctx->digest;
 	u32 *hash = (u32 *)req->result;
-	int i;
+	int i, size = omap_sham_digest_size(ctx);
 
 	if (!hash)
 		return;
 
-	if (likely(ctx->flags & BIT(FLAGS_SHA1))) {
-		/* SHA1 results are in big endian */
-		for (i = 0; i < SHA1_DIGEST_SIZE / sizeof(u32); i++)
+	if (likely((ctx->flags & FLAGS_MODE_MASK) != FLAGS_MODE_MD5)) {
+		/* SHA1 and SHA2 results are in big endian */
+		for (i = 0; i < size / sizeof(u32); i++)
 			hash[i] = be32_to_cpu(in[i]);
 	} else {
 		/* MD5 results are in little endian */
-		for (i = 0; i < MD5_DIGEST_SIZE / sizeof(u32); i++)
+		for (i = 0; i < size / sizeof(u32); i++)
 			hash[i] = le32_to_cpu(in[i]);
 	}
 }
 
+static void omap_sham_hw_get(struct omap_sham_dev *dd)
+{
+	if (dd->iclk)
+		clk_enable(dd->iclk);
+	else
+		pm_runtime_get_sync(dd->dev);
+}
+
+static void omap_sham_hw_put(struct omap_sham_dev *dd)
+{
+	if (dd->iclk)
+		clk_disable(dd->iclk);
+	else
+		pm_runtime_put(dd->dev);
+}
+
 static int omap_sham_hw_init(struct omap_sham_dev *dd)
 {
-	clk_enable(dd->iclk);
+	omap_sham_hw_get(dd);
 
 	if (!test_bit(FLAGS_INIT, &dd->flags)) {
-		omap_sham_write_mask(dd, SHA_REG_MASK,
+		omap_sham_write_mask(dd, SHA_REG_MASK(dd),
 			SHA_REG_MASK_SOFTRESET, SHA_REG_MASK_SOFTRESET);
 
-		if (omap_sham_wait(dd, SHA_REG_SYSSTATUS,
+		if (omap_sham_wait(dd, SHA_REG_SYSSTATUS(dd),
 					SHA_REG_SYSSTATUS_RESETDONE))
 			return -ETIMEDOUT;
 
@@ -255,23 +380,23 @@ static int omap_sham_hw_init(struct omap_sham_dev *dd)
 	return 0;
 }
 
-static void omap_sham_write_ctrl(struct omap_sham_dev *dd, size_t length,
+static void omap_sham_write_ctrl_omap2(struct omap_sham_dev *dd, size_t length,
 				 int final, int dma)
 {
 	struct omap_sham_reqctx *ctx = ahash_request_ctx(dd->req);
 	u32 val = length << 5, mask;
 
 	if (likely(ctx->digcnt))
-		omap_sham_write(dd, SHA_REG_DIGCNT, ctx->digcnt);
+		omap_sham_write(dd, SHA_REG_DIGCNT(dd), ctx->digcnt);
 
-	omap_sham_write_mask(dd, SHA_REG_MASK,
+	omap_sham_write_mask(dd, SHA_REG_MASK(dd),
 		SHA_REG_MASK_IT_EN | (dma ? SHA_REG_MASK_DMA_EN : 0),
 		SHA_REG_MASK_IT_EN | SHA_REG_MASK_DMA_EN);
 	/*
 	 * Setting ALGO_CONST only for the first iteration
 	 * and CLOSE_HASH only for the last one.
 	 */
-	if (ctx->flags & BIT(FLAGS_SHA1))
+	if ((ctx->flags & FLAGS_MODE_MASK) == FLAGS_MODE_SHA1)
 		val |= SHA_REG_CTRL_ALGO;
 	if (!ctx->digcnt)
 		val |= SHA_REG_CTRL_ALGO_CONST;
@@ -284,6 +409,57 @@ static void omap_sham_write_ctrl(struct omap_sham_dev *dd, size_t length,
 	omap_sham_write_mask(dd, SHA_REG_CTRL, val, mask);
 }
 
+static void omap_sham_trigger_omap2(struct omap_sham_dev *dd, size_t length)
+{
+	/* the length went to CTRL with the rest of the setup */
+}
+
+static int omap_sham_poll_irq_omap2(struct omap_sham_dev *dd)
+{
+	return omap_sham_wait(dd, SHA_REG_CTRL, SHA_REG_CTRL_INPUT_READY);
+}
+
+static void omap_sham_write_ctrl_omap4(struct omap_sham_dev *dd, size_t length,
+				 int final, int dma)
+{
+	struct omap_sham_reqctx *ctx = ahash_request_ctx(dd->req);
+	u32 val, mask;
+
+	if (likely(ctx->digcnt))
+		omap_sham_write(dd, SHA_REG_DIGCNT(dd), ctx->digcnt);
+
+	/*
+	 * Setting ALGO_CONST only for the first iteration
+	 * and CLOSE_HASH only for the last one.
+	 */
+	val = (ctx->flags & FLAGS_MODE_MASK) >> (FLAGS_MODE_SHIFT - 1);
+	if (!ctx->digcnt)
+		val |= SHA_REG_MODE_ALGO_CONSTANT;
+	if (final)
+		val |= SHA_REG_MODE_CLOSE_HASH;
+
+	mask = SHA_REG_MODE_ALGO_CONSTANT | SHA_REG_MODE_CLOSE_HASH |
+			SHA_REG_MODE_ALGO_MASK;
+
+	omap_sham_write_mask(dd, SHA_REG_MODE, val, mask);
+	omap_sham_write(dd, SHA_REG_IRQENA, SHA_REG_IRQENA_OUTPUT_RDY);
+	omap_sham_write_mask(dd, SHA_REG_MASK(dd),
+		SHA_REG_MASK_IT_EN | (dma ? SHA_REG_MASK_DMA_EN : 0),
+		SHA_REG_MASK_IT_EN | SHA_REG_MASK_DMA_EN);
+}
+
+static void omap_sham_trigger_omap4(struct omap_sham_dev *dd, size_t length)
+{
+	/* writing the length starts the operation */
+	omap_sham_write(dd, SHA_REG_LENGTH, length);
+}
+
+static int omap_sham_poll_irq_omap4(struct omap_sham_dev *dd)
+{
+	return omap_sham_wait(dd, SHA_REG_IRQSTATUS,
+			      SHA_REG_IRQSTATUS_INPUT_RDY);
+}
+
 static int omap_sham_xmit_cpu(struct omap_sham_dev *dd, const u8 *buf,
 			      size_t length, int final)
 {
@@ -294,12 +470,13 @@ static int omap_sham_xmit_cpu(struct omap_sham_dev *dd, const u8 *buf,
 	dev_dbg(dd->dev, "xmit_cpu: digcnt: %d, length: %d, final: %d\n",
 						ctx->digcnt, length, final);
 
-	omap_sham_write_ctrl(dd, length, final, 0);
+	dd->pdata->write_ctrl(dd, length, final, 0);
+	dd->pdata->trigger(dd, length);
 
 	/* should be non-zero before next lines to disable clocks later */
 	ctx->digcnt += length;
 
-	if (omap_sham_wait(dd, SHA_REG_CTRL, SHA_REG_CTRL_INPUT_READY))
+	if (dd->pdata->poll_irq(dd))
 		return -ETIMEDOUT;
 
 	if (final)
@@ -310,7 +487,7 @@ static int omap_sham_xmit_cpu(struct omap_sham_dev *dd, const u8 *buf,
 	len32 = DIV_ROUND_UP(length, sizeof(u32));
 
 	for (count = 0; count < len32; count++)
-		omap_sham_write(dd, SHA_REG_DIN(count), buffer[count]);
+		omap_sham_write(dd, SHA_REG_DIN(dd, count), buffer[count]);
 
 	return -EINPROGRESS;
 }
@@ -333,7 +510,7 @@ static int omap_sham_xmit_dma(struct omap_sham_dev *dd, dma_addr_t dma_addr,
 	omap_set_dma_src_params(dd->dma_lch, 0, OMAP_DMA_AMODE_POST_INC,
 				dma_addr, 0, 0);
 
-	omap_sham_write_ctrl(dd, length, final, 1);
+	dd->pdata->write_ctrl(dd, length, final, 1);
 
 	ctx->digcnt += length;
 
@@ -344,6 +521,8 @@ static int omap_sham_xmit_dma(struct omap_sham_dev *dd, dma_addr_t dma_addr,
 
 	omap_start_dma(dd->dma_lch);
 
+	dd->pdata->trigger(dd, length);
+
 	return -EINPROGRESS;
 }
 
@@ -527,6 +706,9 @@ static int omap_sham_init(struct ahash_request *req)
 			dd = tmp;
 			break;
 		}
+		/* spread transforms over the engines round robin */
+		if (dd)
+			list_move_tail(&dd->list, &sham.dev_list);
 		tctx->dd = dd;
 	} else {
 		dd = tctx->dd;
@@ -540,8 +722,20 @@ static int omap_sham_init(struct ahash_request *req)
 	dev_dbg(dd->dev, "init: digest size: %d\n",
 		crypto_ahash_digestsize(tfm));
 
-	if (crypto_ahash_digestsize(tfm) == SHA1_DIGEST_SIZE)
-		ctx->flags |= BIT(FLAGS_SHA1);
+	switch (crypto_ahash_digestsize(tfm)) {
+	case MD5_DIGEST_SIZE:
+		ctx->flags |= FLAGS_MODE_MD5;
+		break;
+	case SHA1_DIGEST_SIZE:
+		ctx->flags |= FLAGS_MODE_SHA1;
+		break;
+	case SHA224_DIGEST_SIZE:
+		ctx->flags |= FLAGS_MODE_SHA224;
+		break;
+	case SHA256_DIGEST_SIZE:
+		ctx->flags |= FLAGS_MODE_SHA256;
+		break;
+	}
 
 	ctx->bufcnt = 0;
 	ctx->digcnt = 0;
@@ -637,10 +831,13 @@ static int omap_sham_finish(struct ahash_request *req)
 	return err;
 }
 
-static void omap_sham_finish_req(struct ahash_request *req, int err)
+/* Collects the result of the current request and frees the engine. */
+static int omap_sham_release_req(struct ahash_request *req, int err)
 {
 	struct omap_sham_reqctx *ctx = ahash_request_ctx(req);
 	struct omap_sham_dev *dd = ctx->dd;
+	unsigned long flags;
+	u64 ns;
 
 	if (!err) {
 		omap_sham_copy_hash(req, 1);
@@ -650,13 +847,39 @@ static void omap_sham_finish_req(struct ahash_request *req, int err)
 		ctx->flags |= BIT(FLAGS_ERROR);
 	}
 
+	ns = ktime_to_ns(ktime_sub(ktime_get(), ctx->start));
+
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->stats.hw_requests++;
+	dd->stats.hw_bytes += req->nbytes;
+	dd->stats.hw_ns += ns;
+	if (ns > dd->stats.hw_max_ns)
+		dd->stats.hw_max_ns = ns;
+	spin_unlock_irqrestore(&dd->lock, flags);
+
 	/* atomic operation is not needed here */
 	dd->flags &= ~(BIT(FLAGS_BUSY) | BIT(FLAGS_FINAL) | BIT(FLAGS_CPU) |
 			BIT(FLAGS_DMA_READY) | BIT(FLAGS_OUTPUT_READY));
-	clk_disable(dd->iclk);
+
+	return err;
+}
+
+static void omap_sham_complete(struct omap_sham_dev *dd,
+			       struct ahash_request *req, int err)
+{
+	omap_sham_hw_put(dd);
 
 	if (req->base.complete)
 		req->base.complete(&req->base, err);
+}
+
+static void omap_sham_finish_req(struct ahash_request *req, int err)
+{
+	struct omap_sham_reqctx *ctx = ahash_request_ctx(req);
+	struct omap_sham_dev *dd = ctx->dd;
+
+	err = omap_sham_release_req(req, err);
+	omap_sham_complete(dd, req, err);
 
 	/* handle new request */
 	tasklet_schedule(&dd->done_task);
@@ -702,7 +925,7 @@ static int omap_sham_handle_queue(struct omap_sham_dev *dd,
 
 	omap_set_dma_dest_params(dd->dma_lch, 0,
 			OMAP_DMA_AMODE_CONSTANT,
-			dd->phys_base + SHA_REG_DIN(0), 0, 16);
+			dd->phys_base + SHA_REG_DIN(dd, 0), 0, 16);
 
 	omap_set_dma_dest_burst_mode(dd->dma_lch,
 			OMAP_DMA_DATA_BURST_16);
@@ -739,10 +962,28 @@ static int omap_sham_enqueue(struct ahash_request *req, unsigned int op)
 	struct omap_sham_dev *dd = tctx->dd;
 
 	ctx->op = op;
+	ctx->start = ktime_get();
 
 	return omap_sham_handle_queue(dd, req);
 }
 
+/*
+ * Whether a message that has not reached the engine yet is better hashed
+ * by the fallback: the engine needs at least 9 bytes, and for short
+ * messages the DMA and interrupt round trip costs more than the hash.
+ */
+static bool omap_sham_use_fallback(struct omap_sham_reqctx *ctx, size_t len)
+{
+	if (ctx->digcnt)
+		return false;
+
+	/* the ipad block is not part of the message for the fallback */
+	if (ctx->flags & BIT(FLAGS_HMAC))
+		len -= SHA1_MD5_BLOCK_SIZE;
+
+	return len < 9 || len < ctx->dd->fallback_sz;
+}
+
 static int omap_sham_update(struct ahash_request *req)
 {
 	struct omap_sham_reqctx *ctx = ahash_request_ctx(req);
@@ -755,7 +996,8 @@ static int omap_sham_update(struct ahash_request *req)
 	ctx->offset = 0;
 
 	if (ctx->flags & BIT(FLAGS_FINUP)) {
-		if ((ctx->digcnt + ctx->bufcnt + ctx->total) < 9) {
+		if (omap_sham_use_fallback(ctx, ctx->bufcnt + ctx->total) &&
+		    ctx->bufcnt + ctx->total <= ctx->buflen) {
 			/*
 			* OMAP HW accel works only with buffers >= 9
 			* will switch to bypass in final()
@@ -795,9 +1037,22 @@ static int omap_sham_final_shash(struct ahash_request *req)
 {
 	struct omap_sham_ctx *tctx = crypto_tfm_ctx(req->base.tfm);
 	struct omap_sham_reqctx *ctx = ahash_request_ctx(req);
+	struct omap_sham_dev *dd = ctx->dd;
+	unsigned long flags;
+	int offset = 0;
+
+	/* the keyed fallback does the HMAC itself, skip the ipad block */
+	if (ctx->flags & BIT(FLAGS_HMAC))
+		offset = SHA1_MD5_BLOCK_SIZE;
+
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->stats.sw_requests++;
+	dd->stats.sw_bytes += ctx->bufcnt - offset;
+	spin_unlock_irqrestore(&dd->lock, flags);
 
 	return omap_sham_shash_digest(tctx->fallback, req->base.flags,
-				      ctx->buffer, ctx->bufcnt, req->result);
+				      ctx->buffer + offset,
+				      ctx->bufcnt - offset, req->result);
 }
 
 static int omap_sham_final(struct ahash_request *req)
@@ -810,8 +1065,7 @@ static int omap_sham_final(struct ahash_request *req)
 		return 0; /* uncompleted hash is not needed */
 
 	/* OMAP HW accel works only with buffers >= 9 */
-	/* HMAC is always >= 9 because ipad == block size */
-	if ((ctx->digcnt + ctx->bufcnt) < 9)
+	if (omap_sham_use_fallback(ctx, ctx->bufcnt))
 		return omap_sham_final_shash(req);
 	else if (ctx->bufcnt)
 		return omap_sham_enqueue(req, OP_FINAL);
@@ -927,6 +1181,16 @@ static int omap_sham_cra_md5_init(struct crypto_tfm *tfm)
 	return omap_sham_cra_init_alg(tfm, "md5");
 }
 
+static int omap_sham_cra_sha224_init(struct crypto_tfm *tfm)
+{
+	return omap_sham_cra_init_alg(tfm, "sha224");
+}
+
+static int omap_sham_cra_sha256_init(struct crypto_tfm *tfm)
+{
+	return omap_sham_cra_init_alg(tfm, "sha256");
+}
+
 static void omap_sham_cra_exit(struct crypto_tfm *tfm)
 {
 	struct omap_sham_ctx *tctx = crypto_tfm_ctx(tfm);
@@ -940,7 +1204,7 @@ static void omap_sham_cra_exit(struct crypto_tfm *tfm)
 	}
 }
 
-static struct ahash_alg algs[] = {
+static struct ahash_alg algs_sha1_md5[] = {
 {
 	.init		= omap_sham_init,
 	.update		= omap_sham_update,
@@ -1039,9 +1303,110 @@ static struct ahash_alg algs[] = {
 }
 };
 
+/* OMAP4 and newer */
+static struct ahash_alg algs_sha224_sha256[] = {
+{
+	.init		= omap_sham_init,
+	.update		= omap_sham_update,
+	.final		= omap_sham_final,
+	.finup		= omap_sham_finup,
+	.digest		= omap_sham_digest,
+	.halg.digestsize	= SHA224_DIGEST_SIZE,
+	.halg.base	= {
+		.cra_name		= "sha224",
+		.cra_driver_name	= "omap-sha224",
+		.cra_priority		= 100,
+		.cra_flags		= CRYPTO_ALG_TYPE_AHASH |
+						CRYPTO_ALG_KERN_DRIVER_ONLY |
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize		= SHA224_BLOCK_SIZE,
+		.cra_ctxsize		= sizeof(struct omap_sham_ctx),
+		.cra_alignmask		= OMAP_ALIGN_MASK,
+		.cra_module		= THIS_MODULE,
+		.cra_init		= omap_sham_cra_init,
+		.cra_exit		= omap_sham_cra_exit,
+	}
+},
+{
+	.init		= omap_sham_init,
+	.update		= omap_sham_update,
+	.final		= omap_sham_final,
+	.finup		= omap_sham_finup,
+	.digest		= omap_sham_digest,
+	.halg.digestsize	= SHA256_DIGEST_SIZE,
+	.halg.base	= {
+		.cra_name		= "sha256",
+		.cra_driver_name	= "omap-sha256",
+		.cra_priority		= 100,
+		.cra_flags		= CRYPTO_ALG_TYPE_AHASH |
+						CRYPTO_ALG_KERN_DRIVER_ONLY |
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize		= SHA256_BLOCK_SIZE,
+		.cra_ctxsize		= sizeof(struct omap_sham_ctx),
+		.cra_alignmask		= OMAP_ALIGN_MASK,
+		.cra_module		= THIS_MODULE,
+		.cra_init		= omap_sham_cra_init,
+		.cra_exit		= omap_sham_cra_exit,
+	}
+},
+{
+	.init		= omap_sham_init,
+	.update		= omap_sham_update,
+	.final		= omap_sham_final,
+	.finup		= omap_sham_finup,
+	.digest		= omap_sham_digest,
+	.setkey		= omap_sham_setkey,
+	.halg.digestsize	= SHA224_DIGEST_SIZE,
+	.halg.base	= {
+		.cra_name		= "hmac(sha224)",
+		.cra_driver_name	= "omap-hmac-sha224",
+		.cra_priority		= 100,
+		.cra_flags		= CRYPTO_ALG_TYPE_AHASH |
+						CRYPTO_ALG_KERN_DRIVER_ONLY |
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize		= SHA224_BLOCK_SIZE,
+		.cra_ctxsize		= sizeof(struct omap_sham_ctx) +
+					sizeof(struct omap_sham_hmac_ctx),
+		.cra_alignmask		= OMAP_ALIGN_MASK,
+		.cra_module		= THIS_MODULE,
+		.cra_init		= omap_sham_cra_sha224_init,
+		.cra_exit		= omap_sham_cra_exit,
+	}
+},
+{
+	.init		= omap_sham_init,
+	.update		= omap_sham_update,
+	.final		= omap_sham_final,
+	.finup		= omap_sham_finup,
+	.digest		= omap_sham_digest,
+	.setkey		= omap_sham_setkey,
+	.halg.digestsize	= SHA256_DIGEST_SIZE,
+	.halg.base	= {
+		.cra_name		= "hmac(sha256)",
+		.cra_driver_name	= "omap-hmac-sha256",
+		.cra_priority		= 100,
+		.cra_flags		= CRYPTO_ALG_TYPE_AHASH |
+						CRYPTO_ALG_KERN_DRIVER_ONLY |
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize		= SHA256_BLOCK_SIZE,
+		.cra_ctxsize		= sizeof(struct omap_sham_ctx) +
+					sizeof(struct omap_sham_hmac_ctx),
+		.cra_alignmask		= OMAP_ALIGN_MASK,
+		.cra_module		= THIS_MODULE,
+		.cra_init		= omap_sham_cra_sha256_init,
+		.cra_exit		= omap_sham_cra_exit,
+	}
+}
+};
+
 static void omap_sham_done_task(unsigned long data)
 {
 	struct omap_sham_dev *dd = (struct omap_sham_dev *)data;
+	struct ahash_request *req;
 	int err = 0;
 
 	if (!test_bit(FLAGS_BUSY, &dd->flags)) {
@@ -1074,10 +1439,31 @@ static void omap_sham_done_task(unsigned long data)
 finish:
 	dev_dbg(dd->dev, "update done: err: %d\n", err);
 	/* finish curent request */
-	omap_sham_finish_req(dd->req, err);
+	req = dd->req;
+	err = omap_sham_release_req(req, err);
+
+	/*
+	 * Start the next queued request before completing this one, so the
+	 * engine is busy while the completion callback runs.
+	 */
+	omap_sham_handle_queue(dd, NULL);
+	omap_sham_complete(dd, req, err);
 }
 
-static irqreturn_t omap_sham_irq(int irq, void *dev_id)
+static irqreturn_t omap_sham_irq_common(struct omap_sham_dev *dd)
+{
+	if (!test_bit(FLAGS_BUSY, &dd->flags)) {
+		dev_warn(dd->dev, "Interrupt when no active requests.\n");
+		return IRQ_HANDLED;
+	}
+
+	set_bit(FLAGS_OUTPUT_READY, &dd->flags);
+	tasklet_schedule(&dd->done_task);
+
+	return IRQ_HANDLED;
+}
+
+static irqreturn_t omap_sham_irq_omap2(int irq, void *dev_id)
 {
 	struct omap_sham_dev *dd = dev_id;
 
@@ -1089,17 +1475,193 @@ static irqreturn_t omap_sham_irq(int irq, void *dev_id)
 				 SHA_REG_CTRL_OUTPUT_READY);
 	omap_sham_read(dd, SHA_REG_CTRL);
 
-	if (!test_bit(FLAGS_BUSY, &dd->flags)) {
-		dev_warn(dd->dev, "Interrupt when no active requests.\n");
-		return IRQ_HANDLED;
+	return omap_sham_irq_common(dd);
+}
+
+static irqreturn_t omap_sham_irq_omap4(int irq, void *dev_id)
+{
+	struct omap_sham_dev *dd = dev_id;
+
+	omap_sham_write_mask(dd, SHA_REG_MASK(dd), 0, SHA_REG_MASK_IT_EN);
+
+	return omap_sham_irq_common(dd);
+}
+
+static struct omap_sham_algs_info omap_sham_algs_info_omap2[] = {
+	{
+		.algs_list	= algs_sha1_md5,
+		.size		= ARRAY_SIZE(algs_sha1_md5),
+	},
+};
+
+static const struct omap_sham_pdata omap_sham_pdata_omap2 = {
+	.algs_info	= omap_sham_algs_info_omap2,
+	.algs_info_size	= ARRAY_SIZE(omap_sham_algs_info_omap2),
+	.write_ctrl	= omap_sham_write_ctrl_omap2,
+	.trigger	= omap_sham_trigger_omap2,
+	.poll_irq	= omap_sham_poll_irq_omap2,
+	.intr_hdlr	= omap_sham_irq_omap2,
+	.idigest_ofs	= 0x00,
+	.din_ofs	= 0x1c,
+	.digcnt_ofs	= 0x14,
+	.rev_ofs	= 0x5c,
+	.mask_ofs	= 0x60,
+	.sysstatus_ofs	= 0x64,
+	.major_mask	= 0xf0,
+	.major_shift	= 4,
+	.minor_mask	= 0x0f,
+	.minor_shift	= 0,
+};
+
+static struct omap_sham_algs_info omap_sham_algs_info_omap4[] = {
+	{
+		.algs_list	= algs_sha1_md5,
+		.size		= ARRAY_SIZE(algs_sha1_md5),
+	},
+	{
+		.algs_list	= algs_sha224_sha256,
+		.size		= ARRAY_SIZE(algs_sha224_sha256),
+	},
+};
+
+static const struct omap_sham_pdata omap_sham_pdata_omap4 = {
+	.algs_info	= omap_sham_algs_info_omap4,
+	.algs_info_size	= ARRAY_SIZE(omap_sham_algs_info_omap4),
+	.write_ctrl	= omap_sham_write_ctrl_omap4,
+	.trigger	= omap_sham_trigger_omap4,
+	.poll_irq	= omap_sham_poll_irq_omap4,
+	.intr_hdlr	= omap_sham_irq_omap4,
+	.pm_runtime	= true,
+	.idigest_ofs	= 0x20,
+	.din_ofs	= 0x80,
+	.digcnt_ofs	= 0x40,
+	.rev_ofs	= 0x100,
+	.mask_ofs	= 0x110,
+	.sysstatus_ofs	= 0x114,
+	.major_mask	= 0x0700,
+	.major_shift	= 8,
+	.minor_mask	= 0x003f,
+	.minor_shift	= 0,
+};
+
+static const struct platform_device_id omap_sham_id_table[] = {
+	{ "omap-sham",	(kernel_ulong_t)&omap_sham_pdata_omap2 },
+	{ "omap4-sham",	(kernel_ulong_t)&omap_sham_pdata_omap4 },
+	{ }
+};
+MODULE_DEVICE_TABLE(platform, omap_sham_id_table);
+
+static int omap_sham_register_algs(const struct omap_sham_pdata *pdata)
+{
+	struct ahash_alg *algs;
+	int err, i, j;
+
+	for (i = 0; i < pdata->algs_info_size; i++) {
+		algs = pdata->algs_info[i].algs_list;
+		for (j = 0; j < pdata->algs_info[i].size; j++) {
+			err = crypto_register_ahash(&algs[j]);
+			if (err)
+				goto err_algs;
+		}
 	}
 
-	set_bit(FLAGS_OUTPUT_READY, &dd->flags);
-	tasklet_schedule(&dd->done_task);
+	return 0;
 
-	return IRQ_HANDLED;
+err_algs:
+	for (; i >= 0; i--) {
+		algs = pdata->algs_info[i].algs_list;
+		while (j--)
+			crypto_unregister_ahash(&algs[j]);
+		if (i > 0)
+			j = pdata->algs_info[i - 1].size;
+	}
+
+	return err;
+}
+
+static void omap_sham_unregister_algs(const struct omap_sham_pdata *pdata)
+{
+	struct ahash_alg *algs;
+	int i, j;
+
+	for (i = 0; i < pdata->algs_info_size; i++) {
+		algs = pdata->algs_info[i].algs_list;
+		for (j = 0; j < pdata->algs_info[i].size; j++)
+			crypto_unregister_ahash(&algs[j]);
+	}
+}
+
+static ssize_t omap_sham_stats_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct omap_sham_dev *dd = dev_get_drvdata(dev);
+	struct omap_sham_stats stats;
+	unsigned long flags;
+	u64 avg_ns;
+
+	spin_lock_irqsave(&dd->lock, flags);
+	stats = dd->stats;
+	spin_unlock_irqrestore(&dd->lock, flags);
+
+	avg_ns = stats.hw_requests ?
+		div64_u64(stats.hw_ns, stats.hw_requests) : 0;
+
+	return sprintf(buf, "hw_requests: %lu\n"
+			    "hw_bytes: %llu\n"
+			    "hw_latency_avg_us: %llu\n"
+			    "hw_latency_max_us: %llu\n"
+			    "sw_requests: %lu\n"
+			    "sw_bytes: %llu\n",
+		       stats.hw_requests,
+		       (unsigned long long)stats.hw_bytes,
+		       (unsigned long long)div_u64(avg_ns, NSEC_PER_USEC),
+		       (unsigned long long)div_u64(stats.hw_max_ns,
+						   NSEC_PER_USEC),
+		       stats.sw_requests,
+		       (unsigned long long)stats.sw_bytes);
+}
+
+static ssize_t omap_sham_fallback_show(struct device *dev,
+				       struct device_attribute *attr, char *buf)
+{
+	struct omap_sham_dev *dd = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", dd->fallback_sz);
+}
+
+static ssize_t omap_sham_fallback_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t size)
+{
+	struct omap_sham_dev *dd = dev_get_drvdata(dev);
+	unsigned int val;
+	int err;
+
+	err = kstrtouint(buf, 0, &val);
+	if (err)
+		return err;
+
+	/* short messages are collected in the request buffer */
+	dd->fallback_sz = min_t(unsigned int, val,
+				BUFLEN - SHA1_MD5_BLOCK_SIZE);
+
+	return size;
 }
 
+static DEVICE_ATTR(stats, S_IRUGO, omap_sham_stats_show, NULL);
+static DEVICE_ATTR(fallback_threshold, S_IRUGO | S_IWUSR,
+		   omap_sham_fallback_show, omap_sham_fallback_store);
+
+static struct attribute *omap_sham_attrs[] = {
+	&dev_attr_stats.attr,
+	&dev_attr_fallback_threshold.attr,
+	NULL
+};
+
+static const struct attribute_group omap_sham_attr_group = {
+	.attrs = omap_sham_attrs,
+};
+
 static void omap_sham_dma_callback(int lch, u16 ch_status, void *data)
 {
 	struct omap_sham_dev *dd = data;
@@ -1143,7 +1705,8 @@ static int __devinit omap_sham_probe(struct platform_device *pdev)
 	struct omap_sham_dev *dd;
 	struct device *dev = &pdev->dev;
 	struct resource *res;
-	int err, i, j;
+	int err;
+	u32 rev;
 
 	dd = kzalloc(sizeof(struct omap_sham_dev), GFP_KERNEL);
 	if (dd == NULL) {
@@ -1152,6 +1715,9 @@ static int __devinit omap_sham_probe(struct platform_device *pdev)
 		goto data_err;
 	}
 	dd->dev = dev;
+	dd->pdata = (const struct omap_sham_pdata *)
+			platform_get_device_id(pdev)->driver_data;
+	dd->fallback_sz = OMAP_SHAM_FALLBACK_SIZE;
 	platform_set_drvdata(pdev, dd);
 
 	INIT_LIST_HEAD(&dd->list);
@@ -1187,8 +1753,8 @@ static int __devinit omap_sham_probe(struct platform_device *pdev)
 		goto res_err;
 	}
 
-	err = request_irq(dd->irq, omap_sham_irq,
-			IRQF_TRIGGER_LOW, dev_name(dev), dd);
+	err = request_irq(dd->irq, dd->pdata->intr_hdlr,
+			IRQF_TRIGGER_NONE, dev_name(dev), dd);
 	if (err) {
 		dev_err(dev, "unable to request irq.\n");
 		goto res_err;
@@ -1199,11 +1765,16 @@ static int __devinit omap_sham_probe(struct platform_device *pdev)
 		goto dma_err;
 
 	/* Initializing the clock */
-	dd->iclk = clk_get(dev, "ick");
-	if (IS_ERR(dd->iclk)) {
-		dev_err(dev, "clock intialization failed.\n");
-		err = PTR_ERR(dd->iclk);
-		goto clk_err;
+	if (dd->pdata->pm_runtime) {
+		pm_runtime_irq_safe(dev);
+		pm_runtime_enable(dev);
+	} else {
+		dd->iclk = clk_get(dev, "ick");
+		if (IS_ERR(dd->iclk)) {
+			dev_err(dev, "clock intialization failed.\n");
+			err = PTR_ERR(dd->iclk);
+			goto clk_err;
+		}
 	}
 
 	dd->io_base = ioremap(dd->phys_base, SZ_4K);
@@ -1213,30 +1784,42 @@ static int __devinit omap_sham_probe(struct platform_device *pdev)
 		goto io_err;
 	}
 
-	clk_enable(dd->iclk);
+	omap_sham_hw_get(dd);
+	rev = omap_sham_read(dd, SHA_REG_REV(dd));
 	dev_info(dev, "hw accel on OMAP rev %u.%u\n",
-		(omap_sham_read(dd, SHA_REG_REV) & SHA_REG_REV_MAJOR) >> 4,
-		omap_sham_read(dd, SHA_REG_REV) & SHA_REG_REV_MINOR);
-	clk_disable(dd->iclk);
+		(rev & dd->pdata->major_mask) >> dd->pdata->major_shift,
+		(rev & dd->pdata->minor_mask) >> dd->pdata->minor_shift);
+	omap_sham_hw_put(dd);
 
 	spin_lock(&sham.lock);
 	list_add_tail(&dd->list, &sham.dev_list);
 	spin_unlock(&sham.lock);
 
-	for (i = 0; i < ARRAY_SIZE(algs); i++) {
-		err = crypto_register_ahash(&algs[i]);
-		if (err)
-			goto err_algs;
-	}
+	mutex_lock(&algs_lock);
+	if (!algs_users)
+		err = omap_sham_register_algs(dd->pdata);
+	if (!err)
+		algs_users++;
+	mutex_unlock(&algs_lock);
+	if (err)
+		goto err_algs;
+
+	err = sysfs_create_group(&dev->kobj, &omap_sham_attr_group);
+	if (err)
+		dev_warn(dev, "unable to create sysfs attributes\n");
 
 	return 0;
 
 err_algs:
-	for (j = 0; j < i; j++)
-		crypto_unregister_ahash(&algs[j]);
+	spin_lock(&sham.lock);
+	list_del(&dd->list);
+	spin_unlock(&sham.lock);
 	iounmap(dd->io_base);
 io_err:
-	clk_put(dd->iclk);
+	if (dd->iclk)
+		clk_put(dd->iclk);
+	else
+		pm_runtime_disable(dev);
 clk_err:
 	omap_sham_dma_cleanup(dd);
 dma_err:
@@ -1254,19 +1837,24 @@ data_err:
 static int __devexit omap_sham_remove(struct platform_device *pdev)
 {
 	static struct omap_sham_dev *dd;
-	int i;
 
 	dd = platform_get_drvdata(pdev);
 	if (!dd)
 		return -ENODEV;
+	sysfs_remove_group(&pdev->dev.kobj, &omap_sham_attr_group);
 	spin_lock(&sham.lock);
 	list_del(&dd->list);
 	spin_unlock(&sham.lock);
-	for (i = 0; i < ARRAY_SIZE(algs); i++)
-		crypto_unregister_ahash(&algs[i]);
+	mutex_lock(&algs_lock);
+	if (!--algs_users)
+		omap_sham_unregister_algs(dd->pdata);
+	mutex_unlock(&algs_lock);
 	tasklet_kill(&dd->done_task);
 	iounmap(dd->io_base);
-	clk_put(dd->iclk);
+	if (dd->iclk)
+		clk_put(dd->iclk);
+	else
+		pm_runtime_disable(&pdev->dev);
 	omap_sham_dma_cleanup(dd);
 	if (dd->irq >= 0)
 		free_irq(dd->irq, dd);
@@ -1279,6 +1867,7 @@ static int __devexit omap_sham_remove(struct platform_device *pdev)
 static struct platform_driver omap_sham_driver = {
 	.probe	= omap_sham_probe,
 	.remove	= omap_sham_remove,
+	.id_table = omap_sham_id_table,
 	.driver	= {
 		.name	= "omap-sham",
 		.owner	= THIS_MODULE,
@@ -1289,9 +1878,11 @@ static int __init omap_sham_mod_init(void)
 {
 	pr_info("loading %s driver\n", "omap-sham");
 
+	/* the OMAP4 public engine is usable on GP devices too */
 	if (!cpu_class_is_omap2() ||
 		(omap_type() != OMAP2_DEVICE_TYPE_SEC &&
-			omap_type() != OMAP2_DEVICE_TYPE_EMU)) {
+			omap_type() != OMAP2_DEVICE_TYPE_EMU &&
+			!cpu_is_omap44xx())) {
 		pr_err("Unsupported cpu\n");
 		return -ENODEV;
 	}
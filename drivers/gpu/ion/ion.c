@@ -1098,6 +1098,8 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 		seq_printf(s, "%16.s %16u %16u\n", client->name, client->pid,
 			   size);
 	}
+	if (heap->debug_show)
+		heap->debug_show(heap, s);
 	return 0;
 }
 
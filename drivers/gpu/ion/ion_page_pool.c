@@ -0,0 +1,208 @@
+/*
+ * drivers/gpu/ion/ion_page_pool.c
+ *
+ * Copyright (C) 2011 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/highmem.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include "ion_priv.h"
+
+static void ion_page_pool_zero(struct ion_page_pool *pool, struct page *page)
+{
+	int i;
+
+	for (i = 0; i < (1 << pool->order); i++)
+		clear_highpage(page + i);
+}
+
+static void ion_page_pool_add(struct ion_page_pool *pool, struct page *page,
+			      bool clean)
+{
+	bool high = PageHighMem(page);
+
+	if (clean) {
+		list_add_tail(&page->lru, &pool->clean_items[high]);
+		pool->clean_count[high]++;
+	} else {
+		list_add_tail(&page->lru, &pool->dirty_items[high]);
+		pool->dirty_count[high]++;
+	}
+}
+
+static struct page *ion_page_pool_remove(struct ion_page_pool *pool,
+					 bool high, bool clean)
+{
+	struct page *page;
+
+	if (clean) {
+		BUG_ON(!pool->clean_count[high]);
+		page = list_first_entry(&pool->clean_items[high], struct page,
+					lru);
+		pool->clean_count[high]--;
+	} else {
+		BUG_ON(!pool->dirty_count[high]);
+		page = list_first_entry(&pool->dirty_items[high], struct page,
+					lru);
+		pool->dirty_count[high]--;
+	}
+
+	list_del(&page->lru);
+	return page;
+}
+
+static void ion_page_pool_zero_work(struct work_struct *work)
+{
+	struct ion_page_pool *pool = container_of(work, struct ion_page_pool,
+						  zero_work);
+	struct page *page;
+
+	mutex_lock(&pool->mutex);
+	while (pool->dirty_count[0] || pool->dirty_count[1]) {
+		page = ion_page_pool_remove(pool, !!pool->dirty_count[1],
+					    false);
+		mutex_unlock(&pool->mutex);
+
+		ion_page_pool_zero(pool, page);
+		cond_resched();
+
+		mutex_lock(&pool->mutex);
+		ion_page_pool_add(pool, page, true);
+	}
+	mutex_unlock(&pool->mutex);
+}
+
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page = NULL;
+	bool clean = true;
+
+	/* Hand out highmem pages first, lowmem is the scarcer of the two */
+	mutex_lock(&pool->mutex);
+	if (pool->clean_count[0] || pool->clean_count[1]) {
+		page = ion_page_pool_remove(pool, !!pool->clean_count[1], true);
+	} else if (pool->dirty_count[0] || pool->dirty_count[1]) {
+		/* The zeroing work has not caught up yet, do it here */
+		page = ion_page_pool_remove(pool, !!pool->dirty_count[1],
+					    false);
+		clean = false;
+	}
+	if (page)
+		pool->hits++;
+	else
+		pool->misses++;
+	mutex_unlock(&pool->mutex);
+
+	if (!page)
+		return alloc_pages(pool->gfp_mask | __GFP_ZERO, pool->order);
+
+	if (!clean)
+		ion_page_pool_zero(pool, page);
+
+	return page;
+}
+
+void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	ion_page_pool_add(pool, page, false);
+	mutex_unlock(&pool->mutex);
+
+	queue_work(system_unbound_wq, &pool->zero_work);
+}
+
+/*
+ * Pages of one kind held by the pool.  Lowmem pages help every reclaimer,
+ * highmem ones only a reclaimer that could have used highmem itself.
+ */
+static int ion_page_pool_count(struct ion_page_pool *pool, bool high)
+{
+	return pool->clean_count[high] + pool->dirty_count[high];
+}
+
+static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
+{
+	int count = ion_page_pool_count(pool, false);
+
+	if (high)
+		count += ion_page_pool_count(pool, true);
+
+	return count << pool->order;
+}
+
+int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
+			 int nr_to_scan)
+{
+	bool high = !!(gfp_mask & __GFP_HIGHMEM);
+	struct page *page;
+	int freed = 0;
+	bool from_high;
+
+	mutex_lock(&pool->mutex);
+	if (!nr_to_scan || !ion_page_pool_total(pool, high)) {
+		freed = ion_page_pool_total(pool, high);
+		mutex_unlock(&pool->mutex);
+		return nr_to_scan ? 0 : freed;
+	}
+
+	while (freed < nr_to_scan) {
+		if (high && ion_page_pool_count(pool, true))
+			from_high = true;
+		else if (ion_page_pool_count(pool, false))
+			from_high = false;
+		else
+			break;
+
+		/* Give back pages we have not spent time zeroing first */
+		page = ion_page_pool_remove(pool, from_high,
+					    !pool->dirty_count[from_high]);
+
+		mutex_unlock(&pool->mutex);
+		__free_pages(page, pool->order);
+		freed += (1 << pool->order);
+		mutex_lock(&pool->mutex);
+	}
+	mutex_unlock(&pool->mutex);
+
+	return freed;
+}
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
+{
+	struct ion_page_pool *pool = kzalloc(sizeof(struct ion_page_pool),
+					     GFP_KERNEL);
+	if (!pool)
+		return NULL;
+	INIT_LIST_HEAD(&pool->clean_items[0]);
+	INIT_LIST_HEAD(&pool->clean_items[1]);
+	INIT_LIST_HEAD(&pool->dirty_items[0]);
+	INIT_LIST_HEAD(&pool->dirty_items[1]);
+	INIT_WORK(&pool->zero_work, ion_page_pool_zero_work);
+	mutex_init(&pool->mutex);
+	pool->gfp_mask = gfp_mask;
+	pool->order = order;
+
+	return pool;
+}
+
+void ion_page_pool_destroy(struct ion_page_pool *pool)
+{
+	cancel_work_sync(&pool->zero_work);
+	ion_page_pool_shrink(pool, __GFP_HIGHMEM, INT_MAX);
+	kfree(pool);
+}
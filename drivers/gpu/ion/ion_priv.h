@@ -21,6 +21,9 @@
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
+#include <linux/workqueue.h>
 #include <linux/ion.h>
 
 struct ion_mapping;
@@ -111,6 +114,8 @@ struct ion_heap_ops {
  *			allocating.  These are specified by platform data and
  *			MUST be unique
  * @name:		used for debugging
+ * @debug_show:		called when the heap's debugfs file is read, to
+ *			append heap specific information (optional)
  *
  * Represents a pool of memory from which buffers can be made.  In some
  * systems the only heap is regular system memory allocated via vmalloc.
@@ -124,6 +129,7 @@ struct ion_heap {
 	struct ion_heap_ops *ops;
 	int id;
 	const char *name;
+	int (*debug_show)(struct ion_heap *heap, struct seq_file *s);
 };
 
 /**
@@ -181,4 +187,58 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  */
 #define ION_CARVEOUT_ALLOCATE_FAIL -1
 
+/**
+ * struct ion_page_pool - pagepool struct
+ * @mutex:		protects the lists and counts
+ * @clean_items:	lists of zeroed pages, ready to hand out
+ * @dirty_items:	lists of freed pages waiting to be zeroed
+ * @clean_count:	number of pages on each clean_items list
+ * @dirty_count:	number of pages on each dirty_items list
+ * @zero_work:		zeroes dirty pages in the background
+ * @gfp_mask:		gfp_mask to use for allocations from the page
+ *			allocator
+ * @order:		order of the pages in the pool
+ * @hits:		allocations satisfied from the pool
+ * @misses:		allocations that went to the page allocator
+ *
+ * Allows you to keep a pool of pre allocated pages of one order, so
+ * buffers that are allocated and freed over and over do not each go
+ * through the page allocator. Freed pages are zeroed by a work item
+ * rather than on the allocation path. If a pool runs out of clean
+ * pages a dirty one is zeroed synchronously, and only when both lists
+ * are empty is the page allocator called.
+ *
+ * The lists and counts are indexed by PageHighMem(), so the shrinker
+ * can tell how much of the pool a lowmem-only reclaim can get back.
+ */
+struct ion_page_pool {
+	struct mutex mutex;
+	struct list_head clean_items[2];
+	struct list_head dirty_items[2];
+	int clean_count[2];
+	int dirty_count[2];
+	struct work_struct zero_work;
+	gfp_t gfp_mask;
+	unsigned int order;
+	unsigned long hits;
+	unsigned long misses;
+};
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
+void ion_page_pool_destroy(struct ion_page_pool *);
+struct page *ion_page_pool_alloc(struct ion_page_pool *);
+void ion_page_pool_free(struct ion_page_pool *, struct page *);
+
+/**
+ * ion_page_pool_shrink - shrinks the size of the memory cached in the pool
+ * @pool:		the pool
+ * @gfp_mask:		the memory type to reclaim
+ * @nr_to_scan:		number of items to shrink in pages
+ *
+ * returns the number of pages freed, or if nr_to_scan is 0 the number
+ * of pages the pool holds
+ */
+int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
+			  int nr_to_scan);
+
 #endif /* _ION_PRIV_H */
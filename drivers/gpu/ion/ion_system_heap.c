@@ -15,55 +15,192 @@
  */
 
 #include <linux/err.h>
+#include <linux/hrtimer.h>
+#include <linux/highmem.h>
 #include <linux/ion.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "ion_priv.h"
 
+static unsigned int high_order_gfp_flags = (GFP_HIGHUSER | __GFP_NOWARN |
+					    __GFP_NORETRY) & ~__GFP_WAIT;
+static unsigned int low_order_gfp_flags  = GFP_HIGHUSER;
+static const unsigned int orders[] = {8, 4, 0};
+static const int num_orders = ARRAY_SIZE(orders);
+
+/* Allocation latency buckets, in microseconds: <2, <4, ... <2^(n-1), more */
+#define ION_SYSTEM_HEAP_LAT_BUCKETS	16
+
+struct ion_system_heap {
+	struct ion_heap heap;
+	struct ion_page_pool *pools[ARRAY_SIZE(orders)];
+	struct shrinker shrinker;
+	atomic_t latency[ION_SYSTEM_HEAP_LAT_BUCKETS];
+};
+
+struct page_info {
+	struct page *page;
+	unsigned int order;
+	struct list_head list;
+};
+
+/**
+ * struct ion_system_buffer - pages backing a system heap buffer
+ * @pages:		list of page_info, largest chunks first
+ * @nchunks:		number of entries on @pages
+ * @npages:		number of PAGE_SIZE pages in the buffer
+ */
+struct ion_system_buffer {
+	struct list_head pages;
+	int nchunks;
+	int npages;
+};
+
+static int order_to_index(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++)
+		if (order == orders[i])
+			return i;
+	BUG();
+	return -1;
+}
+
+static inline unsigned int order_to_size(int order)
+{
+	return PAGE_SIZE << order;
+}
+
+static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
+						 unsigned long size,
+						 unsigned int max_order)
+{
+	struct page_info *info;
+	struct page *page;
+	int i;
+
+	for (i = 0; i < num_orders; i++) {
+		if (size < order_to_size(orders[i]))
+			continue;
+		if (max_order < orders[i])
+			continue;
+
+		page = ion_page_pool_alloc(heap->pools[i]);
+		if (!page)
+			continue;
+
+		info = kmalloc(sizeof(struct page_info), GFP_KERNEL);
+		if (!info) {
+			ion_page_pool_free(heap->pools[i], page);
+			return NULL;
+		}
+		info->page = page;
+		info->order = orders[i];
+		return info;
+	}
+	return NULL;
+}
+
+static void free_buffer_page(struct ion_system_heap *heap,
+			     struct page_info *info)
+{
+	ion_page_pool_free(heap->pools[order_to_index(info->order)],
+			   info->page);
+	kfree(info);
+}
+
+static void ion_system_heap_account(struct ion_system_heap *heap,
+				    ktime_t start)
+{
+	s64 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	int bucket = 0;
+
+	while (us > 1 && bucket < ION_SYSTEM_HEAP_LAT_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	atomic_inc(&heap->latency[bucket]);
+}
+
 static int ion_system_heap_allocate(struct ion_heap *heap,
 				     struct ion_buffer *buffer,
 				     unsigned long size, unsigned long align,
 				     unsigned long flags)
 {
-	buffer->priv_virt = vmalloc_user(size);
-	if (!buffer->priv_virt)
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+	struct ion_system_buffer *sys_buffer;
+	struct page_info *info, *tmp_info;
+	unsigned long size_remaining = PAGE_ALIGN(size);
+	unsigned int max_order = orders[0];
+	ktime_t start = ktime_get();
+
+	sys_buffer = kzalloc(sizeof(struct ion_system_buffer), GFP_KERNEL);
+	if (!sys_buffer)
 		return -ENOMEM;
+	INIT_LIST_HEAD(&sys_buffer->pages);
+
+	while (size_remaining > 0) {
+		info = alloc_largest_available(sys_heap, size_remaining,
+					       max_order);
+		if (!info)
+			goto err;
+		list_add_tail(&info->list, &sys_buffer->pages);
+		size_remaining -= order_to_size(info->order);
+		/* Do not retry orders that have already failed */
+		max_order = info->order;
+		sys_buffer->nchunks++;
+		sys_buffer->npages += 1 << info->order;
+	}
+
+	buffer->priv_virt = sys_buffer;
+	ion_system_heap_account(sys_heap, start);
 	return 0;
+
+err:
+	list_for_each_entry_safe(info, tmp_info, &sys_buffer->pages, list)
+		free_buffer_page(sys_heap, info);
+	kfree(sys_buffer);
+	return -ENOMEM;
 }
 
 void ion_system_heap_free(struct ion_buffer *buffer)
 {
-	vfree(buffer->priv_virt);
+	struct ion_system_heap *sys_heap = container_of(buffer->heap,
+							struct ion_system_heap,
+							heap);
+	struct ion_system_buffer *sys_buffer = buffer->priv_virt;
+	struct page_info *info, *tmp_info;
+
+	list_for_each_entry_safe(info, tmp_info, &sys_buffer->pages, list)
+		free_buffer_page(sys_heap, info);
+	kfree(sys_buffer);
 }
 
 struct scatterlist *ion_system_heap_map_dma(struct ion_heap *heap,
 					    struct ion_buffer *buffer)
 {
-	struct scatterlist *sglist;
-	struct page *page;
-	int i;
-	int npages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
-	void *vaddr = buffer->priv_virt;
+	struct ion_system_buffer *sys_buffer = buffer->priv_virt;
+	struct scatterlist *sglist, *sg;
+	struct page_info *info;
 
-	sglist = vmalloc(npages * sizeof(struct scatterlist));
+	sglist = vmalloc(sys_buffer->nchunks * sizeof(struct scatterlist));
 	if (!sglist)
 		return ERR_PTR(-ENOMEM);
-	memset(sglist, 0, npages * sizeof(struct scatterlist));
-	sg_init_table(sglist, npages);
-	for (i = 0; i < npages; i++) {
-		page = vmalloc_to_page(vaddr);
-		if (!page)
-			goto end;
-		sg_set_page(&sglist[i], page, PAGE_SIZE, 0);
-		vaddr += PAGE_SIZE;
+	memset(sglist, 0, sys_buffer->nchunks * sizeof(struct scatterlist));
+	sg_init_table(sglist, sys_buffer->nchunks);
+	sg = sglist;
+	list_for_each_entry(info, &sys_buffer->pages, list) {
+		sg_set_page(sg, info->page, order_to_size(info->order), 0);
+		sg = sg_next(sg);
 	}
 	/* XXX do cache maintenance for dma? */
 	return sglist;
-end:
-	vfree(sglist);
-	return NULL;
 }
 
 void ion_system_heap_unmap_dma(struct ion_heap *heap,
@@ -77,18 +214,64 @@ void ion_system_heap_unmap_dma(struct ion_heap *heap,
 void *ion_system_heap_map_kernel(struct ion_heap *heap,
 				 struct ion_buffer *buffer)
 {
-	return buffer->priv_virt;
+	struct ion_system_buffer *sys_buffer = buffer->priv_virt;
+	struct page_info *info;
+	struct page **pages, **tmp;
+	void *vaddr;
+	int i;
+
+	pages = vmalloc(sizeof(struct page *) * sys_buffer->npages);
+	if (!pages)
+		return ERR_PTR(-ENOMEM);
+	tmp = pages;
+	list_for_each_entry(info, &sys_buffer->pages, list)
+		for (i = 0; i < (1 << info->order); i++)
+			*(tmp++) = info->page + i;
+
+	vaddr = vmap(pages, sys_buffer->npages, VM_MAP, PAGE_KERNEL);
+	vfree(pages);
+	if (!vaddr)
+		return ERR_PTR(-ENOMEM);
+	return vaddr;
 }
 
 void ion_system_heap_unmap_kernel(struct ion_heap *heap,
 				  struct ion_buffer *buffer)
 {
+	vunmap(buffer->vaddr);
 }
 
 int ion_system_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 			     struct vm_area_struct *vma)
 {
-	return remap_vmalloc_range(vma, buffer->priv_virt, vma->vm_pgoff);
+	struct ion_system_buffer *sys_buffer = buffer->priv_virt;
+	struct page_info *info;
+	unsigned long addr = vma->vm_start;
+	unsigned long offset = vma->vm_pgoff;
+	int ret;
+
+	list_for_each_entry(info, &sys_buffer->pages, list) {
+		unsigned long npages = 1 << info->order;
+		unsigned long remainder = vma->vm_end - addr;
+		unsigned long len;
+
+		if (offset >= npages) {
+			offset -= npages;
+			continue;
+		}
+
+		len = min((npages - offset) << PAGE_SHIFT, remainder);
+		ret = remap_pfn_range(vma, addr,
+				      page_to_pfn(info->page) + offset, len,
+				      vma->vm_page_prot);
+		if (ret)
+			return ret;
+		addr += len;
+		offset = 0;
+		if (addr >= vma->vm_end)
+			return 0;
+	}
+	return addr >= vma->vm_end ? 0 : -EINVAL;
 }
 
 static struct ion_heap_ops vmalloc_ops = {
@@ -101,21 +284,106 @@ static struct ion_heap_ops vmalloc_ops = {
 	.map_user = ion_system_heap_map_user,
 };
 
+static int ion_system_heap_shrink(struct shrinker *shrinker,
+				  struct shrink_control *sc)
+{
+	struct ion_system_heap *sys_heap = container_of(shrinker,
+							struct ion_system_heap,
+							shrinker);
+	int nr_to_scan = sc->nr_to_scan;
+	int nr_total = 0;
+	int i;
+
+	/* Free from the largest pools first, they hurt fragmentation most */
+	for (i = 0; i < num_orders && nr_to_scan > 0; i++) {
+		int freed = ion_page_pool_shrink(sys_heap->pools[i],
+						 sc->gfp_mask, nr_to_scan);
+		nr_to_scan -= freed;
+	}
+
+	for (i = 0; i < num_orders; i++)
+		nr_total += ion_page_pool_shrink(sys_heap->pools[i],
+						 sc->gfp_mask, 0);
+	return nr_total;
+}
+
+static int ion_system_heap_debug_show(struct ion_heap *heap,
+				      struct seq_file *s)
+{
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+	int i;
+
+	seq_printf(s, "\n%8s %8s %8s %8s %10s %10s\n", "order", "clean",
+		   "dirty", "highmem", "hits", "misses");
+	for (i = 0; i < num_orders; i++) {
+		struct ion_page_pool *pool = sys_heap->pools[i];
+
+		mutex_lock(&pool->mutex);
+		seq_printf(s, "%8u %8d %8d %8d %10lu %10lu\n", pool->order,
+			   pool->clean_count[0] + pool->clean_count[1],
+			   pool->dirty_count[0] + pool->dirty_count[1],
+			   pool->clean_count[1] + pool->dirty_count[1],
+			   pool->hits, pool->misses);
+		mutex_unlock(&pool->mutex);
+	}
+
+	seq_printf(s, "\n%12s %10s\n", "alloc_us", "count");
+	for (i = 0; i < ION_SYSTEM_HEAP_LAT_BUCKETS - 1; i++)
+		seq_printf(s, "%4s %7u %10d\n", "<", 2 << i,
+			   atomic_read(&sys_heap->latency[i]));
+	seq_printf(s, "%4s %7u %10d\n", ">=", 1 << i,
+		   atomic_read(&sys_heap->latency[i]));
+	return 0;
+}
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
-	struct ion_heap *heap;
+	struct ion_system_heap *heap;
+	int i;
 
-	heap = kzalloc(sizeof(struct ion_heap), GFP_KERNEL);
+	heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
 	if (!heap)
 		return ERR_PTR(-ENOMEM);
-	heap->ops = &vmalloc_ops;
-	heap->type = ION_HEAP_TYPE_SYSTEM;
-	return heap;
+	heap->heap.ops = &vmalloc_ops;
+	heap->heap.type = ION_HEAP_TYPE_SYSTEM;
+	heap->heap.debug_show = ion_system_heap_debug_show;
+
+	for (i = 0; i < num_orders; i++) {
+		gfp_t gfp_flags = low_order_gfp_flags;
+
+		if (orders[i] > 4)
+			gfp_flags = high_order_gfp_flags;
+		heap->pools[i] = ion_page_pool_create(gfp_flags, orders[i]);
+		if (!heap->pools[i])
+			goto err_create_pool;
+	}
+
+	heap->shrinker.shrink = ion_system_heap_shrink;
+	heap->shrinker.seeks = DEFAULT_SEEKS;
+	heap->shrinker.batch = 0;
+	register_shrinker(&heap->shrinker);
+	return &heap->heap;
+
+err_create_pool:
+	while (--i >= 0)
+		ion_page_pool_destroy(heap->pools[i]);
+	kfree(heap);
+	return ERR_PTR(-ENOMEM);
 }
 
 void ion_system_heap_destroy(struct ion_heap *heap)
 {
-	kfree(heap);
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+	int i;
+
+	unregister_shrinker(&sys_heap->shrinker);
+	for (i = 0; i < num_orders; i++)
+		ion_page_pool_destroy(sys_heap->pools[i]);
+	kfree(sys_heap);
 }
 
 static int ion_system_contig_heap_allocate(struct ion_heap *heap,
@@ -168,14 +436,25 @@ int ion_system_contig_heap_map_user(struct ion_heap *heap,
 
 }
 
+void *ion_system_contig_heap_map_kernel(struct ion_heap *heap,
+					struct ion_buffer *buffer)
+{
+	return buffer->priv_virt;
+}
+
+void ion_system_contig_heap_unmap_kernel(struct ion_heap *heap,
+					 struct ion_buffer *buffer)
+{
+}
+
 static struct ion_heap_ops kmalloc_ops = {
 	.allocate = ion_system_contig_heap_allocate,
 	.free = ion_system_contig_heap_free,
 	.phys = ion_system_contig_heap_phys,
 	.map_dma = ion_system_contig_heap_map_dma,
 	.unmap_dma = ion_system_heap_unmap_dma,
-	.map_kernel = ion_system_heap_map_kernel,
-	.unmap_kernel = ion_system_heap_unmap_kernel,
+	.map_kernel = ion_system_contig_heap_map_kernel,
+	.unmap_kernel = ion_system_contig_heap_unmap_kernel,
 	.map_user = ion_system_contig_heap_map_user,
 };
 
@@ -15,6 +15,9 @@
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/scatterlist.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -47,6 +50,171 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	return BLKPREP_OK;
 }
 
+/*
+ * The fetch time of a request, in wrapping microseconds, is kept in
+ * req->special: MMC never uses that for fs requests, and it survives a
+ * requeue so the request keeps its original age.
+ */
+static inline u32 mmc_queue_now_us(void)
+{
+	return (u32)ktime_to_us(ktime_get());
+}
+
+static inline u32 mmc_queue_req_age(struct request *req)
+{
+	return mmc_queue_now_us() - (u32)(unsigned long)req->special;
+}
+
+static inline bool mmc_queue_is_barrier(struct request *req)
+{
+	return req->cmd_flags & (REQ_DISCARD | REQ_FLUSH);
+}
+
+/*
+ * Flushes and discards stay in order with the writes around them, so
+ * they go on the async list and nothing is fetched past them until
+ * they have been dispatched.
+ */
+static struct list_head *mmc_queue_list(struct mmc_queue *mq,
+					struct request *req)
+{
+	if (!mmc_queue_is_barrier(req) && rq_is_sync(req))
+		return &mq->cmdq_sync;
+	return &mq->cmdq_async;
+}
+
+static void mmc_queue_unlink(struct mmc_queue *mq, struct request *req)
+{
+	list_del_init(&req->queuelist);
+	mq->cmdq_depth--;
+	if (mmc_queue_is_barrier(req))
+		mq->cmdq_barrier = false;
+}
+
+/* Called with the queue lock held */
+static void mmc_queue_fill(struct mmc_queue *mq)
+{
+	struct request *req;
+
+	while (mq->cmdq_depth < MMC_QUEUE_DEPTH && !mq->cmdq_barrier) {
+		req = blk_fetch_request(mq->queue);
+		if (!req)
+			break;
+
+		req->special = (void *)(unsigned long)mmc_queue_now_us();
+		if (mmc_queue_is_barrier(req))
+			mq->cmdq_barrier = true;
+		list_add_tail(&req->queuelist, mmc_queue_list(mq, req));
+		mq->cmdq_depth++;
+	}
+}
+
+static bool mmc_queue_async_expired(struct mmc_queue *mq)
+{
+	if (mq->async_starved >= MMC_QUEUE_ASYNC_STARVE)
+		return true;
+
+	return mmc_queue_req_age(list_entry_rq(mq->cmdq_async.next)) >
+		MMC_QUEUE_ASYNC_EXPIRE;
+}
+
+/**
+ * mmc_queue_fetch - pick the next request to hand to the host
+ * @mq: mmc queue
+ *
+ * Sync requests go first, unless the async list has been passed over
+ * MMC_QUEUE_ASYNC_STARVE times in a row or its oldest entry waited
+ * longer than MMC_QUEUE_ASYNC_EXPIRE. Called with the queue lock held.
+ */
+struct request *mmc_queue_fetch(struct mmc_queue *mq)
+{
+	struct request *req;
+	bool async_waiting;
+
+	mmc_queue_fill(mq);
+
+	async_waiting = !list_empty(&mq->cmdq_async);
+	if (async_waiting &&
+	    (list_empty(&mq->cmdq_sync) || mmc_queue_async_expired(mq))) {
+		req = list_entry_rq(mq->cmdq_async.next);
+		mq->async_starved = 0;
+	} else if (!list_empty(&mq->cmdq_sync)) {
+		req = list_entry_rq(mq->cmdq_sync.next);
+		if (async_waiting)
+			mq->async_starved++;
+	} else {
+		return NULL;
+	}
+
+	mmc_queue_unlink(mq, req);
+	return req;
+}
+
+/**
+ * mmc_queue_fetch_next - take the request queued behind @prev
+ * @mq: mmc queue
+ * @prev: request last taken off the queue
+ *
+ * Returns the oldest request of the same class (sync or async) as
+ * @prev, for callers that merge several requests into one command.
+ * Called with the queue lock held.
+ */
+struct request *mmc_queue_fetch_next(struct mmc_queue *mq,
+				     struct request *prev)
+{
+	struct list_head *list = mmc_queue_list(mq, prev);
+	struct request *req;
+
+	mmc_queue_fill(mq);
+
+	if (list_empty(list))
+		return NULL;
+
+	req = list_entry_rq(list->next);
+	mmc_queue_unlink(mq, req);
+	return req;
+}
+
+/**
+ * mmc_queue_requeue - put a fetched request back at the head
+ * @mq: mmc queue
+ * @req: request that was not issued
+ *
+ * Called with the queue lock held.
+ */
+void mmc_queue_requeue(struct mmc_queue *mq, struct request *req)
+{
+	if (mmc_queue_is_barrier(req))
+		mq->cmdq_barrier = true;
+	list_add(&req->queuelist, mmc_queue_list(mq, req));
+	mq->cmdq_depth++;
+}
+
+/**
+ * mmc_queue_latency_add - account a completed read or write
+ * @mq: mmc queue
+ * @req: request about to be completed in full
+ *
+ * Must be called before the request is ended, as @req may be freed
+ * by the completion.
+ */
+void mmc_queue_latency_add(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_queue_lat *lat = &mq->lat[rq_data_dir(req)];
+	u32 us = mmc_queue_req_age(req);
+	int idx;
+
+	idx = (us < 256) ? 0 : fls(us >> 8);
+	if (idx >= MMC_QUEUE_LAT_BUCKETS)
+		idx = MMC_QUEUE_LAT_BUCKETS - 1;
+
+	lat->bucket[idx]++;
+	lat->count++;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -61,7 +229,7 @@ static int mmc_queue_thread(void *d)
 
 		spin_lock_irq(q->queue_lock);
 		set_current_state(TASK_INTERRUPTIBLE);
-		req = blk_fetch_request(q);
+		req = mmc_queue_fetch(mq);
 		mq->mqrq_cur->req = req;
 		spin_unlock_irq(q->queue_lock);
 
@@ -181,6 +349,9 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mq->mqrq_prev = mqrq_prev;
 	mq->queue->queuedata = mq;
 
+	INIT_LIST_HEAD(&mq->cmdq_sync);
+	INIT_LIST_HEAD(&mq->cmdq_async);
+
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	if (mmc_can_erase(card))
@@ -305,6 +476,9 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	/* Then terminate our worker thread */
 	kthread_stop(mq->thread);
 
+	debugfs_remove_recursive(mq->debugfs_dir);
+	mq->debugfs_dir = NULL;
+
 	/* Empty the queue */
 	spin_lock_irqsave(q->queue_lock, flags);
 	q->queuedata = NULL;
@@ -333,6 +507,139 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 }
 EXPORT_SYMBOL(mmc_cleanup_queue);
 
+/**
+ * mmc_packed_init - allocate the packed command state of a queue
+ * @mq: mmc queue
+ * @card: card the queue is attached to
+ *
+ * Both request slots get their own header and request list, so a
+ * packed command can be prepared while the previous one is in flight.
+ */
+int mmc_packed_init(struct mmc_queue *mq, struct mmc_card *card)
+{
+	struct mmc_queue_req *mqrq_cur = &mq->mqrq[0];
+	struct mmc_queue_req *mqrq_prev = &mq->mqrq[1];
+
+	mqrq_cur->packed = kzalloc(sizeof(struct mmc_packed), GFP_KERNEL);
+	if (!mqrq_cur->packed) {
+		pr_warning("%s: unable to allocate packed cmd for mqrq_cur\n",
+			   mmc_card_name(card));
+		return -ENOMEM;
+	}
+
+	mqrq_prev->packed = kzalloc(sizeof(struct mmc_packed), GFP_KERNEL);
+	if (!mqrq_prev->packed) {
+		pr_warning("%s: unable to allocate packed cmd for mqrq_prev\n",
+			   mmc_card_name(card));
+		kfree(mqrq_cur->packed);
+		mqrq_cur->packed = NULL;
+		return -ENOMEM;
+	}
+
+	INIT_LIST_HEAD(&mqrq_cur->packed->list);
+	INIT_LIST_HEAD(&mqrq_prev->packed->list);
+
+	return 0;
+}
+
+void mmc_packed_clean(struct mmc_queue *mq)
+{
+	struct mmc_queue_req *mqrq_cur = &mq->mqrq[0];
+	struct mmc_queue_req *mqrq_prev = &mq->mqrq[1];
+
+	kfree(mqrq_cur->packed);
+	mqrq_cur->packed = NULL;
+	kfree(mqrq_prev->packed);
+	mqrq_prev->packed = NULL;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static void mmc_queue_latency_print(struct seq_file *s, const char *name,
+				    struct mmc_queue_lat *lat)
+{
+	u64 avg = lat->total_us;
+	int i;
+
+	if (lat->count)
+		do_div(avg, lat->count);
+
+	seq_printf(s, "%s: count %lu avg %llu us max %u us\n", name,
+		   lat->count, (unsigned long long)avg, lat->max_us);
+	for (i = 0; i < MMC_QUEUE_LAT_BUCKETS - 1; i++)
+		seq_printf(s, "  < %8u us: %lu\n", 256 << i, lat->bucket[i]);
+	seq_printf(s, "  >= %7u us: %lu\n", 256 << (i - 1), lat->bucket[i]);
+}
+
+static int mmc_queue_latency_show(struct seq_file *s, void *data)
+{
+	struct mmc_queue *mq = s->private;
+
+	mmc_queue_latency_print(s, "read", &mq->lat[READ]);
+	mmc_queue_latency_print(s, "write", &mq->lat[WRITE]);
+
+	return 0;
+}
+
+static int mmc_queue_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_queue_latency_show, inode->i_private);
+}
+
+static ssize_t mmc_queue_latency_write(struct file *file,
+				       const char __user *ubuf,
+				       size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct mmc_queue *mq = s->private;
+
+	/* Any write clears the histograms */
+	memset(mq->lat, 0, sizeof(mq->lat));
+
+	return count;
+}
+
+static const struct file_operations mmc_queue_latency_fops = {
+	.open		= mmc_queue_latency_open,
+	.read		= seq_read,
+	.write		= mmc_queue_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/**
+ * mmc_queue_debugfs_init - expose the queue latency histograms
+ * @mq: mmc queue
+ * @name: name of the disk using the queue
+ *
+ * The directory lives under the host, whose debugfs root outlives the
+ * card's and thus the queue.
+ */
+void mmc_queue_debugfs_init(struct mmc_queue *mq, const char *name)
+{
+	struct dentry *root = mq->card->host->debugfs_root;
+
+	if (!root)
+		return;
+
+	mq->debugfs_dir = debugfs_create_dir(name, root);
+	if (IS_ERR_OR_NULL(mq->debugfs_dir)) {
+		mq->debugfs_dir = NULL;
+		return;
+	}
+
+	if (!debugfs_create_file("latency", S_IRUSR | S_IWUSR,
+				 mq->debugfs_dir, mq,
+				 &mmc_queue_latency_fops)) {
+		debugfs_remove_recursive(mq->debugfs_dir);
+		mq->debugfs_dir = NULL;
+	}
+}
+#else
+void mmc_queue_debugfs_init(struct mmc_queue *mq, const char *name)
+{
+}
+#endif
+
 /**
  * mmc_queue_suspend - suspend a MMC request queue
  * @mq: MMC queue to suspend
@@ -377,6 +684,35 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	}
 }
 
+/*
+ * Map a packed command: the header block first, then the data of
+ * every request on the packed list, back to back in one sg table.
+ */
+static unsigned int mmc_queue_packed_map_sg(struct mmc_queue *mq,
+					    struct mmc_queue_req *mqrq,
+					    struct scatterlist *sg)
+{
+	struct mmc_packed *packed = mqrq->packed;
+	struct scatterlist *__sg = sg;
+	unsigned int sg_len = 0;
+	struct request *req;
+
+	if (mmc_packed_wr(mqrq->cmd_type)) {
+		sg_set_buf(__sg, packed->cmd_hdr, MMC_PACKED_HDR_SIZE);
+		(__sg++)->page_link &= ~0x02;
+		sg_len++;
+	}
+
+	list_for_each_entry(req, &packed->list, queuelist) {
+		sg_len += blk_rq_map_sg(mq->queue, req, __sg);
+		__sg = sg + (sg_len - 1);
+		(__sg++)->page_link &= ~0x02;
+	}
+	sg_mark_end(sg + (sg_len - 1));
+
+	return sg_len;
+}
+
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
@@ -387,12 +723,18 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 	struct scatterlist *sg;
 	int i;
 
-	if (!mqrq->bounce_buf)
+	if (!mqrq->bounce_buf) {
+		if (mmc_packed_cmd(mqrq->cmd_type))
+			return mmc_queue_packed_map_sg(mq, mqrq, mqrq->sg);
 		return blk_rq_map_sg(mq->queue, mqrq->req, mqrq->sg);
+	}
 
 	BUG_ON(!mqrq->bounce_sg);
 
-	sg_len = blk_rq_map_sg(mq->queue, mqrq->req, mqrq->bounce_sg);
+	if (mmc_packed_cmd(mqrq->cmd_type))
+		sg_len = mmc_queue_packed_map_sg(mq, mqrq, mqrq->bounce_sg);
+	else
+		sg_len = blk_rq_map_sg(mq->queue, mqrq->req, mqrq->bounce_sg);
 
 	mqrq->bounce_sg_len = sg_len;
 
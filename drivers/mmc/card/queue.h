@@ -3,6 +3,7 @@
 
 struct request;
 struct task_struct;
+struct dentry;
 
 struct mmc_blk_request {
 	struct mmc_request	mrq;
@@ -12,6 +13,27 @@ struct mmc_blk_request {
 	struct mmc_data		data;
 };
 
+enum mmc_packed_type {
+	MMC_PACKED_NONE = 0,
+	MMC_PACKED_WRITE,
+};
+
+#define mmc_packed_cmd(type)	((type) != MMC_PACKED_NONE)
+#define mmc_packed_wr(type)	((type) == MMC_PACKED_WRITE)
+
+/* One 512 byte header block: a version word, then CMD23/CMD25 args */
+#define MMC_PACKED_HDR_SIZE	512
+#define MMC_PACKED_MAX_ENTRIES	(MMC_PACKED_HDR_SIZE / 8 - 1)
+
+struct mmc_packed {
+	struct list_head	list;
+	u32			cmd_hdr[MMC_PACKED_HDR_SIZE / 4];
+	unsigned int		blocks;
+	u8			nr_entries;
+	u8			retries;
+	s16			idx_failure;
+};
+
 struct mmc_queue_req {
 	struct request		*req;
 	struct mmc_blk_request	brq;
@@ -20,6 +42,26 @@ struct mmc_queue_req {
 	struct scatterlist	*bounce_sg;
 	unsigned int		bounce_sg_len;
 	struct mmc_async_req	mmc_active;
+	enum mmc_packed_type	cmd_type;
+	struct mmc_packed	*packed;
+};
+
+/*
+ * Requests fetched from the block layer wait on the sync or async list
+ * of the queue until the thread hands them to the host. Up to
+ * MMC_QUEUE_DEPTH are held, so reads can overtake queued writes.
+ */
+#define MMC_QUEUE_DEPTH		16
+#define MMC_QUEUE_ASYNC_STARVE	8	/* sync dispatches ahead of async */
+#define MMC_QUEUE_ASYNC_EXPIRE	500000	/* max async wait in us */
+
+#define MMC_QUEUE_LAT_BUCKETS	14	/* <256us, doubling up to >=1s */
+
+struct mmc_queue_lat {
+	unsigned long		bucket[MMC_QUEUE_LAT_BUCKETS];
+	unsigned long		count;
+	u64			total_us;
+	u32			max_us;
 };
 
 struct mmc_queue {
@@ -33,6 +75,13 @@ struct mmc_queue {
 	struct mmc_queue_req	mqrq[2];
 	struct mmc_queue_req	*mqrq_cur;
 	struct mmc_queue_req	*mqrq_prev;
+	struct list_head	cmdq_sync;
+	struct list_head	cmdq_async;
+	unsigned int		cmdq_depth;	/* requests on both lists */
+	bool			cmdq_barrier;	/* flush/discard held */
+	unsigned int		async_starved;
+	struct mmc_queue_lat	lat[2];		/* indexed by READ/WRITE */
+	struct dentry		*debugfs_dir;
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
@@ -41,9 +90,19 @@ extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
 extern void mmc_queue_resume(struct mmc_queue *);
 
+extern struct request *mmc_queue_fetch(struct mmc_queue *);
+extern struct request *mmc_queue_fetch_next(struct mmc_queue *,
+					    struct request *);
+extern void mmc_queue_requeue(struct mmc_queue *, struct request *);
+extern void mmc_queue_latency_add(struct mmc_queue *, struct request *);
+extern void mmc_queue_debugfs_init(struct mmc_queue *, const char *);
+
 extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
 				     struct mmc_queue_req *);
 extern void mmc_queue_bounce_pre(struct mmc_queue_req *);
 extern void mmc_queue_bounce_post(struct mmc_queue_req *);
 
+extern int mmc_packed_init(struct mmc_queue *, struct mmc_card *);
+extern void mmc_packed_clean(struct mmc_queue *);
+
 #endif
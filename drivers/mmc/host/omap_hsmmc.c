@@ -65,6 +65,8 @@
 #define OMAP_HSMMC_ISE		0x0138
 #define OMAP_HSMMC_CAPA		0x0140
 #define OMAP_HSMMC_AC12		0x013C
+#define OMAP_HSMMC_ADMAES	0x0154
+#define OMAP_HSMMC_ADMASAL	0x0158
 
 #define VS18			(1 << 26)
 #define VS30			(1 << 25)
@@ -119,6 +121,27 @@
 #define SRD			(1 << 26)
 #define SOFTRESET		(1 << 1)
 #define RESETDONE		(1 << 0)
+#define DMA_MNS			(1 << 20)	/* CON: DMA master mode */
+#define DMAS_MASK		(0x3 << 3)
+#define DMAS_ADMA2		(0x2 << 3)	/* HCTL: 32-bit ADMA2 */
+#define CAPA_AD2S		(1 << 19)
+#define ADMA_ERR		(1 << 25)
+#define ADMAE_ENABLE		(1 << 25)
+
+/*
+ * ADMA2 descriptor table: one page of 8-byte descriptors, each moving up
+ * to ADMA_DESC_MAX_LEN bytes (the length field is 16 bits wide, keep it a
+ * multiple of the block size).
+ */
+#define ADMA_TABLE_SZ		PAGE_SIZE
+#define ADMA_TABLE_NUM_ENTRIES	(ADMA_TABLE_SZ / \
+					sizeof(struct omap_hsmmc_adma_desc))
+#define ADMA_DESC_MAX_LEN	(63 * 1024)
+
+#define ADMA_DESC_VALID		(1 << 0)
+#define ADMA_DESC_END		(1 << 1)
+#define ADMA_DESC_INT		(1 << 2)
+#define ADMA_DESC_ATTR_TRAN	(0x2 << 4)
 
 #define AUTO_CMD12		(1 << 0)	/* Auto CMD12 support */
 /*
@@ -161,6 +184,12 @@ struct omap_hsmmc_next {
 	s32		cookie;
 };
 
+struct omap_hsmmc_adma_desc {
+	__le16		attr;
+	__le16		len;
+	__le32		addr;
+};
+
 struct omap_hsmmc_host {
 	struct	device		*dev;
 	struct	mmc_host	*mmc;
@@ -191,6 +220,14 @@ struct omap_hsmmc_host {
 	int			irq;
 	int			use_dma, dma_ch;
 	int			dma_line_tx, dma_line_rx;
+	/*
+	 * ADMA2: the controller walks the descriptor table itself, the
+	 * sDMA channel and its per-segment callbacks are not used
+	 */
+	int			use_adma;
+	int			adma_busy;
+	struct omap_hsmmc_adma_desc	*adma_desc;
+	dma_addr_t		adma_desc_dma;
 	int			slot_id;
 	int			got_dbclk;
 	int			response_busy;
@@ -543,6 +580,9 @@ static void omap_hsmmc_enable_irq(struct omap_hsmmc_host *host,
 	else
 		irq_mask = INT_EN_MASK;
 
+	if (host->use_adma)
+		irq_mask |= ADMAE_ENABLE;
+
 	/* Disable timeout for erases */
 	if (cmd->opcode == MMC_ERASE)
 		irq_mask &= ~DTO_ENABLE;
@@ -938,6 +978,14 @@ omap_hsmmc_xfer_done(struct omap_hsmmc_host *host, struct mmc_data *data)
 
 	host->data = NULL;
 
+	if (host->adma_busy) {
+		host->adma_busy = 0;
+		if (!data->host_cookie)
+			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len,
+				     omap_hsmmc_get_dma_dir(host, data));
+	}
+
 	if (!data->error)
 		data->bytes_xfered += data->blocks * (data->blksz);
 	else
@@ -1019,6 +1067,12 @@ static void omap_hsmmc_dma_cleanup(struct omap_hsmmc_host *host, int errno)
 			omap_hsmmc_get_dma_dir(host, host->data));
 		omap_free_dma(dma_ch);
 		host->data->host_cookie = 0;
+	} else if (host->adma_busy) {
+		host->adma_busy = 0;
+		dma_unmap_sg(mmc_dev(host->mmc), host->data->sg,
+			host->data->sg_len,
+			omap_hsmmc_get_dma_dir(host, host->data));
+		host->data->host_cookie = 0;
 	}
 	host->data = NULL;
 }
@@ -1034,7 +1088,7 @@ static void omap_hsmmc_dbg_report_irq(struct omap_hsmmc_host *host, u32 status)
 		"CC"  , "TC"  , "BGE", "---", "BWR" , "BRR" , "---" , "---" ,
 		"CIRQ",	"OBI" , "---", "---", "---" , "---" , "---" , "ERRI",
 		"CTO" , "CCRC", "CEB", "CIE", "DTO" , "DCRC", "DEB" , "---" ,
-		"ACE" , "---" , "---", "---", "CERR", "BADA", "---" , "---"
+		"ACE" , "ADMA", "---", "---", "CERR", "BADA", "---" , "---"
 	};
 	char res[256];
 	char *buf = res;
@@ -1150,6 +1204,15 @@ static void omap_hsmmc_do_irq(struct omap_hsmmc_host *host, int status)
 				end_trans = 1;
 			}
 		}
+		if (status & ADMA_ERR) {
+			dev_err(mmc_dev(host->mmc), "ADMA error, ADMAES %x\n",
+				OMAP_HSMMC_READ(host->base, ADMAES));
+			if (host->data) {
+				omap_hsmmc_dma_cleanup(host, -EIO);
+				omap_hsmmc_reset_controller_fsm(host, SRD);
+				end_trans = 1;
+			}
+		}
 		if (status & CARD_ERR) {
 			dev_dbg(mmc_dev(host->mmc),
 				"Ignoring card err CMD%d\n", host->cmd->opcode);
@@ -1462,14 +1525,10 @@ static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
 	return 0;
 }
 
-/*
- * Routine to configure and start DMA for the MMC card
- */
-static int omap_hsmmc_start_dma_transfer(struct omap_hsmmc_host *host,
-					struct mmc_request *req)
+static int omap_hsmmc_check_dma_data(struct omap_hsmmc_host *host,
+				     struct mmc_data *data)
 {
-	int dma_ch = 0, ret = 0, i;
-	struct mmc_data *data = req->data;
+	int i;
 
 	/* Sanity check: all the SG entries must be aligned by block size. */
 	for (i = 0; i < data->sg_len; i++) {
@@ -1478,6 +1537,9 @@ static int omap_hsmmc_start_dma_transfer(struct omap_hsmmc_host *host,
 		sgl = data->sg + i;
 		if (sgl->length % data->blksz)
 			return -EINVAL;
+		/* ADMA2 descriptors take 32-bit aligned addresses only */
+		if (host->use_adma && !IS_ALIGNED(sgl->offset, 4))
+			return -EINVAL;
 	}
 	if ((data->blksz % 4) != 0)
 		/* REVISIT: The MMC buffer increments only when MSB is written.
@@ -1485,6 +1547,101 @@ static int omap_hsmmc_start_dma_transfer(struct omap_hsmmc_host *host,
 		 */
 		return -EINVAL;
 
+	return 0;
+}
+
+/*
+ * Build the ADMA2 descriptor table for the whole mapped scatterlist, so
+ * the transfer runs without any CPU involvement until TC.
+ */
+static int omap_hsmmc_setup_adma_table(struct omap_hsmmc_host *host,
+				       struct mmc_data *data)
+{
+	struct omap_hsmmc_adma_desc *desc = host->adma_desc;
+	struct scatterlist *sg;
+	int i, n = 0;
+
+	for_each_sg(data->sg, sg, host->dma_len, i) {
+		dma_addr_t addr = sg_dma_address(sg);
+		unsigned int len = sg_dma_len(sg);
+
+		while (len) {
+			unsigned int chunk = min_t(unsigned int, len,
+						   ADMA_DESC_MAX_LEN);
+
+			if (n == ADMA_TABLE_NUM_ENTRIES)
+				return -EINVAL;
+
+			desc[n].addr = cpu_to_le32(addr);
+			desc[n].len = cpu_to_le16(chunk);
+			desc[n].attr = cpu_to_le16(ADMA_DESC_VALID |
+						   ADMA_DESC_ATTR_TRAN);
+			addr += chunk;
+			len -= chunk;
+			n++;
+		}
+	}
+
+	if (!n)
+		return -EINVAL;
+
+	desc[n - 1].attr |= cpu_to_le16(ADMA_DESC_END);
+
+	/* the table must be in memory before the command starts the fetch */
+	wmb();
+
+	return 0;
+}
+
+static int omap_hsmmc_start_adma_transfer(struct omap_hsmmc_host *host,
+					  struct mmc_request *req)
+{
+	struct mmc_data *data = req->data;
+	u32 hctl;
+	int ret;
+
+	ret = omap_hsmmc_check_dma_data(host, data);
+	if (ret)
+		return ret;
+
+	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
+	if (ret)
+		return ret;
+
+	ret = omap_hsmmc_setup_adma_table(host, data);
+	if (ret) {
+		if (!data->host_cookie)
+			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len,
+				     omap_hsmmc_get_dma_dir(host, data));
+		return ret;
+	}
+
+	host->adma_busy = 1;
+
+	/* context restore may have reprogrammed CON and HCTL */
+	OMAP_HSMMC_WRITE(host->base, CON,
+			 OMAP_HSMMC_READ(host->base, CON) | DMA_MNS);
+	hctl = OMAP_HSMMC_READ(host->base, HCTL) & ~DMAS_MASK;
+	OMAP_HSMMC_WRITE(host->base, HCTL, hctl | DMAS_ADMA2);
+	OMAP_HSMMC_WRITE(host->base, ADMASAL, host->adma_desc_dma);
+
+	return 0;
+}
+
+/*
+ * Routine to configure and start DMA for the MMC card
+ */
+static int omap_hsmmc_start_dma_transfer(struct omap_hsmmc_host *host,
+					struct mmc_request *req)
+{
+	int dma_ch = 0, ret = 0;
+	struct mmc_data *data = req->data;
+
+	ret = omap_hsmmc_check_dma_data(host, data);
+	if (ret)
+		return ret;
+
 	BUG_ON(host->dma_ch != -1);
 
 	ret = omap_request_dma(omap_hsmmc_get_dma_sync_dev(host, data),
@@ -1569,7 +1726,10 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 	set_data_timeout(host, req->data->timeout_ns, req->data->timeout_clks);
 
 	if (host->use_dma) {
-		ret = omap_hsmmc_start_dma_transfer(host, req);
+		if (host->use_adma)
+			ret = omap_hsmmc_start_adma_transfer(host, req);
+		else
+			ret = omap_hsmmc_start_dma_transfer(host, req);
 		if (ret != 0) {
 			dev_dbg(mmc_dev(host->mmc), "MMC start dma failure\n");
 			return ret;
@@ -1973,6 +2133,9 @@ static int omap_hsmmc_regs_show(struct seq_file *s, void *data)
 			OMAP_HSMMC_READ(host->base, ISE));
 	seq_printf(s, "CAPA:\t\t0x%08x\n",
 			OMAP_HSMMC_READ(host->base, CAPA));
+	if (host->use_adma)
+		seq_printf(s, "ADMASAL:\t0x%08x\n",
+				OMAP_HSMMC_READ(host->base, ADMASAL));
 
 	pm_runtime_mark_last_busy(host->dev);
 	pm_runtime_put_autosuspend(host->dev);
@@ -2194,10 +2357,31 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 	mmc->max_req_size = mmc->max_blk_size * mmc->max_blk_count;
 	mmc->max_seg_size = mmc->max_req_size;
 
+	/*
+	 * With ADMA2 the whole scatterlist goes into one descriptor table,
+	 * one descriptor per segment.
+	 */
+	if (OMAP_HSMMC_READ(host->base, CAPA) & CAPA_AD2S) {
+		host->adma_desc = dma_alloc_coherent(host->dev, ADMA_TABLE_SZ,
+						     &host->adma_desc_dma,
+						     GFP_KERNEL);
+		if (host->adma_desc) {
+			host->use_adma = 1;
+			mmc->max_segs = ADMA_TABLE_NUM_ENTRIES;
+			mmc->max_seg_size = ADMA_DESC_MAX_LEN;
+			dev_info(&pdev->dev, "using ADMA2\n");
+		} else {
+			dev_warn(&pdev->dev,
+				 "no ADMA descriptor table, using sDMA\n");
+		}
+	}
+
 	mmc->caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_SD_HIGHSPEED |
 		     MMC_CAP_WAIT_WHILE_BUSY | MMC_CAP_ERASE;
 
 	mmc->caps |= mmc_slot(host).caps;
+	/* mrq->sbc is issued ahead of the data command, so packing works */
+	mmc->caps2 |= MMC_CAP2_PACKED_WR;
 	if (mmc->caps & MMC_CAP_8_BIT_DATA)
 		mmc->caps |= MMC_CAP_4_BIT_DATA;
 
@@ -2299,6 +2483,9 @@ err_reg:
 err_irq_cd_init:
 	free_irq(host->irq, host);
 err_irq:
+	if (host->adma_desc)
+		dma_free_coherent(host->dev, ADMA_TABLE_SZ, host->adma_desc,
+				  host->adma_desc_dma);
 	pm_runtime_put_sync(host->dev);
 	pm_runtime_disable(host->dev);
 	clk_put(host->fclk);
@@ -2332,6 +2519,9 @@ static int __devexit omap_hsmmc_remove(struct platform_device *pdev)
 	if (mmc_slot(host).card_detect_irq)
 		free_irq(mmc_slot(host).card_detect_irq, host);
 
+	if (host->adma_desc)
+		dma_free_coherent(host->dev, ADMA_TABLE_SZ, host->adma_desc,
+				  host->adma_desc_dma);
 	pm_runtime_put_sync(host->dev);
 	pm_runtime_disable(host->dev);
 	clk_put(host->fclk);
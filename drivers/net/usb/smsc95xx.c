@@ -46,6 +46,9 @@
 #define SMSC95XX_INTERNAL_PHY_ID	(1)
 #define SMSC95XX_TX_OVERHEAD		(8)
 #define SMSC95XX_TX_OVERHEAD_CSUM	(12)
+/* TX command words of packed frames start DWORD aligned (TX_CMD_A buffer
+ * end alignment 0) */
+#define SMSC95XX_TX_BATCH_ALIGN		(4)
 
 struct smsc95xx_priv {
 	u32 mac_cr;
@@ -589,6 +592,11 @@ static const struct ethtool_ops smsc95xx_ethtool_ops = {
 	.get_eeprom_len	= smsc95xx_ethtool_get_eeprom_len,
 	.get_eeprom	= smsc95xx_ethtool_get_eeprom,
 	.set_eeprom	= smsc95xx_ethtool_set_eeprom,
+	.get_coalesce	= usbnet_get_coalesce,
+	.set_coalesce	= usbnet_set_coalesce,
+	.get_sset_count	= usbnet_get_sset_count,
+	.get_strings	= usbnet_get_strings,
+	.get_ethtool_stats = usbnet_get_ethtool_stats,
 };
 
 static int smsc95xx_ioctl(struct net_device *netdev, struct ifreq *rq, int cmd)
@@ -1032,25 +1040,33 @@ static void smsc95xx_unbind(struct usbnet *dev, struct usb_interface *intf)
 	}
 }
 
-static void smsc95xx_rx_csum_offload(struct sk_buff *skb)
+/* The frame's checksum is appended after its FCS, at @csum */
+static void smsc95xx_rx_csum_offload(struct sk_buff *skb, const u8 *csum)
 {
-	skb->csum = *(u16 *)(skb_tail_pointer(skb) - 2);
+	skb->csum = *(u16 *)csum;
 	skb->ip_summed = CHECKSUM_COMPLETE;
-	skb_trim(skb, skb->len - 2);
 }
 
 static int smsc95xx_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
 {
-	while (skb->len > 0) {
+	u8 *buf = page_address(skb_frag_page(&skb_shinfo(skb)->frags[0]));
+	unsigned offset = 0;
+
+	while (offset < skb->len) {
 		u32 header, align_count;
 		struct sk_buff *ax_skb;
-		unsigned char *packet;
+		unsigned len;
 		u16 size;
 
-		memcpy(&header, skb->data, sizeof(header));
+		if (unlikely(skb->len - offset < 4 + NET_IP_ALIGN)) {
+			netdev_warn(dev->net, "invalid rx length %d\n",
+				    skb->len - offset);
+			return 0;
+		}
+
+		memcpy(&header, buf + offset, sizeof(header));
 		le32_to_cpus(&header);
-		skb_pull(skb, 4 + NET_IP_ALIGN);
-		packet = skb->data;
+		offset += 4 + NET_IP_ALIGN;
 
 		/* get the packet length */
 		size = (u16)((header & RX_STS_FL_) >> 16);
@@ -1074,50 +1090,36 @@ static int smsc95xx_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
 			}
 		} else {
 			/* ETH_FRAME_LEN + 4(CRC) + 2(COE) + 4(Vlan) */
-			if (unlikely(size > (ETH_FRAME_LEN + 12))) {
+			if (unlikely(size > (ETH_FRAME_LEN + 12) ||
+				     size < ETH_HLEN + 6 ||
+				     size > skb->len - offset)) {
 				netif_dbg(dev, rx_err, dev->net,
 					  "size err header=0x%08x\n", header);
 				return 0;
 			}
 
-			/* last frame in this batch */
-			if (skb->len == size) {
-				if (dev->net->features & NETIF_F_RXCSUM)
-					smsc95xx_rx_csum_offload(skb);
-				skb_trim(skb, skb->len - 4); /* remove fcs */
-				skb->truesize = size + sizeof(struct sk_buff);
-
-				return 1;
-			}
+			len = size - 4; /* remove fcs */
+			if (dev->net->features & NETIF_F_RXCSUM)
+				len -= 2;
 
-			ax_skb = skb_clone(skb, GFP_ATOMIC);
+			ax_skb = usbnet_rx_frag(dev, skb, offset, len);
 			if (unlikely(!ax_skb)) {
 				netdev_warn(dev->net, "Error allocating skb\n");
 				return 0;
 			}
 
-			ax_skb->len = size;
-			ax_skb->data = packet;
-			skb_set_tail_pointer(ax_skb, size);
-
 			if (dev->net->features & NETIF_F_RXCSUM)
-				smsc95xx_rx_csum_offload(ax_skb);
-			skb_trim(ax_skb, ax_skb->len - 4); /* remove fcs */
-			ax_skb->truesize = size + sizeof(struct sk_buff);
+				smsc95xx_rx_csum_offload(ax_skb,
+							 buf + offset + size - 2);
 
 			usbnet_skb_return(dev, ax_skb);
 		}
 
-		skb_pull(skb, size);
+		offset += size;
 
 		/* padding bytes before the next frame starts */
-		if (skb->len)
-			skb_pull(skb, align_count);
-	}
-
-	if (unlikely(skb->len < 0)) {
-		netdev_warn(dev->net, "invalid rx length<0 %d\n", skb->len);
-		return 0;
+		if (offset < skb->len)
+			offset += align_count;
 	}
 
 	return 1;
@@ -1192,7 +1194,9 @@ static const struct driver_info smsc95xx_info = {
 	.rx_fixup	= smsc95xx_rx_fixup,
 	.tx_fixup	= smsc95xx_tx_fixup,
 	.status		= smsc95xx_status,
-	.flags		= FLAG_ETHER | FLAG_SEND_ZLP | FLAG_LINK_INTR,
+	.flags		= FLAG_ETHER | FLAG_SEND_ZLP | FLAG_LINK_INTR |
+			  FLAG_TX_BATCH | FLAG_RX_PAGES | FLAG_NAPI,
+	.tx_batch_align	= SMSC95XX_TX_BATCH_ALIGN,
 };
 
 static const struct usb_device_id products[] = {
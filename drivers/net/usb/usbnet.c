@@ -79,6 +79,20 @@
 // between wakeups
 #define UNLINK_TIMEOUT_MS	3
 
+// packets per usbnet_poll() with FLAG_NAPI
+#define NAPI_WEIGHT		64
+
+// FLAG_RX_PAGES frames up to this size are copied whole, larger ones
+// just their headers, with the rest left in the URB buffer page
+#define RX_COPYBREAK		128
+
+// FLAG_TX_BATCH defaults; frames and usecs can be changed with ethtool -C
+#define TX_BATCH_FRAMES		16
+#define TX_BATCH_USECS		100
+#define TX_BATCH_BYTES		(16 * 1024)
+#define TX_BATCH_MAX_FRAMES	64
+#define TX_BATCH_MAX_USECS	10000
+
 /*-------------------------------------------------------------------------*/
 
 // randomly generated ethernet address
@@ -223,7 +237,8 @@ static int init_status (struct usbnet *dev, struct usb_interface *intf)
  * Some link protocols batch packets, so their rx_fixup paths
  * can return clones as well as just modify the original skb.
  */
-void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+static void __usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb,
+				 bool gro)
 {
 	int	status;
 
@@ -243,11 +258,23 @@ void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 	if (skb_defer_rx_timestamp(skb))
 		return;
 
+	if (gro) {
+		if (napi_gro_receive(&dev->napi, skb) == GRO_DROP)
+			netif_dbg(dev, rx_err, dev->net, "gro dropped\n");
+		return;
+	}
+
 	status = netif_rx (skb);
 	if (status != NET_RX_SUCCESS)
 		netif_dbg(dev, rx_err, dev->net,
 			  "netif_rx status %d\n", status);
 }
+
+/* with FLAG_NAPI this is called from the poll loop, and feeds GRO */
+void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+{
+	__usbnet_skb_return(dev, skb, dev->driver_info->flags & FLAG_NAPI);
+}
 EXPORT_SYMBOL_GPL(usbnet_skb_return);
 
 
@@ -292,6 +319,21 @@ static void __usbnet_queue_skb(struct sk_buff_head *list,
 	entry->state = state;
 }
 
+/* The bh runs as a tasklet, or with FLAG_NAPI from the NAPI poll loop */
+static void usbnet_bh_schedule(struct usbnet *dev)
+{
+	if (!(dev->driver_info->flags & FLAG_NAPI)) {
+		tasklet_schedule(&dev->bh);
+	} else if (in_interrupt() || irqs_disabled()) {
+		napi_schedule(&dev->napi);
+	} else {
+		// run the softirq now, not at the next interrupt
+		local_bh_disable();
+		napi_schedule(&dev->napi);
+		local_bh_enable();
+	}
+}
+
 /*-------------------------------------------------------------------------*/
 
 /* some LK 2.4 HCDs oopsed if we freed or resubmitted urbs from
@@ -313,7 +355,7 @@ static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 	spin_lock(&dev->done.lock);
 	__skb_queue_tail(&dev->done, skb);
 	if (dev->done.qlen == 1)
-		tasklet_schedule(&dev->bh);
+		usbnet_bh_schedule(dev);
 	spin_unlock_irqrestore(&dev->done.lock, flags);
 	return old_state;
 }
@@ -337,6 +379,123 @@ EXPORT_SYMBOL_GPL(usbnet_defer_kevent);
 
 static void rx_complete (struct urb *urb);
 
+/* FLAG_RX_PAGES buffers.  The pool keeps one reference to each of its pages,
+ * so a page whose count is back to one has no URB or frame left using it
+ * and can be handed out again without going through the page allocator.
+ */
+static struct page *rx_page_get (struct usbnet *dev, gfp_t flags)
+{
+	struct usbnet_rx_pool	*pool = &dev->rx_pool;
+	unsigned		order = get_order(dev->rx_urb_size);
+	struct page		*page;
+	unsigned long		lockflags;
+	int			i, slot;
+
+	spin_lock_irqsave(&pool->lock, lockflags);
+	if (pool->order == order) {
+		for (i = 0; i < USBNET_RX_POOL; i++) {
+			slot = (pool->next + i) % USBNET_RX_POOL;
+			page = pool->pages[slot];
+			if (page && page_count(page) == 1) {
+				get_page(page);
+				pool->next = (slot + 1) % USBNET_RX_POOL;
+				spin_unlock_irqrestore(&pool->lock, lockflags);
+				return page;
+			}
+		}
+	}
+	spin_unlock_irqrestore(&pool->lock, lockflags);
+
+	page = alloc_pages(flags | __GFP_COMP | __GFP_NOWARN, order);
+	if (!page)
+		return NULL;
+
+	/* replace the oldest entry; whoever still uses it frees it */
+	spin_lock_irqsave(&pool->lock, lockflags);
+	if (pool->order != order) {
+		for (i = 0; i < USBNET_RX_POOL; i++)
+			if (pool->pages[i]) {
+				put_page(pool->pages[i]);
+				pool->pages[i] = NULL;
+			}
+		pool->order = order;
+	}
+	slot = pool->next;
+	if (pool->pages[slot])
+		put_page(pool->pages[slot]);
+	get_page(page);
+	pool->pages[slot] = page;
+	pool->next = (slot + 1) % USBNET_RX_POOL;
+	spin_unlock_irqrestore(&pool->lock, lockflags);
+
+	return page;
+}
+
+static void rx_pool_drain (struct usbnet *dev)
+{
+	struct usbnet_rx_pool	*pool = &dev->rx_pool;
+	unsigned long		lockflags;
+	int			i;
+
+	spin_lock_irqsave(&pool->lock, lockflags);
+	for (i = 0; i < USBNET_RX_POOL; i++)
+		if (pool->pages[i]) {
+			put_page(pool->pages[i]);
+			pool->pages[i] = NULL;
+		}
+	spin_unlock_irqrestore(&pool->lock, lockflags);
+}
+
+static struct sk_buff *rx_alloc_skb (struct usbnet *dev, gfp_t flags)
+{
+	struct sk_buff		*skb;
+	struct page		*page;
+
+	if (!(dev->driver_info->flags & FLAG_RX_PAGES))
+		return __netdev_alloc_skb_ip_align(dev->net, dev->rx_urb_size,
+						   flags);
+
+	/* the skb only carries the page and the URB bookkeeping */
+	skb = __netdev_alloc_skb(dev->net, 0, flags);
+	if (!skb)
+		return NULL;
+
+	page = rx_page_get(dev, flags);
+	if (!page) {
+		dev_kfree_skb_any(skb);
+		return NULL;
+	}
+	skb_fill_page_desc(skb, 0, page, 0, 0);
+	skb->truesize += PAGE_SIZE << compound_order(page);
+	return skb;
+}
+
+/* Build an skb for the frame at @offset, @len bytes long, in the page-backed
+ * buffer of FLAG_RX_PAGES URB @skb.  Short frames are copied; otherwise only
+ * the headers are, and the payload becomes a fragment pointing into the
+ * page, so the frame is charged for its own size rather than the transfer.
+ */
+struct sk_buff *usbnet_rx_frag (struct usbnet *dev, struct sk_buff *skb,
+				unsigned offset, unsigned len)
+{
+	struct page		*page = skb_frag_page(&skb_shinfo(skb)->frags[0]);
+	unsigned		copy = min_t(unsigned, len, RX_COPYBREAK);
+	struct sk_buff		*frame;
+
+	frame = netdev_alloc_skb_ip_align(dev->net, RX_COPYBREAK);
+	if (!frame)
+		return NULL;
+
+	memcpy(skb_put(frame, copy), page_address(page) + offset, copy);
+	if (len > copy) {
+		get_page(page);
+		skb_add_rx_frag(frame, 0, page, offset + copy, len - copy,
+				len - copy);
+	}
+	return frame;
+}
+EXPORT_SYMBOL_GPL(usbnet_rx_frag);
+
 static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 {
 	struct sk_buff		*skb;
@@ -344,8 +503,9 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 	int			retval = 0;
 	unsigned long		lockflags;
 	size_t			size = dev->rx_urb_size;
+	void			*buf;
 
-	skb = __netdev_alloc_skb_ip_align(dev->net, size, flags);
+	skb = rx_alloc_skb(dev, flags);
 	if (!skb) {
 		netif_dbg(dev, rx_err, dev->net, "no rx skb\n");
 		usbnet_defer_kevent (dev, EVENT_RX_MEMORY);
@@ -358,8 +518,12 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 	entry->dev = dev;
 	entry->length = 0;
 
+	if (skb_shinfo(skb)->nr_frags)
+		buf = page_address(skb_frag_page(&skb_shinfo(skb)->frags[0]));
+	else
+		buf = skb->data;
 	usb_fill_bulk_urb (urb, dev->udev, dev->in,
-		skb->data, size, rx_complete, skb);
+		buf, size, rx_complete, skb);
 
 	spin_lock_irqsave (&dev->rxq.lock, lockflags);
 
@@ -384,7 +548,7 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 		default:
 			netif_dbg(dev, rx_err, dev->net,
 				  "rx submit, %d\n", retval);
-			tasklet_schedule (&dev->bh);
+			usbnet_bh_schedule(dev);
 			break;
 		case 0:
 			__usbnet_queue_skb(&dev->rxq, skb, rx_start);
@@ -417,7 +581,8 @@ static inline void rx_process (struct usbnet *dev, struct sk_buff *skb)
 
 	if (skb->len) {
 		/* all data was already cloned from skb inside the driver */
-		if (dev->driver_info->flags & FLAG_MULTI_PACKET)
+		if (dev->driver_info->flags &
+		    (FLAG_MULTI_PACKET | FLAG_RX_PAGES))
 			dev_kfree_skb_any(skb);
 		else
 			usbnet_skb_return(dev, skb);
@@ -440,7 +605,13 @@ static void rx_complete (struct urb *urb)
 	int			urb_status = urb->status;
 	enum skb_state		state;
 
-	skb_put (skb, urb->actual_length);
+	if (skb_shinfo(skb)->nr_frags) {
+		skb_frag_size_set(&skb_shinfo(skb)->frags[0],
+				  urb->actual_length);
+		skb->len += urb->actual_length;
+		skb->data_len += urb->actual_length;
+	} else
+		skb_put (skb, urb->actual_length);
 	state = rx_done;
 	entry->urb = NULL;
 
@@ -571,12 +742,13 @@ void usbnet_resume_rx(struct usbnet *dev)
 
 	clear_bit(EVENT_RX_PAUSED, &dev->flags);
 
+	/* not from the poll loop, so no GRO */
 	while ((skb = skb_dequeue(&dev->rxq_pause)) != NULL) {
-		usbnet_skb_return(dev, skb);
+		__usbnet_skb_return(dev, skb, false);
 		num++;
 	}
 
-	tasklet_schedule(&dev->bh);
+	usbnet_bh_schedule(dev);
 
 	netif_dbg(dev, rx_status, dev->net,
 		  "paused rx queue disabled, %d skbs requeued\n", num);
@@ -645,7 +817,7 @@ void usbnet_unlink_rx_urbs(struct usbnet *dev)
 {
 	if (netif_running(dev->net)) {
 		(void) unlink_urbs (dev, &dev->rxq);
-		tasklet_schedule(&dev->bh);
+		usbnet_bh_schedule(dev);
 	}
 }
 EXPORT_SYMBOL_GPL(usbnet_unlink_rx_urbs);
@@ -720,6 +892,17 @@ int usbnet_stop (struct net_device *net)
 	dev->flags = 0;
 	del_timer_sync (&dev->delay);
 	tasklet_kill (&dev->bh);
+	if (info->flags & FLAG_NAPI)
+		napi_disable(&dev->napi);
+	rx_pool_drain(dev);
+	if (info->flags & FLAG_TX_BATCH) {
+		hrtimer_cancel(&dev->tx_batch.timer);
+		tasklet_kill(&dev->tx_batch.bh);
+		netif_tx_lock_bh(net);
+		__skb_queue_purge(&dev->tx_batch.frames);
+		dev->tx_batch.bytes = 0;
+		netif_tx_unlock_bh(net);
+	}
 	if (info->manage_power)
 		info->manage_power(dev, 0);
 	else
@@ -791,12 +974,18 @@ int usbnet_open (struct net_device *net)
 		   (dev->driver_info->flags & FLAG_FRAMING_AX) ? "ASIX" :
 		   "simple");
 
+	if (info->flags & FLAG_NAPI)
+		napi_enable(&dev->napi);
+
 	// delay posting reads until we're fully open
-	tasklet_schedule (&dev->bh);
+	usbnet_bh_schedule(dev);
 	if (info->manage_power) {
 		retval = info->manage_power(dev, 1);
-		if (retval < 0)
+		if (retval < 0) {
+			if (info->flags & FLAG_NAPI)
+				napi_disable(&dev->napi);
 			goto done;
+		}
 		usb_autopm_put_interface(dev->intf);
 	}
 	return retval;
@@ -900,6 +1089,86 @@ void usbnet_set_msglevel (struct net_device *net, u32 level)
 }
 EXPORT_SYMBOL_GPL(usbnet_set_msglevel);
 
+/* TX batching is tuned with the tx-usecs and tx-frames coalescing
+ * parameters; tx-frames 1 turns it off.
+ */
+int usbnet_get_coalesce(struct net_device *net, struct ethtool_coalesce *ec)
+{
+	struct usbnet *dev = netdev_priv(net);
+
+	if (!(dev->driver_info->flags & FLAG_TX_BATCH))
+		return -EOPNOTSUPP;
+
+	ec->tx_coalesce_usecs = dev->tx_batch.usecs;
+	ec->tx_max_coalesced_frames = dev->tx_batch.max_frames;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(usbnet_get_coalesce);
+
+int usbnet_set_coalesce(struct net_device *net, struct ethtool_coalesce *ec)
+{
+	struct usbnet *dev = netdev_priv(net);
+
+	if (!(dev->driver_info->flags & FLAG_TX_BATCH))
+		return -EOPNOTSUPP;
+
+	if (ec->tx_max_coalesced_frames < 1 ||
+	    ec->tx_max_coalesced_frames > TX_BATCH_MAX_FRAMES ||
+	    ec->tx_coalesce_usecs < 1 ||
+	    ec->tx_coalesce_usecs > TX_BATCH_MAX_USECS)
+		return -EINVAL;
+
+	netif_tx_lock_bh(net);
+	dev->tx_batch.usecs = ec->tx_coalesce_usecs;
+	dev->tx_batch.max_frames = ec->tx_max_coalesced_frames;
+	netif_tx_unlock_bh(net);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(usbnet_set_coalesce);
+
+static const char usbnet_tx_batch_stats[][ETH_GSTRING_LEN] = {
+	"tx_batch_urbs",
+	"tx_batch_frames",
+	"tx_batch_direct",
+	"tx_batch_flush_full",
+	"tx_batch_flush_timer",
+	"tx_batch_max_bytes",
+};
+
+int usbnet_get_sset_count(struct net_device *net, int sset)
+{
+	struct usbnet *dev = netdev_priv(net);
+
+	if (sset != ETH_SS_STATS || !(dev->driver_info->flags & FLAG_TX_BATCH))
+		return -EOPNOTSUPP;
+
+	return ARRAY_SIZE(usbnet_tx_batch_stats);
+}
+EXPORT_SYMBOL_GPL(usbnet_get_sset_count);
+
+void usbnet_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, usbnet_tx_batch_stats,
+		       sizeof(usbnet_tx_batch_stats));
+}
+EXPORT_SYMBOL_GPL(usbnet_get_strings);
+
+void usbnet_get_ethtool_stats(struct net_device *net,
+			      struct ethtool_stats *stats, u64 *data)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct usbnet_tx_batch *batch = &dev->tx_batch;
+
+	data[0] = batch->urbs;
+	data[1] = batch->packed;
+	data[2] = batch->direct;
+	data[3] = batch->flush_full;
+	data[4] = batch->flush_timer;
+	data[5] = batch->max_bytes;
+}
+EXPORT_SYMBOL_GPL(usbnet_get_ethtool_stats);
+
 /* drivers may override default ethtool_ops in their bind() routine */
 static const struct ethtool_ops usbnet_ethtool_ops = {
 	.get_settings		= usbnet_get_settings,
@@ -909,6 +1178,11 @@ static const struct ethtool_ops usbnet_ethtool_ops = {
 	.get_drvinfo		= usbnet_get_drvinfo,
 	.get_msglevel		= usbnet_get_msglevel,
 	.set_msglevel		= usbnet_set_msglevel,
+	.get_coalesce		= usbnet_get_coalesce,
+	.set_coalesce		= usbnet_set_coalesce,
+	.get_sset_count		= usbnet_get_sset_count,
+	.get_strings		= usbnet_get_strings,
+	.get_ethtool_stats	= usbnet_get_ethtool_stats,
 };
 
 /*-------------------------------------------------------------------------*/
@@ -962,7 +1236,7 @@ fail_halt:
 					   status);
 		} else {
 			clear_bit (EVENT_RX_HALT, &dev->flags);
-			tasklet_schedule (&dev->bh);
+			usbnet_bh_schedule(dev);
 		}
 	}
 
@@ -987,7 +1261,7 @@ fail_halt:
 			usb_autopm_put_interface(dev->intf);
 fail_lowmem:
 			if (resched)
-				tasklet_schedule (&dev->bh);
+				usbnet_bh_schedule(dev);
 		}
 	}
 
@@ -1025,8 +1299,7 @@ static void tx_complete (struct urb *urb)
 	struct usbnet		*dev = entry->dev;
 
 	if (urb->status == 0) {
-		if (!(dev->driver_info->flags & FLAG_MULTI_PACKET))
-			dev->net->stats.tx_packets++;
+		dev->net->stats.tx_packets += entry->packets;
 		dev->net->stats.tx_bytes += entry->length;
 	} else {
 		dev->net->stats.tx_errors++;
@@ -1073,7 +1346,7 @@ void usbnet_tx_timeout (struct net_device *net)
 	struct usbnet		*dev = netdev_priv(net);
 
 	unlink_urbs (dev, &dev->txq);
-	tasklet_schedule (&dev->bh);
+	usbnet_bh_schedule(dev);
 
 	// FIXME: device recovery -- reset?
 }
@@ -1081,6 +1354,139 @@ EXPORT_SYMBOL_GPL(usbnet_tx_timeout);
 
 /*-------------------------------------------------------------------------*/
 
+/* FLAG_TX_BATCH: frames that tx_fixup framed are held back while URBs are
+ * in flight and packed into one transfer once tx_batch.max_frames or
+ * tx_batch.max_bytes is reached, or tx_batch.usecs after the first was
+ * queued.  Everything here runs under the netdev tx lock, from
+ * ndo_start_xmit or from the timer's tasklet.
+ */
+
+static struct sk_buff *usbnet_tx_batch_pack(struct usbnet *dev,
+					    unsigned *packets)
+{
+	struct usbnet_tx_batch	*batch = &dev->tx_batch;
+	int			align = dev->driver_info->tx_batch_align;
+	struct sk_buff		*skb, *frame;
+
+	hrtimer_try_to_cancel(&batch->timer);
+
+	*packets = skb_queue_len(&batch->frames);
+	if (*packets == 1) {
+		skb = __skb_dequeue(&batch->frames);
+		goto done;
+	}
+
+	skb = alloc_skb(batch->bytes, GFP_ATOMIC);
+	if (!skb) {
+		dev->net->stats.tx_dropped += *packets;
+		while ((frame = __skb_dequeue(&batch->frames)))
+			dev_kfree_skb_any(frame);
+		goto done;
+	}
+
+	while ((frame = __skb_dequeue(&batch->frames))) {
+		if (align && skb->len % align) {
+			int pad = align - skb->len % align;
+
+			memset(skb_put(skb, pad), 0, pad);
+		}
+		skb_copy_from_linear_data(frame, skb_put(skb, frame->len),
+					  frame->len);
+		dev_kfree_skb_any(frame);
+	}
+	batch->urbs++;
+	batch->packed += *packets;
+
+done:
+	batch->bytes = 0;
+	return skb;
+}
+
+/* Queue a tx_fixup'd frame, or with NULL flush on timer expiry.  Returns
+ * whatever should be sent now, or NULL to wait for more frames.
+ */
+static struct sk_buff *usbnet_tx_batch(struct usbnet *dev,
+				       struct sk_buff *skb, unsigned *packets)
+{
+	struct usbnet_tx_batch	*batch = &dev->tx_batch;
+	int			align = dev->driver_info->tx_batch_align;
+	struct sk_buff		*out = NULL;
+	unsigned		bytes;
+
+	if (!skb) {
+		if (skb_queue_empty(&batch->frames))
+			return NULL;
+		batch->flush_timer++;
+		return usbnet_tx_batch_pack(dev, packets);
+	}
+
+	/* nothing to wait for; don't add latency to an idle link */
+	if (skb_queue_empty(&batch->frames) && !dev->txq.qlen) {
+		batch->direct++;
+		*packets = 1;
+		return skb;
+	}
+
+	bytes = batch->bytes;
+	if (align && bytes % align)
+		bytes += align - bytes % align;
+	if (!skb_queue_empty(&batch->frames) &&
+	    bytes + skb->len > batch->max_bytes) {
+		batch->flush_full++;
+		out = usbnet_tx_batch_pack(dev, packets);
+		bytes = 0;
+	}
+
+	__skb_queue_tail(&batch->frames, skb);
+	batch->bytes = bytes + skb->len;
+
+	if (out)
+		hrtimer_start(&batch->timer, ns_to_ktime(batch->usecs *
+			      NSEC_PER_USEC), HRTIMER_MODE_REL);
+	else if (skb_queue_len(&batch->frames) >= batch->max_frames) {
+		batch->flush_full++;
+		out = usbnet_tx_batch_pack(dev, packets);
+	} else if (skb_queue_len(&batch->frames) == 1)
+		hrtimer_start(&batch->timer, ns_to_ktime(batch->usecs *
+			      NSEC_PER_USEC), HRTIMER_MODE_REL);
+
+	return out;
+}
+
+static enum hrtimer_restart usbnet_tx_batch_timer(struct hrtimer *timer)
+{
+	struct usbnet *dev = container_of(timer, struct usbnet,
+					  tx_batch.timer);
+
+	tasklet_schedule(&dev->tx_batch.bh);
+	return HRTIMER_NORESTART;
+}
+
+static void usbnet_tx_batch_bh(unsigned long param)
+{
+	struct usbnet *dev = (struct usbnet *) param;
+
+	netif_tx_lock_bh(dev->net);
+	if (!skb_queue_empty(&dev->tx_batch.frames))
+		usbnet_start_xmit(NULL, dev->net);
+	netif_tx_unlock_bh(dev->net);
+}
+
+static void usbnet_tx_batch_init(struct usbnet *dev)
+{
+	struct usbnet_tx_batch *batch = &dev->tx_batch;
+
+	skb_queue_head_init(&batch->frames);
+	hrtimer_init(&batch->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	batch->timer.function = usbnet_tx_batch_timer;
+	tasklet_init(&batch->bh, usbnet_tx_batch_bh, (unsigned long) dev);
+	batch->usecs = TX_BATCH_USECS;
+	batch->max_frames = TX_BATCH_FRAMES;
+	batch->max_bytes = TX_BATCH_BYTES;
+}
+
+/*-------------------------------------------------------------------------*/
+
 netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 				     struct net_device *net)
 {
@@ -1090,6 +1496,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	struct skb_data		*entry;
 	struct driver_info	*info = dev->driver_info;
 	unsigned long		flags;
+	unsigned		packets = !(info->flags & FLAG_MULTI_PACKET);
 	int retval;
 
 	if (skb)
@@ -1097,7 +1504,19 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 
 	// some devices want funky USB-level framing, for
 	// win32 driver (usually) and/or hardware quirks
-	if (info->tx_fixup) {
+	if (info->flags & FLAG_TX_BATCH) {
+		if (skb) {
+			skb = info->tx_fixup(dev, skb, GFP_ATOMIC);
+			if (!skb) {
+				netif_dbg(dev, tx_err, dev->net,
+					  "can't tx_fixup skb\n");
+				goto drop;
+			}
+		}
+		skb = usbnet_tx_batch(dev, skb, &packets);
+		if (!skb)
+			goto not_drop;
+	} else if (info->tx_fixup) {
 		skb = info->tx_fixup (dev, skb, GFP_ATOMIC);
 		if (!skb) {
 			if (netif_msg_tx_err(dev)) {
@@ -1120,6 +1539,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	entry->urb = urb;
 	entry->dev = dev;
 	entry->length = length;
+	entry->packets = packets;
 
 	usb_fill_bulk_urb (urb, dev->udev, dev->out,
 			skb->data, skb->len, tx_complete, skb);
@@ -1186,7 +1606,8 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	if (retval) {
 		netif_dbg(dev, tx_err, dev->net, "drop, code %d\n", retval);
 drop:
-		dev->net->stats.tx_dropped++;
+		/* a packed batch takes all of its frames down with it */
+		dev->net->stats.tx_dropped += max(packets, 1U);
 not_drop:
 		if (skb)
 			dev_kfree_skb_any (skb);
@@ -1205,18 +1626,23 @@ EXPORT_SYMBOL_GPL(usbnet_start_xmit);
 
 // tasklet (work deferred from completions, in_irq) or timer
 
-static void usbnet_bh (unsigned long param)
+/* Returns how many packets were passed up the stack, or budget if there's
+ * more to do and it should be run again.
+ */
+static int __usbnet_bh (struct usbnet *dev, int budget)
 {
-	struct usbnet		*dev = (struct usbnet *) param;
 	struct sk_buff		*skb;
 	struct skb_data		*entry;
+	unsigned long		rx_packets = dev->net->stats.rx_packets;
+	int			work = 0;
 
-	while ((skb = skb_dequeue (&dev->done))) {
+	while (work < budget && (skb = skb_dequeue (&dev->done))) {
 		entry = (struct skb_data *) skb->cb;
 		switch (entry->state) {
 		case rx_done:
 			entry->state = rx_cleanup;
 			rx_process (dev, skb);
+			work = dev->net->stats.rx_packets - rx_packets;
 			continue;
 		case tx_done:
 		case rx_cleanup:
@@ -1252,7 +1678,7 @@ static void usbnet_bh (unsigned long param)
 				if (urb != NULL) {
 					if (rx_submit (dev, urb, GFP_ATOMIC) ==
 					    -ENOLINK)
-						return;
+						return work;
 				}
 			}
 			if (temp != dev->rxq.qlen)
@@ -1260,13 +1686,45 @@ static void usbnet_bh (unsigned long param)
 					  "rxqlen %d --> %d\n",
 					  temp, dev->rxq.qlen);
 			if (dev->rxq.qlen < qlen)
-				tasklet_schedule (&dev->bh);
+				work = budget;
 		}
 		if (dev->txq.qlen < TX_QLEN (dev))
 			netif_wake_queue (dev->net);
 	}
+
+	return min(work, budget);
 }
 
+static void usbnet_bh (unsigned long param)
+{
+	struct usbnet		*dev = (struct usbnet *) param;
+
+	// from dev->delay; with FLAG_NAPI the work is done in usbnet_poll()
+	if (dev->driver_info->flags & FLAG_NAPI) {
+		napi_schedule(&dev->napi);
+		return;
+	}
+
+	if (__usbnet_bh(dev, INT_MAX) == INT_MAX)
+		tasklet_schedule (&dev->bh);
+}
+
+static int usbnet_poll (struct napi_struct *napi, int budget)
+{
+	struct usbnet		*dev = container_of(napi, struct usbnet, napi);
+	int			work;
+
+	work = __usbnet_bh(dev, budget);
+	if (work < budget) {
+		napi_complete(napi);
+		// completions that came in after we last looked
+		if (!skb_queue_empty(&dev->done))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
+
 
 /*-------------------------------------------------------------------------
  *
@@ -1304,6 +1762,7 @@ void usbnet_disconnect (struct usb_interface *intf)
 
 	usb_kill_urb(dev->interrupt);
 	usb_free_urb(dev->interrupt);
+	rx_pool_drain(dev);
 
 	free_netdev(net);
 	usb_put_dev (xdev);
@@ -1393,6 +1852,11 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	dev->delay.data = (unsigned long) dev;
 	init_timer (&dev->delay);
 	mutex_init (&dev->phy_mutex);
+	spin_lock_init(&dev->rx_pool.lock);
+	if (info->flags & FLAG_TX_BATCH)
+		usbnet_tx_batch_init(dev);
+	if (info->flags & FLAG_NAPI)
+		netif_napi_add(net, &dev->napi, usbnet_poll, NAPI_WEIGHT);
 
 	dev->net = net;
 	strcpy (net->name, "usb%d");
@@ -1570,7 +2034,7 @@ int usbnet_resume (struct usb_interface *intf)
 		if (test_bit(EVENT_DEV_OPEN, &dev->flags)) {
 			if (!(dev->txq.qlen >= TX_QLEN(dev)))
 				netif_tx_wake_all_queues(dev->net);
-			tasklet_schedule (&dev->bh);
+			usbnet_bh_schedule(dev);
 		}
 	}
 	return 0;
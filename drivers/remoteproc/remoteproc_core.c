@@ -465,6 +465,37 @@ exit:
 }
 EXPORT_SYMBOL(rproc_pa_to_da);
 
+/**
+ * rproc_find_carveout() - find a carveout by the name the firmware gave it
+ * @rproc: handle of a remote processor
+ * @name: name of the carveout
+ *
+ * Carveouts only exist while @rproc is powered up, so this is meant for
+ * users of a vdev, between find_vqs() and del_vqs().
+ *
+ * Returns the carveout, or NULL if the firmware did not ask for one named
+ * @name.
+ */
+struct rproc_mem_entry *rproc_find_carveout(struct rproc *rproc,
+					    const char *name)
+{
+	struct rproc_mem_entry *carveout, *found = NULL;
+
+	mutex_lock(&rproc->lock);
+
+	list_for_each_entry(carveout, &rproc->carveouts, node) {
+		if (!strcmp(carveout->name, name)) {
+			found = carveout;
+			break;
+		}
+	}
+
+	mutex_unlock(&rproc->lock);
+
+	return found;
+}
+EXPORT_SYMBOL(rproc_find_carveout);
+
 
 /**
  * rproc_load_segments() - load firmware segments to memory
@@ -1105,6 +1136,7 @@ static int rproc_handle_carveout(struct rproc *rproc,
 	carveout->len = rsc->len;
 	carveout->dma = dma;
 	carveout->da = rsc->da;
+	strncpy(carveout->name, rsc->name, sizeof(carveout->name) - 1);
 
 	list_add_tail(&carveout->node, &rproc->carveouts);
 
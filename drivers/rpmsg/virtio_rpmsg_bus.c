@@ -33,6 +33,8 @@
 #include <linux/wait.h>
 #include <linux/rpmsg.h>
 #include <linux/mutex.h>
+#include <linux/bitmap.h>
+#include <linux/remoteproc.h>
 
 int get_virtproc_id(struct virtproc_info *vrp)
 {
@@ -64,9 +66,9 @@ struct rpmsg_channel_info {
  *
  * This will require a total space of 256KB for the buffers.
  *
- * We might also want to add support for user-provided buffers in time.
- * This will allow bigger buffer size flexibility, and can also be used
- * to achieve zero-copy messaging.
+ * Bigger messages are passed by reference through a shared buffer pool,
+ * when the remote processor supports it (see struct rpmsg_ref). Senders
+ * can also fill a pool buffer in place to avoid copying altogether.
  *
  * Note that these numbers are purely a decision of this driver - we
  * can change this without changing anything in the firmware of the remote
@@ -86,6 +88,12 @@ struct rpmsg_channel_info {
 /* Address 53 is reserved for advertising remote services */
 #define RPMSG_NS_ADDR			(53)
 
+/* Address 54 is reserved for handing shared pool buffers back */
+#define RPMSG_POOL_ADDR			(54)
+
+/* Shared pool buffers are allocated in chunks of this size */
+#define RPMSG_POOL_CHUNK		(256)
+
 /* sysfs show configuration fields */
 #define rpmsg_show_attr(field, path, format_string)			\
 static ssize_t								\
@@ -552,6 +560,72 @@ static int __rpmsg_destroy_channel(struct virtproc_info *vrp,
 	return 0;
 }
 
+/* allocate a buffer from our half of the shared pool */
+static void *rpmsg_pool_alloc(struct virtproc_info *vrp, int len)
+{
+	int nr = DIV_ROUND_UP(len, RPMSG_POOL_CHUNK);
+	unsigned long i;
+	void *buf = NULL;
+
+	if (!vrp->pool_chunks || len <= 0)
+		return NULL;
+
+	spin_lock(&vrp->pool_lock);
+
+	i = bitmap_find_next_zero_area(vrp->pool_map, vrp->pool_chunks, 0,
+									nr, 0);
+	if (i + nr <= vrp->pool_chunks) {
+		bitmap_set(vrp->pool_map, i, nr);
+		vrp->pool_nr[i] = nr;
+		buf = vrp->pool_va + i * RPMSG_POOL_CHUNK;
+	}
+
+	spin_unlock(&vrp->pool_lock);
+
+	return buf;
+}
+
+static void rpmsg_pool_free(struct virtproc_info *vrp, void *buf)
+{
+	unsigned long offset = buf - vrp->pool_va;
+	unsigned long i = offset / RPMSG_POOL_CHUNK;
+
+	spin_lock(&vrp->pool_lock);
+
+	if (offset % RPMSG_POOL_CHUNK || i >= vrp->pool_chunks ||
+							!vrp->pool_nr[i]) {
+		spin_unlock(&vrp->pool_lock);
+		dev_err(&vrp->vdev->dev, "bad pool buffer %p\n", buf);
+		return;
+	}
+
+	bitmap_clear(vrp->pool_map, i, vrp->pool_nr[i]);
+	vrp->pool_nr[i] = 0;
+
+	spin_unlock(&vrp->pool_lock);
+
+	/* senders may be waiting for room in the pool */
+	wake_up_interruptible(&vrp->sendq);
+}
+
+/*
+ * translate a reference to a buffer in the remote processor's half of the
+ * pool (or in ours, if !remote) to a kernel address, NULL if it is bogus
+ */
+static void *rpmsg_pool_da_to_va(struct virtproc_info *vrp,
+				struct rpmsg_ref *ref, bool remote)
+{
+	u32 half = vrp->pool_len / 2;
+	u32 start = vrp->pool_da + (remote ? half : 0);
+	u32 offset = ref->da - start;
+
+	if (!vrp->pool_chunks || ref->da < start || ref->len > half ||
+						offset > half - ref->len)
+		return NULL;
+
+	return vrp->pool_va + (start - vrp->pool_da) + offset;
+}
+
 /* super simple buffer "allocator" that is just enough for now */
 static void *get_a_tx_buf(struct virtproc_info *vrp)
 {
@@ -666,11 +740,10 @@ static void rpmsg_downref_sleepers(struct virtproc_info *vrp)
  *
  * Returns 0 on success and an appropriate error value on failure.
  */
-int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
-					void *data, int len, bool wait)
+static int __rpmsg_send(struct virtproc_info *vrp, struct device *dev,
+			u32 src, u32 dst, void *data, int len, u16 flags,
+			bool wait)
 {
-	struct virtproc_info *vrp = rpdev->vrp;
-	struct device *dev = &rpdev->dev;
 	struct scatterlist sg;
 	struct rpmsg_hdr *msg;
 	int err;
@@ -683,12 +756,8 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 
 	/*
 	 * We currently use fixed-sized buffers, and therefore the payload
-	 * length is limited.
-	 *
-	 * One of the possible improvements here is either to support
-	 * user-provided buffers (and then we can also support zero-copy
-	 * messaging), or to improve the buffer allocator, to support
-	 * variable-length buffer sizes.
+	 * length is limited. Bigger payloads go through the shared pool,
+	 * see rpmsg_send_offchannel_raw().
 	 */
 	if (len > RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr)) {
 		dev_err(dev, "message is too big (%d)\n", len);
@@ -726,7 +795,7 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 	}
 
 	msg->len = len;
-	msg->flags = 0;
+	msg->flags = flags;
 	msg->src = src;
 	msg->dst = dst;
 	msg->reserved = 0;
@@ -764,18 +833,193 @@ out:
 	mutex_unlock(&vrp->tx_lock);
 	return err;
 }
+
+int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+					void *data, int len, bool wait)
+{
+	struct virtproc_info *vrp = rpdev->vrp;
+	void *buf;
+	int err;
+
+	if (len <= RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr) ||
+							!vrp->pool_chunks)
+		return __rpmsg_send(vrp, &rpdev->dev, src, dst, data, len, 0,
+									wait);
+
+	/* waiting would not help if it can never fit in our half */
+	if (len > vrp->pool_chunks * RPMSG_POOL_CHUNK) {
+		dev_err(&rpdev->dev, "message is too big (%d)\n", len);
+		return -EMSGSIZE;
+	}
+
+	/* too big for an rpmsg buffer: pass it through the shared pool */
+	buf = rpmsg_pool_alloc(vrp, len);
+	if (!buf && !wait)
+		return -ENOMEM;
+
+	if (!buf) {
+		err = wait_event_interruptible_timeout(vrp->sendq,
+					(buf = rpmsg_pool_alloc(vrp, len)),
+					msecs_to_jiffies(15000));
+		if (!err) {
+			dev_err(&rpdev->dev, "timeout waiting for pool room\n");
+			return -ERESTARTSYS;
+		}
+		if (err < 0)
+			return err;
+	}
+
+	memcpy(buf, data, len);
+
+	err = rpmsg_send_buf_offchannel_raw(rpdev, src, dst, buf, len, wait);
+	if (err)
+		rpmsg_pool_free(vrp, buf);
+
+	return err;
+}
 EXPORT_SYMBOL(rpmsg_send_offchannel_raw);
 
+/**
+ * rpmsg_alloc_buf() - allocate a buffer from the shared pool
+ * @rpdev: the rpmsg channel
+ * @len: size of the buffer
+ *
+ * The buffer can be filled in place and then passed to the remote processor
+ * with rpmsg_send_buf(), which saves copying the payload.
+ *
+ * Returns NULL if the remote processor has no shared pool or there is no
+ * room in it right now, in which case callers should use rpmsg_send().
+ */
+void *rpmsg_alloc_buf(struct rpmsg_channel *rpdev, int len)
+{
+	return rpmsg_pool_alloc(rpdev->vrp, len);
+}
+EXPORT_SYMBOL(rpmsg_alloc_buf);
+
+/**
+ * rpmsg_free_buf() - free a shared pool buffer that was not sent
+ * @rpdev: the rpmsg channel
+ * @buf: buffer returned by rpmsg_alloc_buf()
+ */
+void rpmsg_free_buf(struct rpmsg_channel *rpdev, void *buf)
+{
+	rpmsg_pool_free(rpdev->vrp, buf);
+}
+EXPORT_SYMBOL(rpmsg_free_buf);
+
+/**
+ * rpmsg_send_buf_offchannel_raw() - pass a shared pool buffer by reference
+ * @rpdev: the rpmsg channel
+ * @src: source address
+ * @dst: destination address
+ * @buf: buffer returned by rpmsg_alloc_buf()
+ * @len: length of payload
+ * @wait: indicates whether caller should block in case no TX buffers available
+ *
+ * Sends a struct rpmsg_ref to @buf instead of the payload itself; the
+ * remote processor hands @buf back to the pool once it is done with it.
+ *
+ * Returns 0 on success, after which @buf belongs to the remote processor,
+ * and an appropriate error value on failure.
+ */
+int rpmsg_send_buf_offchannel_raw(struct rpmsg_channel *rpdev, u32 src,
+				u32 dst, void *buf, int len, bool wait)
+{
+	struct virtproc_info *vrp = rpdev->vrp;
+	struct rpmsg_ref ref;
+	u64 da;
+	int err;
+
+	if (!vrp->pool_chunks || len <= 0 ||
+			buf < vrp->pool_va || buf + len > vrp->pool_va +
+					vrp->pool_chunks * RPMSG_POOL_CHUNK)
+		return -EINVAL;
+
+	err = rproc_pa_to_da(vdev_to_rproc(vrp->vdev),
+				vrp->pool_dma + (buf - vrp->pool_va), &da);
+	if (err) {
+		dev_err(&rpdev->dev, "can't translate pool buffer: %d\n", err);
+		return err;
+	}
+
+	ref.da = da;
+	ref.len = len;
+
+	return __rpmsg_send(vrp, &rpdev->dev, src, dst, &ref, sizeof(ref),
+							RPMSG_HDR_REF, wait);
+}
+EXPORT_SYMBOL(rpmsg_send_buf_offchannel_raw);
+
+/*
+ * give an rx buffer back to the remote processor's virtqueue.  Called with
+ * rx_lock held.
+ */
+static int rpmsg_recycle_rx_buf(struct virtproc_info *vrp,
+						struct rpmsg_hdr *msg)
+{
+	struct scatterlist sg;
+	int err;
+
+	/* publish the real size of the buffer */
+	sg_init_one(&sg, msg, RPMSG_BUF_SIZE);
+
+	/* add the buffer back to the remote processor's virtqueue */
+	err = virtqueue_add_buf(vrp->rvq, &sg, 0, 1, msg, GFP_KERNEL);
+	if (err < 0) {
+		dev_err(&vrp->vdev->dev,
+				"failed to add a virtqueue buffer: %d\n", err);
+		return err;
+	}
+
+	/* tell the remote processor we added another available rx buffer */
+	virtqueue_kick(vrp->rvq);
+
+	return 0;
+}
+
+/*
+ * hand back the remote processor's pool buffers referenced by the rx
+ * buffers on vrp->pool_ret, for as long as there are tx buffers to do it
+ * with, and recycle those rx buffers.  Called with rx_lock held.
+ */
+static void rpmsg_pool_ret_flush(struct virtproc_info *vrp)
+{
+	struct device *dev = &vrp->vdev->dev;
+	struct rpmsg_hdr *msg;
+	int err;
+
+	while (vrp->pool_ret_tail != vrp->pool_ret_head) {
+		msg = vrp->pool_ret[vrp->pool_ret_tail % (RPMSG_NUM_BUFS / 2)];
+
+		err = __rpmsg_send(vrp, dev, RPMSG_POOL_ADDR, RPMSG_POOL_ADDR,
+				msg->data, sizeof(struct rpmsg_ref), 0, false);
+		/* no tx buffer yet, rpmsg_pool_ret_work() will try again */
+		if (err == -ENOMEM)
+			return;
+		if (err)
+			dev_err(dev, "failed to hand back pool buffer: %d\n",
+									err);
+
+		vrp->pool_ret_tail++;
+		rpmsg_recycle_rx_buf(vrp, msg);
+
+		/* no more tx-complete interrupts needed on our behalf */
+		if (vrp->pool_ret_tail == vrp->pool_ret_head)
+			rpmsg_downref_sleepers(vrp);
+	}
+}
+
 /* called when an rx buffer is used, and it's time to digest a message */
 static void rpmsg_recv_done(struct virtqueue *rvq)
 {
 	struct rpmsg_hdr *msg;
 	unsigned int len;
 	struct rpmsg_endpoint *ept;
-	struct scatterlist sg;
 	struct virtproc_info *vrp = rvq->vdev->priv;
 	struct device *dev = &rvq->vdev->dev;
-	int err;
+	struct rpmsg_ref ref;
+	void *data;
+	int len_data;
 
 	mutex_lock(&vrp->rx_lock);
 	msg = virtqueue_get_buf(rvq, &len);
@@ -804,10 +1048,26 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 		return;
 	}
 
+	data = msg->data;
+	len_data = msg->len;
+
+	/* the payload of a by-reference msg is in the shared pool */
+	if (msg->flags & RPMSG_HDR_REF) {
+		if (msg->len == sizeof(ref)) {
+			memcpy(&ref, msg->data, sizeof(ref));
+			data = rpmsg_pool_da_to_va(vrp, &ref, true);
+			len_data = ref.len;
+		} else
+			data = NULL;
+
+		if (!data)
+			dev_warn(dev, "bad pool reference, msg dropped\n");
+	}
+
 	/* use the dst addr to fetch the callback of the appropriate user */
 	mutex_lock(&vrp->endpoints_lock);
 
-	ept = idr_find(&vrp->endpoints, msg->dst);
+	ept = data ? idr_find(&vrp->endpoints, msg->dst) : NULL;
 
 	/* let's make sure no one deallocates ept while we use it */
 	if (ept)
@@ -820,29 +1080,44 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 		mutex_lock(&ept->cb_lock);
 
 		if (ept->cb)
-			ept->cb(ept->rpdev, msg->data, msg->len, ept->priv,
+			ept->cb(ept->rpdev, data, len_data, ept->priv,
 				msg->src);
 
 		mutex_unlock(&ept->cb_lock);
 
 		/* farewell, ept, we don't need you anymore */
 		kref_put(&ept->refcount, __ept_release);
-	} else
+	} else if (data)
 		dev_warn(dev, "msg received with no recepient\n");
 
-	/* publish the real size of the buffer */
-	sg_init_one(&sg, msg, RPMSG_BUF_SIZE);
+	/*
+	 * The payload is consumed, hand the pool buffer back.  The rx buffer
+	 * still holds the ref, so it is queued (and kept from the remote
+	 * processor) until that is done.  The TX ring may well be full under
+	 * the bulk traffic the pool is for, so tx-complete interrupts are
+	 * enabled while the queue is not empty, and the first try is made
+	 * only after that so a completion cannot slip by unnoticed.
+	 */
+	if (data && msg->flags & RPMSG_HDR_REF) {
+		if (vrp->pool_ret_tail == vrp->pool_ret_head)
+			rpmsg_upref_sleepers(vrp);
+		vrp->pool_ret[vrp->pool_ret_head++ % (RPMSG_NUM_BUFS / 2)] =
+									msg;
+		rpmsg_pool_ret_flush(vrp);
+	} else
+		rpmsg_recycle_rx_buf(vrp, msg);
 
-	/* add the buffer back to the remote processor's virtqueue */
-	err = virtqueue_add_buf(vrp->rvq, &sg, 0, 1, msg, GFP_KERNEL);
-	if (err < 0) {
-		mutex_unlock(&vrp->rx_lock);
-		dev_err(dev, "failed to add a virtqueue buffer: %d\n", err);
-		return;
-	}
+	mutex_unlock(&vrp->rx_lock);
+}
 
-	/* tell the remote processor we added another available rx buffer */
-	virtqueue_kick(vrp->rvq);
+/* retry handing back pool buffers, see rpmsg_recv_done() */
+static void rpmsg_pool_ret_work(struct work_struct *work)
+{
+	struct virtproc_info *vrp = container_of(work, struct virtproc_info,
+							pool_ret_work);
+
+	mutex_lock(&vrp->rx_lock);
+	rpmsg_pool_ret_flush(vrp);
 	mutex_unlock(&vrp->rx_lock);
 }
 
@@ -861,6 +1136,96 @@ static void rpmsg_xmit_done(struct virtqueue *svq)
 
 	/* wake up potential senders that are waiting for a tx buffer */
 	wake_up_interruptible(&vrp->sendq);
+
+	/*
+	 * The hand-backs need rx_lock, which an endpoint callback may be
+	 * holding while it waits on sendq for the very buffer that has
+	 * just been freed, so don't take it here.
+	 */
+	if (vrp->pool_ret)
+		schedule_work(&vrp->pool_ret_work);
+}
+
+/* invoked when the remote processor hands back one of our pool buffers */
+static void rpmsg_pool_cb(struct rpmsg_channel *rpdev, void *data, int len,
+							void *priv, u32 src)
+{
+	struct virtproc_info *vrp = priv;
+	struct device *dev = &vrp->vdev->dev;
+	struct rpmsg_ref *ref = data;
+	void *buf;
+
+	if (len != sizeof(*ref)) {
+		dev_err(dev, "malformed pool msg (%d)\n", len);
+		return;
+	}
+
+	buf = rpmsg_pool_da_to_va(vrp, ref, false);
+	if (!buf) {
+		dev_err(dev, "bad pool reference 0x%x\n", ref->da);
+		return;
+	}
+
+	rpmsg_pool_free(vrp, buf);
+}
+
+/*
+ * set up the shared buffer pool, if the remote processor supports it and
+ * its firmware asked for the carveout
+ */
+static int rpmsg_pool_init(struct virtproc_info *vrp)
+{
+	struct virtio_device *vdev = vrp->vdev;
+	struct rproc_mem_entry *carveout;
+	int chunks;
+
+	if (!virtio_has_feature(vdev, VIRTIO_RPMSG_F_ZC))
+		return 0;
+
+	carveout = rproc_find_carveout(vdev_to_rproc(vdev), RPMSG_POOL_NAME);
+	if (!carveout) {
+		dev_warn(&vdev->dev, "no %s carveout, copying all msgs\n",
+							RPMSG_POOL_NAME);
+		return 0;
+	}
+
+	chunks = carveout->len / 2 / RPMSG_POOL_CHUNK;
+	if (!chunks)
+		return 0;
+
+	vrp->pool_map = kcalloc(BITS_TO_LONGS(chunks),
+				sizeof(*vrp->pool_map), GFP_KERNEL);
+	vrp->pool_nr = kcalloc(chunks, sizeof(*vrp->pool_nr), GFP_KERNEL);
+	/* each pending hand-back holds one of our rx buffers */
+	vrp->pool_ret = kcalloc(RPMSG_NUM_BUFS / 2, sizeof(*vrp->pool_ret),
+								GFP_KERNEL);
+	if (!vrp->pool_map || !vrp->pool_nr || !vrp->pool_ret)
+		goto free_pool;
+
+	vrp->pool_va = carveout->va;
+	vrp->pool_dma = carveout->dma;
+	vrp->pool_da = carveout->da;
+	vrp->pool_len = carveout->len;
+
+	/* a dedicated endpoint takes back the buffers we sent */
+	vrp->pool_ept = __rpmsg_create_ept(vrp, NULL, rpmsg_pool_cb, vrp,
+							RPMSG_POOL_ADDR);
+	if (!vrp->pool_ept)
+		goto free_pool;
+
+	vrp->pool_chunks = chunks;
+
+	dev_info(&vdev->dev, "shared pool: %d bytes at da 0x%x\n",
+					vrp->pool_len, vrp->pool_da);
+
+	return 0;
+
+free_pool:
+	kfree(vrp->pool_ret);
+	kfree(vrp->pool_nr);
+	kfree(vrp->pool_map);
+	vrp->pool_ret = NULL;
+	return -ENOMEM;
 }
 
 struct rpmsg_channel *rpmsg_create_channel(int vrp_id, const char *name,
@@ -956,7 +1321,9 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	mutex_init(&vrp->endpoints_lock);
 	mutex_init(&vrp->tx_lock);
 	mutex_init(&vrp->rx_lock);
+	spin_lock_init(&vrp->pool_lock);
 	init_waitqueue_head(&vrp->sendq);
+	INIT_WORK(&vrp->pool_ret_work, rpmsg_pool_ret_work);
 
 	if (!idr_pre_get(&vprocs, GFP_KERNEL))
 		goto free_vrp;
@@ -1015,6 +1382,12 @@ static int rpmsg_probe(struct virtio_device *vdev)
 
 	vdev->priv = vrp;
 
+	err = rpmsg_pool_init(vrp);
+	if (err) {
+		dev_err(&vdev->dev, "failed to set up the shared pool\n");
+		goto free_coherent;
+	}
+
 	/* if supported by the remote processor, enable the name service */
 	if (virtio_has_feature(vdev, VIRTIO_RPMSG_F_NS)) {
 		/* a dedicated endpoint handles the name service msgs */
@@ -1023,7 +1396,7 @@ static int rpmsg_probe(struct virtio_device *vdev)
 		if (!vrp->ns_ept) {
 			dev_err(&vdev->dev, "failed to create the ns ept\n");
 			err = -ENOMEM;
-			goto free_coherent;
+			goto free_pool;
 		}
 	}
 
@@ -1034,10 +1407,18 @@ static int rpmsg_probe(struct virtio_device *vdev)
 
 	return 0;
 
+free_pool:
+	if (vrp->pool_ept) {
+		__rpmsg_destroy_ept(vrp, vrp->pool_ept);
+		kfree(vrp->pool_ret);
+		kfree(vrp->pool_nr);
+		kfree(vrp->pool_map);
+	}
 free_coherent:
 	dma_free_coherent(vdev->dev.parent->parent, RPMSG_TOTAL_BUF_SPACE,
 					 bufs_va, vrp->bufs_dma);
 vqs_del:
+	cancel_work_sync(&vrp->pool_ret_work);
 	vdev->config->del_vqs(vrp->vdev);
 rem_idr:
 	mutex_lock(&vprocs_mutex);
@@ -1069,11 +1450,20 @@ static void __devexit rpmsg_remove(struct virtio_device *vdev)
 	if (vrp->ns_ept)
 		__rpmsg_destroy_ept(vrp, vrp->ns_ept);
 
+	if (vrp->pool_ept)
+		__rpmsg_destroy_ept(vrp, vrp->pool_ept);
+
 	idr_remove_all(&vrp->endpoints);
 	idr_destroy(&vrp->endpoints);
 
+	cancel_work_sync(&vrp->pool_ret_work);
 	vdev->config->del_vqs(vrp->vdev);
 
+	/* the pool carveout is gone with the remote processor */
+	kfree(vrp->pool_ret);
+	kfree(vrp->pool_nr);
+	kfree(vrp->pool_map);
+
 	dma_free_coherent(vdev->dev.parent->parent, RPMSG_TOTAL_BUF_SPACE,
 					vrp->rbufs, vrp->bufs_dma);
 
@@ -1091,6 +1481,7 @@ static struct virtio_device_id id_table[] = {
 
 static unsigned int features[] = {
 	VIRTIO_RPMSG_F_NS,
+	VIRTIO_RPMSG_F_ZC,
 };
 
 static struct virtio_driver virtio_ipc_driver = {
@@ -25,16 +25,47 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+/*
+ * struct logger_stage - a per-CPU staging ring in front of a log
+ *
+ * Writers append whole entries to the ring of the CPU they run on with
+ * preemption disabled, so every ring has a single producer and needs no lock.
+ * Entries are moved into the log proper, in order of their log->seq stamp, by
+ * whoever next takes log->mutex.  'head' is only advanced by the producer and
+ * 'tail' only by the consumer; both are free running and masked on access
+ * (see Documentation/circular-buffers.txt).
+ */
+struct logger_stage {
+	unsigned char		*buffer;/* LOGGER_STAGE_SIZE bytes */
+	size_t			head;	/* producer's write offset */
+	size_t			tail;	/* consumer's read offset */
+	size_t			end;	/* consumer's snapshot of head */
+};
+
+/*
+ * struct logger_stage_hdr - what precedes each payload in a staging ring: the
+ * entry's log->seq stamp, which is not copied to the log, and its header
+ */
+struct logger_stage_hdr {
+	u32			seq;	/* order of the write across CPUs */
+	struct logger_entry	entry;	/* header copied to the log */
+};
+
+/* per-CPU staging size, a power of two holding at least one full entry */
+#define LOGGER_STAGE_SIZE	(16 * 1024)
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
  * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * mutex 'mutex', except for the per-CPU staging rings.
  */
 struct logger_log {
 	unsigned char		*buffer;/* the ring buffer itself */
@@ -45,6 +76,8 @@ struct logger_log {
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
+	struct logger_stage __percpu *stage; /* lockless write staging */
+	atomic_t		seq;	/* number of the next staged entry */
 };
 
 /*
@@ -239,6 +272,8 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
 	return off;
 }
 
+static void logger_drain(struct logger_log *log);
+
 /*
  * logger_read - our log's read() method
  *
@@ -265,6 +300,7 @@ start:
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
+		logger_drain(log);
 		ret = (log->w_off == reader->r_off);
 		mutex_unlock(&log->mutex);
 		if (!ret)
@@ -439,35 +475,235 @@ static ssize_t do_write_log_from_user(struct logger_log *log,
 }
 
 /*
- * logger_aio_write - our write method, implementing support for write(),
- * writev(), and aio_write(). Writes are our fast path, and we try to optimize
- * them above all else.
+ * stage_read - copies 'count' bytes at offset 'off' of the staging ring
+ * 'stage' into 'buf'
  */
-ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
-			 unsigned long nr_segs, loff_t ppos)
+static void stage_read(struct logger_stage *stage, size_t off, void *buf,
+		       size_t count)
 {
-	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
-	struct logger_entry header;
-	struct timespec now;
-	ssize_t ret = 0;
+	size_t start = off & (LOGGER_STAGE_SIZE - 1);
+	size_t len = min(count, LOGGER_STAGE_SIZE - start);
 
-	now = current_kernel_time();
+	memcpy(buf, stage->buffer + start, len);
+	if (count != len)
+		memcpy(buf + len, stage->buffer, count - len);
+}
 
-	header.pid = current->tgid;
-	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
-	header.euid = current_euid();
-	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
-	header.hdr_size = sizeof(struct logger_entry);
+/*
+ * stage_write - copies 'count' bytes from 'buf' to offset 'off' of the
+ * staging ring 'stage'
+ */
+static void stage_write(struct logger_stage *stage, size_t off,
+			const void *buf, size_t count)
+{
+	size_t start = off & (LOGGER_STAGE_SIZE - 1);
+	size_t len = min(count, LOGGER_STAGE_SIZE - start);
 
-	/* null writes succeed, return zero */
-	if (unlikely(!header.len))
-		return 0;
+	memcpy(stage->buffer + start, buf, len);
+	if (count != len)
+		memcpy(stage->buffer, buf + len, count - len);
+}
+
+/*
+ * stage_write_from_user - copies 'count' bytes from the user-space buffer
+ * 'buf' to offset 'off' of the staging ring 'stage' without sleeping
+ *
+ * The caller must have disabled page faults.  Returns nonzero if any part
+ * of 'buf' was not resident.
+ */
+static int stage_write_from_user(struct logger_stage *stage, size_t off,
+				 const void __user *buf, size_t count)
+{
+	size_t start = off & (LOGGER_STAGE_SIZE - 1);
+	size_t len = min(count, LOGGER_STAGE_SIZE - start);
+
+	if (!access_ok(VERIFY_READ, buf, count))
+		return -EFAULT;
+	if (__copy_from_user_inatomic(stage->buffer + start, buf, len))
+		return -EFAULT;
+	if (count != len &&
+	    __copy_from_user_inatomic(stage->buffer, buf + len, count - len))
+		return -EFAULT;
+	return 0;
+}
+
+/*
+ * do_write_log_from_stage - moves the 'count' bytes at offset 'off' of the
+ * staging ring 'stage' to 'log'
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void do_write_log_from_stage(struct logger_log *log,
+				    struct logger_stage *stage,
+				    size_t off, size_t count)
+{
+	size_t start = off & (LOGGER_STAGE_SIZE - 1);
+	size_t len = min(count, LOGGER_STAGE_SIZE - start);
+
+	do_write_log(log, stage->buffer + start, len);
+	if (count != len)
+		do_write_log(log, stage->buffer, count - len);
+}
+
+static inline bool seq_before(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+/*
+ * logger_drain - moves every entry staged so far on any CPU into 'log',
+ * merging them in the order their writes took a log->seq number.  The
+ * timestamps cannot be used for this: they have tick granularity, and a task
+ * that migrates within a tick would have its entries reordered.
+ *
+ * Only entries numbered before a snapshot of log->seq taken up front are
+ * moved.  A writer takes its number only after its previous staged write is
+ * published, so all of a task's earlier entries are then visible too, on
+ * whatever CPU they were staged.  Later entries are left for the next caller,
+ * whom their writers wake, so a steady stream of writers cannot keep us here
+ * forever either.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_drain(struct logger_log *log)
+{
+	struct logger_stage *stage, *oldest;
+	struct logger_stage_hdr hdr, oldest_hdr;
+	size_t count;
+	u32 limit;
+	int cpu;
+
+	if (!log->stage)
+		return;
+
+	limit = atomic_read(&log->seq);
+	/* pairs with the barrier in the writer's atomic_inc_return() */
+	smp_rmb();
+
+	for_each_possible_cpu(cpu) {
+		stage = per_cpu_ptr(log->stage, cpu);
+		stage->end = ACCESS_ONCE(stage->head);
+	}
+	/* read the entries only after seeing the heads that publish them */
+	smp_rmb();
+
+	for (;;) {
+		oldest = NULL;
+		for_each_possible_cpu(cpu) {
+			stage = per_cpu_ptr(log->stage, cpu);
+			if (stage->tail == stage->end)
+				continue;
+			stage_read(stage, stage->tail, &hdr, sizeof(hdr));
+			if (oldest && !seq_before(hdr.seq, oldest_hdr.seq))
+				continue;
+			oldest = stage;
+			oldest_hdr = hdr;
+		}
+		if (!oldest || !seq_before(oldest_hdr.seq, limit))
+			break;
+
+		count = sizeof(struct logger_entry) + oldest_hdr.entry.len;
+		fix_up_readers(log, count);
+		do_write_log_from_stage(log, oldest,
+					oldest->tail + sizeof(u32), count);
+
+		/* finish reading the entry before the producer may reuse it */
+		smp_mb();
+		oldest->tail += sizeof(u32) + count;
+	}
+}
+
+static void logger_fill_header(struct logger_entry *header, size_t len)
+{
+	struct timespec now = current_kernel_time();
+
+	header->pid = current->tgid;
+	header->tid = current->pid;
+	header->sec = now.tv_sec;
+	header->nsec = now.tv_nsec;
+	header->euid = current_euid();
+	header->len = len;
+	header->hdr_size = sizeof(struct logger_entry);
+}
+
+/*
+ * logger_stage_write - writes an entry with a 'count' byte payload taken
+ * from 'iov' to this CPU's staging ring, without taking any lock
+ *
+ * Returns 'count' on success.  If the ring is full or the payload is not
+ * resident, nothing is written and a negative error code is returned; the
+ * caller then falls back to logger_write_locked().
+ */
+static ssize_t logger_stage_write(struct logger_log *log,
+				  const struct iovec *iov,
+				  unsigned long nr_segs, size_t count)
+{
+	struct logger_stage *stage;
+	struct logger_stage_hdr hdr;
+	size_t done = 0;
+	size_t off;
+	ssize_t ret = -ENOSPC;
+
+	stage = get_cpu_ptr(log->stage);
+	if (LOGGER_STAGE_SIZE - (stage->head - ACCESS_ONCE(stage->tail)) <
+	    sizeof(hdr) + count)
+		goto out;
+
+	off = stage->head + sizeof(hdr);
+
+	pagefault_disable();
+	while (nr_segs-- > 0 && done < count) {
+		size_t len = min_t(size_t, iov->iov_len, count - done);
+
+		if (stage_write_from_user(stage, off, iov->iov_base, len))
+			break;
+		off += len;
+		done += len;
+		iov++;
+	}
+	pagefault_enable();
+
+	if (done != count) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	/*
+	 * atomic_inc_return() implies a full barrier, so the entry this task
+	 * staged last is published before anything numbered after it.
+	 */
+	hdr.seq = atomic_inc_return(&log->seq) - 1;
+	logger_fill_header(&hdr.entry, count);
+	stage_write(stage, stage->head, &hdr, sizeof(hdr));
+	/* publish the entry only once it is complete */
+	smp_wmb();
+	stage->head = off;
+	ret = count;
+out:
+	put_cpu_ptr(log->stage);
+	return ret;
+}
+
+/*
+ * logger_write_locked - writes an entry with a 'count' byte payload taken
+ * from 'iov' straight into 'log', after anything still staged
+ *
+ * Returns 'count' on success, negative error code on failure.
+ */
+static ssize_t logger_write_locked(struct logger_log *log,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, size_t count)
+{
+	size_t orig;
+	struct logger_entry header;
+	ssize_t ret = 0;
 
 	mutex_lock(&log->mutex);
 
+	logger_drain(log);
+	orig = log->w_off;
+	logger_fill_header(&header, count);
+
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
 	 * entry after (what will be) the new write offset. We do this now
@@ -499,8 +735,41 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 
 	mutex_unlock(&log->mutex);
 
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	return ret;
+}
+
+/*
+ * logger_aio_write - our write method, implementing support for write(),
+ * writev(), and aio_write(). Writes are our fast path, and we try to optimize
+ * them above all else: the common case copies the entry once, into a per-CPU
+ * staging ring, without taking log->mutex.
+ */
+ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
+			 unsigned long nr_segs, loff_t ppos)
+{
+	struct logger_log *log = file_get_log(iocb->ki_filp);
+	size_t len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
+	ssize_t ret = -ENOSPC;
+
+	/* null writes succeed, return zero */
+	if (unlikely(!len))
+		return 0;
+
+	if (log->stage)
+		ret = logger_stage_write(log, iov, nr_segs, len);
+	if (ret < 0)
+		ret = logger_write_locked(log, iov, nr_segs, len);
+	if (ret < 0)
+		return ret;
+
+	/*
+	 * Wake up any blocked readers.  Pairs with the barrier in
+	 * prepare_to_wait(), so a reader either sees the new entry or is
+	 * already on the wait queue.
+	 */
+	smp_mb();
+	if (waitqueue_active(&log->wq))
+		wake_up_interruptible(&log->wq);
 
 	return ret;
 }
@@ -540,6 +809,7 @@ static int logger_open(struct inode *inode, struct file *file)
 		INIT_LIST_HEAD(&reader->list);
 
 		mutex_lock(&log->mutex);
+		logger_drain(log);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
 		mutex_unlock(&log->mutex);
@@ -596,6 +866,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
+	logger_drain(log);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
@@ -628,6 +899,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	void __user *argp = (void __user *) arg;
 
 	mutex_lock(&log->mutex);
+	logger_drain(log);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -746,10 +1018,45 @@ static struct logger_log *get_log_from_minor(int minor)
 	return NULL;
 }
 
+/*
+ * init_log_stage - sets up the per-CPU staging rings of 'log'.  On failure
+ * the log still works, with every write taking log->mutex.
+ */
+static void __init init_log_stage(struct logger_log *log)
+{
+	struct logger_stage __percpu *stage;
+	int cpu;
+
+	stage = alloc_percpu(struct logger_stage);
+	if (!stage)
+		goto err;
+
+	for_each_possible_cpu(cpu) {
+		struct logger_stage *s = per_cpu_ptr(stage, cpu);
+
+		s->buffer = kmalloc(LOGGER_STAGE_SIZE, GFP_KERNEL);
+		if (!s->buffer)
+			goto err_free;
+	}
+
+	log->stage = stage;
+	return;
+
+err_free:
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(stage, cpu)->buffer);
+	free_percpu(stage);
+err:
+	printk(KERN_WARNING "logger: no write staging for log '%s'\n",
+	       log->misc.name);
+}
+
 static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+	init_log_stage(log);
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
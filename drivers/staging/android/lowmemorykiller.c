@@ -37,6 +37,12 @@
 #include <linux/sched.h>
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <linux/bitmap.h>
+#include <linux/ktime.h>
+
+#define CREATE_TRACE_POINTS
+#include "trace/lowmemorykiller.h"
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -55,6 +61,7 @@ static int lowmem_minfree[6] = {
 static int lowmem_minfree_size = 4;
 
 static unsigned long lowmem_deathpending_timeout;
+static struct task_struct *lowmem_victim;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -62,16 +69,132 @@ static unsigned long lowmem_deathpending_timeout;
 			printk(x);			\
 	} while (0)
 
+/*
+ * Every thread group is kept on a list indexed by its oom_score_adj, with a
+ * bitmap of the non-empty lists, so the shrinker only has to look at the
+ * processes in the highest populated bucket instead of walking the whole
+ * task list.  The index is maintained from fork, exit and the oom_score_adj
+ * writers.  lowmem_adj_lock nests inside tasklist_lock and outside
+ * task_lock; it is never taken under a sighand lock.
+ */
+#define LOWMEM_ADJ_BUCKETS	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+
+static DEFINE_SPINLOCK(lowmem_adj_lock);
+static struct list_head lowmem_adj_buckets[LOWMEM_ADJ_BUCKETS];
+static DECLARE_BITMAP(lowmem_adj_map, LOWMEM_ADJ_BUCKETS);
+static bool lowmem_adj_index_ready;
+
+static void lowmem_adj_link(struct signal_struct *sig)
+{
+	int bucket = sig->oom_score_adj - OOM_SCORE_ADJ_MIN;
+
+	sig->lowmem_adj = sig->oom_score_adj;
+	list_add_tail(&sig->lowmem_adj_node, &lowmem_adj_buckets[bucket]);
+	__set_bit(bucket, lowmem_adj_map);
+}
+
+static void lowmem_adj_unlink(struct signal_struct *sig)
+{
+	int bucket = sig->lowmem_adj - OOM_SCORE_ADJ_MIN;
+
+	list_del_init(&sig->lowmem_adj_node);
+	if (list_empty(&lowmem_adj_buckets[bucket]))
+		__clear_bit(bucket, lowmem_adj_map);
+}
+
+/* Called from copy_process() with tasklist_lock held for writing. */
+void lowmem_adj_index_add(struct signal_struct *sig)
+{
+	unsigned long flags;
+
+	INIT_LIST_HEAD(&sig->lowmem_adj_node);
+	if (!lowmem_adj_index_ready)
+		return;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	lowmem_adj_link(sig);
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+/* Called from __exit_signal() with tasklist_lock held for writing. */
+void lowmem_adj_index_del(struct signal_struct *sig)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (!list_empty(&sig->lowmem_adj_node))
+		lowmem_adj_unlink(sig);
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+void lowmem_adj_index_update(struct signal_struct *sig)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (!list_empty(&sig->lowmem_adj_node) &&
+	    sig->lowmem_adj != sig->oom_score_adj) {
+		lowmem_adj_unlink(sig);
+		lowmem_adj_link(sig);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+/* Highest populated oom_score_adj below @adj, or OOM_SCORE_ADJ_MIN - 1. */
+static int lowmem_adj_prev(int adj)
+{
+	int bucket = adj - OOM_SCORE_ADJ_MIN;
+	int prev;
+
+	if (bucket <= 0)
+		return OOM_SCORE_ADJ_MIN - 1;
+	prev = find_last_bit(lowmem_adj_map, bucket);
+	if (prev >= bucket)
+		return OOM_SCORE_ADJ_MIN - 1;
+	return prev + OOM_SCORE_ADJ_MIN;
+}
+
+/*
+ * The last process we killed may sit below the buckets we are about to
+ * scan, e.g. once min_score_adj has gone back up, so check it directly:
+ * until it has let go of its mm, or the timeout runs out, killing anything
+ * else would only add to the memory that is already on its way back.
+ * Called with lowmem_adj_lock held.
+ */
+static bool lowmem_victim_pending(void)
+{
+	bool pending = false;
+
+	if (!lowmem_victim)
+		return false;
+
+	if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+		task_lock(lowmem_victim);
+		pending = lowmem_victim->mm != NULL;
+		task_unlock(lowmem_victim);
+	}
+	if (!pending) {
+		put_task_struct(lowmem_victim);
+		lowmem_victim = NULL;
+	}
+	return pending;
+}
+
 static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
-	struct task_struct *tsk;
+	struct signal_struct *sig;
 	struct task_struct *selected = NULL;
 	int rem = 0;
 	int tasksize;
 	int i;
+	int adj;
 	int min_score_adj = OOM_SCORE_ADJ_MAX + 1;
 	int selected_tasksize = 0;
 	int selected_oom_score_adj;
+	int buckets = 0;
+	int scanned = 0;
+	unsigned long flags;
+	ktime_t start;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free = global_page_state(NR_FREE_PAGES);
 	int other_file = global_page_state(NR_FILE_PAGES) -
@@ -103,51 +226,65 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	}
 	selected_oom_score_adj = min_score_adj;
 
+	start = ktime_get();
 	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		int oom_score_adj;
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (lowmem_victim_pending()) {
+		spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+		rcu_read_unlock();
+		return 0;
+	}
+	for (adj = lowmem_adj_prev(OOM_SCORE_ADJ_MAX + 1);
+	     adj >= min_score_adj && !selected; adj = lowmem_adj_prev(adj)) {
+		buckets++;
+		list_for_each_entry(sig,
+				    &lowmem_adj_buckets[adj - OOM_SCORE_ADJ_MIN],
+				    lowmem_adj_node) {
+			struct task_struct *tsk = sig->curr_target;
+			struct task_struct *p;
 
-		if (tsk->flags & PF_KTHREAD)
-			continue;
+			scanned++;
+			if (tsk->flags & PF_KTHREAD)
+				continue;
 
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+			p = find_lock_task_mm(tsk);
+			if (!p)
+				continue;
 
-		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
-		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			task_unlock(p);
-			rcu_read_unlock();
-			return 0;
-		}
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
+			/* e.g. a task the OOM killer has picked */
+			if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
+			    time_before_eq(jiffies,
+					   lowmem_deathpending_timeout)) {
+				task_unlock(p);
+				spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+				rcu_read_unlock();
+				return 0;
+			}
+			tasksize = get_mm_rss(p->mm);
 			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
+			if (tasksize <= 0 || tasksize <= selected_tasksize)
 				continue;
+			selected = p;
+			selected_tasksize = tasksize;
+			selected_oom_score_adj = adj;
+			lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
+				     p->pid, p->comm, adj, tasksize);
 		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_score_adj, tasksize);
 	}
+	if (selected) {
+		get_task_struct(selected);
+		lowmem_victim = selected;
+		lowmem_deathpending_timeout = jiffies + HZ;
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+	trace_lowmemory_select(min_score_adj, buckets, scanned,
+			       selected ? selected->pid : 0,
+			       selected_oom_score_adj, selected_tasksize,
+			       ktime_to_ns(ktime_sub(ktime_get(), start)));
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
 			     selected_oom_score_adj, selected_tasksize);
-		lowmem_deathpending_timeout = jiffies + HZ;
 		send_sig(SIGKILL, selected, 0);
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
 		rem -= selected_tasksize;
@@ -165,6 +302,22 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	struct task_struct *p;
+	int i;
+
+	for (i = 0; i < LOWMEM_ADJ_BUCKETS; i++)
+		INIT_LIST_HEAD(&lowmem_adj_buckets[i]);
+
+	/* index the processes forked before we got here */
+	write_lock_irq(&tasklist_lock);
+	spin_lock(&lowmem_adj_lock);
+	INIT_LIST_HEAD(&init_task.signal->lowmem_adj_node);
+	for_each_process(p)
+		lowmem_adj_link(p->signal);
+	lowmem_adj_index_ready = true;
+	spin_unlock(&lowmem_adj_lock);
+	write_unlock_irq(&tasklist_lock);
+
 	register_shrinker(&lowmem_shrinker);
 	return 0;
 }
@@ -172,6 +325,8 @@ static int __init lowmem_init(void)
 static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
+	if (lowmem_victim)
+		put_task_struct(lowmem_victim);
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -51,6 +51,23 @@ static int mm_show(struct seq_file *m, void *arg)
 	return drm_mm_dump_table(m, dev->mm_private);
 }
 
+static int usergart_show(struct seq_file *m, void *arg)
+{
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_device *dev = node->minor->dev;
+	int ret;
+
+	ret = mutex_lock_interruptible(&dev->struct_mutex);
+	if (ret)
+		return ret;
+
+	omap_gem_describe_usergart(m);
+
+	mutex_unlock(&dev->struct_mutex);
+
+	return 0;
+}
+
 static int fb_show(struct seq_file *m, void *arg)
 {
 	struct drm_info_node *node = (struct drm_info_node *) m->private;
@@ -96,6 +113,9 @@ static struct drm_info_list omap_debugfs_list[] = {
 /* list of debugfs files that are specific to devices with dmm/tiler */
 static struct drm_info_list omap_dmm_debugfs_list[] = {
 	{"tiler_map", tiler_map_show, 0},
+	{"tiler_frag", tiler_frag_show, 0},
+	{"tiler_bench", tiler_bench_show, 0},
+	{"usergart", usergart_show, 0},
 };
 
 int omap_debugfs_init(struct drm_minor *minor)
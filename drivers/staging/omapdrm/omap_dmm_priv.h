@@ -59,12 +59,12 @@
 #define DMM_IRQSTAT_ERR_UPD_DATA	(1<<6)
 #define DMM_IRQSTAT_ERR_LUT_MISS	(1<<7)
 
-#define DMM_IRQSTAT_ERR_MASK	(DMM_IRQ_STAT_ERR_INV_DSC | \
-				DMM_IRQ_STAT_ERR_INV_DATA | \
-				DMM_IRQ_STAT_ERR_UPD_AREA | \
-				DMM_IRQ_STAT_ERR_UPD_CTRL | \
-				DMM_IRQ_STAT_ERR_UPD_DATA | \
-				DMM_IRQ_STAT_ERR_LUT_MISS)
+#define DMM_IRQSTAT_ERR_MASK	(DMM_IRQSTAT_ERR_INV_DSC | \
+				DMM_IRQSTAT_ERR_INV_DATA | \
+				DMM_IRQSTAT_ERR_UPD_AREA | \
+				DMM_IRQSTAT_ERR_UPD_CTRL | \
+				DMM_IRQSTAT_ERR_UPD_DATA | \
+				DMM_IRQSTAT_ERR_LUT_MISS)
 
 #define DMM_PATSTATUS_READY		(1<<0)
 #define DMM_PATSTATUS_VALID		(1<<1)
@@ -118,6 +118,9 @@ struct pat {
 #define DESCR_SIZE 128
 #define REFILL_BUFFER_SIZE ((4 * 128 * 256) + (3 * DESCR_SIZE))
 
+/* give up on an asynchronous refill that has not completed after this */
+#define REFILL_TIMEOUT_MS 100
+
 /* For OMAP5, a fixed offset is added to all Y coordinates for 1D buffers.
  * This is used in programming to address the upper portion of the LUT
 */
@@ -125,6 +128,20 @@ struct pat {
 
 struct dmm;
 
+/* an asynchronous pin (or unpin) waiting for, or using, a refill engine */
+struct dmm_pin {
+	struct list_head node;
+	struct tiler_block *block;
+	struct page **pages;
+	uint32_t npages;
+	uint32_t roll;
+
+	/* completion callback, called from done_work */
+	void (*fxn)(void *arg, int ret);
+	void *arg;
+	int ret;
+};
+
 struct dmm_txn {
 	void *engine_handle;
 	struct tcm *tcm;
@@ -152,6 +169,13 @@ struct refill_engine {
 	wait_queue_head_t wait_for_refill;
 
 	struct list_head idle_node;
+
+	/* asynchronous refill in flight, completed by refill_work */
+	bool async;
+	unsigned long deadline;
+	struct list_head pins;
+	struct timer_list refill_timer;
+	struct work_struct refill_work;
 };
 
 struct dmm {
@@ -186,6 +210,15 @@ struct dmm {
 
 	/* allocation list and lock */
 	struct list_head alloc_head;
+
+	/* asynchronous pins waiting for an idle refill engine */
+	struct list_head pin_head;
+	struct work_struct pin_work;
+	wait_queue_head_t pin_wait;
+
+	/* completed pins whose callbacks have not run yet */
+	struct list_head done_head;
+	struct work_struct done_work;
 };
 
 #endif
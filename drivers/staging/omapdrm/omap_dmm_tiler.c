@@ -30,6 +30,10 @@
 #include <linux/time.h>
 #include <linux/list.h>
 #include <linux/semaphore.h>
+#include <linux/workqueue.h>
+#include <linux/bitmap.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
 
 #include "omap_dmm_tiler.h"
 #include "omap_dmm_priv.h"
@@ -43,6 +47,10 @@ static struct dmm *omap_dmm;
 /* global spinlock for protecting lists */
 static DEFINE_SPINLOCK(list_lock);
 
+static bool tiler_sita;
+MODULE_PARM_DESC(tiler_sita, "Use the SiTA container manager (default 'n')");
+module_param(tiler_sita, bool, 0444);
+
 /* Geometry table */
 #define GEOM(xshift, yshift, bytes_per_pixel) { \
 		.x_shft = (xshift), \
@@ -130,8 +138,14 @@ irqreturn_t omap_dmm_irq_handler(int irq, void *arg)
 	writel(status, dmm->base + DMM_PAT_IRQSTATUS);
 
 	for (i = 0; i < dmm->num_engines; i++) {
+		struct refill_engine *engine = &dmm->engines[i];
+
 		if (status & DMM_IRQSTAT_LST)
-			wake_up_interruptible(&dmm->engines[i].wait_for_refill);
+			wake_up_interruptible(&engine->wait_for_refill);
+
+		if (engine->async && (status & (DMM_IRQSTAT_LST |
+						DMM_IRQSTAT_ERR_MASK)))
+			queue_work(system_nrt_wq, &engine->refill_work);
 
 		status >>= 8;
 	}
@@ -139,16 +153,12 @@ irqreturn_t omap_dmm_irq_handler(int irq, void *arg)
 	return IRQ_HANDLED;
 }
 
-/**
- * Get a handle for a DMM transaction
- */
-static struct dmm_txn *dmm_txn_init(struct dmm *dmm, struct tcm *tcm)
+/* start a transaction on an idle engine, engine_sem must be held */
+static struct dmm_txn *__dmm_txn_init(struct dmm *dmm, struct tcm *tcm)
 {
 	struct dmm_txn *txn = NULL;
 	struct refill_engine *engine = NULL;
 
-	down(&dmm->engine_sem);
-
 	/* grab an idle engine */
 	spin_lock(&list_lock);
 	if (!list_empty(&dmm->idle_head)) {
@@ -170,6 +180,16 @@ static struct dmm_txn *dmm_txn_init(struct dmm *dmm, struct tcm *tcm)
 	return txn;
 }
 
+/**
+ * Get a handle for a DMM transaction
+ */
+static struct dmm_txn *dmm_txn_init(struct dmm *dmm, struct tcm *tcm)
+{
+	down(&dmm->engine_sem);
+
+	return __dmm_txn_init(dmm, tcm);
+}
+
 /**
  * Add region to DMM transaction.  If pages or pages[i] is NULL, then the
  * corresponding slot is cleared (ie. dummy_pa is programmed)
@@ -223,7 +243,119 @@ static int dmm_txn_append(struct dmm_txn *txn, struct pat_area *area,
 }
 
 /**
- * Commit the DMM transaction.
+ * Add all the 2D slices of a tcm area to DMM transaction.  The area may
+ * belong to a different container than earlier ones in the transaction.
+ */
+static int dmm_txn_append_area(struct dmm_txn *txn, struct tcm_area *area,
+		struct page **pages, uint32_t npages, uint32_t roll)
+{
+	struct refill_engine *engine = txn->engine_handle;
+	struct tcm_area slice, area_s;
+	u32 y_offset = 0;
+	int ret = 0;
+
+	engine->tcm = area->tcm;
+
+	if (cpu_is_omap54xx() && !area->is2d)
+		y_offset = OMAP5_LUT_OFFSET;
+
+	tcm_for_each_slice(slice, *area, area_s) {
+		struct pat_area p_area = {
+				.x0 = slice.p0.x, .y0 = slice.p0.y,
+				.x1 = slice.p1.x, .y1 = slice.p1.y,
+		};
+
+		ret = dmm_txn_append(txn, &p_area, pages, npages, roll,
+					y_offset);
+		if (ret)
+			break;
+
+		roll += tcm_sizeof(slice);
+	}
+
+	return ret;
+}
+
+/* refill buffer space dmm_txn_append_area() will take for an area */
+static size_t dmm_area_refill_size(struct tcm_area *area)
+{
+	struct tcm_area slice, area_s;
+	size_t sz = 0;
+
+	/* a descriptor and the slot addresses per slice, 16 byte aligned */
+	tcm_for_each_slice(slice, *area, area_s)
+		sz += round_up(sizeof(struct pat), 16) +
+				round_up(4 * tcm_sizeof(slice), 16);
+
+	return sz;
+}
+
+/**
+ * Return an engine to the idle list, and complete the asynchronous pins
+ * that were programmed through it.  The callbacks are left to done_work:
+ * this can be called from the pinning thread itself when programming
+ * fails, and it may hold locks that the callbacks take.
+ */
+static void dmm_engine_put(struct refill_engine *engine, int ret)
+{
+	struct dmm *dmm = engine->dmm;
+	struct dmm_pin *pin;
+	LIST_HEAD(done);
+
+	engine->async = false;
+	list_splice_init(&engine->pins, &done);
+
+	spin_lock(&list_lock);
+	list_add(&engine->idle_node, &dmm->idle_head);
+	spin_unlock(&list_lock);
+
+	up(&dmm->engine_sem);
+
+	/* more pins may have been queued while all engines were busy */
+	if (!list_empty(&dmm->pin_head))
+		schedule_work(&dmm->pin_work);
+
+	if (list_empty(&done))
+		return;
+
+	/*
+	 * let waiters in tiler_pin_async()/tiler_release() go before the
+	 * callbacks run, the block may be released once its refills land
+	 */
+	list_for_each_entry(pin, &done, node) {
+		atomic_dec(&pin->block->pending);
+		pin->ret = ret;
+	}
+	wake_up_all(&dmm->pin_wait);
+
+	spin_lock(&list_lock);
+	list_splice_tail(&done, &dmm->done_head);
+	spin_unlock(&list_lock);
+
+	schedule_work(&dmm->done_work);
+}
+
+/* run the callbacks of the pins completed by dmm_engine_put() */
+static void dmm_done_work(struct work_struct *work)
+{
+	struct dmm *dmm = container_of(work, struct dmm, done_work);
+	struct dmm_pin *pin, *n;
+	LIST_HEAD(done);
+
+	spin_lock(&list_lock);
+	list_splice_init(&dmm->done_head, &done);
+	spin_unlock(&list_lock);
+
+	list_for_each_entry_safe(pin, n, &done, node) {
+		if (pin->fxn)
+			pin->fxn(pin->arg, pin->ret);
+		kfree(pin);
+	}
+}
+
+/**
+ * Commit the DMM transaction.  Unless waiting, the refill completes
+ * asynchronously in dmm_refill_done(), which also releases the engine.
  */
 static int dmm_txn_commit(struct dmm_txn *txn, bool wait)
 {
@@ -249,28 +381,133 @@ static int dmm_txn_commit(struct dmm_txn *txn, bool wait)
 		goto cleanup;
 	}
 
+	if (!wait) {
+		/* the irq handler or, failing that, the timer completes it */
+		engine->deadline = jiffies +
+				msecs_to_jiffies(REFILL_TIMEOUT_MS);
+		engine->async = true;
+		mod_timer(&engine->refill_timer, engine->deadline);
+	}
+
 	/* kick reload */
 	writel(engine->refill_pa,
 		dmm->base + reg[PAT_DESCR][engine->id]);
 
-	if (wait) {
-		if (wait_event_interruptible_timeout(engine->wait_for_refill,
-				wait_status(engine, DMM_PATSTATUS_READY) == 0,
-				msecs_to_jiffies(1)) <= 0) {
-			dev_err(dmm->dev, "timed out waiting for done\n");
-			ret = -ETIMEDOUT;
-		}
+	if (!wait)
+		return 0;
+
+	if (wait_event_interruptible_timeout(engine->wait_for_refill,
+			wait_status(engine, DMM_PATSTATUS_READY) == 0,
+			msecs_to_jiffies(1)) <= 0) {
+		dev_err(dmm->dev, "timed out waiting for done\n");
+		ret = -ETIMEDOUT;
 	}
 
 cleanup:
-	spin_lock(&list_lock);
-	list_add(&engine->idle_node, &dmm->idle_head);
-	spin_unlock(&list_lock);
-
-	up(&omap_dmm->engine_sem);
+	dmm_engine_put(engine, ret);
 	return ret;
 }
 
+/* complete an asynchronous refill, see dmm_txn_commit() */
+static void dmm_refill_done(struct work_struct *work)
+{
+	struct refill_engine *engine =
+			container_of(work, struct refill_engine, refill_work);
+	struct dmm *dmm = engine->dmm;
+	uint32_t status;
+	int ret = 0;
+
+	if (!engine->async)
+		return;
+
+	status = readl(dmm->base + reg[PAT_STATUS][engine->id]);
+
+	/* a stale timer or irq can get here before the refill is done */
+	if (!(status & (DMM_PATSTATUS_READY | DMM_PATSTATUS_ERR)) &&
+			time_before(jiffies, engine->deadline))
+		return;
+
+	del_timer_sync(&engine->refill_timer);
+
+	if (status & DMM_PATSTATUS_ERR)
+		ret = -EFAULT;
+	else if (!(status & DMM_PATSTATUS_READY))
+		ret = -ETIMEDOUT;
+
+	if (ret) {
+		dev_err(dmm->dev, "refill failed: %d\n", ret);
+		writel(0x0, dmm->base + reg[PAT_DESCR][engine->id]);
+	}
+
+	dmm_engine_put(engine, ret);
+}
+
+static void dmm_refill_timeout(unsigned long data)
+{
+	struct refill_engine *engine = (struct refill_engine *)data;
+
+	queue_work(system_nrt_wq, &engine->refill_work);
+}
+
+/**
+ * Program queued pins on idle engines.  Pins queued while all engines are
+ * busy are programmed together, in as few transactions as the refill
+ * buffers allow, as engines become idle.
+ */
+static void dmm_pin_kick(struct dmm *dmm)
+{
+	struct refill_engine *engine;
+	struct dmm_txn *txn;
+	struct dmm_pin *pin, *n;
+	size_t used, sz;
+	int ret;
+
+	while (!list_empty(&dmm->pin_head)) {
+		if (down_trylock(&dmm->engine_sem))
+			return;
+
+		txn = __dmm_txn_init(dmm, NULL);
+		engine = txn->engine_handle;
+		used = 0;
+		ret = 0;
+
+		/* a single area always fits, the buffer covers a container */
+		spin_lock(&list_lock);
+		list_for_each_entry_safe(pin, n, &dmm->pin_head, node) {
+			sz = dmm_area_refill_size(&pin->block->area);
+			if (!list_empty(&engine->pins) &&
+					used + sz > REFILL_BUFFER_SIZE)
+				break;
+			used += sz;
+			list_move_tail(&pin->node, &engine->pins);
+		}
+		spin_unlock(&list_lock);
+
+		/* another caller got there first */
+		if (list_empty(&engine->pins)) {
+			dmm_engine_put(engine, 0);
+			return;
+		}
+
+		list_for_each_entry(pin, &engine->pins, node) {
+			ret = dmm_txn_append_area(txn, &pin->block->area,
+					pin->pages, pin->npages, pin->roll);
+			if (ret)
+				break;
+		}
+
+		if (ret)
+			dmm_engine_put(engine, ret);
+		else
+			dmm_txn_commit(txn, false);
+	}
+}
+
+static void dmm_pin_work(struct work_struct *work)
+{
+	dmm_pin_kick(container_of(work, struct dmm, pin_work));
+}
+
 /*
  * DMM programming
  */
@@ -278,30 +515,15 @@ static int fill(struct tcm_area *area, struct page **pages,
 		uint32_t npages, uint32_t roll, bool wait)
 {
 	int ret = 0;
-	struct tcm_area slice, area_s;
 	struct dmm_txn *txn;
-	u32 y_offset = 0;
 
 	txn = dmm_txn_init(omap_dmm, area->tcm);
 	if (IS_ERR_OR_NULL(txn))
 		return PTR_ERR(txn);
 
-	if (cpu_is_omap54xx() && !area->is2d)
-		y_offset = OMAP5_LUT_OFFSET;
-
-	tcm_for_each_slice(slice, *area, area_s) {
-		struct pat_area p_area = {
-				.x0 = slice.p0.x, .y0 = slice.p0.y,
-				.x1 = slice.p1.x, .y1 = slice.p1.y,
-		};
-
-		ret = dmm_txn_append(txn, &p_area, pages, npages, roll,
-					y_offset);
-		if (ret)
-			goto fail;
-
-		roll += tcm_sizeof(slice);
-	}
+	ret = dmm_txn_append_area(txn, area, pages, npages, roll);
+	if (ret)
+		goto fail;
 
 	ret = dmm_txn_commit(txn, wait);
 
@@ -320,6 +542,12 @@ int tiler_pin(struct tiler_block *block, struct page **pages,
 {
 	int ret;
 
+	if (!wait)
+		return tiler_pin_async(block, pages, npages, roll, NULL, NULL);
+
+	/* refills of a block must land in order */
+	wait_event(omap_dmm->pin_wait, !atomic_read(&block->pending));
+
 	ret = fill(&block->area, pages, npages, roll, wait);
 
 	if (ret)
@@ -328,9 +556,53 @@ int tiler_pin(struct tiler_block *block, struct page **pages,
 	return ret;
 }
 
+/**
+ * Queue a pin and return without waiting for the PAT refill.  fxn(arg, ret)
+ * is called from a workqueue once the refill has completed (ret == 0) or
+ * failed, in which case the caller should unpin the block.  It is never
+ * called before this returns, so the caller may hold locks fxn takes.  The
+ * pages array must stay valid until fxn is called.
+ *
+ * Pins queued while all refill engines are busy are batched into multi-area
+ * transactions, so a burst of pins costs a few refill round-trips rather
+ * than one each.
+ */
+int tiler_pin_async(struct tiler_block *block, struct page **pages,
+		uint32_t npages, uint32_t roll,
+		void (*fxn)(void *arg, int ret), void *arg)
+{
+	struct dmm_pin *pin = kzalloc(sizeof(*pin), GFP_KERNEL);
+
+	if (!pin)
+		return -ENOMEM;
+
+	pin->block = block;
+	pin->pages = pages;
+	pin->npages = npages;
+	pin->roll = roll;
+	pin->fxn = fxn;
+	pin->arg = arg;
+
+	/* refills of a block must land in order */
+	wait_event(omap_dmm->pin_wait, !atomic_read(&block->pending));
+	atomic_inc(&block->pending);
+
+	spin_lock(&list_lock);
+	list_add_tail(&pin->node, &omap_dmm->pin_head);
+	spin_unlock(&list_lock);
+
+	dmm_pin_kick(omap_dmm);
+
+	return 0;
+}
+
 int tiler_unpin(struct tiler_block *block)
 {
-	return fill(&block->area, NULL, 0, 0, false);
+	/* tiler_release() waits for the refill before freeing the area */
+	if (tiler_pin_async(block, NULL, 0, 0, NULL, NULL))
+		return fill(&block->area, NULL, 0, 0, true);
+
+	return 0;
 }
 
 /*
@@ -396,7 +668,12 @@ struct tiler_block *tiler_reserve_1d(size_t size)
 /* note: if you have pin'd pages, you should have already unpin'd first! */
 int tiler_release(struct tiler_block *block)
 {
-	int ret = tcm_free(&block->area);
+	int ret;
+
+	/* the area must not be reused while it is still being refilled */
+	wait_event(omap_dmm->pin_wait, !atomic_read(&block->pending));
+
+	ret = tcm_free(&block->area);
 
 	if (block->area.tcm)
 		dev_err(omap_dmm->dev, "failed to release block\n");
@@ -539,6 +816,13 @@ static int omap_dmm_remove(struct platform_device *dev)
 				omap_dmm->tcm[i]->deinit(omap_dmm->tcm[i]);
 		kfree(omap_dmm->tcm);
 
+		cancel_work_sync(&omap_dmm->pin_work);
+		for (i = 0; omap_dmm->engines && i < omap_dmm->num_engines;
+				i++) {
+			del_timer_sync(&omap_dmm->engines[i].refill_timer);
+			cancel_work_sync(&omap_dmm->engines[i].refill_work);
+		}
+		flush_work_sync(&omap_dmm->done_work);
 		kfree(omap_dmm->engines);
 		if (omap_dmm->refill_va)
 			dma_free_coherent(omap_dmm->dev,
@@ -577,6 +861,11 @@ static int omap_dmm_probe(struct platform_device *dev)
 	/* initialize lists */
 	INIT_LIST_HEAD(&omap_dmm->alloc_head);
 	INIT_LIST_HEAD(&omap_dmm->idle_head);
+	INIT_LIST_HEAD(&omap_dmm->pin_head);
+	INIT_WORK(&omap_dmm->pin_work, dmm_pin_work);
+	init_waitqueue_head(&omap_dmm->pin_wait);
+	INIT_LIST_HEAD(&omap_dmm->done_head);
+	INIT_WORK(&omap_dmm->done_work, dmm_done_work);
 
 	/* lookup hwmod data - base address and irq */
 	mem = platform_get_resource(dev, IORESOURCE_MEM, 0);
@@ -698,6 +987,11 @@ static int omap_dmm_probe(struct platform_device *dev)
 		omap_dmm->engines[i].refill_pa = omap_dmm->refill_pa +
 						(REFILL_BUFFER_SIZE * i);
 		init_waitqueue_head(&omap_dmm->engines[i].wait_for_refill);
+		INIT_LIST_HEAD(&omap_dmm->engines[i].pins);
+		INIT_WORK(&omap_dmm->engines[i].refill_work, dmm_refill_done);
+		setup_timer(&omap_dmm->engines[i].refill_timer,
+				dmm_refill_timeout,
+				(unsigned long)&omap_dmm->engines[i]);
 
 		list_add(&omap_dmm->engines[i].idle_node, &omap_dmm->idle_head);
 	}
@@ -712,9 +1006,14 @@ static int omap_dmm_probe(struct platform_device *dev)
 
 	/* init containers */
 	for (i = 0; i < omap_dmm->num_lut; i++) {
-		omap_dmm->tcm[i] = sita_init(omap_dmm->container_width,
+		if (tiler_sita)
+			omap_dmm->tcm[i] = sita_init(omap_dmm->container_width,
 						omap_dmm->container_height,
 						NULL);
+		else
+			omap_dmm->tcm[i] = rowmap_init(
+						omap_dmm->container_width,
+						omap_dmm->container_height);
 
 		if (!omap_dmm->tcm[i]) {
 			dev_err(&dev->dev, "failed to allocate container\n");
@@ -941,6 +1240,302 @@ error:
 
 	return 0;
 }
+
+/* free space statistics of a container */
+struct tiler_frag {
+	u32 free;		/* free slots */
+	u32 runs;		/* runs of free slots in raster order */
+	u32 max_run;		/* longest such run, i.e. largest 1D area */
+	u32 max_rect;		/* slots in the largest free rectangle */
+	u16 rect_w, rect_h;	/* dimensions of that rectangle */
+};
+
+/* mark the slots of an area in a raster order bitmap of its container */
+static void frag_mark(unsigned long *map, struct tcm_area *a)
+{
+	u16 w = a->tcm->width;
+	u16 y;
+
+	if (!a->is2d) {
+		bitmap_set(map, a->p0.y * w + a->p0.x, tcm_sizeof(*a));
+		return;
+	}
+
+	for (y = a->p0.y; y <= a->p1.y; y++)
+		bitmap_set(map, y * w + a->p0.x, tcm_awidth(*a));
+}
+
+static int frag_stats(unsigned long *map, u16 width, u16 height,
+		struct tiler_frag *f)
+{
+	u32 n = width * height, x, end, area;
+	u16 *hist, *stack, left, y;
+	int top;
+
+	memset(f, 0, sizeof(*f));
+
+	/* 1D view: runs of free slots in raster order */
+	for (x = find_first_zero_bit(map, n); x < n;
+	     x = find_next_zero_bit(map, n, end)) {
+		end = find_next_bit(map, n, x);
+		f->free += end - x;
+		f->runs++;
+		f->max_run = max(f->max_run, end - x);
+	}
+
+	/*
+	 * 2D view: largest free rectangle.  hist[x] is the number of free
+	 * slots in column x ending at the current row, and the rectangles
+	 * ending at a row are those under the histogram it forms.  The
+	 * extra zero column at the end flushes the stack.
+	 */
+	hist = kcalloc(width + 1, sizeof(*hist), GFP_KERNEL);
+	stack = kcalloc(width + 1, sizeof(*stack), GFP_KERNEL);
+	if (!hist || !stack) {
+		kfree(hist);
+		kfree(stack);
+		return -ENOMEM;
+	}
+
+	for (y = 0; y < height; y++) {
+		top = 0;
+		for (x = 0; x <= width; x++) {
+			if (x < width)
+				hist[x] = test_bit(y * width + x, map) ?
+							0 : hist[x] + 1;
+
+			while (top && hist[stack[top - 1]] >= hist[x]) {
+				u16 h = hist[stack[--top]];
+
+				left = top ? stack[top - 1] + 1 : 0;
+				area = h * (x - left);
+				if (area > f->max_rect) {
+					f->max_rect = area;
+					f->rect_w = x - left;
+					f->rect_h = h;
+				}
+			}
+			stack[top++] = x;
+		}
+	}
+
+	kfree(hist);
+	kfree(stack);
+	return 0;
+}
+
+/* share of the free slots that the largest possible area cannot use */
+static u32 frag_pct(u32 largest, u32 free)
+{
+	return free ? 100 - 100 * largest / free : 0;
+}
+
+int tiler_frag_show(struct seq_file *s, void *arg)
+{
+	struct tiler_block *block;
+	struct tiler_frag f;
+	unsigned long *map, flags;
+	u16 w, h;
+	int lut_idx, ret = 0;
+
+	if (!omap_dmm) {
+		/* early return if dmm/tiler device is not initialized */
+		return 0;
+	}
+
+	w = omap_dmm->container_width;
+	h = omap_dmm->container_height;
+
+	map = kcalloc(BITS_TO_LONGS(w * h), sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return -ENOMEM;
+
+	for (lut_idx = 0; lut_idx < omap_dmm->num_lut; lut_idx++) {
+		bitmap_zero(map, w * h);
+
+		spin_lock_irqsave(&list_lock, flags);
+		list_for_each_entry(block, &omap_dmm->alloc_head, alloc_node)
+			if (block->area.tcm->lut_id == lut_idx)
+				frag_mark(map, &block->area);
+		spin_unlock_irqrestore(&list_lock, flags);
+
+		ret = frag_stats(map, w, h, &f);
+		if (ret)
+			break;
+
+		seq_printf(s, "CONTAINER %d: %u of %u slots free\n",
+				lut_idx, f.free, w * h);
+		seq_printf(s, "  1D: %u free runs, largest %u slots, "
+				"fragmentation %u%%\n", f.runs, f.max_run,
+				frag_pct(f.max_run, f.free));
+		seq_printf(s, "  2D: largest free area %ux%u (%u slots), "
+				"fragmentation %u%%\n", f.rect_w, f.rect_h,
+				f.max_rect, frag_pct(f.max_rect, f.free));
+	}
+
+	kfree(map);
+	return ret;
+}
+
+/*
+ * Allocation stress benchmark: reading the tiler_bench debugfs file replays
+ * the same pseudo-random sequence of reservations and frees against a
+ * private SiTA and RowMap container of the real container size, and reports
+ * the time spent in the container managers and the fragmentation they left.
+ */
+static uint tiler_bench_ops = 10000;
+MODULE_PARM_DESC(tiler_bench_ops, "Operations per tiler_bench run");
+module_param(tiler_bench_ops, uint, 0644);
+
+static uint tiler_bench_seed = 1;
+MODULE_PARM_DESC(tiler_bench_seed, "Random seed for tiler_bench");
+module_param(tiler_bench_seed, uint, 0644);
+
+#define BENCH_LIVE	64	/* areas that may be reserved at once */
+#define BENCH_MAX_1D	1024	/* largest 1D area, in slots */
+#define BENCH_SAMPLE	256	/* operations between fragmentation samples */
+
+/* 2D areas in slots, as reserved for common buffers by omap_gem */
+static const struct {
+	u16 w, h, align;
+} bench_2d[] = {
+	{ 30, 17, 0 },		/* 1080p NV12 Y */
+	{ 15, 17, 0 },		/* 1080p NV12 UV */
+	{ 20, 12, 0 },		/* 720p NV12 Y */
+	{ 10, 12, 0 },		/* 720p NV12 UV */
+	{ 60, 34, 0 },		/* 1080p ARGB */
+	{ 64, 1, 64 },		/* usergart 8-bit entry */
+};
+
+struct tiler_bench {
+	u64 reserve_ns, free_ns;
+	u32 reserves, frees, failed;
+	u32 max_reserve_ns;
+	u32 frag_1d, frag_2d;	/* sums of the sampled percentages */
+	u32 samples;
+};
+
+static int tiler_bench_run(struct tcm *tcm, struct tiler_bench *b)
+{
+	struct tcm_area *live, *a;
+	struct rnd_state rnd;
+	struct tiler_frag f;
+	unsigned long *map;
+	u32 n = tcm->width * tcm->height;
+	u32 i, k, r, ns;
+	ktime_t t;
+	int ret = 0, err;
+
+	memset(b, 0, sizeof(*b));
+
+	live = kcalloc(BENCH_LIVE, sizeof(*live), GFP_KERNEL);
+	map = kcalloc(BITS_TO_LONGS(n), sizeof(*map), GFP_KERNEL);
+	if (!live || !map) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	prandom32_seed(&rnd, tiler_bench_seed);
+
+	for (i = 0; i < tiler_bench_ops; i++) {
+		/* one draw per operation keeps the runs in step */
+		r = prandom32(&rnd);
+		a = &live[r % BENCH_LIVE];
+		r /= BENCH_LIVE;
+
+		if (a->tcm) {
+			t = ktime_get();
+			tcm_free(a);
+			b->free_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
+			b->frees++;
+		} else {
+			k = (r >> 1) % ARRAY_SIZE(bench_2d);
+			t = ktime_get();
+			if (r & 1)
+				err = tcm_reserve_1d(tcm,
+						(r >> 1) % BENCH_MAX_1D + 1, a);
+			else
+				err = tcm_reserve_2d(tcm, bench_2d[k].w,
+						bench_2d[k].h,
+						bench_2d[k].align, a);
+			ns = ktime_to_ns(ktime_sub(ktime_get(), t));
+			b->reserve_ns += ns;
+			b->max_reserve_ns = max(b->max_reserve_ns, ns);
+			b->reserves++;
+			if (err)
+				b->failed++;
+		}
+
+		if (i % BENCH_SAMPLE == BENCH_SAMPLE - 1) {
+			bitmap_zero(map, n);
+			for (k = 0; k < BENCH_LIVE; k++)
+				if (live[k].tcm)
+					frag_mark(map, &live[k]);
+
+			ret = frag_stats(map, tcm->width, tcm->height, &f);
+			if (ret)
+				goto out;
+
+			b->frag_1d += frag_pct(f.max_run, f.free);
+			b->frag_2d += frag_pct(f.max_rect, f.free);
+			b->samples++;
+		}
+
+		cond_resched();
+	}
+
+out:
+	for (k = 0; live && k < BENCH_LIVE; k++)
+		tcm_free(&live[k]);
+	kfree(live);
+	kfree(map);
+	return ret;
+}
+
+int tiler_bench_show(struct seq_file *s, void *arg)
+{
+	static const char * const names[] = { "SiTA", "RowMap" };
+	struct tiler_bench b;
+	struct tcm *tcm;
+	u16 w, h;
+	int i, ret;
+
+	if (!omap_dmm) {
+		/* early return if dmm/tiler device is not initialized */
+		return 0;
+	}
+
+	w = omap_dmm->container_width;
+	h = omap_dmm->container_height;
+
+	seq_printf(s, "%u ops, seed %u, %ux%u container, %u live areas\n",
+			tiler_bench_ops, tiler_bench_seed, w, h, BENCH_LIVE);
+	seq_printf(s, "%-8s %12s %12s %12s %8s %8s %8s\n", "manager",
+			"reserve(ns)", "max(ns)", "free(ns)", "failed",
+			"frag1d", "frag2d");
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		tcm = i ? rowmap_init(w, h) : sita_init(w, h, NULL);
+		if (!tcm)
+			return -ENOMEM;
+
+		ret = tiler_bench_run(tcm, &b);
+		tcm_deinit(tcm);
+		if (ret)
+			return ret;
+
+		seq_printf(s, "%-8s %12llu %12u %12llu %8u %7u%% %7u%%\n",
+			names[i],
+			b.reserves ? div_u64(b.reserve_ns, b.reserves) : 0,
+			b.max_reserve_ns,
+			b.frees ? div_u64(b.free_ns, b.frees) : 0,
+			b.failed,
+			b.samples ? b.frag_1d / b.samples : 0,
+			b.samples ? b.frag_2d / b.samples : 0);
+	}
+
+	return 0;
+}
 #endif
 
 struct platform_driver omap_dmm_driver = {
@@ -39,6 +39,7 @@ struct tiler_block {
 	struct list_head alloc_node;	/* node for global block list */
 	struct tcm_area area;		/* area */
 	enum tiler_fmt fmt;		/* format */
+	atomic_t pending;		/* queued or in-flight refills */
 };
 
 /* bits representing the same slot in DMM-TILER hw-block */
@@ -86,11 +87,16 @@ S Y X	Description				Alternate description
 
 #ifdef CONFIG_DEBUG_FS
 int tiler_map_show(struct seq_file *s, void *arg);
+int tiler_frag_show(struct seq_file *s, void *arg);
+int tiler_bench_show(struct seq_file *s, void *arg);
 #endif
 
 /* pin/unpin */
 int tiler_pin(struct tiler_block *block, struct page **pages,
 		uint32_t npages, uint32_t roll, bool wait);
+int tiler_pin_async(struct tiler_block *block, struct page **pages,
+		uint32_t npages, uint32_t roll,
+		void (*fxn)(void *arg, int ret), void *arg);
 int tiler_unpin(struct tiler_block *block);
 
 /* reserve/release */
@@ -1056,6 +1056,7 @@ MODULE_LICENSE("GPL v2");
 EXPORT_SYMBOL(omap_gem_mmap_offset);
 EXPORT_SYMBOL(omap_gem_tiled_size);
 EXPORT_SYMBOL(omap_gem_get_paddr);
+EXPORT_SYMBOL(omap_gem_get_paddr_async);
 EXPORT_SYMBOL(omap_gem_put_paddr);
 EXPORT_SYMBOL(omap_gem_get_pages);
 EXPORT_SYMBOL(omap_gem_put_pages);
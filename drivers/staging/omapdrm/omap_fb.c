@@ -268,17 +268,24 @@ int omap_framebuffer_replace(struct drm_framebuffer *a,
 			pa->paddr = 0;
 		}
 
-		if (pb && !ret) {
-			ret = omap_gem_get_paddr(pb->bo, &pb->paddr, true);
-			if (!ret)
-				omap_gem_dma_sync(pb->bo, DMA_TO_DEVICE);
-		}
+		if (pb && !ret)
+			ret = omap_gem_get_paddr_async(pb->bo, &pb->paddr,
+					true);
 	}
 
-	if (ret && a) {
+	/* let the TILER refills of all the planes run before waiting */
+	for (i = 0; i < nb && !ret; i++) {
+		struct plane *pb = &ofbb->planes[i];
+
+		ret = omap_gem_op_sync(pb->bo, OMAP_GEM_READ);
+		if (!ret)
+			omap_gem_dma_sync(pb->bo, DMA_TO_DEVICE);
+	}
+
+	if (ret) {
 		/* something went wrong.. unpin what has been pinned */
 		for (i = 0; i < nb; i++) {
-			struct plane *pb = &ofba->planes[i];
+			struct plane *pb = &ofbb->planes[i];
 			if (pb->paddr) {
 				unpin(arg, pb->bo);
 				pb->paddr = 0;
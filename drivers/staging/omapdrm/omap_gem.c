@@ -80,6 +80,15 @@ struct omap_gem_object {
 	 */
 	struct tiler_block *block;
 
+	/**
+	 * Error of a failed asynchronous pin of the current TILER mapping,
+	 * returned by omap_gem_op_sync().  pin_gen counts mappings, so that
+	 * a late completion for an earlier one is not taken for this one.
+	 * Both are protected by sync_lock.
+	 */
+	int pin_err;
+	uint32_t pin_gen;
+
 	/**
 	 * Array of backing pages, if allocated.  Note that pages are never
 	 * allocated for buffers originally allocated from contiguous memory
@@ -139,25 +148,46 @@ static uint64_t mmap_offset(struct drm_gem_object *obj);
  * can create a second page-aligned mapping of parts of the buffer
  * being accessed from userspace.
  *
+ * Each entry maps one slot-row of a buffer.  Entries are recycled in
+ * least recently faulted order, and those of freed buffers are reused
+ * first.  On a fault the following slot-rows are mapped as well, since
+ * CPU access to a buffer is mostly sequential.
+ *
  * Note that we could optimize slightly when we know that multiple
  * tiler containers are backed by the same PAT.. but I'll leave that
  * for later..
  */
-#define NUM_USERGART_ENTRIES 2
+#define MAX_USERGART_ENTRIES 64
+
+static int usergart_entries = 8;
+MODULE_PARM_DESC(usergart_entries,
+		"Usergart entries per tiled format (default 8, max 64)");
+module_param(usergart_entries, int, 0444);
+
+static int usergart_prefault = 1;
+MODULE_PARM_DESC(usergart_prefault,
+		"Slot-rows to map ahead on a tiled buffer fault (default 1)");
+module_param(usergart_prefault, int, 0644);
+
 struct usergart_entry {
 	struct tiler_block *block;	/* the reserved tiler block */
 	dma_addr_t paddr;
 	struct drm_gem_object *obj;	/* the current pinned obj */
 	pgoff_t obj_pgoff;		/* page offset of obj currently
 					   mapped in */
+	struct list_head lru;		/* node in usergart lru list */
 };
 static struct {
-	struct usergart_entry entry[NUM_USERGART_ENTRIES];
+	struct usergart_entry *entry;
+	int num_entries;
+	struct list_head lru;		/* least recently used entry first */
 	int height;				/* height in rows */
 	int height_shift;		/* ilog2(height in rows) */
 	int slot_shift;			/* ilog2(width per slot) */
 	int stride_pfn;			/* stride in pages */
-	int last;				/* index of last used entry */
+	unsigned long faults;		/* slot-rows mapped on a fault */
+	unsigned long prefaults;	/* slot-rows mapped ahead of a fault */
+	unsigned long evictions;	/* mappings evicted to make room */
 } *usergart;
 
 static void evict_entry(struct drm_gem_object *obj,
@@ -184,6 +214,9 @@ static void evict_entry(struct drm_gem_object *obj,
 	}
 
 	entry->obj = NULL;
+
+	/* a free entry is the first to be reused */
+	list_move(&entry->lru, &usergart[fmt].lru);
 }
 
 /* Evict a buffer from usergart, if it is mapped there */
@@ -198,7 +231,7 @@ static void evict(struct drm_gem_object *obj)
 		if (!usergart)
 			return;
 
-		for (i = 0; i < NUM_USERGART_ENTRIES; i++) {
+		for (i = 0; i < usergart[fmt].num_entries; i++) {
 			struct usergart_entry *entry = &usergart[fmt].entry[i];
 			if (entry->obj == obj)
 				evict_entry(obj, fmt, entry);
@@ -388,16 +421,50 @@ static int fault_1d(struct drm_gem_object *obj,
 	return vm_insert_mixed(vma, (unsigned long)vmf->virtual_address, pfn);
 }
 
-/* Special handling for the case of faulting in 2d tiled buffers */
-static int fault_2d(struct drm_gem_object *obj,
-		struct vm_area_struct *vma, struct vm_fault *vmf)
+/*
+ * Virtual stride of a 2d tiled buffer in pages.  If the buffer width in
+ * bytes > PAGE_SIZE then the virtual stride is rounded up to the next
+ * multiple of PAGE_SIZE.. this needs to be taken into account in some of
+ * the math.
+ */
+static int vstride_pages(struct omap_gem_object *omap_obj, enum tiler_fmt fmt)
+{
+	return 1 + ((omap_obj->width << fmt) / PAGE_SIZE);
+}
+
+/* page offset of the part of a slot-row mapped by a usergart entry */
+static pgoff_t slot_pgoff(struct omap_gem_object *omap_obj,
+		enum tiler_fmt fmt, pgoff_t pgoff)
+{
+	const int m = vstride_pages(omap_obj, fmt);
+
+	return round_down(pgoff, m << usergart[fmt].height_shift) + pgoff % m;
+}
+
+/* find the usergart entry mapping obj at obj_pgoff, if any */
+static struct usergart_entry *find_entry(struct drm_gem_object *obj,
+		enum tiler_fmt fmt, pgoff_t obj_pgoff)
+{
+	int i;
+
+	for (i = 0; i < usergart[fmt].num_entries; i++) {
+		struct usergart_entry *entry = &usergart[fmt].entry[i];
+		if (entry->obj == obj && entry->obj_pgoff == obj_pgoff)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Map the slot-row holding page pgoff of a 2d tiled buffer thru entry */
+static int map_slot(struct drm_gem_object *obj, struct vm_area_struct *vma,
+		struct usergart_entry *entry, pgoff_t pgoff)
 {
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
-	struct usergart_entry *entry;
 	enum tiler_fmt fmt = gem2fmt(omap_obj->flags);
 	struct page *pages[64];  /* XXX is this too much to have on stack? */
 	unsigned long pfn;
-	pgoff_t pgoff, base_pgoff;
+	pgoff_t base_pgoff;
 	void __user *vaddr;
 	int i, ret, slots;
 
@@ -409,17 +476,8 @@ static int fault_2d(struct drm_gem_object *obj,
 	const int n = usergart[fmt].height;
 	const int n_shift = usergart[fmt].height_shift;
 
-	/*
-	 * If buffer width in bytes > PAGE_SIZE then the virtual stride is
-	 * rounded up to next multiple of PAGE_SIZE.. this need to be taken
-	 * into account in some of the math, so figure out virtual stride
-	 * in pages
-	 */
-	const int m = 1 + ((omap_obj->width << fmt) / PAGE_SIZE);
-
-	/* We don't use vmf->pgoff since that has the fake offset: */
-	pgoff = ((unsigned long)vmf->virtual_address -
-			vma->vm_start) >> PAGE_SHIFT;
+	/* virtual stride in pages: */
+	const int m = vstride_pages(omap_obj, fmt);
 
 	/*
 	 * Actual address we start mapping at is rounded down to previous slot
@@ -430,16 +488,13 @@ static int fault_2d(struct drm_gem_object *obj,
 	/* figure out buffer width in slots */
 	slots = omap_obj->width >> usergart[fmt].slot_shift;
 
-	vaddr = vmf->virtual_address - ((pgoff - base_pgoff) << PAGE_SHIFT);
-
-	entry = &usergart[fmt].entry[usergart[fmt].last];
+	vaddr = (void __user *)(vma->vm_start + (base_pgoff << PAGE_SHIFT));
 
 	/* evict previous buffer using this usergart entry, if any: */
-	if (entry->obj)
+	if (entry->obj) {
 		evict_entry(entry->obj, fmt, entry);
-
-	entry->obj = obj;
-	entry->obj_pgoff = base_pgoff;
+		usergart[fmt].evictions++;
+	}
 
 	/* now convert base_pgoff to phys offset from virt offset: */
 	base_pgoff = (base_pgoff >> n_shift) * slots;
@@ -447,7 +502,6 @@ static int fault_2d(struct drm_gem_object *obj,
 	/* for wider-than 4k.. figure out which part of the slot-row we want: */
 	if (m > 1) {
 		int off = pgoff % m;
-		entry->obj_pgoff += off;
 		base_pgoff /= m;
 		slots = min(slots - (off << n_shift), n);
 		base_pgoff += off << n_shift;
@@ -472,10 +526,12 @@ static int fault_2d(struct drm_gem_object *obj,
 		return ret;
 	}
 
+	entry->obj = obj;
+	entry->obj_pgoff = slot_pgoff(omap_obj, fmt, pgoff);
+
 	pfn = entry->paddr >> PAGE_SHIFT;
 
-	VERB("Inserting %p pfn %lx, pa %lx", vmf->virtual_address,
-			pfn, pfn << PAGE_SHIFT);
+	VERB("Inserting %p pfn %lx, pa %lx", vaddr, pfn, pfn << PAGE_SHIFT);
 
 	for (i = n; i > 0; i--) {
 		vm_insert_mixed(vma, (unsigned long)vaddr, pfn);
@@ -483,8 +539,59 @@ static int fault_2d(struct drm_gem_object *obj,
 		vaddr += PAGE_SIZE * m;
 	}
 
-	/* simple round-robin: */
-	usergart[fmt].last = (usergart[fmt].last + 1) % NUM_USERGART_ENTRIES;
+	return 0;
+}
+
+/* Special handling for the case of faulting in 2d tiled buffers */
+static int fault_2d(struct drm_gem_object *obj,
+		struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct omap_gem_object *omap_obj = to_omap_bo(obj);
+	enum tiler_fmt fmt = gem2fmt(omap_obj->flags);
+	struct list_head *lru = &usergart[fmt].lru;
+	struct usergart_entry *entry, *next;
+	pgoff_t pgoff, npages, step;
+	int i, ret, prefault;
+
+	/* We don't use vmf->pgoff since that has the fake offset: */
+	pgoff = ((unsigned long)vmf->virtual_address -
+			vma->vm_start) >> PAGE_SHIFT;
+
+	entry = list_first_entry(lru, struct usergart_entry, lru);
+
+	ret = map_slot(obj, vma, entry, pgoff);
+	if (ret)
+		return ret;
+
+	list_move_tail(&entry->lru, lru);
+	usergart[fmt].faults++;
+
+	/*
+	 * Map the same part of the following slot-rows too, without ever
+	 * recycling the entry that was just faulted in:
+	 */
+	prefault = min(usergart_prefault, usergart[fmt].num_entries - 1);
+	npages = min_t(pgoff_t, vma_pages(vma),
+			omap_gem_mmap_size(obj) >> PAGE_SHIFT);
+	step = vstride_pages(omap_obj, fmt) << usergart[fmt].height_shift;
+
+	for (i = 0; i < prefault; i++) {
+		pgoff += step;
+		if (pgoff >= npages)
+			break;
+
+		if (find_entry(obj, fmt, slot_pgoff(omap_obj, fmt, pgoff)))
+			continue;
+
+		next = list_first_entry(lru, struct usergart_entry, lru);
+		if (map_slot(obj, vma, next, pgoff))
+			break;
+
+		list_move_tail(&next->lru, lru);
+		usergart[fmt].prefaults++;
+	}
+
+	list_move_tail(&entry->lru, lru);
 
 	return 0;
 }
@@ -752,12 +859,70 @@ void omap_gem_dma_sync(struct drm_gem_object *obj,
 	}
 }
 
-/* Get physical address for DMA.. if 'remap' is true, and the buffer is not
- * already contiguous, remap it to pin in physically contiguous memory.. (ie.
- * map in TILER)
+/* an asynchronous TILER pin started by pin_async() */
+struct omap_gem_pin {
+	struct drm_gem_object *obj;
+	uint32_t gen;		/* the mapping it is for, see pin_gen */
+};
+
+/* completion of an asynchronous TILER pin started by pin_async() */
+static void pin_done(void *arg, int ret)
+{
+	struct omap_gem_pin *pin = arg;
+	struct drm_gem_object *obj = pin->obj;
+	struct omap_gem_object *omap_obj = to_omap_bo(obj);
+
+	if (ret) {
+		dev_err(obj->dev->dev, "could not pin: %d\n", ret);
+
+		spin_lock(&sync_lock);
+		if (omap_obj->pin_gen == pin->gen)
+			omap_obj->pin_err = ret;
+		spin_unlock(&sync_lock);
+	}
+
+	omap_gem_op_finish(obj, OMAP_GEM_WRITE);
+	drm_gem_object_unreference_unlocked(obj);
+	kfree(pin);
+}
+
+/* start programming a TILER mapping, the refill is a pending write on the
+ * bo until pin_done() runs.  Called with struct_mutex held.
  */
-int omap_gem_get_paddr(struct drm_gem_object *obj,
-		dma_addr_t *paddr, bool remap)
+static int pin_async(struct drm_gem_object *obj, struct tiler_block *block,
+		struct page **pages, uint32_t npages)
+{
+	struct omap_gem_object *omap_obj = to_omap_bo(obj);
+	struct omap_gem_pin *pin;
+	int ret;
+
+	pin = kmalloc(sizeof(*pin), GFP_KERNEL);
+	if (!pin)
+		return -ENOMEM;
+
+	ret = omap_gem_op_start(obj, OMAP_GEM_WRITE);
+	if (ret) {
+		kfree(pin);
+		return ret;
+	}
+
+	pin->obj = obj;
+	pin->gen = omap_obj->pin_gen;
+	drm_gem_object_reference(obj);
+
+	ret = tiler_pin_async(block, pages, npages, omap_obj->roll,
+			pin_done, pin);
+	if (ret) {
+		omap_gem_op_finish(obj, OMAP_GEM_WRITE);
+		drm_gem_object_unreference(obj);
+		kfree(pin);
+	}
+
+	return ret;
+}
+
+static int get_paddr(struct drm_gem_object *obj,
+		dma_addr_t *paddr, bool remap, bool wait)
 {
 	struct omap_drm_private *priv = obj->dev->dev_private;
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
@@ -778,6 +943,12 @@ int omap_gem_get_paddr(struct drm_gem_object *obj,
 			if (ret)
 				goto fail;
 
+			/* a new mapping, forget how earlier ones went */
+			spin_lock(&sync_lock);
+			omap_obj->pin_gen++;
+			omap_obj->pin_err = 0;
+			spin_unlock(&sync_lock);
+
 			if (omap_obj->flags & OMAP_BO_TILED) {
 				block = tiler_reserve_2d(fmt,
 						omap_obj->width,
@@ -793,9 +964,12 @@ int omap_gem_get_paddr(struct drm_gem_object *obj,
 				goto fail;
 			}
 
-			/* TODO: enable async refill.. */
-			ret = tiler_pin(block, pages, npages,
-					omap_obj->roll, true);
+			if (wait)
+				ret = tiler_pin(block, pages, npages,
+						omap_obj->roll, true);
+			else
+				ret = pin_async(obj, block, pages, npages);
+
 			if (ret) {
 				tiler_release(block);
 				dev_err(obj->dev->dev,
@@ -825,6 +999,29 @@ fail:
 	return ret;
 }
 
+/* Get physical address for DMA.. if 'remap' is true, and the buffer is not
+ * already contiguous, remap it to pin in physically contiguous memory.. (ie.
+ * map in TILER)
+ */
+int omap_gem_get_paddr(struct drm_gem_object *obj,
+		dma_addr_t *paddr, bool remap)
+{
+	return get_paddr(obj, paddr, remap, true);
+}
+
+/* Like omap_gem_get_paddr(), but don't wait for the TILER mapping to be
+ * programmed.  Until it is, the refill counts as a pending write on the
+ * buffer, so use omap_gem_op_sync() before handing the address to hw; it
+ * fails if the refill did, and the caller should then put the paddr.
+ * This lets a caller pin several buffers back to back and have their
+ * refills batched and overlapped.
+ */
+int omap_gem_get_paddr_async(struct drm_gem_object *obj,
+		dma_addr_t *paddr, bool remap)
+{
+	return get_paddr(obj, paddr, remap, false);
+}
+
 /* Release physical address, when DMA is no longer being performed.. this
  * could potentially unpin and unmap buffers from TILER
  */
@@ -1012,6 +1209,28 @@ void omap_gem_describe_objects(struct list_head *list, struct seq_file *m)
 
 	seq_printf(m, "Total %d objects, %zu bytes\n", count, size);
 }
+
+void omap_gem_describe_usergart(struct seq_file *m)
+{
+	static const char *names[] = { "8bit", "16bit", "32bit" };
+	int i, j, used;
+
+	if (!usergart)
+		return;
+
+	seq_printf(m, "fmt\tentries\tused\tfaults\tprefaults\tevictions\n");
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		for (j = 0, used = 0; j < usergart[i].num_entries; j++)
+			if (usergart[i].entry[j].obj)
+				used++;
+
+		seq_printf(m, "%s\t%d\t%d\t%lu\t%lu\t\t%lu\n", names[i],
+				usergart[i].num_entries, used,
+				usergart[i].faults, usergart[i].prefaults,
+				usergart[i].evictions);
+	}
+}
 #endif
 
 /* Buffer Synchronization:
@@ -1204,6 +1423,9 @@ int omap_gem_op_sync(struct drm_gem_object *obj, enum omap_gem_op op)
 				}
 			}
 		}
+		/* the buffer is not usable if its TILER mapping failed */
+		if (!ret)
+			ret = omap_obj->pin_err;
 		spin_unlock(&sync_lock);
 
 		kfree(waiter);
@@ -1462,7 +1684,7 @@ void omap_gem_init(struct drm_device *dev)
 	const enum tiler_fmt fmts[] = {
 			TILFMT_8BIT, TILFMT_16BIT, TILFMT_32BIT
 	};
-	int i, j;
+	int i, j, num_entries;
 
 	if (!dmm_is_initialized()) {
 		/* DMM only supported on OMAP4 and later, so this isn't fatal */
@@ -1476,6 +1698,8 @@ void omap_gem_init(struct drm_device *dev)
 		return;
 	}
 
+	num_entries = clamp(usergart_entries, 1, MAX_USERGART_ENTRIES);
+
 	/* reserve 4k aligned/wide regions for userspace mappings: */
 	for (i = 0; i < ARRAY_SIZE(fmts); i++) {
 		uint16_t h = 1, w = PAGE_SIZE >> i;
@@ -1488,7 +1712,14 @@ void omap_gem_init(struct drm_device *dev)
 		usergart[i].height_shift = ilog2(h);
 		usergart[i].stride_pfn = tiler_stride(fmts[i], 0) >> PAGE_SHIFT;
 		usergart[i].slot_shift = ilog2((PAGE_SIZE / h) >> i);
-		for (j = 0; j < NUM_USERGART_ENTRIES; j++) {
+		INIT_LIST_HEAD(&usergart[i].lru);
+		usergart[i].entry = kcalloc(num_entries,
+				sizeof(*usergart[i].entry), GFP_KERNEL);
+		if (!usergart[i].entry) {
+			dev_err(dev->dev, "could not allocate usergart\n");
+			goto fail;
+		}
+		for (j = 0; j < num_entries; j++) {
 			struct usergart_entry *entry = &usergart[i].entry[j];
 			struct tiler_block *block =
 					tiler_reserve_2d(fmts[i], w, h,
@@ -1497,10 +1728,15 @@ void omap_gem_init(struct drm_device *dev)
 				dev_err(dev->dev,
 						"reserve failed: %d, %d, %ld\n",
 						i, j, PTR_ERR(block));
-				return;
+				/* make do with the entries we have, if any */
+				if (!j)
+					goto fail;
+				break;
 			}
 			entry->paddr = tiler_ssptr(block);
 			entry->block = block;
+			list_add_tail(&entry->lru, &usergart[i].lru);
+			usergart[i].num_entries++;
 
 			DBG("%d:%d: %dx%d: paddr=%08x stride=%d", i, j, w, h,
 					entry->paddr,
@@ -1509,6 +1745,17 @@ void omap_gem_init(struct drm_device *dev)
 	}
 
 	priv->has_dmm = true;
+	return;
+
+fail:
+	/* without usergart, tiled buffers cannot be allocated */
+	for (i = 0; i < ARRAY_SIZE(fmts); i++) {
+		for (j = 0; j < usergart[i].num_entries; j++)
+			tiler_release(usergart[i].entry[j].block);
+		kfree(usergart[i].entry);
+	}
+	kfree(usergart);
+	usergart = NULL;
 }
 
 void omap_gem_deinit(struct drm_device *dev)
@@ -1516,6 +1763,11 @@ void omap_gem_deinit(struct drm_device *dev)
 	/* I believe we can rely on there being no more outstanding GEM
 	 * objects which could depend on usergart/dmm at this point.
 	 */
+	if (usergart) {
+		int i;
+		for (i = 0; i < 3; i++)
+			kfree(usergart[i].entry);
+	}
 	kfree(usergart);
 }
 
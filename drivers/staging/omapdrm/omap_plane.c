@@ -66,6 +66,9 @@ struct omap_plane {
 
 	/* callback on next endwin irq */
 	struct callback endwin;
+
+	/* signalled once dss has taken in the last commit */
+	struct omap_dss_fence fence;
 };
 
 /* map from ovl->id to the irq we are interested in for scanout-done */
@@ -113,6 +116,15 @@ static void unpin_worker(struct work_struct *work)
 		endwin.fxn(endwin.arg);
 }
 
+static void fence_cb(struct omap_dss_fence *fence)
+{
+	struct omap_plane *omap_plane =
+			container_of(fence, struct omap_plane, fence);
+	struct omap_drm_private *priv = omap_plane->base.dev->dev_private;
+
+	queue_work(priv->wq, &omap_plane->work);
+}
+
 static void install_irq(struct drm_plane *plane)
 {
 	struct omap_plane *omap_plane = to_omap_plane(plane);
@@ -166,19 +178,14 @@ static int commit(struct drm_plane *plane)
 	 * could this be in the encoder somehow?
 	 */
 	if (ovl->manager) {
-		ret = ovl->manager->apply(ovl->manager);
+		/* unpin the old buffers once dss has switched to new ones: */
+		ret = omap_dss_apply_commit(1 << ovl->manager->id,
+				omap_plane->num_unpins > 0 ?
+						&omap_plane->fence : NULL);
 		if (ret) {
 			dev_err(dev->dev, "could not apply settings\n");
 			return ret;
 		}
-
-		/*
-		 * NOTE: really this should be atomic w/ mgr->apply() but
-		 * omapdss does not expose such an API
-		 */
-		if (omap_plane->num_unpins > 0)
-			install_irq(plane);
-
 	} else {
 		struct omap_drm_private *priv = dev->dev_private;
 		queue_work(priv->wq, &omap_plane->work);
@@ -367,6 +374,7 @@ static void omap_plane_destroy(struct drm_plane *plane)
 	DBG("%s", omap_plane->ovl->name);
 	omap_plane_disable(plane);
 	drm_plane_cleanup(plane);
+	omap_dss_fence_cancel(&omap_plane->fence);
 	WARN_ON(omap_plane->pending_num_unpins + omap_plane->num_unpins > 0);
 	kfifo_free(&omap_plane->unpin_fifo);
 	kfree(omap_plane);
@@ -494,6 +502,7 @@ struct drm_plane *omap_plane_init(struct drm_device *dev,
 	}
 
 	INIT_WORK(&omap_plane->work, unpin_worker);
+	omap_dss_fence_init(&omap_plane->fence, fence_cb);
 
 	omap_plane->nformats = omap_framebuffer_get_formats(
 			omap_plane->formats, ARRAY_SIZE(omap_plane->formats),
@@ -0,0 +1,383 @@
+/*
+ * tcm-rowmap.c
+ *
+ * Row bitmap TILER container manager (RowMap): 2D and 1D allocation
+ * (reservation) algorithm
+ *
+ * The container is kept as one busy bit per slot, row after row, along with
+ * a small free space summary of every row (see struct rowmap_row).  A 2D
+ * area of height h fits at row y only if each of the rows y..y+h-1 has a
+ * free run of at least the area width, so the scanners skip whole bands of
+ * rows on the summaries alone and only combine the bitmaps of the bands
+ * that may fit, a word at a time.  Reserve and free therefore cost
+ * O(rows * words per row) no matter how many areas are allocated, where
+ * SiTA walks (and on free rewrites) the per-slot area map.
+ *
+ * Placement follows SiTA: aligned 2D areas are packed from the top-left,
+ * unaligned 2D areas from the top-right and 1D areas from the bottom-right
+ * of the container.
+ *
+ * This package is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * THIS PACKAGE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+#include <linux/bitmap.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include "tcm-rowmap.h"
+
+#define ROW(pvt, y) ((pvt)->map + (y) * (pvt)->words)
+
+/*********************************************
+ *	Support Infrastructure Methods
+ *********************************************/
+
+/* recompute the free space summary of row y */
+static void update_row(struct tcm *tcm, u16 y)
+{
+	struct rowmap_pvt *pvt = tcm->pvt;
+	struct rowmap_row *r = &pvt->row[y];
+	unsigned long *map = ROW(pvt, y);
+	int x, end;
+
+	x = find_first_bit(map, tcm->width);
+	r->lead = r->run = x;
+	if (x == tcm->width) {
+		r->trail = x;
+		return;
+	}
+
+	r->trail = tcm->width - 1 - find_last_bit(map, tcm->width);
+	r->run = max(r->lead, r->trail);
+
+	/* walk the free runs between the first and last busy slots */
+	while (1) {
+		x = find_next_zero_bit(map, tcm->width, x);
+		if (x >= tcm->width - r->trail)
+			break;
+		end = find_next_bit(map, tcm->width, x);
+		r->run = max_t(u16, r->run, end - x);
+		x = end;
+	}
+}
+
+/* find the rightmost run of w free slots in a row, -1 if there is none */
+static int find_last_fit(unsigned long *map, u16 width, u16 w)
+{
+	int x = 0, end, found = -1;
+
+	while (1) {
+		x = find_next_zero_bit(map, width, x);
+		if (x >= width)
+			break;
+		end = find_next_bit(map, width, x);
+		if (end - x >= w)
+			found = end - w;
+		x = end;
+	}
+
+	return found;
+}
+
+/*
+ * Mark (busy = true) or clear the slots of an area in the busy map.  Returns
+ * false if any slot was already in the requested state, which means the
+ * area does not match what is in the container.
+ */
+static bool fill_area(struct tcm *tcm, struct tcm_area *area, bool busy)
+{
+	struct rowmap_pvt *pvt = tcm->pvt;
+	unsigned long *map;
+	u16 x0, x1, y;
+	bool ok = true;
+
+	for (y = area->p0.y; y <= area->p1.y; y++) {
+		map = ROW(pvt, y);
+
+		/* a 1D area spans whole rows except for its first and last */
+		x0 = area->is2d || y == area->p0.y ? area->p0.x : 0;
+		x1 = area->is2d || y == area->p1.y ? area->p1.x :
+						     tcm->width - 1;
+
+		if (busy) {
+			ok &= find_next_bit(map, x1 + 1, x0) > x1;
+			bitmap_set(map, x0, x1 - x0 + 1);
+		} else {
+			ok &= find_next_zero_bit(map, x1 + 1, x0) > x1;
+			bitmap_clear(map, x0, x1 - x0 + 1);
+		}
+
+		update_row(tcm, y);
+	}
+
+	return ok;
+}
+
+/*********************************************
+ *	Main Scanner functions
+ *********************************************/
+
+/**
+ * Scan the container top to bottom for a place for a 2D area, left to
+ * right if r2l is false and right to left otherwise.
+ *
+ * @param w	width of desired area
+ * @param h	height of desired area
+ * @param align	desired area alignment (ignored when scanning right to left)
+ * @param area	pointer to the area that will be set to the found position
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static s32 scan_2d(struct tcm *tcm, u16 w, u16 h, u16 align, bool r2l,
+		   struct tcm_area *area)
+{
+	struct rowmap_pvt *pvt = tcm->pvt;
+	unsigned long *band = pvt->band;
+	unsigned long x;
+	u16 y = 0, i;
+	int fit;
+
+	while (y + h <= tcm->height) {
+		/* restart below the lowest row of the band that is too full */
+		for (i = h; i > 0; i--)
+			if (pvt->row[y + i - 1].run < w)
+				break;
+		if (i) {
+			y += i;
+			continue;
+		}
+
+		/* a slot is usable only if it is free in every row */
+		bitmap_copy(band, ROW(pvt, y), tcm->width);
+		for (i = 1; i < h; i++)
+			bitmap_or(band, band, ROW(pvt, y + i), tcm->width);
+
+		if (r2l) {
+			fit = find_last_fit(band, tcm->width, w);
+			if (fit >= 0) {
+				x = fit;
+				goto found;
+			}
+		} else {
+			x = bitmap_find_next_zero_area(band, tcm->width, 0, w,
+						       align - 1);
+			if (x + w <= tcm->width)
+				goto found;
+		}
+
+		y++;
+	}
+
+	return -ENOSPC;
+
+found:
+	area->p0.x = x;
+	area->p0.y = y;
+	area->p1.x = x + w - 1;
+	area->p1.y = y + h - 1;
+	return 0;
+}
+
+/**
+ * Scan the container from the bottom-right, in raster order, for the last
+ * run of num_slots free slots.  Runs may span several rows; rows that are
+ * completely free or cannot hold the area are passed over on their
+ * summaries alone.
+ *
+ * @param num_slots	size of desired area
+ * @param area		pointer to the area that will be set to the found
+ *			position
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static s32 scan_1d(struct tcm *tcm, u32 num_slots, struct tcm_area *area)
+{
+	struct rowmap_pvt *pvt = tcm->pvt;
+	struct rowmap_row *r;
+	u32 run = 0;		/* free slots from the row start to 'end' */
+	u32 end = 0;		/* raster index of the last slot of the run */
+	u32 start;
+	s32 y;
+	int x;
+
+	for (y = tcm->height - 1; y >= 0; y--) {
+		r = &pvt->row[y];
+
+		/* free slots at the end of the row extend the current run */
+		if (r->trail) {
+			if (!run)
+				end = y * tcm->width + tcm->width - 1;
+			run += r->trail;
+			if (run >= num_slots)
+				goto found;
+		}
+
+		if (r->lead == tcm->width)
+			continue;
+
+		/* otherwise the run is broken inside this row */
+		if (r->run >= num_slots) {
+			x = find_last_fit(ROW(pvt, y), tcm->width, num_slots);
+			if (x >= 0) {
+				end = y * tcm->width + x + num_slots - 1;
+				goto found;
+			}
+		}
+
+		run = r->lead;
+		end = y * tcm->width + r->lead - 1;
+	}
+
+	return -ENOSPC;
+
+found:
+	start = end - num_slots + 1;
+	area->p0.x = start % tcm->width;
+	area->p0.y = start / tcm->width;
+	area->p1.x = end % tcm->width;
+	area->p1.y = end / tcm->width;
+	return 0;
+}
+
+/*********************************************
+ *	TCM API - RowMap Implementation
+ *********************************************/
+
+/**
+ * Reserve a 1D area in the container
+ *
+ * @param num_slots	size of 1D area
+ * @param area		pointer to the area that will be populated with the
+ *			reserved area
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static s32 rowmap_reserve_1d(struct tcm *tcm, u32 num_slots,
+			     struct tcm_area *area)
+{
+	struct rowmap_pvt *pvt = tcm->pvt;
+	s32 ret;
+
+	spin_lock(&pvt->lock);
+	ret = scan_1d(tcm, num_slots, area);
+	if (!ret)
+		fill_area(tcm, area, true);
+	spin_unlock(&pvt->lock);
+
+	return ret;
+}
+
+/**
+ * Reserve a 2D area in the container
+ *
+ * @param w	width
+ * @param h	height
+ * @param area	pointer to the area that will be populated with the reserved
+ *		area
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static s32 rowmap_reserve_2d(struct tcm *tcm, u16 h, u16 w, u8 align,
+			     struct tcm_area *area)
+{
+	struct rowmap_pvt *pvt = tcm->pvt;
+	s32 ret;
+
+	if (align > tcm->width)
+		return -EINVAL;
+
+	spin_lock(&pvt->lock);
+	/* like SiTA, keep aligned areas left and unaligned ones right */
+	ret = scan_2d(tcm, w, h, align ? : 1, align <= 1, area);
+	if (!ret)
+		fill_area(tcm, area, true);
+	spin_unlock(&pvt->lock);
+
+	return ret;
+}
+
+/**
+ * Unreserve a previously allocated 2D or 1D area
+ * @param area	area to be freed
+ * @return 0 - success
+ */
+static s32 rowmap_free(struct tcm *tcm, struct tcm_area *area)
+{
+	struct rowmap_pvt *pvt = tcm->pvt;
+	bool ok;
+
+	spin_lock(&pvt->lock);
+	ok = fill_area(tcm, area, false);
+	spin_unlock(&pvt->lock);
+
+	/* check that this was in fact an existing area */
+	WARN_ON(!ok);
+
+	return 0;
+}
+
+static void rowmap_deinit(struct tcm *tcm)
+{
+	struct rowmap_pvt *pvt = tcm->pvt;
+
+	kfree(pvt->row);
+	kfree(pvt->band);
+	kfree(pvt->map);
+	kfree(pvt);
+	kfree(tcm);
+}
+
+struct tcm *rowmap_init(u16 width, u16 height)
+{
+	struct tcm *tcm;
+	struct rowmap_pvt *pvt;
+	u16 y;
+
+	if (width == 0 || height == 0)
+		return NULL;
+
+	tcm = kzalloc(sizeof(*tcm), GFP_KERNEL);
+	pvt = kzalloc(sizeof(*pvt), GFP_KERNEL);
+	if (!tcm || !pvt)
+		goto error;
+
+	pvt->words = BITS_TO_LONGS(width);
+	pvt->map = kcalloc(height * pvt->words, sizeof(*pvt->map),
+			   GFP_KERNEL);
+	pvt->band = kcalloc(pvt->words, sizeof(*pvt->band), GFP_KERNEL);
+	pvt->row = kcalloc(height, sizeof(*pvt->row), GFP_KERNEL);
+	if (!pvt->map || !pvt->band || !pvt->row)
+		goto error;
+
+	spin_lock_init(&pvt->lock);
+
+	/* Updating the pointers to RowMap implementation APIs */
+	tcm->height = height;
+	tcm->width = width;
+	tcm->reserve_2d = rowmap_reserve_2d;
+	tcm->reserve_1d = rowmap_reserve_1d;
+	tcm->free = rowmap_free;
+	tcm->deinit = rowmap_deinit;
+	tcm->pvt = pvt;
+
+	for (y = 0; y < height; y++)
+		update_row(tcm, y);
+
+	return tcm;
+
+error:
+	if (pvt) {
+		kfree(pvt->row);
+		kfree(pvt->band);
+		kfree(pvt->map);
+	}
+	kfree(pvt);
+	kfree(tcm);
+	return NULL;
+}
@@ -0,0 +1,39 @@
+/*
+ * tcm-rowmap.h
+ *
+ * Row bitmap TILER container manager (RowMap) private structures.
+ *
+ * This package is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * THIS PACKAGE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef _TCM_ROWMAP_H
+#define _TCM_ROWMAP_H
+
+#include "tcm.h"
+
+/*
+ * Free space summary of one container row.  A row with lead == width is
+ * completely free.  The summary is refreshed whenever the row changes, so
+ * the scanners can reject rows without looking at their bitmaps.
+ */
+struct rowmap_row {
+	u16 lead;		/* free slots before the first busy slot */
+	u16 trail;		/* free slots after the last busy slot */
+	u16 run;		/* longest run of free slots */
+};
+
+struct rowmap_pvt {
+	spinlock_t lock;	/* spinlock to protect access */
+	u16 words;		/* longs per row in the busy map */
+	unsigned long *map;	/* busy bit per slot, one row after another */
+	unsigned long *band;	/* scratch row for combining a band of rows */
+	struct rowmap_row *row;	/* per-row free space summary */
+};
+
+#endif
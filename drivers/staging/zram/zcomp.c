@@ -0,0 +1,286 @@
+/*
+ * Compressed RAM block device - compression streams
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/err.h>
+#include <linux/gfp.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zcomp.h"
+
+/*
+ * Algorithms a device may be configured with, in order of preference.
+ * Any of them may be missing from the running kernel; availability is
+ * checked with the crypto API when one is selected.
+ */
+const char * const zcomp_backends[] = {
+	"lzo",
+	"lz4",
+	"deflate",
+	NULL
+};
+
+const char *zcomp_lookup_backend(const char *name)
+{
+	int i;
+
+	for (i = 0; zcomp_backends[i]; i++) {
+		if (sysfs_streq(name, zcomp_backends[i]))
+			return zcomp_backends[i];
+	}
+
+	return NULL;
+}
+
+static void zcomp_strm_free(struct zcomp_strm *zstrm)
+{
+	if (!IS_ERR_OR_NULL(zstrm->tfm))
+		crypto_free_comp(zstrm->tfm);
+	free_pages((unsigned long)zstrm->buffer, 1);
+	kfree(zstrm);
+}
+
+static struct zcomp_strm *zcomp_strm_alloc(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+
+	zstrm = kzalloc(sizeof(*zstrm), GFP_KERNEL);
+	if (!zstrm)
+		return NULL;
+
+	zstrm->tfm = crypto_alloc_comp(comp->name, 0, 0);
+	/*
+	 * The output buffer is two pages since the compressed size of
+	 * an incompressible page may exceed PAGE_SIZE.
+	 */
+	zstrm->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (IS_ERR(zstrm->tfm) || !zstrm->buffer) {
+		zcomp_strm_free(zstrm);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&zstrm->list);
+	return zstrm;
+}
+
+static int zcomp_idle_available(struct zcomp *comp)
+{
+	int ret;
+
+	spin_lock(&comp->strm_lock);
+	ret = !list_empty(&comp->idle_strm);
+	spin_unlock(&comp->strm_lock);
+
+	return ret;
+}
+
+/*
+ * Get an idle stream, sleeping until another user releases one if
+ * the pool is exhausted. Must not be called in atomic context.
+ */
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+	ktime_t start;
+	int waited = 0;
+
+	spin_lock(&comp->strm_lock);
+	while (list_empty(&comp->idle_strm)) {
+		spin_unlock(&comp->strm_lock);
+
+		if (!waited) {
+			start = ktime_get();
+			waited = 1;
+		}
+		wait_event(comp->strm_wait, zcomp_idle_available(comp));
+
+		spin_lock(&comp->strm_lock);
+	}
+
+	zstrm = list_first_entry(&comp->idle_strm, struct zcomp_strm, list);
+	list_del(&zstrm->list);
+
+	if (waited) {
+		comp->wait_count++;
+		comp->wait_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+	spin_unlock(&comp->strm_lock);
+
+	return zstrm;
+}
+
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm)
+{
+	spin_lock(&comp->strm_lock);
+	if (comp->avail_strm <= comp->max_strm) {
+		list_add(&zstrm->list, &comp->idle_strm);
+		spin_unlock(&comp->strm_lock);
+		wake_up(&comp->strm_wait);
+		return;
+	}
+
+	/* The pool was shrunk while this stream was in use */
+	comp->avail_strm--;
+	spin_unlock(&comp->strm_lock);
+	zcomp_strm_free(zstrm);
+}
+
+/*
+ * Change the number of streams. Growing allocates the new streams
+ * right away. When shrinking, idle streams in excess of the new limit
+ * are freed immediately and busy ones as they are released.
+ */
+int zcomp_set_max_streams(struct zcomp *comp, int num_strm)
+{
+	struct zcomp_strm *zstrm;
+	int ret = 0;
+
+	if (num_strm < 1)
+		return -EINVAL;
+
+	spin_lock(&comp->strm_lock);
+	comp->max_strm = num_strm;
+	while (comp->avail_strm < num_strm) {
+		comp->avail_strm++;
+		spin_unlock(&comp->strm_lock);
+
+		zstrm = zcomp_strm_alloc(comp);
+
+		spin_lock(&comp->strm_lock);
+		if (!zstrm) {
+			comp->avail_strm--;
+			comp->max_strm = comp->avail_strm;
+			ret = -ENOMEM;
+			break;
+		}
+		list_add(&zstrm->list, &comp->idle_strm);
+	}
+
+	while (comp->avail_strm > num_strm &&
+	       !list_empty(&comp->idle_strm)) {
+		zstrm = list_first_entry(&comp->idle_strm,
+				struct zcomp_strm, list);
+		list_del(&zstrm->list);
+		comp->avail_strm--;
+		spin_unlock(&comp->strm_lock);
+		zcomp_strm_free(zstrm);
+		spin_lock(&comp->strm_lock);
+	}
+	spin_unlock(&comp->strm_lock);
+
+	wake_up_all(&comp->strm_wait);
+	return ret;
+}
+
+void zcomp_wait_stats(struct zcomp *comp, u64 *count, u64 *ns)
+{
+	spin_lock(&comp->strm_lock);
+	*count = comp->wait_count;
+	*ns = comp->wait_ns;
+	spin_unlock(&comp->strm_lock);
+}
+
+void zcomp_get_stats(struct zcomp *comp, struct zcomp_stats *stats)
+{
+	spin_lock(&comp->stat_lock);
+	*stats = comp->stats;
+	spin_unlock(&comp->stat_lock);
+}
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len)
+{
+	unsigned int len = 2 * PAGE_SIZE;
+	ktime_t start;
+	s64 delta;
+	int ret;
+
+	start = ktime_get();
+	ret = crypto_comp_compress(zstrm->tfm, src, PAGE_SIZE,
+				   zstrm->buffer, &len);
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (ret)
+		return ret;
+
+	*dst_len = len;
+
+	spin_lock(&comp->stat_lock);
+	comp->stats.num_compress++;
+	comp->stats.compress_in += PAGE_SIZE;
+	comp->stats.compress_out += len;
+	comp->stats.compress_ns += delta;
+	spin_unlock(&comp->stat_lock);
+
+	return 0;
+}
+
+int zcomp_decompress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t src_len, unsigned char *dst)
+{
+	unsigned int dst_len = PAGE_SIZE;
+	ktime_t start;
+	s64 delta;
+	int ret;
+
+	start = ktime_get();
+	ret = crypto_comp_decompress(zstrm->tfm, src, src_len,
+				     dst, &dst_len);
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (ret)
+		return ret;
+
+	spin_lock(&comp->stat_lock);
+	comp->stats.num_decompress++;
+	comp->stats.decompress_ns += delta;
+	spin_unlock(&comp->stat_lock);
+
+	return 0;
+}
+
+void zcomp_destroy(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+
+	while (!list_empty(&comp->idle_strm)) {
+		zstrm = list_first_entry(&comp->idle_strm,
+				struct zcomp_strm, list);
+		list_del(&zstrm->list);
+		zcomp_strm_free(zstrm);
+	}
+	kfree(comp);
+}
+
+struct zcomp *zcomp_create(const char *name, int max_strm)
+{
+	struct zcomp *comp;
+
+	comp = kzalloc(sizeof(*comp), GFP_KERNEL);
+	if (!comp)
+		return NULL;
+
+	comp->name = name;
+	spin_lock_init(&comp->strm_lock);
+	spin_lock_init(&comp->stat_lock);
+	INIT_LIST_HEAD(&comp->idle_strm);
+	init_waitqueue_head(&comp->strm_wait);
+
+	if (zcomp_set_max_streams(comp, max_strm)) {
+		zcomp_destroy(comp);
+		return NULL;
+	}
+
+	return comp;
+}
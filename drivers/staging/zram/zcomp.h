@@ -0,0 +1,80 @@
+/*
+ * Compressed RAM block device - compression streams
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZCOMP_H_
+#define _ZCOMP_H_
+
+#include <linux/crypto.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+/*
+ * A compression stream holds everything a single user needs to
+ * (de)compress one page: a crypto API transform for the selected
+ * algorithm and an output buffer large enough for the worst case
+ * expansion.
+ */
+struct zcomp_strm {
+	struct crypto_comp *tfm;
+	void *buffer;
+	struct list_head list;
+};
+
+struct zcomp_stats {
+	u64 num_compress;
+	u64 compress_in;	/* bytes fed to the compressor */
+	u64 compress_out;	/* bytes it produced */
+	u64 compress_ns;
+	u64 num_decompress;
+	u64 decompress_ns;
+};
+
+/*
+ * Pool of compression streams shared by all users of a device.
+ * Streams are preallocated up to max_strm since the crypto API
+ * allocates transforms with GFP_KERNEL, which we cannot do from the
+ * swap-out path. When the pool is exhausted users sleep on strm_wait
+ * until a stream is released.
+ */
+struct zcomp {
+	const char *name;
+
+	spinlock_t strm_lock;		/* protects all fields below */
+	struct list_head idle_strm;
+	wait_queue_head_t strm_wait;
+	int avail_strm;			/* no. of streams allocated */
+	int max_strm;
+
+	u64 wait_count;			/* no. of times a user slept */
+	u64 wait_ns;			/* total time users slept */
+
+	spinlock_t stat_lock;		/* protects stats */
+	struct zcomp_stats stats;
+};
+
+extern const char * const zcomp_backends[];
+
+const char *zcomp_lookup_backend(const char *name);
+struct zcomp *zcomp_create(const char *name, int max_strm);
+void zcomp_destroy(struct zcomp *comp);
+
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp);
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm);
+int zcomp_set_max_streams(struct zcomp *comp, int num_strm);
+void zcomp_wait_stats(struct zcomp *comp, u64 *count, u64 *ns);
+void zcomp_get_stats(struct zcomp *comp, struct zcomp_stats *stats);
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len);
+int zcomp_decompress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t src_len, unsigned char *dst);
+
+#endif /* _ZCOMP_H_ */
@@ -0,0 +1,152 @@
+/*
+ * Compressed RAM block device - deduplication of identical pages
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zram_drv.h"
+
+/*
+ * Compressed objects are indexed by a hash of their uncompressed
+ * contents. Pages with the same hash are compared byte by byte (by
+ * decompressing the stored object) before an object is shared, so
+ * hash collisions never alias different data.
+ */
+u32 zram_dedup_checksum(const void *mem)
+{
+	return jhash2(mem, PAGE_SIZE / sizeof(u32), 0);
+}
+
+static int zram_dedup_match(struct zram *zram, struct zcomp_strm *zstrm,
+			struct zram_dedup_entry *entry, const void *mem)
+{
+	unsigned char *cmem;
+	int ret;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle);
+	ret = zcomp_decompress(zram->comp, zstrm,
+			       cmem + sizeof(struct zobj_header),
+			       entry->size, zstrm->buffer);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return !ret && !memcmp(zstrm->buffer, mem, PAGE_SIZE);
+}
+
+/*
+ * Look up a stored object whose contents equal the page at mem and
+ * take a reference to it. zstrm->buffer is used as scratch space, so
+ * this must be called before compressing into the same stream.
+ * Does not sleep.
+ */
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		struct zcomp_strm *zstrm, const void *mem, u32 checksum)
+{
+	struct rb_node *node;
+	struct zram_dedup_entry *entry;
+
+	spin_lock(&zram->dedup_lock);
+	node = zram->dedup_root.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_dedup_entry, rb_node);
+		if (checksum < entry->checksum) {
+			node = node->rb_left;
+		} else if (checksum > entry->checksum) {
+			node = node->rb_right;
+		} else {
+			/* Walk back to the first entry with this checksum */
+			struct rb_node *prev = rb_prev(node);
+
+			while (prev) {
+				entry = rb_entry(prev, struct zram_dedup_entry,
+						 rb_node);
+				if (entry->checksum != checksum)
+					break;
+				node = prev;
+				prev = rb_prev(node);
+			}
+			break;
+		}
+	}
+
+	for (; node; node = rb_next(node)) {
+		entry = rb_entry(node, struct zram_dedup_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+
+		if (zram_dedup_match(zram, zstrm, entry, mem)) {
+			entry->refcount++;
+			spin_unlock(&zram->dedup_lock);
+			return entry;
+		}
+	}
+	spin_unlock(&zram->dedup_lock);
+
+	return NULL;
+}
+
+/*
+ * Make a newly stored object available for sharing. Returns the
+ * index entry, holding one reference, or NULL if it could not be
+ * allocated in which case the caller keeps using the plain handle.
+ */
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram, void *handle,
+		u16 size, u32 checksum)
+{
+	struct rb_node **link, *parent = NULL;
+	struct zram_dedup_entry *entry, *cur;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->size = size;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+
+	spin_lock(&zram->dedup_lock);
+	link = &zram->dedup_root.rb_node;
+	while (*link) {
+		parent = *link;
+		cur = rb_entry(parent, struct zram_dedup_entry, rb_node);
+		if (checksum < cur->checksum)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, link);
+	rb_insert_color(&entry->rb_node, &zram->dedup_root);
+	spin_unlock(&zram->dedup_lock);
+
+	return entry;
+}
+
+/*
+ * Drop a reference to a shared object, freeing it along with its
+ * index entry when the last one goes away. Returns 1 in that case.
+ */
+int zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	spin_lock(&zram->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&zram->dedup_lock);
+		return 0;
+	}
+	rb_erase(&entry->rb_node, &zram->dedup_root);
+	spin_unlock(&zram->dedup_lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	kfree(entry);
+
+	return 1;
+}
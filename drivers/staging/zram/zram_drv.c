@@ -29,7 +29,6 @@
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -89,21 +88,66 @@ static void zram_clear_flag(struct zram *zram, u32 index,
 	zram->table[index].flags &= ~BIT(flag);
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * Check whether the page consists of a single repeated word, which
+ * is then returned in *element. Zero pages are the common case.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
+static void zram_fill_page(void *ptr, unsigned int len, unsigned long value)
+{
+	unsigned int pos;
+	unsigned long *page;
+
+	page = (unsigned long *)ptr;
+
+	for (pos = 0; pos != len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static u32 zram_now(void)
+{
+	struct timespec ts;
+
+	ktime_get_ts(&ts);
+	return ts.tv_sec;
+}
+#endif
+
+/* Record an access to a page, for idle page writeback */
+static void zram_accessed(struct zram *zram, u32 index)
+{
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram->table[index].ac_time = zram_now();
+#endif
+}
+
+/* zsmalloc handle of a compressed page, possibly shared through dedup */
+static void *zram_zs_handle(struct zram *zram, u32 index)
+{
+	void *handle = zram->table[index].handle;
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP))
+		return ((struct zram_dedup_entry *)handle)->handle;
+
+	return handle;
+}
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -137,6 +181,26 @@ static void zram_free_page(struct zram *zram, size_t index)
 {
 	void *handle = zram->table[index].handle;
 
+	/* Tell a writeback in progress that the page has changed */
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_clear_flag(zram, index, ZRAM_SAME);
+		zram_stat_dec(&zram->stats.pages_same);
+		zram->table[index].element = 0;
+		return;
+	}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_bd_free(zram, zram->table[index].element);
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram_stat_dec(&zram->stats.pages_wb);
+		zram->table[index].element = 0;
+		return;
+	}
+#endif
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -156,7 +220,19 @@ static void zram_free_page(struct zram *zram, size_t index)
 		goto out;
 	}
 
-	zs_free(zram->mem_pool, handle);
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		if (!zram_dedup_put(zram, handle)) {
+			/* Object is still in use by other pages */
+			zram_stat_dec(&zram->stats.pages_dup);
+			zram_stat64_sub(zram, &zram->stats.dup_data_size,
+					zram->table[index].size);
+			zram_stat_dec(&zram->stats.pages_stored);
+			goto clear;
+		}
+	} else {
+		zs_free(zram->mem_pool, handle);
+	}
 
 	if (zram->table[index].size <= PAGE_SIZE / 2)
 		zram_stat_dec(&zram->stats.good_compress);
@@ -166,6 +242,7 @@ out:
 			zram->table[index].size);
 	zram_stat_dec(&zram->stats.pages_stored);
 
+clear:
 	zram->table[index].handle = NULL;
 	zram->table[index].size = 0;
 }
@@ -182,6 +259,18 @@ static void handle_zero_page(struct bio_vec *bvec)
 	flush_dcache_page(page);
 }
 
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
+{
+	struct page *page = bvec->bv_page;
+	void *user_mem;
+
+	user_mem = kmap_atomic(page);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
+	kunmap_atomic(user_mem);
+
+	flush_dcache_page(page);
+}
+
 static void handle_uncompressed_page(struct zram *zram, struct bio_vec *bvec,
 				     u32 index, int offset)
 {
@@ -203,22 +292,75 @@ static inline int is_partial_io(struct bio_vec *bvec)
 	return bvec->bv_len != PAGE_SIZE;
 }
 
-static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
-			  u32 index, int offset, struct bio *bio)
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Copy len bytes at offset of a written back page to mem */
+static int zram_read_from_bd(struct zram *zram, u32 index, void *mem,
+			     int offset, int len)
 {
+	struct page *page;
+	void *src;
 	int ret;
-	size_t clen;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bd_read(zram, zram->table[index].element, page);
+	if (ret) {
+		pr_err("Backing device read failed! err=%d, page=%u\n",
+		       ret, index);
+		zram_stat64_inc(zram, &zram->stats.failed_reads);
+		goto out;
+	}
+	zram_stat64_inc(zram, &zram->stats.bd_reads);
+
+	src = kmap_atomic(page);
+	memcpy(mem, src + offset, len);
+	kunmap_atomic(src);
+
+out:
+	__free_page(page);
+	return ret;
+}
+#endif
+
+static int zram_bvec_read(struct zram *zram, struct zcomp_strm *zstrm,
+			  struct bio_vec *bvec, u32 index, int offset,
+			  struct bio *bio)
+{
+	int ret;
+	void *handle;
 	struct page *page;
 	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
 
 	page = bvec->bv_page;
 
+	zram_accessed(zram, index);
+
 	if (zram_test_flag(zram, index, ZRAM_ZERO)) {
 		handle_zero_page(bvec);
 		return 0;
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		handle_same_page(bvec, zram->table[index].element);
+		return 0;
+	}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		user_mem = kmap(page);
+		ret = zram_read_from_bd(zram, index,
+					user_mem + bvec->bv_offset,
+					offset, bvec->bv_len);
+		kunmap(page);
+		if (!ret)
+			flush_dcache_page(page);
+		return ret;
+	}
+#endif
+
 	/* Requested page is not present in compressed area */
 	if (unlikely(!zram->table[index].handle)) {
 		pr_debug("Read before write: sector=%lu, size=%u",
@@ -245,13 +387,12 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	user_mem = kmap_atomic(page);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
-	clen = PAGE_SIZE;
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+	handle = zram_zs_handle(zram, index);
+	cmem = zs_map_object(zram->mem_pool, handle);
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    uncmem, &clen);
+	ret = zcomp_decompress(zram->comp, zstrm, cmem + sizeof(*zheader),
+			       zram->table[index].size, uncmem);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -259,11 +400,11 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		kfree(uncmem);
 	}
 
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
+	zs_unmap_object(zram->mem_pool, handle);
 	kunmap_atomic(user_mem);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -274,35 +415,46 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	return 0;
 }
 
-static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
+static int zram_read_before_write(struct zram *zram, struct zcomp_strm *zstrm,
+				  char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
+	void *handle;
 	struct zobj_header *zheader;
 	unsigned char *cmem;
 
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_fill_page(mem, PAGE_SIZE, zram->table[index].element);
+		return 0;
+	}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	if (zram_test_flag(zram, index, ZRAM_WB))
+		return zram_read_from_bd(zram, index, mem, 0, PAGE_SIZE);
+#endif
+
 	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
 	    !zram->table[index].handle) {
 		memset(mem, 0, PAGE_SIZE);
 		return 0;
 	}
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
-
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic(zram->table[index].handle);
 		memcpy(mem, cmem, PAGE_SIZE);
 		kunmap_atomic(cmem);
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    mem, &clen);
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
+	handle = zram_zs_handle(zram, index);
+	cmem = zs_map_object(zram->mem_pool, handle);
+	ret = zcomp_decompress(zram->comp, zstrm, cmem + sizeof(*zheader),
+			       zram->table[index].size, mem);
+	zs_unmap_object(zram->mem_pool, handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -311,46 +463,45 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
-static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
-			   int offset)
+/*
+ * Only the table update is done under zram->lock. Compression runs
+ * on a stream taken from zram->comp, so concurrent writers compress
+ * in parallel.
+ */
+static int zram_bvec_write(struct zram *zram, struct zcomp_strm *zstrm,
+			   struct bio_vec *bvec, u32 index, int offset)
 {
-	int ret;
-	u32 store_offset;
+	int ret = 0;
+	int uncompressed = 0, dup = 0;
 	size_t clen;
-	void *handle;
+	void *handle = NULL;
+	u32 checksum = 0;
+	unsigned long element;
 	struct zobj_header *zheader;
+	struct zram_dedup_entry *entry = NULL;
 	struct page *page, *page_store;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
 		 * This is a partial IO. We need to read the full page
 		 * before to write the changes.
 		 */
-		uncmem = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
 		if (!uncmem) {
 			pr_info("Error allocating temp memory!\n");
 			ret = -ENOMEM;
 			goto out;
 		}
-		ret = zram_read_before_write(zram, uncmem, index);
-		if (ret) {
-			kfree(uncmem);
+		down_read(&zram->lock);
+		ret = zram_read_before_write(zram, zstrm, uncmem, index);
+		up_read(&zram->lock);
+		if (ret)
 			goto out;
-		}
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].handle ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
-
 	user_mem = kmap_atomic(page);
 
 	if (is_partial_io(bvec))
@@ -359,24 +510,46 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	else
 		uncmem = user_mem;
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		kunmap_atomic(user_mem);
-		if (is_partial_io(bvec))
-			kfree(uncmem);
-		zram_stat_inc(&zram->stats.pages_zero);
-		zram_set_flag(zram, index, ZRAM_ZERO);
-		ret = 0;
+
+		down_write(&zram->lock);
+		clear_bit(index, zram->pending_free);
+		if (zram->table[index].handle ||
+		    zram_test_flag(zram, index, ZRAM_ZERO))
+			zram_free_page(zram, index);
+		if (element) {
+			zram->table[index].element = element;
+			zram_stat_inc(&zram->stats.pages_same);
+			zram_set_flag(zram, index, ZRAM_SAME);
+		} else {
+			zram_stat_inc(&zram->stats.pages_zero);
+			zram_set_flag(zram, index, ZRAM_ZERO);
+		}
+		zram_accessed(zram, index);
+		up_write(&zram->lock);
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	if (zram->dedup_enable) {
+		checksum = zram_dedup_checksum(uncmem);
+		entry = zram_dedup_find(zram, zstrm, uncmem, checksum);
+		if (entry) {
+			kunmap_atomic(user_mem);
+			clen = entry->size;
+			dup = 1;
+			zram_stat64_inc(zram, &zram->stats.dedup_hits);
+			goto store;
+		}
+	}
+
+	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
 
 	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-			kfree(uncmem);
+	if (!is_partial_io(bvec))
+		uncmem = NULL;
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
@@ -396,55 +569,82 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 
-		store_offset = 0;
-		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_inc(&zram->stats.pages_expand);
+		uncompressed = 1;
 		handle = page_store;
-		src = kmap_atomic(page);
+		src = uncmem ? uncmem : kmap_atomic(page);
 		cmem = kmap_atomic(page_store);
-		goto memstore;
-	}
-
-	handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
-	if (!handle) {
-		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
-		ret = -ENOMEM;
-		goto out;
-	}
-	cmem = zs_map_object(zram->mem_pool, handle);
+		memcpy(cmem, src, clen);
+		kunmap_atomic(cmem);
+		if (!uncmem)
+			kunmap_atomic(src);
+	} else {
+		handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
+		if (!handle) {
+			pr_info("Error allocating memory for compressed "
+				"page: %u, size=%zu\n", index, clen);
+			ret = -ENOMEM;
+			goto out;
+		}
+		cmem = zs_map_object(zram->mem_pool, handle);
 
-memstore:
-#if 0
-	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
+		/* Back-reference needed for compaction */
 		zheader = (struct zobj_header *)cmem;
 		zheader->table_idx = index;
 		cmem += sizeof(*zheader);
+
+		memcpy(cmem, zstrm->buffer, clen);
+		zs_unmap_object(zram->mem_pool, handle);
+
+		/* Failure to index the object only costs the sharing */
+		if (zram->dedup_enable)
+			entry = zram_dedup_insert(zram, handle, clen,
+						  checksum);
 	}
-#endif
 
-	memcpy(cmem, src, clen);
+store:
+	down_write(&zram->lock);
 
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		kunmap_atomic(cmem);
-		kunmap_atomic(src);
-	} else {
-		zs_unmap_object(zram->mem_pool, handle);
+	/* Any deferred free of this slot refers to the old contents */
+	clear_bit(index, zram->pending_free);
+
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	if (zram->table[index].handle ||
+	    zram_test_flag(zram, index, ZRAM_ZERO))
+		zram_free_page(zram, index);
+
+	if (entry) {
+		handle = entry;
+		zram_set_flag(zram, index, ZRAM_DEDUP);
 	}
 
 	zram->table[index].handle = handle;
 	zram->table[index].size = clen;
+	zram_accessed(zram, index);
 
 	/* Update stats */
-	zram_stat64_add(zram, &zram->stats.compr_size, clen);
 	zram_stat_inc(&zram->stats.pages_stored);
+	if (dup) {
+		zram_stat_inc(&zram->stats.pages_dup);
+		zram_stat64_add(zram, &zram->stats.dup_data_size, clen);
+		goto unlock;
+	}
+	if (unlikely(uncompressed)) {
+		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+		zram_stat_inc(&zram->stats.pages_expand);
+	}
+	zram_stat64_add(zram, &zram->stats.compr_size, clen);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
 
-	return 0;
+unlock:
+	up_write(&zram->lock);
 
 out:
+	if (is_partial_io(bvec))
+		kfree(uncmem);
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
 	return ret;
@@ -454,17 +654,24 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio, int rw)
 {
 	int ret;
+	struct zcomp_strm *zstrm;
+
+	/*
+	 * Get a stream before taking zram->lock or mapping any page:
+	 * we may have to sleep until another user releases its stream.
+	 */
+	zstrm = zcomp_strm_find(zram->comp);
 
 	if (rw == READ) {
 		down_read(&zram->lock);
-		ret = zram_bvec_read(zram, bvec, index, offset, bio);
+		ret = zram_bvec_read(zram, zstrm, bvec, index, offset, bio);
 		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
-		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
+		ret = zram_bvec_write(zram, zstrm, bvec, index, offset);
 	}
 
+	zcomp_strm_release(zram->comp, zstrm);
+
 	return ret;
 }
 
@@ -577,33 +784,262 @@ error:
 	bio_io_error(bio);
 }
 
+/*
+ * Called by zs_compact() with zram->lock held for writing, after
+ * the object at old_handle was copied to new_handle. Find the table
+ * entry through the object's back-reference and repoint it.
+ */
+static int zram_migrate(struct zs_pool *pool, void *old_handle,
+			void *new_handle, void *priv)
+{
+	struct zram *zram = priv;
+	struct zobj_header *zheader;
+	struct zram_dedup_entry *entry;
+	u32 index;
+	int ret = -EBUSY;
+
+	zheader = zs_map_object(pool, new_handle);
+	index = zheader->table_idx;
+	zs_unmap_object(pool, new_handle);
+
+	if (index >= zram->disksize >> PAGE_SHIFT)
+		return -EINVAL;
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		/*
+		 * The back-reference is that of the first page stored
+		 * with this content, which may since have been freed.
+		 */
+		entry = zram->table[index].handle;
+		spin_lock(&zram->dedup_lock);
+		if (entry->handle == old_handle) {
+			entry->handle = new_handle;
+			ret = 0;
+		}
+		spin_unlock(&zram->dedup_lock);
+		return ret;
+	}
+
+	if (zram_test_flag(zram, index, ZRAM_UNCOMPRESSED) ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram->table[index].handle != old_handle)
+		return ret;
+
+	zram->table[index].handle = new_handle;
+	return 0;
+}
+
+unsigned long zram_compact(struct zram *zram)
+{
+	unsigned long freed;
+
+	down_write(&zram->lock);
+	freed = zs_compact(zram->mem_pool);
+	up_write(&zram->lock);
+
+	zram_stat64_add(zram, &zram->stats.pages_compacted, freed);
+	return freed;
+}
+
+static int zram_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct zram *zram = container_of(shrinker, struct zram, shrinker);
+	unsigned long freed;
+
+	if (sc->nr_to_scan) {
+		/* Never make reclaim wait for zram I/O */
+		if (!down_write_trylock(&zram->lock))
+			return -1;
+		freed = zs_compact(zram->mem_pool);
+		up_write(&zram->lock);
+
+		zram_stat64_add(zram, &zram->stats.pages_compacted, freed);
+	}
+
+	return zs_pages_compactable(zram->mem_pool);
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static int zram_wb_candidate(struct zram *zram, u32 index,
+			     enum zram_wb_mode mode, u32 now)
+{
+	if (!zram->table[index].handle ||
+	    test_bit(index, zram->pending_free) ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_DEDUP) ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB))
+		return 0;
+
+	if (mode == ZRAM_WB_HUGE)
+		return zram_test_flag(zram, index, ZRAM_UNCOMPRESSED);
+
+	return now - zram->table[index].ac_time >= zram->wb_idle_secs;
+}
+
+/*
+ * Move pages selected by mode to the backing device, returning the
+ * number moved. Pages are copied out under zram->lock and marked
+ * ZRAM_UNDER_WB, then written ZRAM_WB_BATCH at a time without the
+ * lock held. A page that was freed or overwritten meanwhile loses
+ * its ZRAM_UNDER_WB flag, and its copy on the backing device is
+ * dropped.
+ */
+unsigned long zram_writeback(struct zram *zram, enum zram_wb_mode mode)
+{
+	size_t index = 0, num_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long written = 0;
+	struct zram_wb_batch *batch;
+	struct zram_wb_req *req;
+	struct zcomp_strm *zstrm;
+	u32 now = zram_now();
+	void *mem;
+	int i, ret;
+
+	batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return 0;
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		batch->req[i].page = alloc_page(GFP_KERNEL);
+		if (!batch->req[i].page)
+			goto out;
+	}
+
+	while (index < num_pages) {
+		batch->nr = 0;
+
+		zstrm = zcomp_strm_find(zram->comp);
+		for (; index < num_pages && batch->nr < ZRAM_WB_BATCH;
+		     index++) {
+			req = &batch->req[batch->nr];
+
+			down_write(&zram->lock);
+			if (!zram_wb_candidate(zram, index, mode, now)) {
+				up_write(&zram->lock);
+				continue;
+			}
+
+			req->blk = zram_bd_alloc(zram);
+			if (!req->blk) {
+				up_write(&zram->lock);
+				/* Backing device is full */
+				num_pages = index;
+				break;
+			}
+
+			mem = kmap(req->page);
+			ret = zram_read_before_write(zram, zstrm, mem, index);
+			kunmap(req->page);
+			if (ret) {
+				zram_bd_free(zram, req->blk);
+				up_write(&zram->lock);
+				continue;
+			}
+
+			zram_set_flag(zram, index, ZRAM_UNDER_WB);
+			up_write(&zram->lock);
+
+			req->index = index;
+			batch->nr++;
+		}
+		zcomp_strm_release(zram->comp, zstrm);
+
+		if (!batch->nr)
+			continue;
+
+		zram_bd_write_batch(zram, batch);
+
+		for (i = 0; i < batch->nr; i++) {
+			req = &batch->req[i];
+
+			down_write(&zram->lock);
+			if (!req->error &&
+			    zram_test_flag(zram, req->index, ZRAM_UNDER_WB)) {
+				zram_free_page(zram, req->index);
+				zram->table[req->index].element = req->blk;
+				zram_set_flag(zram, req->index, ZRAM_WB);
+				zram_stat_inc(&zram->stats.pages_wb);
+				written++;
+			} else {
+				zram_clear_flag(zram, req->index,
+						ZRAM_UNDER_WB);
+				zram_bd_free(zram, req->blk);
+			}
+			up_write(&zram->lock);
+		}
+
+		cond_resched();
+	}
+
+	zram_stat64_add(zram, &zram->stats.bd_writes, written);
+
+out:
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		if (batch->req[i].page)
+			__free_page(batch->req[i].page);
+	}
+	kfree(batch);
+
+	return written;
+}
+#endif
+
+static void zram_free_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, free_work);
+	size_t index, num_pages = zram->disksize >> PAGE_SHIFT;
+
+	down_write(&zram->lock);
+	for_each_set_bit(index, zram->pending_free, num_pages) {
+		clear_bit(index, zram->pending_free);
+		zram_free_page(zram, index);
+	}
+	up_write(&zram->lock);
+}
+
 void __zram_reset_device(struct zram *zram)
 {
 	size_t index;
 
 	zram->init_done = 0;
 
-	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
+	if (zram->mem_pool)
+		unregister_shrinker(&zram->shrinker);
+	cancel_work_sync(&zram->free_work);
 
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	/* Free various per-device buffers */
+	if (zram->comp)
+		zcomp_destroy(zram->comp);
+	zram->comp = NULL;
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		void *handle = zram->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_WB))
 			continue;
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
 			__free_page(handle);
+		else if (zram_test_flag(zram, index, ZRAM_DEDUP))
+			zram_dedup_put(zram, handle);
 		else
 			zs_free(zram->mem_pool, handle);
 	}
+	zram->dedup_root = RB_ROOT;
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* The backing device stays attached, only its contents go */
+	if (zram->bd_map)
+		bitmap_zero(zram->bd_map, zram->nr_bd_pages);
+#endif
 
 	vfree(zram->table);
 	zram->table = NULL;
+	vfree(zram->pending_free);
+	zram->pending_free = NULL;
 
 	zs_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
@@ -635,17 +1071,9 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail_no_table;
-	}
-
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
+	zram->comp = zcomp_create(zram->compressor, zram->max_comp_streams);
+	if (!zram->comp) {
+		pr_err("Error allocating compression streams!\n");
 		ret = -ENOMEM;
 		goto fail_no_table;
 	}
@@ -658,17 +1086,27 @@ int zram_init_device(struct zram *zram)
 		goto fail_no_table;
 	}
 
+	zram->pending_free = vzalloc(BITS_TO_LONGS(num_pages) * sizeof(long));
+	if (!zram->pending_free) {
+		pr_err("Error allocating zram free bitmap\n");
+		ret = -ENOMEM;
+		goto fail;
+	}
+
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM);
+	zram->mem_pool = zs_create_pool(zram->disk->disk_name,
+					GFP_NOIO | __GFP_HIGHMEM);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
 		goto fail;
 	}
+	zs_set_migrate_callback(zram->mem_pool, zram_migrate, zram);
+	register_shrinker(&zram->shrinker);
 
 	zram->init_done = 1;
 	up_write(&zram->init_lock);
@@ -692,7 +1130,18 @@ static void zram_slot_free_notify(struct block_device *bdev,
 	struct zram *zram;
 
 	zram = bdev->bd_disk->private_data;
-	zram_free_page(zram, index);
+
+	/*
+	 * We are called under the swap lock and cannot sleep. If zram->lock
+	 * is busy, leave the free to zram_free_work().
+	 */
+	if (down_write_trylock(&zram->lock)) {
+		zram_free_page(zram, index);
+		up_write(&zram->lock);
+	} else {
+		set_bit(index, zram->pending_free);
+		schedule_work(&zram->free_work);
+	}
 	zram_stat64_inc(zram, &zram->stats.notify_free);
 }
 
@@ -708,6 +1157,18 @@ static int create_device(struct zram *zram, int device_id)
 	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	spin_lock_init(&zram->dedup_lock);
+	zram->dedup_root = RB_ROOT;
+	INIT_WORK(&zram->free_work, zram_free_work);
+	zram->shrinker.shrink = zram_shrink;
+	zram->shrinker.seeks = DEFAULT_SEEKS;
+
+	/* One compression stream per CPU unless told otherwise */
+	zram->max_comp_streams = num_online_cpus();
+	zram->compressor = zcomp_backends[0];
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram->wb_idle_secs = default_wb_idle_secs;
+#endif
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -770,6 +1231,10 @@ static void destroy_device(struct zram *zram)
 	sysfs_remove_group(&disk_to_dev(zram->disk)->kobj,
 			&zram_disk_attr_group);
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram_bd_close(zram);
+#endif
+
 	if (zram->disk) {
 		del_gendisk(zram->disk);
 		put_disk(zram->disk);
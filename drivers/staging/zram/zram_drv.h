@@ -17,8 +17,14 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/rbtree.h>
+#include <linux/shrinker.h>
+#include <linux/workqueue.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zcomp.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -33,9 +39,7 @@ static const unsigned max_num_devices = 32;
  * object. This is required to support memory defragmentation.
  */
 struct zobj_header {
-#if 0
 	u32 table_idx;
-#endif
 };
 
 /*-- Configurable parameters */
@@ -49,6 +53,12 @@ static const unsigned default_disksize_perc_ram = 25;
  */
 static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 
+/*
+ * Pages not accessed for this long are written back by 'writeback idle'
+ * unless changed through the 'writeback_idle_secs' sysfs node.
+ */
+static const u32 default_wb_idle_secs = 3600;
+
 /*
  * NOTE: max_zpage_size must be less than or equal to:
  *   ZS_MAX_ALLOC_SIZE - sizeof(struct zobj_header)
@@ -74,17 +84,47 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
 
+	/* Page is filled with a repeated non-zero word (table.element) */
+	ZRAM_SAME,
+
+	/* table.handle points to a shared struct zram_dedup_entry */
+	ZRAM_DEDUP,
+
+	/* Page is on the backing device, table.element is its block */
+	ZRAM_WB,
+
+	/* Page is being written to the backing device */
+	ZRAM_UNDER_WB,
+
 	__NR_ZRAM_PAGEFLAGS,
 };
 
 /*-- Data structures */
 
+/*
+ * A compressed object that may be shared by several disk pages with
+ * identical contents. Indexed by checksum in zram->dedup_root.
+ */
+struct zram_dedup_entry {
+	struct rb_node rb_node;
+	void *handle;		/* zsmalloc handle */
+	u32 checksum;
+	u16 size;		/* object size (excluding header) */
+	int refcount;		/* protected by zram->dedup_lock */
+};
+
 /* Allocated for each disk page */
 struct table {
-	void *handle;
+	union {
+		void *handle;
+		unsigned long element;	/* fill value of ZRAM_SAME pages */
+	};
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	u32 ac_time;	/* last access, in seconds of uptime */
+#endif
 } __attribute__((aligned(4)));
 
 struct zram_stats {
@@ -95,20 +135,39 @@ struct zram_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
+	u64 dup_data_size;	/* compressed bytes saved by dedup */
+	u64 dedup_hits;		/* no. of compressions avoided by dedup */
+	u64 pages_compacted;	/* no. of pages freed by compaction */
+	u64 bd_reads;		/* no. of pages read from backing device */
+	u64 bd_writes;		/* no. of pages written to backing device */
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of same element filled pages */
+	u32 pages_dup;		/* no. of pages sharing another's object */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 pages_wb;		/* no. of pages on backing device */
 };
 
 struct zram {
 	struct zs_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zcomp *comp;
 	struct table *table;
+	/* Index of shared objects, only used when dedup_enable is set */
+	struct rb_root dedup_root;
+	spinlock_t dedup_lock;
+	int dedup_enable;
+	/*
+	 * Swap slot frees that could not take zram->lock, see
+	 * zram_slot_free_notify().
+	 */
+	unsigned long *pending_free;
+	struct work_struct free_work;
+	/* Compacts mem_pool under memory pressure */
+	struct shrinker shrinker;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
+	struct rw_semaphore lock; /* protect table against concurrent
+				   * read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -119,6 +178,16 @@ struct zram {
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
+	/* Upper bound on concurrently compressing writers */
+	int max_comp_streams;
+	const char *compressor;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* Receives pages written back from memory, see zram_wb.c */
+	struct block_device *backing_dev;
+	unsigned long nr_bd_pages;
+	unsigned long *bd_map;	/* blocks in use on backing_dev */
+	u32 wb_idle_secs;	/* age at which pages count as idle */
+#endif
 
 	struct zram_stats stats;
 };
@@ -131,5 +200,52 @@ extern struct attribute_group zram_disk_attr_group;
 
 extern int zram_init_device(struct zram *zram);
 extern void __zram_reset_device(struct zram *zram);
+extern unsigned long zram_compact(struct zram *zram);
+
+extern u32 zram_dedup_checksum(const void *mem);
+extern struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		struct zcomp_strm *zstrm, const void *mem, u32 checksum);
+extern struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+		void *handle, u16 size, u32 checksum);
+extern int zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry);
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Max pages in flight to the backing device per writeback batch */
+#define ZRAM_WB_BATCH	32
+
+/* Pages selected by zram_writeback() */
+enum zram_wb_mode {
+	ZRAM_WB_HUGE,	/* incompressible pages */
+	ZRAM_WB_IDLE,	/* pages not accessed for wb_idle_secs */
+};
+
+struct zram_wb_batch;
+
+struct zram_wb_req {
+	struct zram_wb_batch *batch;
+	u32 index;
+	unsigned long blk;
+	struct page *page;
+	int error;
+};
+
+struct zram_wb_batch {
+	atomic_t pending;
+	struct completion done;
+	int nr;
+	struct zram_wb_req req[ZRAM_WB_BATCH];
+};
+
+extern unsigned long zram_writeback(struct zram *zram, enum zram_wb_mode mode);
+
+extern int zram_bd_open(struct zram *zram, const char *path);
+extern void zram_bd_close(struct zram *zram);
+extern unsigned long zram_bd_alloc(struct zram *zram);
+extern void zram_bd_free(struct zram *zram, unsigned long blk);
+extern int zram_bd_read(struct zram *zram, unsigned long blk,
+		struct page *page);
+extern void zram_bd_write_batch(struct zram *zram,
+		struct zram_wb_batch *batch);
+#endif
 
 #endif
@@ -0,0 +1,178 @@
+/*
+ * Compressed RAM block device - writeback to a backing device
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/bio.h>
+#include <linux/bitops.h>
+#include <linux/blkdev.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+#define ZRAM_BD_MODE	(FMODE_READ | FMODE_WRITE | FMODE_EXCL)
+
+/*
+ * The backing device is split in PAGE_SIZE blocks, each holding one
+ * uncompressed page. Block 0 is never handed out so that a written
+ * back page always has a non-zero table.element.
+ */
+int zram_bd_open(struct zram *zram, const char *path)
+{
+	struct block_device *bdev;
+	unsigned long nr_pages, *bd_map;
+
+	bdev = blkdev_get_by_path(path, ZRAM_BD_MODE, zram);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+
+	nr_pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	if (nr_pages < 2) {
+		blkdev_put(bdev, ZRAM_BD_MODE);
+		return -EINVAL;
+	}
+
+	bd_map = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bd_map) {
+		blkdev_put(bdev, ZRAM_BD_MODE);
+		return -ENOMEM;
+	}
+
+	zram_bd_close(zram);
+	zram->backing_dev = bdev;
+	zram->nr_bd_pages = nr_pages;
+	zram->bd_map = bd_map;
+
+	return 0;
+}
+
+void zram_bd_close(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	blkdev_put(zram->backing_dev, ZRAM_BD_MODE);
+	vfree(zram->bd_map);
+	zram->backing_dev = NULL;
+	zram->nr_bd_pages = 0;
+	zram->bd_map = NULL;
+}
+
+/* Returns a free block, or 0 if the backing device is full */
+unsigned long zram_bd_alloc(struct zram *zram)
+{
+	unsigned long blk = 1;
+
+	for (;;) {
+		blk = find_next_zero_bit(zram->bd_map, zram->nr_bd_pages, blk);
+		if (blk >= zram->nr_bd_pages)
+			return 0;
+		if (!test_and_set_bit(blk, zram->bd_map))
+			return blk;
+	}
+}
+
+void zram_bd_free(struct zram *zram, unsigned long blk)
+{
+	WARN_ON(!test_and_clear_bit(blk, zram->bd_map));
+}
+
+static void zram_bd_read_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+/* Synchronously read block blk into page */
+int zram_bd_read(struct zram *zram, unsigned long blk, struct page *page)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bio *bio;
+	int ret = 0;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_bdev = zram->backing_dev;
+	bio->bi_end_io = zram_bd_read_end_io;
+	bio->bi_private = &done;
+	bio_add_page(bio, page, PAGE_SIZE, 0);
+
+	submit_bio(READ_SYNC, bio);
+	wait_for_completion(&done);
+
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags))
+		ret = -EIO;
+	bio_put(bio);
+
+	return ret;
+}
+
+static void zram_bd_write_end_io(struct bio *bio, int err)
+{
+	struct zram_wb_req *req = bio->bi_private;
+	struct zram_wb_batch *batch = req->batch;
+
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags))
+		req->error = err ? err : -EIO;
+	bio_put(bio);
+
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+/*
+ * Write all pages of a batch to their blocks and wait for them. The
+ * bios are submitted back to back under one plug so the block layer
+ * can merge and dispatch them together. Failures are reported in
+ * each request's error.
+ */
+void zram_bd_write_batch(struct zram *zram, struct zram_wb_batch *batch)
+{
+	struct blk_plug plug;
+	struct bio *bio;
+	int i;
+
+	/* Bias the count so the batch cannot complete while submitting */
+	atomic_set(&batch->pending, 1);
+	init_completion(&batch->done);
+
+	blk_start_plug(&plug);
+	for (i = 0; i < batch->nr; i++) {
+		struct zram_wb_req *req = &batch->req[i];
+
+		req->batch = batch;
+		req->error = 0;
+
+		bio = bio_alloc(GFP_NOIO, 1);
+		if (!bio) {
+			req->error = -ENOMEM;
+			continue;
+		}
+
+		bio->bi_sector = req->blk << SECTORS_PER_PAGE_SHIFT;
+		bio->bi_bdev = zram->backing_dev;
+		bio->bi_end_io = zram_bd_write_end_io;
+		bio->bi_private = req;
+		bio_add_page(bio, req->page, PAGE_SIZE, 0);
+
+		atomic_inc(&batch->pending);
+		submit_bio(WRITE, bio);
+	}
+	blk_finish_plug(&plug);
+
+	if (!atomic_dec_and_test(&batch->pending))
+		wait_for_completion(&batch->done);
+}
@@ -17,9 +17,12 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/bitops.h>
+#include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/highmem.h>
 #include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <asm/tlbflush.h>
@@ -425,6 +428,417 @@ static struct page *find_get_zspage(struct size_class *class)
 	return page;
 }
 
+/* Take a free object from the given zspage. Called with class->lock held. */
+static void *obj_malloc(struct page *first_page, struct size_class *class)
+{
+	void *obj;
+	struct link_free *link;
+	struct page *m_page;
+	unsigned long m_objidx, m_offset;
+
+	obj = first_page->freelist;
+	obj_handle_to_location(obj, &m_page, &m_objidx);
+	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
+
+	link = (struct link_free *)kmap_atomic(m_page) +
+					m_offset / sizeof(*link);
+	first_page->freelist = link->next;
+	memset(link, POISON_INUSE, sizeof(*link));
+	kunmap_atomic(link);
+
+	first_page->inuse++;
+	class->obj_used++;
+
+	return obj;
+}
+
+/* Return an object to its zspage. Called with class->lock held. */
+static void obj_free(struct page *first_page, void *obj,
+			struct size_class *class)
+{
+	struct link_free *link;
+	struct page *f_page;
+	unsigned long f_objidx, f_offset;
+
+	obj_handle_to_location(obj, &f_page, &f_objidx);
+	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+
+	/* Insert this object in containing zspage's freelist */
+	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
+							+ f_offset);
+	link->next = first_page->freelist;
+	kunmap_atomic(link);
+	first_page->freelist = obj;
+
+	first_page->inuse--;
+	class->obj_used--;
+}
+
+/*
+ * Compaction
+ *
+ * Handles encode the location of an object, so moving an object
+ * changes its handle. The pool owner registers a migrate callback
+ * which, given the old and new handle, updates its reference; it
+ * typically finds the reference through a back-pointer stored in the
+ * object itself.
+ *
+ * Objects are moved out of ZS_ALMOST_EMPTY zspages into the free
+ * slots of other zspages of the same class, fullest first. Source
+ * zspages emptied this way are freed.
+ */
+
+/* Object index within the zspage, counting from the first page */
+static unsigned long zspage_obj_index(struct page *first_page,
+			struct page *page, unsigned long obj_idx, int size)
+{
+	unsigned long pgno = 0;
+	struct page *p = first_page;
+
+	while (p != page) {
+		p = get_next_page(p);
+		pgno++;
+	}
+
+	return (pgno * PAGE_SIZE + obj_idx_to_offset(page, obj_idx, size)) /
+		size;
+}
+
+/* Handle of the index'th object of a zspage */
+static void *zspage_obj_handle(struct page *first_page, unsigned long index,
+			int size)
+{
+	unsigned long off = index * size;
+	unsigned long page_off;
+	struct page *page = first_page;
+
+	while (off >= PAGE_SIZE) {
+		page = get_next_page(page);
+		off -= PAGE_SIZE;
+	}
+	page_off = is_first_page(page) ? 0 : page->index;
+
+	return obj_location_to_handle(page, (off - page_off) / size);
+}
+
+/* Mark the free objects of a zspage in @map */
+static void zspage_free_map(struct page *first_page, struct size_class *class,
+			unsigned long *map)
+{
+	void *obj = first_page->freelist;
+	struct link_free *link;
+	struct page *page;
+	unsigned long obj_idx, off;
+
+	while (obj) {
+		obj_handle_to_location(obj, &page, &obj_idx);
+		__set_bit(zspage_obj_index(first_page, page, obj_idx,
+					   class->size), map);
+
+		off = obj_idx_to_offset(page, obj_idx, class->size);
+		link = (struct link_free *)((unsigned char *)kmap_atomic(page)
+							+ off);
+		obj = link->next;
+		kunmap_atomic(link);
+	}
+}
+
+/* Copy an object, either of which may span two pages */
+static void zs_object_copy(void *dst, void *src, struct size_class *class)
+{
+	struct page *s_page, *d_page;
+	unsigned long s_idx, d_idx, s_off, d_off;
+	unsigned char *s_addr, *d_addr;
+	int len, written = 0;
+
+	obj_handle_to_location(src, &s_page, &s_idx);
+	obj_handle_to_location(dst, &d_page, &d_idx);
+	s_off = obj_idx_to_offset(s_page, s_idx, class->size);
+	d_off = obj_idx_to_offset(d_page, d_idx, class->size);
+
+	while (written < class->size) {
+		len = min_t(int, class->size - written,
+			    min(PAGE_SIZE - s_off, PAGE_SIZE - d_off));
+
+		s_addr = kmap_atomic(s_page);
+		d_addr = kmap_atomic(d_page);
+		memcpy(d_addr + d_off, s_addr + s_off, len);
+		kunmap_atomic(d_addr);
+		kunmap_atomic(s_addr);
+
+		written += len;
+		s_off += len;
+		d_off += len;
+		if (s_off >= PAGE_SIZE) {
+			s_page = get_next_page(s_page);
+			s_off = 0;
+		}
+		if (d_off >= PAGE_SIZE) {
+			d_page = get_next_page(d_page);
+			d_off = 0;
+		}
+	}
+}
+
+/* Pick a zspage with free objects to migrate into, fullest first */
+static struct page *find_dst_zspage(struct size_class *class)
+{
+	return find_get_zspage(class);
+}
+
+/*
+ * Move as many objects as possible out of @src. Called with
+ * class->lock held and @src isolated from the fullness lists.
+ * Returns -ENOSPC if the class ran out of free objects.
+ */
+static int migrate_zspage(struct zs_pool *pool, struct size_class *class,
+			struct page *src)
+{
+	DECLARE_BITMAP(free_map, ZS_MAX_OBJS_PER_ZSPAGE);
+	struct page *dst;
+	void *old, *new;
+	unsigned long index;
+
+	bitmap_zero(free_map, ZS_MAX_OBJS_PER_ZSPAGE);
+	zspage_free_map(src, class, free_map);
+
+	for (index = 0; index < src->objects && src->inuse; index++) {
+		if (test_bit(index, free_map))
+			continue;
+
+		dst = find_dst_zspage(class);
+		if (!dst)
+			return -ENOSPC;
+
+		old = zspage_obj_handle(src, index, class->size);
+		new = obj_malloc(dst, class);
+		zs_object_copy(new, old, class);
+
+		if (pool->migrate(pool, old, new, pool->migrate_priv)) {
+			/* The owner could not relocate it, leave it be */
+			obj_free(dst, new, class);
+			continue;
+		}
+
+		obj_free(src, old, class);
+		fix_fullness_group(pool, dst);
+	}
+
+	return 0;
+}
+
+static unsigned long compact_class(struct zs_pool *pool,
+				struct size_class *class)
+{
+	struct page *src, *head;
+	unsigned long nr_isolate, freed = 0;
+	enum fullness_group fg;
+	int ret;
+
+	spin_lock(&class->lock);
+	/* Bound the pass so zspages we fail to empty are tried once */
+	nr_isolate = class->pages_allocated / class->zspage_order;
+	spin_unlock(&class->lock);
+
+	while (nr_isolate--) {
+		spin_lock(&class->lock);
+		head = class->fullness_list[ZS_ALMOST_EMPTY];
+		if (!head) {
+			spin_unlock(&class->lock);
+			break;
+		}
+		/* New zspages are inserted at the head, take the oldest */
+		src = list_entry(head->lru.prev, struct page, lru);
+
+		remove_zspage(src, class, ZS_ALMOST_EMPTY);
+		ret = migrate_zspage(pool, class, src);
+
+		fg = get_fullness_group(src);
+		if (fg == ZS_EMPTY) {
+			class->pages_allocated -= class->zspage_order;
+			class->pages_compacted += class->zspage_order;
+			freed += class->zspage_order;
+		} else {
+			insert_zspage(src, class, fg);
+		}
+		set_zspage_mapping(src, class->index, fg);
+		spin_unlock(&class->lock);
+
+		if (fg == ZS_EMPTY)
+			free_zspage(src);
+		else if (ret == -ENOSPC)
+			break;
+
+		cond_resched();
+	}
+
+	return freed;
+}
+
+static unsigned long class_pages_compactable(struct size_class *class)
+{
+	unsigned long obj_per_zspage, obj_allocated, obj_wasted;
+
+	obj_per_zspage = class->zspage_order * PAGE_SIZE / class->size;
+	obj_allocated = class->pages_allocated / class->zspage_order *
+			obj_per_zspage;
+	obj_wasted = obj_allocated - class->obj_used;
+
+	return obj_wasted / obj_per_zspage * class->zspage_order;
+}
+
+/**
+ * zs_pages_compactable - estimate pages zs_compact() could free
+ * @pool: pool to examine
+ */
+unsigned long zs_pages_compactable(struct zs_pool *pool)
+{
+	int i;
+	unsigned long pages = 0;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		pages += class_pages_compactable(class);
+		spin_unlock(&class->lock);
+	}
+
+	return pages;
+}
+EXPORT_SYMBOL_GPL(zs_pages_compactable);
+
+/**
+ * zs_compact - migrate objects to free sparsely used zspages
+ * @pool: pool to compact
+ *
+ * The caller must guarantee that no handle of the pool is freed or
+ * dereferenced concurrently, other than from the migrate callback.
+ * Returns the number of pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	int i;
+	unsigned long freed = 0;
+
+	if (!pool->migrate)
+		return 0;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++)
+		freed += compact_class(pool, &pool->size_class[i]);
+
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+void zs_set_migrate_callback(struct zs_pool *pool, zs_migrate_fn migrate,
+			void *priv)
+{
+	pool->migrate = migrate;
+	pool->migrate_priv = priv;
+}
+EXPORT_SYMBOL_GPL(zs_set_migrate_callback);
+
+#ifdef CONFIG_DEBUG_FS
+
+static struct dentry *zs_stat_root;
+
+static int zs_stats_show(struct seq_file *s, void *v)
+{
+	int i, fg;
+	struct zs_pool *pool = s->private;
+	struct page *head, *page;
+	unsigned long nr_zspages[_ZS_NR_FULLNESS_GROUPS];
+	unsigned long obj_allocated, obj_used, pages, compactable;
+	u64 compacted;
+
+	seq_printf(s, " %5s %5s %11s %12s %13s %10s %10s %8s %6s %16s\n",
+		"class", "size", "almost_full", "almost_empty",
+		"obj_allocated", "obj_used", "pages_used",
+		"frag(%)", "order", "pages_compacted");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		for (fg = 0; fg < _ZS_NR_FULLNESS_GROUPS; fg++) {
+			nr_zspages[fg] = 0;
+			head = class->fullness_list[fg];
+			if (!head)
+				continue;
+			nr_zspages[fg]++;
+			list_for_each_entry(page, &head->lru, lru)
+				nr_zspages[fg]++;
+		}
+		pages = class->pages_allocated;
+		obj_allocated = pages / class->zspage_order *
+				(class->zspage_order * PAGE_SIZE / class->size);
+		obj_used = class->obj_used;
+		compactable = class_pages_compactable(class);
+		compacted = class->pages_compacted;
+		spin_unlock(&class->lock);
+
+		if (!pages && !compacted)
+			continue;
+
+		seq_printf(s, " %5u %5u %11lu %12lu %13lu %10lu %10lu "
+			"%8lu %6d %16llu\n",
+			i, class->size, nr_zspages[ZS_ALMOST_FULL],
+			nr_zspages[ZS_ALMOST_EMPTY], obj_allocated, obj_used,
+			pages, obj_allocated ?
+				100 - obj_used * 100 / obj_allocated : 0,
+			class->zspage_order, compacted);
+		if (compactable)
+			seq_printf(s, "       (%lu pages compactable)\n",
+				compactable);
+	}
+
+	return 0;
+}
+
+static int zs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_show, inode->i_private);
+}
+
+static const struct file_operations zs_stat_fops = {
+	.open		= zs_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+	if (!zs_stat_root) {
+		zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
+		if (!zs_stat_root)
+			return;
+	}
+
+	pool->stat_dentry = debugfs_create_file(pool->name, S_IRUGO,
+					zs_stat_root, pool, &zs_stat_fops);
+	if (!pool->stat_dentry)
+		pr_warning("zsmalloc: no debugfs stats for pool %s\n",
+			   pool->name);
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+	debugfs_remove(pool->stat_dentry);
+}
+
+#else /* CONFIG_DEBUG_FS */
+
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+}
+
+#endif /* CONFIG_DEBUG_FS */
 
 /*
  * If this becomes a separate module, register zs_init() with
@@ -530,6 +944,7 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 
 	pool->flags = flags;
 	pool->name = name;
+	zs_pool_stat_create(pool);
 
 	error = 0; /* Success */
 
@@ -559,6 +974,7 @@ void zs_destroy_pool(struct zs_pool *pool)
 			}
 		}
 	}
+	zs_pool_stat_destroy(pool);
 	kfree(pool);
 }
 EXPORT_SYMBOL_GPL(zs_destroy_pool);
@@ -579,12 +995,9 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
 void *zs_malloc(struct zs_pool *pool, size_t size)
 {
 	void *obj;
-	struct link_free *link;
 	int class_idx;
 	struct size_class *class;
-
-	struct page *first_page, *m_page;
-	unsigned long m_objidx, m_offset;
+	struct page *first_page;
 
 	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
 		return NULL;
@@ -607,17 +1020,7 @@ void *zs_malloc(struct zs_pool *pool, size_t size)
 		class->pages_allocated += class->zspage_order;
 	}
 
-	obj = first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
-	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
-
-	link = (struct link_free *)kmap_atomic(m_page) +
-					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link);
-
-	first_page->inuse++;
+	obj = obj_malloc(first_page, class);
 	/* Now move the zspage to another fullness group, if required */
 	fix_fullness_group(pool, first_page);
 	spin_unlock(&class->lock);
@@ -628,9 +1031,8 @@ EXPORT_SYMBOL_GPL(zs_malloc);
 
 void zs_free(struct zs_pool *pool, void *obj)
 {
-	struct link_free *link;
 	struct page *first_page, *f_page;
-	unsigned long f_objidx, f_offset;
+	unsigned long f_objidx;
 
 	int class_idx;
 	struct size_class *class;
@@ -644,18 +1046,9 @@ void zs_free(struct zs_pool *pool, void *obj)
 
 	get_zspage_mapping(first_page, &class_idx, &fullness);
 	class = &pool->size_class[class_idx];
-	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
 	spin_lock(&class->lock);
-
-	/* Insert this object in containing zspage's freelist */
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
-							+ f_offset);
-	link->next = first_page->freelist;
-	kunmap_atomic(link);
-	first_page->freelist = obj;
-
-	first_page->inuse--;
+	obj_free(first_page, obj, class);
 	fullness = fix_fullness_group(pool, first_page);
 
 	if (fullness == ZS_EMPTY)
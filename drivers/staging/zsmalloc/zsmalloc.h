@@ -17,6 +17,16 @@
 
 struct zs_pool;
 
+/*
+ * Called by zs_compact() once an object has been copied to its new
+ * location, with the size class of the object locked. The owner must
+ * switch its reference from old_handle to new_handle and return 0, or
+ * return non-zero to leave the object where it is. It must not
+ * allocate from or free to the pool.
+ */
+typedef int (*zs_migrate_fn)(struct zs_pool *pool, void *old_handle,
+			void *new_handle, void *priv);
+
 struct zs_pool *zs_create_pool(const char *name, gfp_t flags);
 void zs_destroy_pool(struct zs_pool *pool);
 
@@ -28,4 +38,9 @@ void zs_unmap_object(struct zs_pool *pool, void *handle);
 
 u64 zs_get_total_size_bytes(struct zs_pool *pool);
 
+void zs_set_migrate_callback(struct zs_pool *pool, zs_migrate_fn migrate,
+			void *priv);
+unsigned long zs_pages_compactable(struct zs_pool *pool);
+unsigned long zs_compact(struct zs_pool *pool);
+
 #endif
@@ -17,6 +17,8 @@
 #include <linux/spinlock.h>
 #include <linux/types.h>
 
+#include "zsmalloc.h"
+
 /*
  * This must be power of 2 and greater than of equal to sizeof(link_free).
  * These two conditions ensure that any 'struct link_free' itself doesn't
@@ -81,6 +83,10 @@
 #define ZS_SIZE_CLASSES		((ZS_MAX_ALLOC_SIZE - ZS_MIN_ALLOC_SIZE) / \
 					ZS_SIZE_CLASS_DELTA + 1)
 
+/* Upper bound on the number of objects in a single zspage */
+#define ZS_MAX_OBJS_PER_ZSPAGE \
+	((ZS_MAX_PAGES_PER_ZSPAGE << PAGE_SHIFT) / ZS_MIN_ALLOC_SIZE)
+
 /*
  * We do not maintain any list for completely empty or full pages
  */
@@ -130,6 +136,8 @@ struct size_class {
 
 	/* stats */
 	u64 pages_allocated;
+	unsigned long obj_used;		/* no. of objects handed out */
+	u64 pages_compacted;		/* no. of pages freed by compaction */
 
 	struct page *fullness_list[_ZS_NR_FULLNESS_GROUPS];
 };
@@ -150,6 +158,12 @@ struct zs_pool {
 
 	gfp_t flags;	/* allocation flags used when growing pool */
 	const char *name;
+
+	/* Owner callback to relocate references during compaction */
+	zs_migrate_fn migrate;
+	void *migrate_priv;
+
+	struct dentry *stat_dentry;
 };
 
 #endif
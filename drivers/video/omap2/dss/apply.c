@@ -18,6 +18,7 @@
 #define DSS_SUBSYS_NAME "APPLY"
 
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/jiffies.h>
@@ -104,6 +105,16 @@ struct mgr_priv_data {
 	bool shadow_extra_info_dirty;
 
 	struct omap_video_timings timings;
+
+	/*
+	 * dss_data.commit_seq of the last commit whose settings have been
+	 * written to the shadow registers, are covered by the GO bit that is
+	 * up, and have been taken in by HW.  Not used for manual update
+	 * displays.
+	 */
+	u32 shadow_seq;
+	u32 go_seq;
+	u32 taken_seq;
 };
 
 static struct {
@@ -114,6 +125,11 @@ static struct {
 	bool fifo_merge;
 
 	bool irq_enabled;
+
+	/* fences of commits whose settings are not yet taken in by HW */
+	struct list_head fence_list;
+	/* number of the last omap_dss_apply_commit() */
+	u32 commit_seq;
 } dss_data;
 
 /* protects dss_data */
@@ -141,6 +157,8 @@ void dss_apply_init(void)
 
 	spin_lock_init(&data_lock);
 
+	INIT_LIST_HEAD(&dss_data.fence_list);
+
 	for (i = 0; i < num_ovls; ++i) {
 		struct ovl_priv_data *op;
 
@@ -371,6 +389,60 @@ static bool extra_info_update_ongoing(void)
 	return false;
 }
 
+/*
+ * returns true if the settings of commit 'seq' have not yet been taken in by
+ * the HW of the manager
+ */
+static bool mgr_commit_pending(struct omap_overlay_manager *mgr, u32 seq)
+{
+	struct mgr_priv_data *mp = get_mgr_priv(mgr);
+
+	if (!mp->enabled)
+		return false;
+
+	/*
+	 * manual update managers take in new settings when the next update
+	 * starts, wait only for the one in progress to finish
+	 */
+	if (mgr_manual_update(mgr))
+		return mp->updating;
+
+	/*
+	 * compare sequence numbers rather than wait for the manager to be
+	 * idle, later commits keep it busy if they come every frame
+	 */
+	return (s32)(mp->taken_seq - seq) < 0;
+}
+
+/* signal the fences whose managers have all taken in their settings */
+static void dss_signal_fences(void)
+{
+	struct omap_dss_fence *fence, *n;
+	int i;
+
+	list_for_each_entry_safe(fence, n, &dss_data.fence_list, list) {
+		for (i = 0; i < MAX_DSS_MANAGERS; ++i) {
+			struct omap_overlay_manager *mgr;
+
+			if (!(fence->mgr_mask & (1 << i)))
+				continue;
+
+			mgr = omap_dss_get_overlay_manager(i);
+			if (mgr_commit_pending(mgr, fence->seq))
+				break;
+		}
+
+		if (i < MAX_DSS_MANAGERS)
+			continue;
+
+		list_del_init(&fence->list);
+		complete_all(&fence->completion);
+
+		if (fence->fxn)
+			fence->fxn(fence);
+	}
+}
+
 /* wait until no extra_info updates are pending */
 static void wait_pending_extra_info_updates(void)
 {
@@ -694,6 +766,9 @@ static void dss_write_regs(void)
 
 		dss_mgr_write_regs(mgr);
 		dss_mgr_write_regs_extra(mgr);
+
+		/* all the settings applied so far are in the shadow regs */
+		mp->shadow_seq = dss_data.commit_seq;
 	}
 }
 
@@ -712,10 +787,14 @@ static void dss_set_go_bits(void)
 		if (!mp->enabled || mgr_manual_update(mgr) || mp->busy)
 			continue;
 
-		if (!need_go(mgr))
+		if (!need_go(mgr)) {
+			/* nothing left for HW to take in */
+			mp->taken_seq = mp->shadow_seq;
 			continue;
+		}
 
 		mp->busy = true;
+		mp->go_seq = mp->shadow_seq;
 
 		if (!dss_data.irq_enabled && need_isr())
 			dss_register_vsync_isr();
@@ -843,14 +922,18 @@ static void dss_apply_irq_handler(void *data, u32 mask)
 			bool was_busy = mp->busy;
 			mp->busy = dispc_mgr_go_busy(i);
 
-			if (was_busy && !mp->busy)
+			if (was_busy && !mp->busy) {
 				mgr_clear_shadow_dirty(mgr);
+				mp->taken_seq = mp->go_seq;
+			}
 		}
 	}
 
 	dss_write_regs();
 	dss_set_go_bits();
 
+	dss_signal_fences();
+
 	extra_updating = extra_info_update_ongoing();
 	if (!extra_updating)
 		complete_all(&extra_updated_completion);
@@ -889,37 +972,156 @@ static void omap_dss_mgr_apply_mgr(struct omap_overlay_manager *mgr)
 	mp->info = mp->user_info;
 }
 
-int omap_dss_mgr_apply(struct omap_overlay_manager *mgr)
+/**
+ * omap_dss_apply_commit - apply the settings of several managers at once
+ * @mgr_mask: managers to apply, as a mask of (1 << mgr->id)
+ * @fence: signalled once HW has taken in the settings, or NULL
+ *
+ * The settings given with set_manager_info() and set_overlay_info() for
+ * the managers and their overlays are checked together and either all of
+ * them are applied or, if any is illegal, none.  The shadow registers of
+ * all the managers are then written and their GO bits set in one go, so
+ * the settings are taken in by HW on the same VSYNC of each manager.
+ *
+ * Does not block.  A fence that is still pending from an earlier commit is
+ * rearmed to wait for this commit as well.
+ */
+int omap_dss_apply_commit(u32 mgr_mask, struct omap_dss_fence *fence)
 {
-	unsigned long flags;
+	const int num_mgrs = omap_dss_get_num_overlay_managers();
+	struct omap_overlay_manager *mgr;
 	struct omap_overlay *ovl;
-	int r;
+	unsigned long flags;
+	u32 seq;
+	int r, i;
+
+	DSSDBG("omap_dss_apply_commit(%#x)\n", mgr_mask);
 
-	DSSDBG("omap_dss_mgr_apply(%s)\n", mgr->name);
+	if (mgr_mask & ~((1 << num_mgrs) - 1))
+		return -EINVAL;
 
 	spin_lock_irqsave(&data_lock, flags);
 
-	r = dss_check_settings_apply(mgr);
-	if (r) {
-		spin_unlock_irqrestore(&data_lock, flags);
-		DSSERR("failed to apply settings: illegal configuration.\n");
-		return r;
+	for (i = 0; i < num_mgrs; ++i) {
+		if (!(mgr_mask & (1 << i)))
+			continue;
+
+		mgr = omap_dss_get_overlay_manager(i);
+
+		r = dss_check_settings_apply(mgr);
+		if (r) {
+			spin_unlock_irqrestore(&data_lock, flags);
+			DSSERR("failed to apply settings for manager %s: "
+					"illegal configuration.\n", mgr->name);
+			return r;
+		}
 	}
 
-	/* Configure overlays */
-	list_for_each_entry(ovl, &mgr->overlays, list)
-		omap_dss_mgr_apply_ovl(ovl);
+	for (i = 0; i < num_mgrs; ++i) {
+		if (!(mgr_mask & (1 << i)))
+			continue;
+
+		mgr = omap_dss_get_overlay_manager(i);
 
-	/* Configure manager */
-	omap_dss_mgr_apply_mgr(mgr);
+		/* Configure overlays */
+		list_for_each_entry(ovl, &mgr->overlays, list)
+			omap_dss_mgr_apply_ovl(ovl);
+
+		/* Configure manager */
+		omap_dss_mgr_apply_mgr(mgr);
+	}
+
+	seq = ++dss_data.commit_seq;
 
 	dss_write_regs();
 	dss_set_go_bits();
 
+	if (fence) {
+		if (list_empty(&fence->list)) {
+			INIT_COMPLETION(fence->completion);
+			fence->mgr_mask = 0;
+			list_add_tail(&fence->list, &dss_data.fence_list);
+		}
+
+		fence->mgr_mask |= mgr_mask;
+		fence->seq = seq;
+	}
+
+	/* nothing may be left to wait for, e.g. for disabled managers */
+	dss_signal_fences();
+
 	spin_unlock_irqrestore(&data_lock, flags);
 
 	return 0;
 }
+EXPORT_SYMBOL(omap_dss_apply_commit);
+
+int omap_dss_mgr_apply(struct omap_overlay_manager *mgr)
+{
+	return omap_dss_apply_commit(1 << mgr->id, NULL);
+}
+
+/**
+ * omap_dss_fence_init - initialize a fence for omap_dss_apply_commit()
+ * @fence: the fence
+ * @fxn: called when the fence is signalled, or NULL
+ *
+ * fxn is called from interrupt context with DSS locks held, so it must not
+ * block or call back into omapdss.
+ */
+void omap_dss_fence_init(struct omap_dss_fence *fence,
+		void (*fxn)(struct omap_dss_fence *fence))
+{
+	INIT_LIST_HEAD(&fence->list);
+	init_completion(&fence->completion);
+	complete_all(&fence->completion);
+	fence->mgr_mask = 0;
+	fence->seq = 0;
+	fence->fxn = fxn;
+}
+EXPORT_SYMBOL(omap_dss_fence_init);
+
+/**
+ * omap_dss_fence_wait - wait for a fence to be signalled
+ * @fence: the fence
+ * @timeout: timeout in jiffies
+ *
+ * Returns 0 once the fence is signalled, -ETIMEDOUT or -ERESTARTSYS.
+ */
+int omap_dss_fence_wait(struct omap_dss_fence *fence, unsigned long timeout)
+{
+	long r;
+
+	r = wait_for_completion_interruptible_timeout(&fence->completion,
+			timeout);
+	if (r < 0)
+		return r;
+
+	return r ? 0 : -ETIMEDOUT;
+}
+EXPORT_SYMBOL(omap_dss_fence_wait);
+
+/**
+ * omap_dss_fence_cancel - stop waiting for the settings of a fence
+ * @fence: the fence
+ *
+ * Signals the fence, without calling its fxn, if it is still pending.  Must
+ * be called before freeing a fence that may still be pending.
+ */
+void omap_dss_fence_cancel(struct omap_dss_fence *fence)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&data_lock, flags);
+
+	if (!list_empty(&fence->list)) {
+		list_del_init(&fence->list);
+		complete_all(&fence->completion);
+	}
+
+	spin_unlock_irqrestore(&data_lock, flags);
+}
+EXPORT_SYMBOL(omap_dss_fence_cancel);
 
 static void dss_apply_ovl_enable(struct omap_overlay *ovl, bool enable)
 {
@@ -1159,6 +1361,9 @@ void dss_mgr_disable(struct omap_overlay_manager *mgr)
 	dss_write_regs();
 	dss_set_go_bits();
 
+	/* a disabled manager has nothing more to take in */
+	dss_signal_fences();
+
 	spin_unlock_irqrestore(&data_lock, flags);
 
 	wait_pending_extra_info_updates();
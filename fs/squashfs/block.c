@@ -31,6 +31,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/buffer_head.h>
+#include <linux/hrtimer.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -94,6 +95,7 @@ int squashfs_read_data(struct super_block *sb, void **buffer, u64 index,
 	int offset = index & ((1 << msblk->devblksize_log2) - 1);
 	u64 cur_index = index >> msblk->devblksize_log2;
 	int bytes, compressed, b = 0, k = 0, page = 0, avail;
+	ktime_t start = ktime_get();
 
 	bh = kcalloc(((srclength + msblk->devblksize - 1)
 		>> msblk->devblksize_log2) + 1, sizeof(*bh), GFP_KERNEL);
@@ -197,6 +199,10 @@ int squashfs_read_data(struct super_block *sb, void **buffer, u64 index,
 	}
 
 	kfree(bh);
+	atomic64_inc(&msblk->stats.read_blocks);
+	atomic64_add(length, &msblk->stats.read_bytes);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		&msblk->stats.read_ns);
 	return length;
 
 block_release:
@@ -26,28 +26,61 @@
 struct squashfs_decompressor {
 	void	*(*init)(struct squashfs_sb_info *, void *, int);
 	void	(*free)(void *);
-	int	(*decompress)(struct squashfs_sb_info *, void **,
+	int	(*decompress)(struct squashfs_sb_info *, void *, void **,
 		struct buffer_head **, int, int, int, int, int);
 	int	id;
 	char	*name;
 	int	supported;
 };
 
-static inline void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
-	void *s)
+/*
+ * Decompressor "thread" backends decide how many decompressor streams a
+ * filesystem has and how concurrent readers share them.  The backend is
+ * chosen with the threads= mount option, msblk->stream is its private state.
+ */
+struct squashfs_decompressor_thread_ops {
+	void	*(*create)(struct squashfs_sb_info *, void *, int);
+	void	(*destroy)(struct squashfs_sb_info *);
+	int	(*decompress)(struct squashfs_sb_info *, void **,
+		struct buffer_head **, int, int, int, int, int);
+	int	(*max_decompressors)(void);
+	char	*name;
+};
+
+extern const struct squashfs_decompressor_thread_ops
+	squashfs_decompressor_single;
+extern const struct squashfs_decompressor_thread_ops
+	squashfs_decompressor_multi;
+extern const struct squashfs_decompressor_thread_ops
+	squashfs_decompressor_percpu;
+
+#if defined(CONFIG_SQUASHFS_DECOMP_MULTI)
+#define SQUASHFS_DEFAULT_DECOMPRESSOR	(&squashfs_decompressor_multi)
+#elif defined(CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU)
+#define SQUASHFS_DEFAULT_DECOMPRESSOR	(&squashfs_decompressor_percpu)
+#else
+#define SQUASHFS_DEFAULT_DECOMPRESSOR	(&squashfs_decompressor_single)
+#endif
+
+static inline void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
 {
-	if (msblk->decompressor)
-		msblk->decompressor->free(s);
+	if (msblk->stream)
+		msblk->thread_ops->destroy(msblk);
 }
 
 static inline int squashfs_decompress(struct squashfs_sb_info *msblk,
 	void **buffer, struct buffer_head **bh, int b, int offset, int length,
 	int srclength, int pages)
 {
-	return msblk->decompressor->decompress(msblk, buffer, bh, b, offset,
+	return msblk->thread_ops->decompress(msblk, buffer, bh, b, offset,
 		length, srclength, pages);
 }
 
+static inline int squashfs_max_decompressors(struct squashfs_sb_info *msblk)
+{
+	return msblk->thread_ops->max_decompressors();
+}
+
 #ifdef CONFIG_SQUASHFS_XZ
 extern const struct squashfs_decompressor squashfs_xz_comp_ops;
 #endif
@@ -47,6 +47,8 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/highmem.h>
+#include <linux/vmalloc.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -371,6 +373,110 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress a datablock straight into the page cache pages it covers,
+ * rather than into the read_page cache and then copying it out.  Every page
+ * of the block must be grabbed for this to work, if any of them can't be
+ * (or is already uptodate) -EAGAIN is returned with nothing read and only
+ * target_page still locked, and the caller falls back to the cache.  On
+ * success all the pages, including target_page, are uptodate and unlocked.
+ */
+static int squashfs_readpage_direct(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int i = 0, n, pages, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+	void *vaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	pageaddr = kmalloc(pages * sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto fallback;
+
+	for (n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+
+		if (page[i] == NULL)
+			goto fallback;
+
+		if (page[i] != target_page && PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			goto fallback;
+		}
+	}
+
+	/*
+	 * The decompressors may sleep, and a block can cover more pages than
+	 * it is reasonable to hold kmaps for, so map the block contiguously.
+	 */
+	vaddr = vmap(page, pages, VM_MAP, PAGE_KERNEL);
+	if (vaddr == NULL)
+		goto fallback;
+
+	for (n = 0; n < pages; n++)
+		pageaddr[n] = vaddr + (n << PAGE_CACHE_SHIFT);
+
+	/*
+	 * Bound the read by the pages grabbed rather than the block size, the
+	 * final block of a file may be covered by fewer pages.
+	 */
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+	if (res >= 0)
+		memset(vaddr + res, 0, (pages << PAGE_CACHE_SHIFT) - res);
+
+	flush_kernel_vmap_range(vaddr, pages << PAGE_CACHE_SHIFT);
+	vunmap(vaddr);
+
+	for (n = 0; n < pages; n++) {
+		flush_dcache_page(page[n]);
+		if (res >= 0)
+			SetPageUptodate(page[n]);
+		if (page[n] != target_page) {
+			unlock_page(page[n]);
+			page_cache_release(page[n]);
+		}
+	}
+
+	if (res < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		goto out;
+	}
+
+	unlock_page(target_page);
+	atomic64_inc(&msblk->stats.direct_blocks);
+	res = 0;
+	goto out;
+
+fallback:
+	while (i--)
+		if (page[i] != target_page) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		}
+	atomic64_inc(&msblk->stats.direct_fallbacks);
+
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -409,8 +515,14 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				 msblk->block_size;
 			sparse = 1;
 		} else {
+			int res = squashfs_readpage_direct(page, block, bsize);
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN)
+				goto error_out;
+
 			/*
-			 * Read and decompress datablock.
+			 * Read and decompress datablock into the cache.
 			 */
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
@@ -69,6 +69,12 @@ extern struct inode *squashfs_iget(struct super_block *, long long,
 				unsigned int);
 extern int squashfs_read_inode(struct inode *, long long);
 
+/* stats.c */
+extern int squashfs_proc_init(void);
+extern void squashfs_proc_exit(void);
+extern void squashfs_stats_register(struct super_block *);
+extern void squashfs_stats_unregister(struct super_block *);
+
 /* xattr.c */
 extern ssize_t squashfs_listxattr(struct dentry *, char *, size_t);
 
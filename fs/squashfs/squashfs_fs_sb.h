@@ -34,6 +34,8 @@ struct squashfs_cache {
 	int			unused;
 	int			block_size;
 	int			pages;
+	unsigned long		hits;
+	unsigned long		misses;
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
@@ -52,8 +54,17 @@ struct squashfs_cache_entry {
 	void			**data;
 };
 
+struct squashfs_stats {
+	atomic64_t		read_blocks;
+	atomic64_t		read_bytes;
+	atomic64_t		read_ns;
+	atomic64_t		direct_blocks;
+	atomic64_t		direct_fallbacks;
+};
+
 struct squashfs_sb_info {
 	const struct squashfs_decompressor	*decompressor;
+	const struct squashfs_decompressor_thread_ops *thread_ops;
 	int					devblksize;
 	int					devblksize_log2;
 	struct squashfs_cache			*block_cache;
@@ -63,7 +74,6 @@ struct squashfs_sb_info {
 	__le64					*id_table;
 	__le64					*fragment_index;
 	__le64					*xattr_id_table;
-	struct mutex				read_data_mutex;
 	struct mutex				meta_index_mutex;
 	struct meta_index			*meta_index;
 	void					*stream;
@@ -76,5 +86,7 @@ struct squashfs_sb_info {
 	long long				bytes_used;
 	unsigned int				inodes;
 	int					xattr_ids;
+	struct squashfs_stats			stats;
+	struct proc_dir_entry			*proc;
 };
 #endif
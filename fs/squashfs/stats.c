@@ -0,0 +1,139 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * stats.c
+ */
+
+/*
+ * Per-mount read statistics, exported in /proc/fs/squashfs/<dev>/stats.
+ *
+ * The block read counters are updated by squashfs_read_data() for every
+ * block read and decompressed (metadata, fragments and datablocks), the
+ * direct counters by squashfs_readpage() and the cache counters by
+ * squashfs_cache_get().
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/module.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs.h"
+
+static struct proc_dir_entry *squashfs_proc_root;
+
+static void squashfs_show_cache(struct seq_file *m, const char *name,
+	struct squashfs_cache *cache)
+{
+	unsigned long hits, misses;
+
+	spin_lock(&cache->lock);
+	hits = cache->hits;
+	misses = cache->misses;
+	spin_unlock(&cache->lock);
+
+	seq_printf(m, "%s_cache_hits: %lu\n", name, hits);
+	seq_printf(m, "%s_cache_misses: %lu\n", name, misses);
+}
+
+
+static int squashfs_stats_show(struct seq_file *m, void *v)
+{
+	struct super_block *sb = m->private;
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct squashfs_stats *stats = &msblk->stats;
+	u64 bytes = atomic64_read(&stats->read_bytes);
+	u64 usecs = div_u64(atomic64_read(&stats->read_ns), NSEC_PER_USEC);
+
+	seq_printf(m, "read_blocks: %llu\n",
+		(unsigned long long) atomic64_read(&stats->read_blocks));
+	seq_printf(m, "read_bytes: %llu\n", (unsigned long long) bytes);
+	seq_printf(m, "read_usecs: %llu\n", (unsigned long long) usecs);
+	seq_printf(m, "read_kbytes_per_sec: %llu\n", usecs ?
+		(unsigned long long) div64_u64(bytes * 1000000 >> 10, usecs) :
+		0ULL);
+	seq_printf(m, "direct_blocks: %llu\n",
+		(unsigned long long) atomic64_read(&stats->direct_blocks));
+	seq_printf(m, "direct_fallbacks: %llu\n",
+		(unsigned long long) atomic64_read(&stats->direct_fallbacks));
+
+	squashfs_show_cache(m, "metadata", msblk->block_cache);
+	squashfs_show_cache(m, "fragment", msblk->fragment_cache);
+	squashfs_show_cache(m, "data", msblk->read_page);
+
+	return 0;
+}
+
+
+static int squashfs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, squashfs_stats_show, PDE(inode)->data);
+}
+
+
+static const struct file_operations squashfs_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = squashfs_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+
+void squashfs_stats_register(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+
+	if (squashfs_proc_root == NULL)
+		return;
+
+	msblk->proc = proc_mkdir(sb->s_id, squashfs_proc_root);
+	if (msblk->proc)
+		proc_create_data("stats", S_IRUGO, msblk->proc,
+			&squashfs_stats_fops, sb);
+}
+
+
+void squashfs_stats_unregister(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+
+	if (msblk->proc == NULL)
+		return;
+
+	remove_proc_entry("stats", msblk->proc);
+	remove_proc_entry(sb->s_id, squashfs_proc_root);
+	msblk->proc = NULL;
+}
+
+
+int squashfs_proc_init(void)
+{
+	squashfs_proc_root = proc_mkdir("fs/squashfs", NULL);
+	return squashfs_proc_root ? 0 : -ENOMEM;
+}
+
+
+void squashfs_proc_exit(void)
+{
+	if (squashfs_proc_root)
+		remove_proc_entry("fs/squashfs", NULL);
+}
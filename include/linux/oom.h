@@ -67,6 +67,29 @@ static inline void oom_killer_enable(void)
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+/*
+ * The Android lowmemorykiller keeps every thread group in a list indexed
+ * by oom_score_adj.  Call lowmem_adj_index_update() after changing
+ * signal->oom_score_adj, without holding the task or sighand lock.
+ */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+extern void lowmem_adj_index_add(struct signal_struct *sig);
+extern void lowmem_adj_index_del(struct signal_struct *sig);
+extern void lowmem_adj_index_update(struct signal_struct *sig);
+#else
+static inline void lowmem_adj_index_add(struct signal_struct *sig)
+{
+}
+
+static inline void lowmem_adj_index_del(struct signal_struct *sig)
+{
+}
+
+static inline void lowmem_adj_index_update(struct signal_struct *sig)
+{
+}
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
@@ -325,6 +325,7 @@ struct fw_rsc_suspd_time {
  * @da: device address
  * @priv: associated data
  * @node: list node
+ * @name: name of the carveout, as given by the firmware
  */
 struct rproc_mem_entry {
 	void *va;
@@ -333,6 +334,7 @@ struct rproc_mem_entry {
 	u32 da;
 	void *priv;
 	struct list_head node;
+	char name[32];
 };
 
 struct rproc;
@@ -533,6 +535,8 @@ void rproc_error_reporter(struct rproc *rproc, enum rproc_err type);
 int rproc_set_constraints(struct device *dev, struct rproc *rproc,
 			  enum rproc_constraint type, long v);
 int rproc_pa_to_da(struct rproc *rproc, phys_addr_t pa, u64 *da);
+struct rproc_mem_entry *rproc_find_carveout(struct rproc *rproc,
+					    const char *name);
 
 static inline struct rproc_vdev *vdev_to_rvdev(struct virtio_device *vdev)
 {
@@ -41,9 +41,18 @@
 #include <linux/idr.h>
 #include <linux/kref.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 /* The feature bitmap for virtio rpmsg */
 #define VIRTIO_RPMSG_F_NS	0 /* RP supports name service notifications */
+#define VIRTIO_RPMSG_F_ZC	1 /* RP supports messages passed by reference */
+
+/*
+ * Name of the firmware carveout that holds the shared buffer pool for
+ * messages passed by reference (see struct rpmsg_ref).
+ */
+#define RPMSG_POOL_NAME		"rpmsg_pool"
 
 /**
  * struct rpmsg_hdr - common header for all rpmsg messages
@@ -51,7 +60,7 @@
  * @dst: destination address
  * @reserved: reserved for future use
  * @len: length of payload (in bytes)
- * @flags: message flags
+ * @flags: message flags (see enum rpmsg_hdr_flags)
  * @data: @len bytes of message payload data
  *
  * Every message sent(/received) on the rpmsg bus begins with this header.
@@ -65,6 +74,31 @@ struct rpmsg_hdr {
 	u8 data[0];
 } __packed;
 
+/**
+ * enum rpmsg_hdr_flags - message flags
+ *
+ * @RPMSG_HDR_REF: the payload is a struct rpmsg_ref, which refers to the
+ *	actual payload in the shared buffer pool
+ */
+enum rpmsg_hdr_flags {
+	RPMSG_HDR_REF		= (1 << 0),
+};
+
+/**
+ * struct rpmsg_ref - reference to a message payload in the shared pool
+ * @da: device address of the payload
+ * @len: length of the payload (in bytes)
+ *
+ * The host allocates the buffers it sends from the first half of the
+ * RPMSG_POOL_NAME carveout, and the remote processor from the second half.
+ * Once the receiver is done with a buffer, it hands it back to its owner
+ * by sending the same rpmsg_ref to the owner's pool address.
+ */
+struct rpmsg_ref {
+	u32 da;
+	u32 len;
+} __packed;
+
 /**
  * struct rpmsg_ns_msg - dynamic name service announcement message
  * @name: name of remote service that is published
@@ -114,6 +148,20 @@ enum rpmsg_ns_flags {
  * @sendq:	wait queue of sending contexts waiting for a tx buffers
  * @sleepers:	number of senders that are waiting for a tx buffer
  * @ns_ept:	the bus's name service endpoint
+ * @pool_ept:	the bus's endpoint for buffers handed back to the pool
+ * @pool_va:	kernel address of the shared buffer pool, if there is one
+ * @pool_dma:	dma address of the shared buffer pool
+ * @pool_da:	device address of the shared buffer pool
+ * @pool_len:	size of the shared buffer pool
+ * @pool_lock:	protects @pool_map and @pool_nr
+ * @pool_map:	busy bit per chunk of our half of the pool
+ * @pool_nr:	number of chunks of the buffer starting at each chunk
+ * @pool_chunks: number of chunks in our half of the pool, 0 if no pool
+ * @pool_ret:	rx buffers holding refs we could not hand back yet, for lack
+ *		of a tx buffer; they are retried when tx buffers are consumed
+ * @pool_ret_head: producer index of @pool_ret, protected by @rx_lock
+ * @pool_ret_tail: consumer index of @pool_ret, protected by @rx_lock
+ * @pool_ret_work: retries the hand-backs on @pool_ret after a tx-complete
  * @id:		unique system-wide index id for this vproc
  *
  * This structure stores the rpmsg state of a given virtio remote processor
@@ -133,6 +181,18 @@ struct virtproc_info {
 	wait_queue_head_t sendq;
 	atomic_t sleepers;
 	struct rpmsg_endpoint *ns_ept;
+	struct rpmsg_endpoint *pool_ept;
+	void *pool_va;
+	dma_addr_t pool_dma;
+	u32 pool_da;
+	u32 pool_len;
+	spinlock_t pool_lock;
+	unsigned long *pool_map;
+	unsigned int *pool_nr;
+	int pool_chunks;
+	void **pool_ret;
+	unsigned int pool_ret_head, pool_ret_tail;
+	struct work_struct pool_ret_work;
 	int id;
 };
 
@@ -215,6 +275,10 @@ struct rpmsg_endpoint *rpmsg_create_ept(struct rpmsg_channel *,
 				rpmsg_rx_cb_t cb, void *priv, u32 addr);
 int
 rpmsg_send_offchannel_raw(struct rpmsg_channel *, u32, u32, void *, int, bool);
+void *rpmsg_alloc_buf(struct rpmsg_channel *rpdev, int len);
+void rpmsg_free_buf(struct rpmsg_channel *rpdev, void *buf);
+int rpmsg_send_buf_offchannel_raw(struct rpmsg_channel *, u32, u32, void *,
+								int, bool);
 
 /**
  * rpmsg_send() - send a message across to the remote processor
@@ -368,6 +432,28 @@ int rpmsg_trysend_offchannel(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 	return rpmsg_send_offchannel_raw(rpdev, src, dst, data, len, false);
 }
 
+/**
+ * rpmsg_send_buf() - pass a shared pool buffer to the remote processor
+ * @rpdev: the rpmsg channel
+ * @buf: buffer returned by rpmsg_alloc_buf()
+ * @len: length of payload
+ *
+ * Like rpmsg_send(), but the payload is not copied: the remote processor
+ * gets a reference to @buf, and hands it back to the pool once it is done
+ * with it.  On success @buf must not be touched or freed anymore.
+ *
+ * Can only be called from process context (for now).
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+static inline int rpmsg_send_buf(struct rpmsg_channel *rpdev, void *buf,
+								int len)
+{
+	u32 src = rpdev->src, dst = rpdev->dst;
+
+	return rpmsg_send_buf_offchannel_raw(rpdev, src, dst, buf, len, true);
+}
+
 int get_virtproc_id(struct virtproc_info *vrp);
 struct rpmsg_channel *rpmsg_create_channel(int vrp_id, const char *name,
 							int src, int dst);
@@ -22,6 +22,40 @@
 #ifndef	__LINUX_USB_USBNET_H
 #define	__LINUX_USB_USBNET_H
 
+#include <linux/hrtimer.h>
+
+/* packing of several tx_fixup'd frames into one URB, for FLAG_TX_BATCH */
+struct usbnet_tx_batch {
+	struct sk_buff_head	frames;		/* waiting to be packed */
+	unsigned		bytes;		/* their length once packed */
+	struct hrtimer		timer;		/* bounds how long they wait */
+	struct tasklet_struct	bh;
+
+	/* tunables, see usbnet_set_coalesce() */
+	u32			usecs;
+	u32			max_frames;
+	u32			max_bytes;
+
+	/* statistics, see usbnet_get_ethtool_stats() */
+	unsigned long		urbs;		/* batches sent */
+	unsigned long		packed;		/* frames sent in them */
+	unsigned long		direct;		/* frames sent alone, link idle */
+	unsigned long		flush_full;	/* frame or byte limit reached */
+	unsigned long		flush_timer;	/* timer expired */
+};
+
+/* page-backed rx URB buffers for FLAG_RX_PAGES, reused once the stack has
+ * released every frame that usbnet_rx_frag() built on them
+ */
+#define USBNET_RX_POOL		32
+
+struct usbnet_rx_pool {
+	spinlock_t		lock;
+	unsigned		order;
+	unsigned		next;
+	struct page		*pages[USBNET_RX_POOL];
+};
+
 /* interface from usbnet core to each USB networking link we handle */
 struct usbnet {
 	/* housekeeping */
@@ -57,6 +91,9 @@ struct usbnet {
 	struct urb		*interrupt;
 	struct usb_anchor	deferred;
 	struct tasklet_struct	bh;
+	struct napi_struct	napi;
+	struct usbnet_tx_batch	tx_batch;
+	struct usbnet_rx_pool	rx_pool;
 
 	struct work_struct	kevent;
 	unsigned long		flags;
@@ -107,6 +144,26 @@ struct driver_info {
 #define FLAG_MULTI_PACKET	0x2000
 #define FLAG_RX_ASSEMBLE	0x4000	/* rx packets may span >1 frames */
 
+/*
+ * Frames returned by tx_fixup may be sent several to a URB, each padded
+ * to tx_batch_align bytes.  Only for devices whose framing says where each
+ * frame ends, such as a length in a per-frame header.
+ */
+#define FLAG_TX_BATCH		0x8000
+
+/*
+ * rx URBs complete into (recycled) pages rather than an skb's linear data,
+ * and rx_fixup hands each frame up with usbnet_rx_frag(), which references
+ * the page instead of cloning or copying the whole transfer.
+ */
+#define FLAG_RX_PAGES		0x10000
+
+/*
+ * The bh runs as a NAPI poll rather than a tasklet, and frames handed to
+ * usbnet_skb_return() from rx_fixup go through GRO.
+ */
+#define FLAG_NAPI		0x20000
+
 	/* init device ... can sleep, or cause probe() failure */
 	int	(*bind)(struct usbnet *, struct usb_interface *);
 
@@ -150,6 +207,8 @@ struct driver_info {
 	int		in;		/* rx endpoint */
 	int		out;		/* tx endpoint */
 
+	int		tx_batch_align;	/* FLAG_TX_BATCH frame alignment */
+
 	unsigned long	data;		/* Misc driver specific data */
 };
 
@@ -200,6 +259,7 @@ struct skb_data {	/* skb->cb is one of these */
 	struct usbnet		*dev;
 	enum skb_state		state;
 	size_t			length;
+	unsigned		packets;
 };
 
 extern int usbnet_open(struct net_device *net);
@@ -213,6 +273,8 @@ extern int usbnet_get_endpoints(struct usbnet *, struct usb_interface *);
 extern int usbnet_get_ethernet_addr(struct usbnet *, int);
 extern void usbnet_defer_kevent(struct usbnet *, int);
 extern void usbnet_skb_return(struct usbnet *, struct sk_buff *);
+extern struct sk_buff *usbnet_rx_frag(struct usbnet *, struct sk_buff *,
+				      unsigned, unsigned);
 extern void usbnet_unlink_rx_urbs(struct usbnet *);
 
 extern void usbnet_pause_rx(struct usbnet *);
@@ -228,5 +290,13 @@ extern u32 usbnet_get_msglevel(struct net_device *);
 extern void usbnet_set_msglevel(struct net_device *, u32);
 extern void usbnet_get_drvinfo(struct net_device *, struct ethtool_drvinfo *);
 extern int usbnet_nway_reset(struct net_device *net);
+extern int usbnet_get_coalesce(struct net_device *net,
+			       struct ethtool_coalesce *ec);
+extern int usbnet_set_coalesce(struct net_device *net,
+			       struct ethtool_coalesce *ec);
+extern int usbnet_get_sset_count(struct net_device *net, int sset);
+extern void usbnet_get_strings(struct net_device *net, u32 sset, u8 *data);
+extern void usbnet_get_ethtool_stats(struct net_device *net,
+				     struct ethtool_stats *stats, u64 *data);
 
 #endif /* __LINUX_USB_USBNET_H */
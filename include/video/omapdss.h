@@ -21,6 +21,7 @@
 #include <linux/list.h>
 #include <linux/kobject.h>
 #include <linux/device.h>
+#include <linux/completion.h>
 
 #define DISPC_IRQ_FRAMEDONE		(1 << 0)
 #define DISPC_IRQ_VSYNC			(1 << 1)
@@ -521,6 +522,18 @@ struct omap_overlay_manager {
 	int (*wait_for_vsync)(struct omap_overlay_manager *mgr);
 };
 
+/* completion of an omap_dss_apply_commit() */
+struct omap_dss_fence {
+	/* private, protected by omapdss */
+	struct list_head list;
+	u32 mgr_mask;
+	u32 seq;
+	struct completion completion;
+
+	/* called from interrupt context once HW has taken in the settings */
+	void (*fxn)(struct omap_dss_fence *fence);
+};
+
 /* 22 pins means 1 clk lane and 10 data lanes */
 #define OMAP_DSS_MAX_DSI_PINS 22
 
@@ -747,6 +760,12 @@ struct omap_overlay_manager *omap_dss_get_overlay_manager(int num);
 int omap_dss_get_num_overlays(void);
 struct omap_overlay *omap_dss_get_overlay(int num);
 
+int omap_dss_apply_commit(u32 mgr_mask, struct omap_dss_fence *fence);
+void omap_dss_fence_init(struct omap_dss_fence *fence,
+		void (*fxn)(struct omap_dss_fence *fence));
+int omap_dss_fence_wait(struct omap_dss_fence *fence, unsigned long timeout);
+void omap_dss_fence_cancel(struct omap_dss_fence *fence);
+
 void omapdss_default_get_resolution(struct omap_dss_device *dssdev,
 		u16 *xres, u16 *yres);
 int omapdss_default_get_recommended_bpp(struct omap_dss_device *dssdev);
@@ -150,6 +150,7 @@ static void __exit_signal(struct task_struct *tsk)
 	__cleanup_sighand(sighand);
 	clear_tsk_thread_flag(tsk,TIF_SIGPENDING);
 	if (group_dead) {
+		lowmem_adj_index_del(sig);
 		flush_sigqueue(&sig->shared_pending);
 		tty_kref_put(tty);
 	}
@@ -1464,6 +1464,8 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 
 	total_forks++;
 	spin_unlock(&current->sighand->siglock);
+	if (!(clone_flags & CLONE_THREAD))
+		lowmem_adj_index_add(p->signal);
 	write_unlock_irq(&tasklist_lock);
 	proc_fork_connector(p);
 	cgroup_post_fork(p);
@@ -0,0 +1,136 @@
+/*
+ *  LZ4 Compressor
+ *
+ *  A single pass, greedy compressor producing the LZ4 block format
+ *  described at http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(const unsigned char *p)
+{
+	return (get_unaligned((const u32 *)p) * 2654435761U) >>
+		(32 - LZ4_HASH_LOG);
+}
+
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = len;
+
+	return op;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	const unsigned char * const src_end = src + src_len;
+	const unsigned char * const mflimit = src_end - MFLIMIT;
+	const unsigned char * const matchlimit = src_end - LASTLITERALS;
+	unsigned char * const dst_end = dst + *dst_len;
+	u32 * const dict = wrkmem;
+	const unsigned char *ip = src, *anchor = src, *ref;
+	unsigned char *op = dst, *token;
+	size_t lit_len, match_len;
+	unsigned int misses = 1 << SKIP_TRIGGER;
+
+	memset(dict, 0, LZ4_MEM_COMPRESS);
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	dict[lz4_hash(ip)] = 0;
+	ip++;
+
+	while (ip <= mflimit) {
+		u32 h = lz4_hash(ip);
+
+		ref = src + dict[h];
+		dict[h] = ip - src;
+
+		if (ref >= ip || ip - ref > MAX_DISTANCE ||
+		    get_unaligned((const u32 *)ref) !=
+		    get_unaligned((const u32 *)ip)) {
+			/* Skip faster over incompressible data */
+			ip += misses++ >> SKIP_TRIGGER;
+			continue;
+		}
+		misses = 1 << SKIP_TRIGGER;
+
+		/* Extend the match backwards over pending literals */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		match_len = MINMATCH;
+		while (ip + match_len < matchlimit &&
+		       ip[match_len] == ref[match_len])
+			match_len++;
+
+		lit_len = ip - anchor;
+		if (op + 1 + lit_len + lit_len / 255 + 1 + 2 +
+		    (match_len - MINMATCH) / 255 + 1 > dst_end)
+			return LZ4_E_OUTPUT_OVERRUN;
+
+		token = op++;
+		if (lit_len >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, lit_len - RUN_MASK);
+		} else {
+			*token = lit_len << ML_BITS;
+		}
+		memcpy(op, anchor, lit_len);
+		op += lit_len;
+
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		if (match_len - MINMATCH >= ML_MASK) {
+			*token |= ML_MASK;
+			op = lz4_put_length(op, match_len - MINMATCH - ML_MASK);
+		} else {
+			*token |= match_len - MINMATCH;
+		}
+
+		ip += match_len;
+		anchor = ip;
+
+		/* Index a position inside the match for the next search */
+		if (ip <= mflimit)
+			dict[lz4_hash(ip - 2)] = ip - 2 - src;
+	}
+
+last_literals:
+	lit_len = src_end - anchor;
+	if (op + 1 + lit_len + lit_len / 255 + 1 > dst_end)
+		return LZ4_E_OUTPUT_OVERRUN;
+
+	if (lit_len >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, lit_len - RUN_MASK);
+	} else {
+		*op++ = lit_len << ML_BITS;
+	}
+	memcpy(op, anchor, lit_len);
+	op += lit_len;
+
+	*dst_len = op - dst;
+	return LZ4_E_OK;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
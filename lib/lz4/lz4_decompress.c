@@ -0,0 +1,113 @@
+/*
+ *  LZ4 Decompressor
+ *
+ *  Decoder for the LZ4 block format described at
+ *  http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+int lz4_decompress_safe(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len)
+{
+	const unsigned char * const ip_end = src + src_len;
+	unsigned char * const op_end = dst + *dst_len;
+	const unsigned char *ip = src;
+	unsigned char *op = dst;
+	const unsigned char *ref;
+	size_t length, offset;
+	unsigned int token, s;
+
+	while (ip < ip_end) {
+		token = *ip++;
+
+		/* literals */
+		length = token >> ML_BITS;
+		if (length == RUN_MASK) {
+			do {
+				if (ip >= ip_end)
+					goto input_overrun;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+
+		if (length > (size_t)(ip_end - ip))
+			goto input_overrun;
+		if (length > (size_t)(op_end - op))
+			goto output_overrun;
+		memcpy(op, ip, length);
+		op += length;
+		ip += length;
+
+		/* the last sequence carries literals only */
+		if (ip == ip_end)
+			break;
+
+		/* match */
+		if (ip_end - ip < 2)
+			goto input_overrun;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			goto lookbehind_overrun;
+
+		length = token & ML_MASK;
+		if (length == ML_MASK) {
+			do {
+				if (ip >= ip_end)
+					goto input_overrun;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+		length += MINMATCH;
+
+		if (length > (size_t)(op_end - op))
+			goto output_overrun;
+
+		ref = op - offset;
+		if (offset >= length) {
+			memcpy(op, ref, length);
+			op += length;
+		} else {
+			/* overlapping copy replicates the last offset bytes */
+			while (length--)
+				*op++ = *ref++;
+		}
+	}
+
+	*dst_len = op - dst;
+	return LZ4_E_OK;
+
+input_overrun:
+	*dst_len = op - dst;
+	return LZ4_E_INPUT_OVERRUN;
+
+output_overrun:
+	*dst_len = op - dst;
+	return LZ4_E_OUTPUT_OVERRUN;
+
+lookbehind_overrun:
+	*dst_len = op - dst;
+	return LZ4_E_LOOKBEHIND_OVERRUN;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress_safe);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ *  lz4defs.h -- LZ4 block format constants
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#define MINMATCH	4
+
+/* The last match must start at least MFLIMIT bytes before the end */
+#define MFLIMIT		12
+/* The last LASTLITERALS bytes are always literals */
+#define LASTLITERALS	5
+
+#define MAX_DISTANCE	0xffff
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+/* Search step grows once this many consecutive probes have missed */
+#define SKIP_TRIGGER	6
@@ -33,6 +33,12 @@ EXPORT_SYMBOL(raid6_empty_zero_page);
 struct raid6_calls raid6_call;
 EXPORT_SYMBOL_GPL(raid6_call);
 
+void (*raid6_2data_recov)(int, size_t, int, int, void **);
+EXPORT_SYMBOL_GPL(raid6_2data_recov);
+
+void (*raid6_datap_recov)(int, size_t, int, void **);
+EXPORT_SYMBOL_GPL(raid6_datap_recov);
+
 const struct raid6_calls * const raid6_algos[] = {
 	&raid6_intx1,
 	&raid6_intx2,
@@ -60,6 +66,20 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_altivec2,
 	&raid6_altivec4,
 	&raid6_altivec8,
+#endif
+#ifdef CONFIG_KERNEL_MODE_NEON
+	&raid6_neonx1,
+	&raid6_neonx2,
+	&raid6_neonx4,
+	&raid6_neonx8,
+#endif
+	NULL
+};
+
+const struct raid6_recov_calls * const raid6_recov_algos[] = {
+	&raid6_recov_intx1,
+#ifdef CONFIG_KERNEL_MODE_NEON
+	&raid6_recov_neon,
 #endif
 	NULL
 };
@@ -75,49 +95,44 @@ const struct raid6_calls * const raid6_algos[] = {
 /* Try to pick the best algorithm */
 /* This code uses the gfmul table as convenient data set to abuse */
 
-int __init raid6_select_algo(void)
+/*
+ * Run fn repeatedly for 2^RAID6_TIME_JIFFIES_LG2 jiffies and return the
+ * number of iterations; each one processes 64K worth of data disks.
+ */
+#define RAID6_BENCH(fn)						\
+({								\
+	unsigned long perf = 0, j0, j1;				\
+								\
+	preempt_disable();					\
+	j0 = jiffies;						\
+	while ( (j1 = jiffies) == j0 )				\
+		cpu_relax();					\
+	while (time_before(jiffies,				\
+			    j1 + (1<<RAID6_TIME_JIFFIES_LG2))) {	\
+		fn;						\
+		perf++;						\
+	}							\
+	preempt_enable();					\
+	perf;							\
+})
+
+#define RAID6_MBPS(perf) \
+	(((perf)*HZ) >> (20-16+RAID6_TIME_JIFFIES_LG2))
+
+static const struct raid6_calls *raid6_choose_gen(void **dptrs,
+						  int disks)
 {
 	const struct raid6_calls * const * algo;
 	const struct raid6_calls * best;
-	char *syndromes;
-	void *dptrs[(65536/PAGE_SIZE)+2];
-	int i, disks;
 	unsigned long perf, bestperf;
 	int bestprefer;
-	unsigned long j0, j1;
-
-	disks = (65536/PAGE_SIZE)+2;
-	for ( i = 0 ; i < disks-2 ; i++ ) {
-		dptrs[i] = ((char *)raid6_gfmul) + PAGE_SIZE*i;
-	}
-
-	/* Normal code - use a 2-page allocation to avoid D$ conflict */
-	syndromes = (void *) __get_free_pages(GFP_KERNEL, 1);
-
-	if ( !syndromes ) {
-		printk("raid6: Yikes!  No memory available.\n");
-		return -ENOMEM;
-	}
-
-	dptrs[disks-2] = syndromes;
-	dptrs[disks-1] = syndromes + PAGE_SIZE;
 
 	bestperf = 0;  bestprefer = 0;  best = NULL;
 
 	for ( algo = raid6_algos ; *algo ; algo++ ) {
 		if ( !(*algo)->valid || (*algo)->valid() ) {
-			perf = 0;
-
-			preempt_disable();
-			j0 = jiffies;
-			while ( (j1 = jiffies) == j0 )
-				cpu_relax();
-			while (time_before(jiffies,
-					    j1 + (1<<RAID6_TIME_JIFFIES_LG2))) {
-				(*algo)->gen_syndrome(disks, PAGE_SIZE, dptrs);
-				perf++;
-			}
-			preempt_enable();
+			perf = RAID6_BENCH((*algo)->gen_syndrome(disks,
+							PAGE_SIZE, dptrs));
 
 			if ( (*algo)->prefer > bestprefer ||
 			     ((*algo)->prefer == bestprefer &&
@@ -127,21 +142,104 @@ int __init raid6_select_algo(void)
 				bestperf = perf;
 			}
 			printk("raid6: %-8s %5ld MB/s\n", (*algo)->name,
-			       (perf*HZ) >> (20-16+RAID6_TIME_JIFFIES_LG2));
+			       RAID6_MBPS(perf));
 		}
 	}
 
 	if (best) {
 		printk("raid6: using algorithm %s (%ld MB/s)\n",
-		       best->name,
-		       (bestperf*HZ) >> (20-16+RAID6_TIME_JIFFIES_LG2));
+		       best->name, RAID6_MBPS(bestperf));
 		raid6_call = *best;
 	} else
 		printk("raid6: Yikes!  No algorithm found!\n");
 
-	free_pages((unsigned long)syndromes, 1);
+	return best;
+}
+
+/*
+ * Recovery is timed as a two data disk rebuild, which includes the
+ * syndrome pass done with the raid6_call chosen above.  The two failed
+ * disks are pointed at scratch pages since the routines write to them.
+ */
+static const struct raid6_recov_calls *raid6_choose_recov(void **dptrs,
+							  int disks,
+							  char *scratch)
+{
+	const struct raid6_recov_calls * const * algo;
+	const struct raid6_recov_calls * best;
+	unsigned long perf, bestperf;
+	int bestprefer;
+	void *d0 = dptrs[0], *d1 = dptrs[1];
+
+	dptrs[0] = scratch;
+	dptrs[1] = scratch + PAGE_SIZE;
+
+	bestperf = 0;  bestprefer = 0;  best = NULL;
+
+	for ( algo = raid6_recov_algos ; *algo ; algo++ ) {
+		if ( !(*algo)->valid || (*algo)->valid() ) {
+			perf = RAID6_BENCH((*algo)->data2(disks, PAGE_SIZE,
+							  0, 1, dptrs));
+
+			if ( (*algo)->prefer > bestprefer ||
+			     ((*algo)->prefer == bestprefer &&
+			      perf > bestperf) ) {
+				best = *algo;
+				bestprefer = best->prefer;
+				bestperf = perf;
+			}
+			printk("raid6: %-8s %5ld MB/s (recovery)\n",
+			       (*algo)->name, RAID6_MBPS(perf));
+		}
+	}
+
+	dptrs[0] = d0;
+	dptrs[1] = d1;
+
+	if (best) {
+		printk("raid6: using %s recovery algorithm (%ld MB/s)\n",
+		       best->name, RAID6_MBPS(bestperf));
+		raid6_2data_recov = best->data2;
+		raid6_datap_recov = best->datap;
+	} else
+		printk("raid6: Yikes!  No recovery algorithm found!\n");
+
+	return best;
+}
+
+int __init raid6_select_algo(void)
+{
+	const struct raid6_calls *gen_best;
+	const struct raid6_recov_calls *rec_best;
+	char *syndromes;
+	void *dptrs[(65536/PAGE_SIZE)+2];
+	int i, disks;
+
+	disks = (65536/PAGE_SIZE)+2;
+	for ( i = 0 ; i < disks-2 ; i++ ) {
+		dptrs[i] = ((char *)raid6_gfmul) + PAGE_SIZE*i;
+	}
+
+	/* Normal code - use a 2-page allocation to avoid D$ conflict;
+	   the other two pages are scratch space for recovery */
+	syndromes = (void *) __get_free_pages(GFP_KERNEL, 2);
+
+	if ( !syndromes ) {
+		printk("raid6: Yikes!  No memory available.\n");
+		return -ENOMEM;
+	}
+
+	dptrs[disks-2] = syndromes;
+	dptrs[disks-1] = syndromes + PAGE_SIZE;
+
+	gen_best = raid6_choose_gen(dptrs, disks);
+	rec_best = gen_best ?
+		raid6_choose_recov(dptrs, disks, syndromes + 2*PAGE_SIZE) :
+		NULL;
+
+	free_pages((unsigned long)syndromes, 2);
 
-	return best ? 0 : -EINVAL;
+	return gen_best && rec_best ? 0 : -EINVAL;
 }
 
 static void raid6_exit(void)
@@ -0,0 +1,106 @@
+/*
+ * linux/lib/raid6/recov_neon_inner.c
+ *
+ * RAID-6 dual failure recovery inner loops using ARM NEON intrinsics.
+ * Built with -mfpu=neon; see the comment in neon.c on why this is kept
+ * apart from the kernel_neon_begin()/kernel_neon_end() callers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <arm_neon.h>
+
+/*
+ * GF(2^8) multiplication by a constant, 16 bytes at a time: look up the
+ * products of the low and the high nibble of each byte in the two halves
+ * of a raid6_vgfmul[] row and add them.  vtbl only has 64-bit lookups on
+ * ARMv7, so each half of the input vector is translated separately.
+ */
+static inline uint8x16_t vgfmul(uint8x8x2_t lo, uint8x8x2_t hi, uint8x16_t v)
+{
+	uint8x16_t l = vandq_u8(v, vdupq_n_u8(0x0f));
+	uint8x16_t h = vshrq_n_u8(v, 4);
+
+	return veorq_u8(vcombine_u8(vtbl2_u8(lo, vget_low_u8(l)),
+				    vtbl2_u8(lo, vget_high_u8(l))),
+			vcombine_u8(vtbl2_u8(hi, vget_low_u8(h)),
+				    vtbl2_u8(hi, vget_high_u8(h))));
+}
+
+static inline uint8x8x2_t vgfmul_tbl(const uint8_t *p)
+{
+	uint8x8x2_t r;
+
+	r.val[0] = vld1_u8(p);
+	r.val[1] = vld1_u8(p + 8);
+	return r;
+}
+
+void __raid6_2data_recov_neon(int bytes, uint8_t *p, uint8_t *q, uint8_t *dp,
+			      uint8_t *dq, const uint8_t *pbmul,
+			      const uint8_t *qmul)
+{
+	const uint8x8x2_t pm0 = vgfmul_tbl(pbmul);
+	const uint8x8x2_t pm1 = vgfmul_tbl(pbmul + 16);
+	const uint8x8x2_t qm0 = vgfmul_tbl(qmul);
+	const uint8x8x2_t qm1 = vgfmul_tbl(qmul + 16);
+
+	/*
+	 * while ( bytes-- ) {
+	 *	uint8_t px, qx, db;
+	 *
+	 *	px    = *p ^ *dp;
+	 *	qx    = qmul[*q ^ *dq];
+	 *	*dq++ = db = pbmul[px] ^ qx;
+	 *	*dp++ = db ^ px;
+	 *	p++; q++;
+	 * }
+	 */
+
+	while (bytes) {
+		uint8x16_t px, qx, db;
+
+		px = veorq_u8(vld1q_u8(p), vld1q_u8(dp));
+		qx = vgfmul(qm0, qm1, veorq_u8(vld1q_u8(q), vld1q_u8(dq)));
+		db = veorq_u8(vgfmul(pm0, pm1, px), qx);
+
+		vst1q_u8(dq, db);
+		vst1q_u8(dp, veorq_u8(db, px));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dp += 16;
+		dq += 16;
+	}
+}
+
+void __raid6_datap_recov_neon(int bytes, uint8_t *p, uint8_t *q, uint8_t *dq,
+			      const uint8_t *qmul)
+{
+	const uint8x8x2_t qm0 = vgfmul_tbl(qmul);
+	const uint8x8x2_t qm1 = vgfmul_tbl(qmul + 16);
+
+	/*
+	 * while (bytes--) {
+	 *	*p++ ^= *dq = qmul[*q ^ *dq];
+	 *	q++; dq++;
+	 * }
+	 */
+
+	while (bytes) {
+		uint8x16_t vx;
+
+		vx = vgfmul(qm0, qm1, veorq_u8(vld1q_u8(q), vld1q_u8(dq)));
+
+		vst1q_u8(dq, vx);
+		vst1q_u8(p, veorq_u8(vx, vld1q_u8(p)));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dq += 16;
+	}
+}
@@ -0,0 +1,535 @@
+/*
+ * binder_pingpong.c - binder transaction throughput benchmark
+ *
+ * Forks N server/client process pairs which ping-pong synchronous
+ * binder transactions at each other, and reports the aggregate
+ * transaction rate for 1..N concurrently active pairs.  With the old
+ * global binder_lock the aggregate rate stays flat as pairs are added;
+ * with per-process locking it should scale with the number of CPUs.
+ *
+ * The benchmark acts as its own context manager, so it must run as root
+ * with servicemanager stopped:
+ *
+ *	stop servicemanager
+ *	./binder_pingpong -p 4 -t 2 -s 128
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "binder.h"
+
+#define BINDER_DEV		"/dev/binder"
+#define BINDER_MAP_SIZE		(128 * 1024)
+#define MAX_PAIRS		64
+#define MAX_PAYLOAD		4096
+
+enum {
+	MSG_REGISTER = 1,
+	MSG_LOOKUP,
+	MSG_PING,
+};
+
+/* request sent to the context manager */
+struct mgr_msg {
+	uint32_t op;
+	uint32_t index;
+	struct flat_binder_object obj;	/* MSG_REGISTER only */
+};
+
+/* context manager's answer to MSG_LOOKUP */
+struct mgr_reply {
+	uint32_t found;
+	uint32_t pad;
+	struct flat_binder_object obj;
+};
+
+/* state shared between the manager and the client processes */
+struct shared {
+	volatile int round;
+	volatile int active;
+	volatile int stop;
+	volatile int quit;
+	volatile int done;
+	volatile unsigned long count[MAX_PAIRS];
+};
+
+struct binder_ctx {
+	int fd;
+	void *map;
+	size_t out_len;
+	uint8_t out[512];
+	uint8_t in[512];
+};
+
+static struct shared *shared;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void put(struct binder_ctx *ctx, const void *p, size_t len)
+{
+	if (ctx->out_len + len > sizeof(ctx->out)) {
+		fprintf(stderr, "binder command buffer overflow\n");
+		exit(1);
+	}
+	memcpy(ctx->out + ctx->out_len, p, len);
+	ctx->out_len += len;
+}
+
+static void put_cmd(struct binder_ctx *ctx, uint32_t cmd)
+{
+	put(ctx, &cmd, sizeof(cmd));
+}
+
+static void put_handle_cmd(struct binder_ctx *ctx, uint32_t cmd,
+			   uint32_t handle)
+{
+	put_cmd(ctx, cmd);
+	put(ctx, &handle, sizeof(handle));
+}
+
+static void put_free_buffer(struct binder_ctx *ctx,
+			    const struct binder_transaction_data *txn)
+{
+	const void *buffer = txn->data.ptr.buffer;
+
+	put_cmd(ctx, BC_FREE_BUFFER);
+	put(ctx, &buffer, sizeof(buffer));
+}
+
+static void put_txn(struct binder_ctx *ctx, uint32_t cmd, uint32_t handle,
+		    uint32_t code, const void *data, size_t size,
+		    const size_t *offsets, size_t offsets_size)
+{
+	struct binder_transaction_data txn;
+
+	memset(&txn, 0, sizeof(txn));
+	txn.target.handle = handle;
+	txn.code = code;
+	txn.data_size = size;
+	txn.offsets_size = offsets_size;
+	txn.data.ptr.buffer = data;
+	txn.data.ptr.offsets = offsets;
+	put_cmd(ctx, cmd);
+	put(ctx, &txn, sizeof(txn));
+}
+
+static void binder_ctx_open(struct binder_ctx *ctx)
+{
+	struct binder_version version;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->fd = open(BINDER_DEV, O_RDWR);
+	if (ctx->fd < 0)
+		die("open " BINDER_DEV);
+	if (ioctl(ctx->fd, BINDER_VERSION, &version) < 0)
+		die("BINDER_VERSION");
+	if (version.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder protocol version %ld, expected %d\n",
+			version.protocol_version,
+			BINDER_CURRENT_PROTOCOL_VERSION);
+		exit(1);
+	}
+	ctx->map = mmap(NULL, BINDER_MAP_SIZE, PROT_READ, MAP_PRIVATE,
+			ctx->fd, 0);
+	if (ctx->map == MAP_FAILED)
+		die("mmap " BINDER_DEV);
+}
+
+static void binder_write_read(struct binder_ctx *ctx, size_t read_size)
+{
+	struct binder_write_read bwr;
+
+	bwr.write_size = ctx->out_len;
+	bwr.write_consumed = 0;
+	bwr.write_buffer = (unsigned long)ctx->out;
+	bwr.read_size = read_size;
+	bwr.read_consumed = 0;
+	bwr.read_buffer = (unsigned long)ctx->in;
+
+	do {
+		if (ioctl(ctx->fd, BINDER_WRITE_READ, &bwr) >= 0)
+			break;
+		if (errno != EINTR)
+			die("BINDER_WRITE_READ");
+	} while (1);
+
+	if ((size_t)bwr.write_consumed != ctx->out_len) {
+		fprintf(stderr, "binder consumed %ld of %zu command bytes\n",
+			bwr.write_consumed, ctx->out_len);
+		exit(1);
+	}
+	ctx->out_len = 0;
+	memset(ctx->in + bwr.read_consumed, 0,
+	       sizeof(ctx->in) - bwr.read_consumed);
+}
+
+/* Send any queued commands without waiting for anything back. */
+static void binder_flush(struct binder_ctx *ctx)
+{
+	if (ctx->out_len)
+		binder_write_read(ctx, 0);
+}
+
+/*
+ * Send the queued commands and read until a transaction, a reply or a
+ * failure arrives.  Reference count requests are acknowledged on the next
+ * write.  Returns the BR_* code and fills in @txn for transactions and
+ * replies.
+ */
+static uint32_t binder_wait(struct binder_ctx *ctx,
+			    struct binder_transaction_data *txn)
+{
+	struct binder_ptr_cookie pc;
+	uint32_t result = 0;
+	uint8_t *p, *end;
+	uint32_t cmd;
+	int err;
+
+	while (!result) {
+		binder_write_read(ctx, sizeof(ctx->in));
+		p = ctx->in;
+		end = ctx->in + sizeof(ctx->in);
+
+		while (p + sizeof(cmd) <= end) {
+			memcpy(&cmd, p, sizeof(cmd));
+			p += sizeof(cmd);
+			switch (cmd) {
+			case 0:
+				p = end;
+				break;
+			case BR_NOOP:
+			case BR_TRANSACTION_COMPLETE:
+			case BR_SPAWN_LOOPER:
+				break;
+			case BR_INCREFS:
+			case BR_ACQUIRE:
+				memcpy(&pc, p, sizeof(pc));
+				p += sizeof(pc);
+				put_cmd(ctx, cmd == BR_INCREFS ?
+					BC_INCREFS_DONE : BC_ACQUIRE_DONE);
+				put(ctx, &pc, sizeof(pc));
+				break;
+			case BR_RELEASE:
+			case BR_DECREFS:
+				p += sizeof(pc);
+				break;
+			case BR_TRANSACTION:
+			case BR_REPLY:
+				memcpy(txn, p, sizeof(*txn));
+				p += sizeof(*txn);
+				result = cmd;
+				break;
+			case BR_DEAD_REPLY:
+			case BR_FAILED_REPLY:
+				result = cmd;
+				break;
+			case BR_ERROR:
+				memcpy(&err, p, sizeof(err));
+				fprintf(stderr, "BR_ERROR %d\n", err);
+				exit(1);
+			default:
+				fprintf(stderr, "unexpected binder return %#x\n",
+					cmd);
+				exit(1);
+			}
+		}
+	}
+	return result;
+}
+
+static void expect(uint32_t cmd, uint32_t want, const char *who)
+{
+	if (cmd != want) {
+		fprintf(stderr, "%s: got binder return %#x, expected %#x\n",
+			who, cmd, want);
+		exit(1);
+	}
+}
+
+static void run_manager(struct binder_ctx *ctx, int pairs)
+{
+	static uint32_t handles[MAX_PAIRS];
+	static const size_t obj_offset = offsetof(struct mgr_reply, obj);
+	struct binder_transaction_data txn;
+	struct mgr_reply reply;
+	struct mgr_msg msg;
+	int found = 0;
+
+	while (found < pairs) {
+		expect(binder_wait(ctx, &txn), BR_TRANSACTION, "manager");
+		if (txn.data_size < offsetof(struct mgr_msg, obj)) {
+			fprintf(stderr, "manager: short request\n");
+			exit(1);
+		}
+		memset(&msg, 0, sizeof(msg));
+		memcpy(&msg, txn.data.ptr.buffer,
+		       txn.data_size < sizeof(msg) ? txn.data_size :
+		       sizeof(msg));
+		memset(&reply, 0, sizeof(reply));
+
+		if (msg.index >= (uint32_t)pairs) {
+			fprintf(stderr, "manager: bad index %u\n", msg.index);
+			exit(1);
+		}
+
+		if (msg.op == MSG_REGISTER) {
+			if (msg.obj.type != BINDER_TYPE_HANDLE) {
+				fprintf(stderr, "manager: no object registered\n");
+				exit(1);
+			}
+			/* keep the node alive after the buffer is freed */
+			handles[msg.index] = msg.obj.handle;
+			put_handle_cmd(ctx, BC_ACQUIRE, msg.obj.handle);
+			put_txn(ctx, BC_REPLY, 0, 0, &reply, sizeof(uint32_t),
+				NULL, 0);
+		} else if (msg.op == MSG_LOOKUP && handles[msg.index]) {
+			reply.found = 1;
+			reply.obj.type = BINDER_TYPE_HANDLE;
+			reply.obj.handle = handles[msg.index];
+			found++;
+			put_txn(ctx, BC_REPLY, 0, 0, &reply, sizeof(reply),
+				&obj_offset, sizeof(obj_offset));
+		} else {
+			put_txn(ctx, BC_REPLY, 0, 0, &reply, sizeof(uint32_t),
+				NULL, 0);
+		}
+		put_free_buffer(ctx, &txn);
+		if (found == pairs)
+			binder_flush(ctx);
+	}
+}
+
+static void run_server(int index)
+{
+	static uint8_t payload[MAX_PAYLOAD];
+	static const size_t obj_offset = offsetof(struct mgr_msg, obj);
+	struct binder_transaction_data txn;
+	struct binder_ctx ctx;
+	struct mgr_msg msg;
+	size_t size;
+
+	binder_ctx_open(&ctx);
+	put_cmd(&ctx, BC_ENTER_LOOPER);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.op = MSG_REGISTER;
+	msg.index = index;
+	msg.obj.type = BINDER_TYPE_BINDER;
+	msg.obj.binder = (void *)(uintptr_t)(index + 1);
+	put_txn(&ctx, BC_TRANSACTION, 0, MSG_REGISTER, &msg, sizeof(msg),
+		&obj_offset, sizeof(obj_offset));
+	expect(binder_wait(&ctx, &txn), BR_REPLY, "server register");
+	put_free_buffer(&ctx, &txn);
+
+	for (;;) {
+		expect(binder_wait(&ctx, &txn), BR_TRANSACTION, "server");
+		/* echo the payload back; copy it out before the free */
+		size = txn.data_size < MAX_PAYLOAD ? txn.data_size :
+			MAX_PAYLOAD;
+		memcpy(payload, txn.data.ptr.buffer, size);
+		put_txn(&ctx, BC_REPLY, 0, 0, payload, size, NULL, 0);
+		put_free_buffer(&ctx, &txn);
+	}
+}
+
+static uint32_t client_lookup(struct binder_ctx *ctx, int index)
+{
+	struct binder_transaction_data txn;
+	struct mgr_reply reply;
+	struct mgr_msg msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.op = MSG_LOOKUP;
+	msg.index = index;
+
+	for (;;) {
+		put_txn(ctx, BC_TRANSACTION, 0, MSG_LOOKUP, &msg,
+			offsetof(struct mgr_msg, obj), NULL, 0);
+		expect(binder_wait(ctx, &txn), BR_REPLY, "client lookup");
+		memset(&reply, 0, sizeof(reply));
+		memcpy(&reply, txn.data.ptr.buffer,
+		       txn.data_size < sizeof(reply) ? txn.data_size :
+		       sizeof(reply));
+		if (reply.found) {
+			/* the buffer's reference goes away with the free */
+			put_handle_cmd(ctx, BC_ACQUIRE, reply.obj.handle);
+			put_free_buffer(ctx, &txn);
+			return reply.obj.handle;
+		}
+		put_free_buffer(ctx, &txn);
+		usleep(10000);
+	}
+}
+
+static void run_client(int index, size_t payload_size)
+{
+	static uint8_t payload[MAX_PAYLOAD];
+	struct binder_transaction_data txn;
+	struct binder_ctx ctx;
+	unsigned long count;
+	uint32_t handle;
+	int round = 0;
+
+	binder_ctx_open(&ctx);
+	handle = client_lookup(&ctx, index);
+	memset(payload, index, payload_size);
+
+	for (;;) {
+		while (shared->round == round)
+			usleep(1000);
+		__sync_synchronize();
+		round = shared->round;
+		if (shared->quit)
+			break;
+		if (index >= shared->active)
+			continue;
+
+		count = 0;
+		while (!shared->stop) {
+			put_txn(&ctx, BC_TRANSACTION, handle, MSG_PING,
+				payload, payload_size, NULL, 0);
+			expect(binder_wait(&ctx, &txn), BR_REPLY, "client");
+			put_free_buffer(&ctx, &txn);
+			count++;
+		}
+		binder_flush(&ctx);
+		shared->count[index] = count;
+		__sync_fetch_and_add(&shared->done, 1);
+	}
+	exit(0);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-p pairs] [-t seconds] [-s payload bytes]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	pid_t servers[MAX_PAIRS], clients[MAX_PAIRS];
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int pairs = ncpus > 0 ? ncpus : 1;
+	size_t payload_size = 32;
+	struct binder_ctx mgr;
+	double start, elapsed, base = 0;
+	unsigned long total;
+	int seconds = 2;
+	int opt, i, p;
+
+	while ((opt = getopt(argc, argv, "p:t:s:")) != -1) {
+		switch (opt) {
+		case 'p':
+			pairs = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 's':
+			payload_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (pairs < 1 || pairs > MAX_PAIRS || seconds < 1 ||
+	    payload_size > MAX_PAYLOAD)
+		usage(argv[0]);
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		die("mmap shared");
+	memset(shared, 0, sizeof(*shared));
+
+	binder_ctx_open(&mgr);
+	if (ioctl(mgr.fd, BINDER_SET_CONTEXT_MGR, 0) < 0)
+		die("BINDER_SET_CONTEXT_MGR (is servicemanager running?)");
+
+	for (i = 0; i < pairs; i++) {
+		servers[i] = fork();
+		if (servers[i] < 0)
+			die("fork");
+		if (!servers[i]) {
+			close(mgr.fd);
+			run_server(i);
+		}
+		clients[i] = fork();
+		if (clients[i] < 0)
+			die("fork");
+		if (!clients[i]) {
+			close(mgr.fd);
+			run_client(i, payload_size);
+		}
+	}
+
+	run_manager(&mgr, pairs);
+
+	printf("%d cpus, %zu byte payload, %d s per run\n",
+	       (int)ncpus, payload_size, seconds);
+	printf("pairs      txn/s   txn/s/pair  scaling\n");
+	for (p = 1; p <= pairs; p++) {
+		shared->stop = 0;
+		shared->done = 0;
+		shared->active = p;
+		__sync_synchronize();
+		start = now();
+		shared->round = p;
+
+		sleep(seconds);
+		shared->stop = 1;
+		elapsed = now() - start;
+		while (shared->done < p)
+			usleep(1000);
+
+		total = 0;
+		for (i = 0; i < p; i++)
+			total += shared->count[i];
+		if (p == 1)
+			base = total / elapsed;
+		printf("%5d %10.0f %12.0f %8.2f\n", p, total / elapsed,
+		       total / elapsed / p, base ? total / elapsed / base : 0);
+	}
+
+	shared->quit = 1;
+	__sync_synchronize();
+	shared->round = pairs + 1;
+	for (i = 0; i < pairs; i++)
+		waitpid(clients[i], NULL, 0);
+	for (i = 0; i < pairs; i++) {
+		kill(servers[i], SIGTERM);
+		waitpid(servers[i], NULL, 0);
+	}
+	return 0;
+}
@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# parallel_read.sh - compare squashfs decompressor modes with a cold
+# cache parallel read
+#
+# usage: parallel_read.sh <image> <mountpoint> [jobs]
+#
+# For each threads= mode the image is mounted, the page cache is dropped,
+# and 'jobs' readers cat every regular file in the image between them.
+# The wall clock time of each run is printed.  Must be run as root.
+
+image=$1
+mnt=$2
+jobs=${3:-$(grep -c ^processor /proc/cpuinfo)}
+
+if [ -z "$image" -o -z "$mnt" ]; then
+	echo "usage: $0 <image> <mountpoint> [jobs]" >&2
+	exit 1
+fi
+
+list=$(mktemp)
+trap 'rm -f $list $list.*' EXIT
+
+for mode in single multi percpu; do
+	if ! mount -t squashfs -o loop,ro,threads=$mode "$image" "$mnt"; then
+		echo "$mode: mount failed" >&2
+		continue
+	fi
+
+	# deal the files out round robin so each reader gets a similar share
+	find "$mnt" -type f > $list
+	i=0
+	while [ $i -lt $jobs ]; do
+		awk -v n=$jobs -v i=$i 'NR % n == i' $list > $list.$i
+		i=$((i + 1))
+	done
+
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+
+	start=$(date +%s.%N)
+	i=0
+	while [ $i -lt $jobs ]; do
+		xargs -d '\n' cat < $list.$i > /dev/null &
+		i=$((i + 1))
+	done
+	wait
+	end=$(date +%s.%N)
+
+	umount "$mnt"
+	echo "threads=$mode jobs=$jobs: $(echo "$end - $start" | bc) s"
+done
@@ -0,0 +1,276 @@
+/*
+ * zram_swap_stress.c - multi-threaded swap stress test for zram
+ *
+ * Forks N writer processes which dirty and re-verify a private anonymous
+ * region each, several passes over, so that the kernel keeps swapping
+ * pages out to and back in from a zram swap device.  The run is repeated
+ * for an increasing max_comp_streams setting, and the aggregate paging
+ * rate and the comp_stream_waits/comp_stream_wait_ns deltas are printed
+ * for each.  With a single compression stream the writers serialize on
+ * it; with one stream per writer the rate should scale with the number
+ * of CPUs and the waits should drop to (nearly) zero.
+ *
+ * Every page carries a pattern derived from its writer, index and pass,
+ * which is checked on the next pass, so a stream handed to two writers
+ * at once shows up as a verify failure rather than just a bad number.
+ *
+ * The writers' footprint must exceed the memory available to them, or
+ * nothing is swapped.  Either boot with a small mem= or run inside a
+ * memory cgroup, and make the zram device the only swap:
+ *
+ *	echo $((1024*1024*1024)) > /sys/block/zram0/disksize
+ *	mkswap /dev/zram0 && swapon /dev/zram0
+ *	mkdir /dev/memcg/stress
+ *	echo $((256*1024*1024)) > /dev/memcg/stress/memory.limit_in_bytes
+ *	echo $$ > /dev/memcg/stress/tasks
+ *	./zram_swap_stress -d zram0 -w 4 -m 128 -p 4
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_WORKERS		64
+
+/* state shared between the parent and the writer processes */
+struct shared {
+	volatile int go;
+	volatile unsigned long errors;
+};
+
+static struct shared *shared;
+static char sysfs_dir[256];
+static long page_size;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static int sysfs_read(const char *attr, unsigned long long *val)
+{
+	char path[512];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, attr);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	ret = fscanf(f, "%llu", val) == 1 ? 0 : -1;
+	fclose(f);
+	return ret;
+}
+
+static void sysfs_write(const char *attr, int val)
+{
+	char path[512];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, attr);
+	f = fopen(path, "w");
+	if (!f)
+		die(path);
+	fprintf(f, "%d\n", val);
+	if (fclose(f))
+		die(path);
+}
+
+static uint32_t seed_of(int worker, size_t page, int pass)
+{
+	uint32_t x = (worker + 1) * 0x9e3779b9u ^ (uint32_t)page * 0x85ebca6bu ^
+		     (pass + 1) * 0xc2b2ae35u;
+
+	return x ? x : 1;
+}
+
+/*
+ * Fill (or check) a page with its pattern: a quarter of pseudo-random
+ * words followed by the seed repeated, so it compresses to a few times
+ * smaller but is never a same-filled page.
+ */
+static unsigned long do_page(uint32_t *p, uint32_t seed, int check)
+{
+	size_t words = page_size / sizeof(*p), i;
+	unsigned long bad = 0;
+	uint32_t x = seed, want;
+
+	for (i = 0; i < words; i++) {
+		if (i < words / 4) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			want = x;
+		} else {
+			want = seed;
+		}
+		if (!check)
+			p[i] = want;
+		else if (p[i] != want)
+			bad++;
+	}
+	return bad;
+}
+
+static void run_worker(int index, size_t pages, int passes)
+{
+	unsigned long errors = 0;
+	uint8_t *region;
+	size_t pg;
+	int pass;
+
+	region = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED)
+		die("mmap region");
+
+	while (!shared->go)
+		usleep(1000);
+
+	for (pass = 0; pass < passes; pass++) {
+		for (pg = 0; pg < pages; pg++) {
+			uint32_t *p = (uint32_t *)(region + pg * page_size);
+
+			if (pass && do_page(p, seed_of(index, pg, pass - 1), 1))
+				errors++;
+			do_page(p, seed_of(index, pg, pass), 0);
+		}
+	}
+	for (pg = 0; pg < pages; pg++)
+		if (do_page((uint32_t *)(region + pg * page_size),
+			    seed_of(index, pg, passes - 1), 1))
+			errors++;
+
+	if (errors)
+		__sync_fetch_and_add(&shared->errors, errors);
+	exit(0);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d zram device] [-w writers] [-m MB per writer]"
+		" [-p passes]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	pid_t pids[MAX_WORKERS];
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int workers = ncpus > 0 ? ncpus : 1;
+	const char *dev = "zram0";
+	unsigned long long waits0, waits1, ns0, ns1;
+	double start, elapsed, base = 0;
+	int passes = 4, mb = 64;
+	int opt, i, streams, last, status;
+	size_t pages;
+
+	while ((opt = getopt(argc, argv, "d:w:m:p:")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'w':
+			workers = atoi(optarg);
+			break;
+		case 'm':
+			mb = atoi(optarg);
+			break;
+		case 'p':
+			passes = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (workers < 1 || workers > MAX_WORKERS || mb < 1 || passes < 1)
+		usage(argv[0]);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	pages = (size_t)mb * 1024 * 1024 / page_size;
+	snprintf(sysfs_dir, sizeof(sysfs_dir), "/sys/block/%s", dev);
+	if (access(sysfs_dir, F_OK) ||
+	    sysfs_read("max_comp_streams", &waits0))
+		die("max_comp_streams (is the zram stream pool built in?)");
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		die("mmap shared");
+
+	printf("%s: %d writers x %d MB, %d passes, %d cpus\n",
+	       dev, workers, mb, passes, (int)ncpus);
+	printf("streams     MB/s  scaling      waits   wait ms\n");
+
+	/* 1, 2, 4, ... streams, always finishing with one per writer */
+	for (streams = 1, last = 0; !last; streams *= 2) {
+		if (streams >= workers) {
+			streams = workers;
+			last = 1;
+		}
+		sysfs_write("max_comp_streams", streams);
+
+		shared->go = 0;
+		fflush(stdout);
+		for (i = 0; i < workers; i++) {
+			pids[i] = fork();
+			if (pids[i] < 0)
+				die("fork");
+			if (!pids[i])
+				run_worker(i, pages, passes);
+		}
+
+		if (sysfs_read("comp_stream_waits", &waits0) ||
+		    sysfs_read("comp_stream_wait_ns", &ns0))
+			waits0 = ns0 = 0;
+		__sync_synchronize();
+		start = now();
+		shared->go = 1;
+		for (i = 0; i < workers; i++) {
+			waitpid(pids[i], &status, 0);
+			if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+				fprintf(stderr, "writer %d failed\n", i);
+				return 1;
+			}
+		}
+		elapsed = now() - start;
+		if (sysfs_read("comp_stream_waits", &waits1) ||
+		    sysfs_read("comp_stream_wait_ns", &ns1))
+			waits1 = ns1 = 0;
+
+		/* each pass writes every page once, plus the final check */
+		if (streams == 1)
+			base = (double)workers * mb * (passes + 1) / elapsed;
+		printf("%7d %8.1f %8.2f %10llu %9.1f\n", streams,
+		       workers * mb * (passes + 1) / elapsed,
+		       workers * mb * (passes + 1) / elapsed / base,
+		       waits1 - waits0, (ns1 - ns0) / 1e6);
+
+		if (shared->errors) {
+			fprintf(stderr, "%lu pages failed to verify\n",
+				shared->errors);
+			return 1;
+		}
+	}
+	return 0;
+}